@@ -0,0 +1,360 @@
+#! /usr/bin/env python3
+
+# AUTHOR: Yu-Chung Hsiao
+# DATE  : Oct. 19, 2026
+# EMAIL : project.caplet@gmail.com
+#
+# This file is part of CAPLET.
+#
+# CAPLET is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# CAPLET is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser General Public License for more details.
+#
+# You should have received a copy of the Lesser GNU General Public License
+# along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+
+# Benchmark of the CAPLET pipeline on synthetic layouts
+#
+# Each case generates a parametrized .geo file, runs caplet_geo_cli and
+# caplet_solver with --metrics, and collects the wall time of each stage
+# (loadGeo, basis construction, fill, factorization, ...) for increasing
+# sizes and for OpenMP and MPI runs. Results are written as CSV and JSON.
+# With a baseline, the run fails when a stage is slower than the baseline
+# by more than the tolerance, or when the capacitance matrix changes.
+
+
+import argparse
+import csv
+import json
+import os
+import shlex
+import subprocess
+import sys
+
+
+BENCH_DIR  = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR   = os.path.dirname(BENCH_DIR)
+GEO_CLI    = os.path.join(ROOT_DIR, 'caplet_geo', 'caplet_geo_cli')
+SOLVER_MPI = os.path.join(ROOT_DIR, 'caplet_solver', 'bin', 'capletMPI')
+SOLVER_OMP = os.path.join(ROOT_DIR, 'caplet_solver', 'bin', 'capletOpenMP')
+
+# unit of all generated coordinates (nm): wire width and spacing
+W = 100
+
+# metal layers: (index, z_min, z_max); vias: (index, z_min, z_max, bottom, top)
+METALS = [(0, 0, 200), (1, 400, 600)]
+VIAS   = [(2, 200, 400, 0, 1)]
+
+
+#**
+#* .geo writer
+#* - layers: {layer_index: [rect]}, rect = (x1, y1, x2, y2)
+#* - touching rectangles of a layer form one conductor in caplet_geo
+def write_geo(filename, layers, vias=False):
+    via_list = VIAS if vias else []
+    lines = [str(len(METALS))]
+    lines += ['%d, %d, %d' % m for m in METALS]
+    lines += [str(len(via_list))]
+    lines += ['%d, %d, %d, %d, %d' % v for v in via_list]
+    for index in [m[0] for m in METALS] + [v[0] for v in via_list]:
+        rects = layers.get(index, [])
+        lines += [str(index), str(len(rects))]
+        for (x1, y1, x2, y2) in rects:
+            lines += ['5', '%d, %d' % (x1, y1), '%d, %d' % (x2, y1),
+                      '%d, %d' % (x2, y2), '%d, %d' % (x1, y2), '%d, %d' % (x1, y1)]
+    with open(filename, 'w') as f:
+        f.write('\n'.join(lines) + '\n')
+
+
+#**
+#* N x N crossing buses on two metal layers (2N conductors)
+def gen_bus(n):
+    pitch  = 2*W
+    length = pitch*n + W
+    m0 = [(0, W + pitch*k, length, 2*W + pitch*k) for k in range(n)]
+    m1 = [(W + pitch*k, 0, 2*W + pitch*k, length) for k in range(n)]
+    return {0: m0, 1: m1}, False
+
+
+#**
+#* comb with n fingers and a serpentine meandering around the fingers
+#* (2 conductors); the serpentine makes a U-turn in every gap and passes
+#* over the finger tips
+def gen_comb(n):
+    period = 6*W
+    height = 20*W
+    comb = [(0, 0, period*n + W, W)]
+    comb += [(period*k, W, period*k + W, height) for k in range(n + 1)]
+    serp = []
+    for k in range(n):
+        x = period*k
+        serp += [(x + 2*W, 2*W, x + 3*W, height + 3*W),        # down
+                 (x + 3*W, 2*W, x + 4*W, 3*W),                 # U-turn
+                 (x + 4*W, 2*W, x + 5*W, height + 2*W)]        # up
+        if k + 1 < n:
+            serp += [(x + 4*W, height + 2*W, x + 9*W, height + 3*W)]   # over the tip
+    return {0: comb + serp}, False
+
+
+#**
+#* n straps; each is a line on both metal layers joined by n vias
+#* (n conductors)
+def gen_via(n):
+    pitch  = 3*W
+    length = 2*W*(2*n + 1)
+    m0 = [(0, pitch*k, length, pitch*k + W) for k in range(n)]
+    m1 = list(m0)
+    via = [(2*W*(2*j + 1), pitch*k, 2*W*(2*j + 1) + W, pitch*k + W)
+           for k in range(n) for j in range(n)]
+    return {0: m0, 1: m1, 2: via}, True
+
+
+#**
+#* n rows of n standard cells between power rails on metal 0, with
+#* two pins per cell and n vertical routes on metal 1
+#* ((n+1) rails + 2n^2 pins + n routes)
+def gen_cells(n):
+    cell   = 8*W
+    row    = 12*W
+    width  = cell*n
+    rails  = [(0, row*r, width, row*r + 2*W) for r in range(n + 1)]
+    pins   = []
+    for r in range(n):
+        y = row*r
+        for c in range(n):
+            x = cell*c
+            pins += [(x + 2*W, y + 4*W, x + 3*W, y + 10*W),
+                     (x + 5*W, y + 4*W, x + 6*W, y + 10*W)]
+    routes = [(cell*c + 4*W - W//2, 0, cell*c + 4*W + W//2, row*n + 2*W) for c in range(n)]
+    return {0: rails + pins, 1: routes}, False
+
+
+CASES = {
+    'bus':   (gen_bus,   [4, 8, 16],  [4, 8]),
+    'comb':  (gen_comb,  [8, 16, 32], [8, 16]),
+    'via':   (gen_via,   [4, 8, 12],  [4, 8]),
+    'cells': (gen_cells, [2, 4, 6],   [2, 4]),
+}
+
+
+#**
+#* metrics helpers
+def find_phase(phases, path):
+    # path: list of nested phase names
+    for p in phases:
+        if p['name'] == path[0]:
+            return p if len(path) == 1 else find_phase(p['children'], path[1:])
+    return None
+
+# stage name: (program, phase path)
+STAGES = [
+    ('load_geo',        'geo',    ['load_geo']),
+    ('basis',           'geo',    ['instantiable_basis']),
+    ('parse',           'solver', ['parse']),
+    ('aspect_ratio',    'solver', ['extract', 'aspect_ratio_split']),
+    ('fill',            'solver', ['extract', 'fill']),
+    ('gather',          'solver', ['extract', 'fill', 'gather']),
+    ('factorization',   'solver', ['extract', 'factorization']),
+    ('cmat_gemm',       'solver', ['extract', 'cmat_gemm']),
+    ('extract',         'solver', ['extract']),
+]
+
+
+#**
+#* run a command in the output folder; caplet_geo_cli writes its
+#* results to the working directory
+def run(command, args):
+    args.log.write('$ ' + ' '.join(command) + '\n')
+    args.log.flush()
+    result = subprocess.call(command, stdout=args.log, stderr=subprocess.STDOUT,
+                             cwd=args.output)
+    if result != 0:
+        raise RuntimeError('command failed (%d): %s' % (result, ' '.join(command)))
+
+
+#**
+#* run a command args.repeat times and keep the fastest wall time of
+#* each stage of the program; return ({stage: seconds}, last metrics)
+def run_repeated(args, program, command, metrics_name):
+    best = {}
+    m = None
+    for r in range(args.repeat):
+        run(command, args)
+        with open(metrics_name) as f:
+            m = json.load(f)
+        for stage, stage_program, path in STAGES:
+            if stage_program != program:
+                continue
+            p = find_phase(m['phases'], path)
+            if p is not None:
+                best[stage] = min(best.get(stage, p['wall_s']), p['wall_s'])
+    return best, m
+
+
+def read_cmat(filename):
+    with open(filename) as f:
+        return [[float(v) for v in line.split()] for line in f if line.strip()]
+
+
+def bench_case(args, name, size, configs):
+    gen = CASES[name][0]
+    base = os.path.join(args.output, '%s_%d' % (name, size))
+    layers, vias = gen(size)
+    write_geo(base + '.geo', layers, vias)
+
+    rows = []
+    best, m = run_repeated(args, 'geo',
+                           [GEO_CLI, '--metrics', base + '.geo.json', base + '.geo'],
+                           base + '.geo.json')
+    for stage, _, _ in STAGES:
+        if stage in best:
+            rows.append({'case': name, 'size': size, 'config': 'geo', 'stage': stage,
+                         'wall_s': best[stage],
+                         'conductors': m['counters'].get('conductors', 0),
+                         'basis_shapes': m['counters'].get('basis_shapes', 0)})
+
+    for config in configs:
+        if config == 'omp':
+            command = [SOLVER_OMP]
+        else:
+            command = shlex.split(args.mpirun) + ['-np', config[3:], SOLVER_MPI]
+        metrics_name = base + '.' + config + '.json'
+        best, m = run_repeated(args, 'solver',
+                               command + [base + '.caplet', '-o', base + '.cmat',
+                                          '--metrics', metrics_name], metrics_name)
+        for stage, _, _ in STAGES:
+            if stage in best:
+                rows.append({'case': name, 'size': size, 'config': config, 'stage': stage,
+                             'wall_s': best[stage],
+                             'conductors': int(m['values']['conductors']),
+                             'basis_shapes': int(m['values']['basis_shapes']),
+                             'ranks': int(m['values']['ranks']),
+                             'threads': int(m['values']['threads'])})
+
+    #* all configurations write the same Cmat up to round-off; keep the last one
+    cmat = read_cmat(base + '.cmat')
+
+    diag = [cmat[i][i] for i in range(len(cmat))]
+    return rows, diag
+
+
+#**
+#* compare against the baseline; return a list of failure messages
+def compare(results, baseline, tol, floor, accuracy_tol):
+    failures = []
+    base_rows = dict(((r['case'], r['size'], r['config'], r['stage']), r)
+                     for r in baseline['rows'])
+    for r in results['rows']:
+        b = base_rows.get((r['case'], r['size'], r['config'], r['stage']))
+        if b is None:
+            continue
+        if r['wall_s'] > b['wall_s']*(1 + tol) and r['wall_s'] - b['wall_s'] > floor:
+            failures.append('%s_%d %s %s: %.4f s (baseline %.4f s, +%.0f%%)'
+                            % (r['case'], r['size'], r['config'], r['stage'],
+                               r['wall_s'], b['wall_s'], 100*(r['wall_s']/b['wall_s'] - 1)))
+    for key, diag in results['cmat_diagonal'].items():
+        b = baseline.get('cmat_diagonal', {}).get(key)
+        if b is None or len(b) != len(diag):
+            continue
+        err = max(abs(x - y)/abs(y) for x, y in zip(diag, b) if y != 0)
+        if err > accuracy_tol:
+            failures.append('%s: Cmat diagonal changed by %.2e (tolerance %.0e)'
+                            % (key, err, accuracy_tol))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Benchmark caplet_geo and caplet_solver on synthetic layouts")
+    parser.add_argument("-c", "--case", dest="cases", action="append",
+                        choices=sorted(CASES.keys()),
+                        help="case to run (default: all)")
+    parser.add_argument("-s", "--sizes", dest="sizes",
+                        help="comma-separated sizes for all cases (default: per case)")
+    parser.add_argument("-q", "--quick", action="store_true",
+                        help="run the two smallest default sizes only")
+    parser.add_argument("-r", "--ranks", default="1,2",
+                        help="comma-separated MPI rank counts (default: 1,2; empty: none)")
+    parser.add_argument("--no-openmp", action="store_true",
+                        help="skip capletOpenMP runs")
+    parser.add_argument("--mpirun", default="mpirun",
+                        help="MPI launcher command (default: mpirun)")
+    parser.add_argument("-n", "--repeat", type=int, default=1,
+                        help="runs per configuration; the fastest is kept (default: 1)")
+    parser.add_argument("-o", "--output", default=os.path.join(BENCH_DIR, 'out'),
+                        help="folder of generated files and results (default: bench/out)")
+    parser.add_argument("-b", "--baseline",
+                        help="baseline JSON file to compare with")
+    parser.add_argument("--save-baseline", metavar="FILE",
+                        help="write the results as a new baseline")
+    parser.add_argument("-t", "--tolerance", type=float, default=0.25,
+                        help="allowed relative slowdown of a stage (default: 0.25)")
+    parser.add_argument("--floor", type=float, default=0.05,
+                        help="slowdowns below this many seconds are ignored (default: 0.05)")
+    parser.add_argument("--accuracy", type=float, default=1e-3,
+                        help="allowed relative change of the Cmat diagonal (default: 1e-3)")
+    args = parser.parse_args()
+
+    for binary in [GEO_CLI, SOLVER_MPI, SOLVER_OMP]:
+        if not os.path.exists(binary):
+            print('ERROR: %s not found; build caplet_geo_cli and caplet_solver first' % binary)
+            return 2
+    args.output = os.path.abspath(args.output)
+    if not os.path.isdir(args.output):
+        os.makedirs(args.output)
+
+    configs = [] if args.no_openmp else ['omp']
+    configs += ['mpi' + r.strip() for r in args.ranks.split(',') if r.strip()]
+
+    results = {'rows': [], 'cmat_diagonal': {}}
+    log_name = os.path.join(args.output, 'bench.log')
+    with open(log_name, 'w') as args.log:
+        for name in (args.cases or sorted(CASES.keys())):
+            if args.sizes:
+                sizes = [int(s) for s in args.sizes.split(',')]
+            else:
+                sizes = CASES[name][2] if args.quick else CASES[name][1]
+            for size in sizes:
+                print('BENCH: %s_%d ...' % (name, size))
+                sys.stdout.flush()
+                rows, diag = bench_case(args, name, size, configs)
+                results['rows'] += rows
+                results['cmat_diagonal']['%s_%d' % (name, size)] = diag
+
+    #* CSV and JSON
+    fields = ['case', 'size', 'config', 'stage', 'wall_s',
+              'conductors', 'basis_shapes', 'ranks', 'threads']
+    with open(os.path.join(args.output, 'results.csv'), 'w') as f:
+        writer = csv.DictWriter(f, fieldnames=fields, restval='')
+        writer.writeheader()
+        for r in results['rows']:
+            writer.writerow(r)
+    with open(os.path.join(args.output, 'results.json'), 'w') as f:
+        json.dump(results, f, indent=1)
+    print('BENCH: results in %s (results.csv, results.json, bench.log)' % args.output)
+
+    if args.save_baseline:
+        with open(args.save_baseline, 'w') as f:
+            json.dump(results, f, indent=1)
+        print('BENCH: baseline saved to %s' % args.save_baseline)
+
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        failures = compare(results, baseline, args.tolerance, args.floor, args.accuracy)
+        for msg in failures:
+            print('REGRESSION: ' + msg)
+        if failures:
+            return 1
+        print('BENCH: no regression against %s' % args.baseline)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -11,12 +11,17 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 TARGET = caplet_geo
 TEMPLATE = app
 
+QMAKE_CXXFLAGS += -fopenmp
+QMAKE_LFLAGS   += -fopenmp
+DEFINES        += CAPLET_OPENMP
+
 
 SOURCES += main.cpp\
         mainwindow.cpp \
     geoloader.cpp \
     panelrenderer.cpp \
     gdsgeometry.cpp \
+    geometrics.cpp \
     colorpalette.cpp
 
 HEADERS  += mainwindow.h \
@@ -24,6 +29,8 @@ HEADERS  += mainwindow.h \
     panelrenderer.h \
     gdsgeometry.h \
     debug.h \
+    geoarena.h \
+    geometrics.h \
     colorpalette.h
 
 FORMS    += mainwindow.ui \
@@ -30,6 +30,9 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 //#define DEBUG_PANEL_DISCRETIZATION
 //#define DEBUG_CUT
 //#define DEBUG_POLY2RECT
+//- DEBUG_GEO_ARENA
+//  print GeoArena usage at the end of loadGeo
+//#define DEBUG_GEO_ARENA
 
 
 
@@ -52,10 +55,45 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 //* - No projection distance info is used
 //#define MERGE_PROJECTION_VER1_0
 
+//* Number of threads for basis function instantiation
+//* - effective when compiled with -fopenmp -DCAPLET_OPENMP
+#ifdef CAPLET_OPENMP
+    #define CAPLET_OPENMP_NUM_THREADS 4
+#endif
+
 namespace caplet{
     const float DEFAULT_PROJECTION_MERGE_DISTANCE = 1e-7f;
     const float DEFAULT_PROJECTION_DISTANCE = 2e-6f;
     const float DEFAULT_COINCIDENTAL_MARGIN = 0.05;
+
+    //* Graded PWC basis functions (discretizeDisjointSurface)
+    //* - number of panels, each smaller by the growth ratio, between
+    //*   conductor edges and panels of the suggested size
+    const int   PWC_GRADING_LEVELS = 4;
+
+    //* Via arrays merged into blocks (GeoLoader::setViaArrayMerging)
+    //* - at least this many vias in both x and y
+    //* - spacing between vias at most this ratio of the via size
+    const int   VIA_ARRAY_MIN_COUNT = 2;
+    const float VIA_ARRAY_MAX_SPACING_RATIO = 1.5f;
+
+    //* Basis function budget (pruneBasisFunction)
+    //* - arches of the same length on the same line overlapping by at
+    //*   least this ratio of their length are merged
+    //* - tolerance of coordinates, relative to the arch length
+    const float BASIS_FUNCTION_MERGE_OVERLAP = 0.6f;
+    const float BASIS_FUNCTION_MERGE_MARGIN = 1e-3f;
+
+    //* Reference Cmat (GeoLoader::computeReference)
+    //* - panel size ratio between levels (caplet_geo_cli)
+    //* - refinement levels extracted at a time, and at most in total
+    //* - order of the panel-size error and the number of last levels
+    //*   fitted for Richardson extrapolation
+    const float DEFAULT_REFERENCE_REFINEMENT = 1.5f;
+    const int   REFERENCE_CONCURRENT_LEVELS = 2;
+    const int   REFERENCE_MAX_LEVELS = 8;
+    const float REFERENCE_ORDER = 1.0f;
+    const int   REFERENCE_FIT_LEVELS = 3;
 };
 
 #endif // DEBUG_H
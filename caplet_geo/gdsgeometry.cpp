@@ -27,6 +27,7 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 using namespace std;
 
@@ -98,8 +99,8 @@ bool Polygon::isManhattan() const
         return false;
     }
 
-    list<Point>::const_iterator eachVertexIt = ++this->begin();
-    list<Point>::const_iterator prevVertexIt =   this->begin();
+    PointList::const_iterator eachVertexIt = ++this->begin();
+    PointList::const_iterator prevVertexIt =   this->begin();
     bool dirFlag = ( (*prevVertexIt).x == this->back().x ) ? true : false;
     for ( ; eachVertexIt != this->end();
          ++eachVertexIt, ++prevVertexIt)
@@ -158,9 +159,9 @@ Rectangle::Rectangle( const Polygon &poly ) throw (ShapeTransformationError)
         ss << "Polygon contains more than five points, size = " << poly.size();
         throw ShapeTransformationError(ss.str());
     }
-    list<Point>::const_iterator p1 = poly.begin();
-    list<Point>::const_iterator p2 = ++(poly.begin());
-    list<Point>::const_reverse_iterator p4 = poly.rbegin();
+    PointList::const_iterator p1 = poly.begin();
+    PointList::const_iterator p2 = ++(poly.begin());
+    PointList::const_reverse_iterator p4 = poly.rbegin();
 
     if ( p1->x == p2->x ) {
         //* if p1 and p2 are of the same x coord
@@ -1061,6 +1062,38 @@ RectangleGL RectangleGL::intersectProjection(const RectangleGL &rect) const
     return result;
 }
 
+bool RectangleGL::projectFrom(const RectangleGL &rect, const float distance, RectangleGL &projection) const
+{
+    if ( !(//* x-dir normal
+         ( rect.xn > 0 && xn < 0 && rect.x1 < x1 && x1 < rect.x1+distance ) ||
+         ( rect.xn < 0 && xn > 0 && x1 < rect.x1 && rect.x1 < x1+distance ) ||
+         //* y-dir normal
+         ( rect.yn > 0 && yn < 0 && rect.y1 < y1 && y1 < rect.y1+distance ) ||
+         ( rect.yn < 0 && yn > 0 && y1 < rect.y1 && rect.y1 < y1+distance ) ||
+         //* z-dir normal
+         ( rect.zn > 0 && zn < 0 && rect.z1 < z1 && z1 < rect.z1+distance ) ||
+         ( rect.zn < 0 && zn > 0 && z1 < rect.z1 && rect.z1 < z1+distance )
+         ) ) {
+        return false;
+    }
+
+    if (isOverlappingProjection(rect)==false){
+        return false;
+    }
+
+    projection = intersectProjection(rect);
+    if (projection.xn!=0){
+        projection.shapeNormalDistance = abs(rect.x1-x1);
+    }
+    else if (projection.yn!=0){
+        projection.shapeNormalDistance = abs(rect.y1-y1);
+    }
+    else if (projection.zn!=0){
+        projection.shapeNormalDistance = abs(rect.z1-z1);
+    }
+    return true;
+}
+
 
 RectangleGL RectangleGL::intersectArchOnFlat(const RectangleGL &flat) const
 {
@@ -1226,6 +1259,7 @@ ConductorFP::ConductorFP(const Conductor &cond, const float unit)
 {
     for ( int layerIndex = 0; layerIndex < nLayer; ++layerIndex ){
         for ( unsigned dirIndex = 0; dirIndex < nDir; ++dirIndex){
+            layer[layerIndex][dirIndex].reserve(cond.layer[layerIndex][dirIndex].size());
             for ( RectangleList::const_iterator eachRect = cond.layer[layerIndex][dirIndex].begin();
                     eachRect != cond.layer[layerIndex][dirIndex].end(); ++eachRect ){
                 layer[layerIndex][dirIndex].push_back(RectangleGL(*eachRect, unit));
@@ -1249,25 +1283,25 @@ unsigned ConductorFP::size() const
 }
 
 ConductorFPList::ConductorFPList(const allocator_type &allo)
-    : list<ConductorFP>(allo)
+    : vector<ConductorFP>(allo)
 { }
 
 ConductorFPList::ConductorFPList(
         size_type n,
         const ConductorFP &value,
         const allocator_type &allo)
-    : list<ConductorFP>(n, value, allo)
+    : vector<ConductorFP>(n, value, allo)
 { }
 
 ConductorFPList::ConductorFPList(
         iterator first,
         iterator last,
         const allocator_type &allo)
-    : list<ConductorFP>(first, last, allo)
+    : vector<ConductorFP>(first, last, allo)
 { }
 
 ConductorFPList::ConductorFPList(const ConductorFPList &condFGList)
-    : list<ConductorFP>()
+    : vector<ConductorFP>()
 {
     this->insert(this->begin(), condFGList.begin(), condFGList.end());
 }
@@ -1275,6 +1309,7 @@ ConductorFPList::ConductorFPList(const ConductorFPList &condFGList)
 void ConductorFPList::constructFrom(const ConductorList &condList, const float unit)
 {
     this->clear();
+    this->reserve(condList.size());
     for ( ConductorList::const_iterator eachCond = condList.begin();
             eachCond != condList.end(); ++eachCond){
         this->push_back(ConductorFP(*eachCond, unit));
@@ -1282,7 +1317,7 @@ void ConductorFPList::constructFrom(const ConductorList &condList, const float u
 }
 
 ConductorFPList::ConductorFPList(const ConductorList &condList, const float unit)
-    : list<ConductorFP>()
+    : vector<ConductorFP>()
 {
     this->constructFrom(condList, unit);
 }
@@ -1295,314 +1330,338 @@ ConductorFPList::ConductorFPList(const ConductorList &condList, const float unit
 //*
 
 RectangleGLList::RectangleGLList(const allocator_type &allo)
-    : list<RectangleGL> (allo)
+    : vector<RectangleGL> (allo)
 { }
 
 RectangleGLList::RectangleGLList(size_type n, const RectangleGL &value, const allocator_type &allo)
-    : list<RectangleGL> (n, value, allo)
+    : vector<RectangleGL> (n, value, allo)
 { }
 
 RectangleGLList::RectangleGLList(iterator first, iterator last, const allocator_type &allo)
-    : list<RectangleGL> (first, last, allo)
+    : vector<RectangleGL> (first, last, allo)
 { }
 
 RectangleGLList::RectangleGLList(const RectangleGLList &rectList)
-    : list<RectangleGL> (rectList)
+    : vector<RectangleGL> (rectList)
 { }
 
 //**
-//* mergeProjection Ver1.0
-//* - Only used when 'this' RectangleGLList contains only one signed direction
-//*   (being as part of a condcutorFPList)
-//* - If each contains what is after, then erase the latter one.
-//* - If only overlapping with the same boundaries, then merge (update *each and erase *after)
-//* - Inner loop returns to the first one if any modification happens to the list
-//* - does not support sublayer
-void RectangleGLList::mergeProjection()
+//* mergeProjectionScan
+//* - shared body of mergeProjection() and mergeProjection1_1()
+//* - rects: rects from the first projection to the end in list order
+//* - alive: set to false for the rects to be erased
+//* - For each rect, the earliest qualifying rect is absorbed and the scan
+//*   starts over, skipping the first live rect once anything is erased.
+//*   This is the visiting order of the former list-based double loop, so
+//*   the result is unchanged; candidates come from a RectangleGLIndex
+//*   instead of a scan over the whole list.
+static bool absorbProjection(RectangleGL &each, const RectangleGL &after,
+                             const bool flagVer1_1, const float zero);
+static void mergeProjectionScan(vector<RectangleGL*> &rects, vector<bool> &alive,
+                                const bool flagVer1_1, const float zero)
 {
-    iterator first = this->begin();
+    const unsigned n = rects.size();
+    alive.assign(n, true);
 
-    //* Find the first projection
-    for ( iterator each=this->begin(); each!=end(); ++each){
-        if (each->shapeShift!=0){
-            first = each;
-            break;
-        }
+    RectangleGLIndex index;
+    for ( unsigned i=0; i<n; ++i ){
+        index.insert(*rects[i], i);
     }
+    index.build();
 
-    //* From the first projection, find
-    for ( iterator each = first; each != end(); ++each ){
-        for ( iterator after = first; after != end(); ++after){
-
-            //* Inner loop starts from the next of each
-            if (after==each){
-                continue;
-            }
-
-            //* Debug: must be in the same direction (regardless of sign)
-            if (each->xn*after->xn==0 && each->yn*after->yn==0 && each->zn*after->zn==0){
-                cerr << "ERROR: should be in the same direction (regardless of sign)" << endl;
-                continue;
-            }
-
-            //* Check if *each and *after are on the same surface
-            //  and either overlapping or edge neighboring
-            if (each->isOverlappingOrEdgeNeighboring(*after)==false){
-                continue;
-            }
+    unsigned first = 0;
+    vector<unsigned> candidateList;
+    for ( unsigned i=0; i<n; ++i ){
+        RectangleGL &each = *rects[i];
+        if (alive[i]==false || (flagVer1_1 && each.shapeShift==0)){
+            continue;
+        }
 
-            //* If containing, erase later
-            bool flagEraseAfter = false;
-            if (each->isContaining(*after)==true){
-                flagEraseAfter = true;
+        bool flagErased = false;
+        bool flagFound = true;
+        while (flagFound){
+            flagFound = false;
+            while (first<n && alive[first]==false){
+                ++first;
             }
 
-            //* If overlapping, not containing, same sign of direction
-            else if (each->zn!=0 && each->z1==after->z1){
-                //* z-dir
-                if ( each->x1==after->x1 && each->x2==after->x2 ){
-                    //* same xrange
-                    each->y1 = min(each->y1, after->y1);
-                    each->y2 = max(each->y2, after->y2);
-                    flagEraseAfter = true;
-                }
-                else if ( each->y1==after->y1 && each->y2==after->y2 ){
-                    //* same yrange
-                    each->x1 = min(each->x1, after->x1);
-                    each->x2 = max(each->x2, after->x2);
-                    flagEraseAfter = true;
+            const float plane = (each.xn!=0)? each.x1 : (each.yn!=0)? each.y1 : each.z1;
+            index.query(each, plane, plane, candidateList);
+            for ( vector<unsigned>::const_iterator eachId = candidateList.begin();
+                  eachId != candidateList.end(); ++eachId ){
+                const unsigned j = *eachId;
+                if (j==i || alive[j]==false || (flagErased && j==first)){
+                    continue;
                 }
-            }
-            else if (each->xn!=0 && each->x1==after->x1){
-                //* x-dir
-                each->y1 = min(each->y1, after->y1);
-                each->y2 = max(each->y2, after->y2);
-                flagEraseAfter = true;
-            }
-            else if (each->yn!=0 && each->y1==after->y1){
-                //* y-dir
-                each->x1 = min(each->x1, after->x1);
-                each->x2 = max(each->x2, after->x2);
-                flagEraseAfter = true;
-            }
-
-            if (flagEraseAfter==true){
-                if (after==first){
-                    after = erase(after);
-                    first = after;
+                if (flagVer1_1 && rects[j]->shapeShift==0){
+                    continue;
                 }
-                else{
-                    after = erase(after);
-                    after = first;
+                if (absorbProjection(each, *rects[j], flagVer1_1, zero)==true){
+                    alive[j] = false;
+                    flagErased = true;
+                    flagFound = true;
+                    break;
                 }
             }
         }
+        if (flagErased==true){
+            //* register the grown extent
+            index.insert(each, i);
+        }
     }
 }
 
-
 //**
-//* mergeProjection Ver1.1
-//* - Only used when 'this' RectangleGLList contains only one signed direction
-//*   (being as part of a condcutorFPList)
-//* - Honor the shapeNormalDistance info
-//* - Assume the grid size is 1e-9 (zero)
-//* - If each contains what is after, then erase the latter one.
-//* - If only overlapping with the same boundaries, then merge (update *each and erase *after)
-//* - does not support sublayer
-void RectangleGLList::mergeProjection1_1(const float projectionMergeDistance)
+//* absorbProjection
+//* - merge condition for one (each, after) pair
+//* - return true if after should be erased; each may be extended
+static bool absorbProjection(RectangleGL &each, const RectangleGL &after,
+                             const bool flagVer1_1, const float zero)
 {
-    const float zero = projectionMergeDistance;
-    iterator first = this->begin();
+    //* Check if each and after are on the same surface
+    //  and either overlapping or edge neighboring
+    if (each.isOverlappingOrEdgeNeighboring(after)==false){
+        return false;
+    }
 
-    //* Find the first projection
-    for ( iterator each=this->begin(); each!=end(); ++each){
-        if (each->shapeShift!=0){
-            first = each;
-            break;
+    //* Ver1.0
+    if (flagVer1_1==false){
+        //* Debug: must be in the same direction (regardless of sign)
+        if (each.xn*after.xn==0 && each.yn*after.yn==0 && each.zn*after.zn==0){
+            cerr << "ERROR: should be in the same direction (regardless of sign)" << endl;
+            return false;
         }
-    }
 
-    //* From the first projection, find
-    for ( iterator each = first; each != end(); ++each ){
-        if (each->shapeShift==0){
-            continue;
+        //* If containing, erase later
+        if (each.isContaining(after)==true){
+            return true;
         }
-        for ( iterator after = first; after != end(); ++after){
-            //* Inner loop starts from the next of each
-            if (after==each){
-                continue;
-            }
 
-            if (after->shapeShift==0){
-                continue;
+        //* If overlapping, not containing, same sign of direction
+        if (each.zn!=0 && each.z1==after.z1){
+            //* z-dir
+            if ( each.x1==after.x1 && each.x2==after.x2 ){
+                //* same xrange
+                each.y1 = min(each.y1, after.y1);
+                each.y2 = max(each.y2, after.y2);
+                return true;
             }
-
-            //* Check if *each and *after are on the same surface
-            //  and either overlapping or edge neighboring
-            if (each->isOverlappingOrEdgeNeighboring(*after)==false){
-                continue;
+            else if ( each.y1==after.y1 && each.y2==after.y2 ){
+                //* same yrange
+                each.x1 = min(each.x1, after.x1);
+                each.x2 = max(each.x2, after.x2);
+                return true;
             }
+        }
+        else if (each.xn!=0 && each.x1==after.x1){
+            //* x-dir
+            each.y1 = min(each.y1, after.y1);
+            each.y2 = max(each.y2, after.y2);
+            return true;
+        }
+        else if (each.yn!=0 && each.y1==after.y1){
+            //* y-dir
+            each.x1 = min(each.x1, after.x1);
+            each.x2 = max(each.x2, after.x2);
+            return true;
+        }
+        return false;
+    }
 
-            //* If containing and *after is farther than *each, erase *after later
-            bool flagEraseAfter = false;
-            if (each->isContaining(*after)==true &&
-                each->shapeNormalDistance <= after->shapeNormalDistance ){
+    //* Ver1.1
+    //* If containing and after is farther than each, erase after
+    if (each.isContaining(after)==true &&
+        each.shapeNormalDistance <= after.shapeNormalDistance ){
+        return true;
+    }
 
-                flagEraseAfter = true;
-            }
+    //* If overlapping but not containing with the same sign of direction
+    //* and projected from the same distance
+    const bool flagSameDistance = abs(each.shapeNormalDistance-after.shapeNormalDistance)<zero;
+    if (each.zn * after.zn == 1){
+        //* z-dir
+        if ( each.x1==after.x1 && each.x2==after.x2 && flagSameDistance ){
+            //* same xrange
+            each.y1 = min(each.y1, after.y1);
+            each.y2 = max(each.y2, after.y2);
+            return true;
+        }
+        else if ( each.y1==after.y1 && each.y2==after.y2 && flagSameDistance ){
+            //* same yrange
+            each.x1 = min(each.x1, after.x1);
+            each.x2 = max(each.x2, after.x2);
+            return true;
+        }
+    }
+    else if (each.xn * after.xn == 1){
+        //* x-dir
+        if ( flagSameDistance ){
+            each.y1 = min(each.y1, after.y1);
+            each.y2 = max(each.y2, after.y2);
+            return true;
+        }
+    }
+    else if (each.yn * after.yn == 1){
+        //* y-dir
+        if ( flagSameDistance ){
+            each.x1 = min(each.x1, after.x1);
+            each.x2 = max(each.x2, after.x2);
+            return true;
+        }
+    }
+    return false;
+}
 
-            //* If overlapping but not containing with the same sign of direction
-            //* and projected from the same distance
-            else if (each->zn * after->zn == 1){
-                //* z-dir
-                if ( each->x1==after->x1 && each->x2==after->x2 &&
-                     abs(each->shapeNormalDistance-after->shapeNormalDistance)<zero ){
-                    //* same xrange
-                    each->y1 = min(each->y1, after->y1);
-                    each->y2 = max(each->y2, after->y2);
-                    flagEraseAfter = true;
-                }
-                else if ( each->y1==after->y1 && each->y2==after->y2 &&
-                          abs(each->shapeNormalDistance-after->shapeNormalDistance)<zero ){
-                    //* same yrange
-                    each->x1 = min(each->x1, after->x1);
-                    each->x2 = max(each->x2, after->x2);
-                    flagEraseAfter = true;
-                }
-            }
-            else if (each->xn * after->xn == 1){
-                //* x-dir
-                if ( abs(each->shapeNormalDistance-after->shapeNormalDistance)<zero ){
-                    each->y1 = min(each->y1, after->y1);
-                    each->y2 = max(each->y2, after->y2);
-                    flagEraseAfter = true;
-                }
-            }
-            else if (each->yn * after->yn == 1){
-                //* y-dir
-                if ( abs(each->shapeNormalDistance-after->shapeNormalDistance)<zero ){
-                    each->x1 = min(each->x1, after->x1);
-                    each->x2 = max(each->x2, after->x2);
-                    flagEraseAfter = true;
-                }
-            }
+//**
+//* mergeProjectionList
+//* - run mergeProjectionScan() on [first projection, end) of rectList
+//*   and erase the absorbed rects
+static void mergeProjectionList(RectangleGLList &rectList, const bool flagVer1_1, const float zero)
+{
+    RectangleGLList::size_type first = 0;
 
-            if (flagEraseAfter==true){
-                if (after==first){
-                    after = erase(after);
-                    first = after;
-                }
-                else{
-                    after = erase(after);
-                    after = first;
-                }
-            }
+    //* Find the first projection
+    for ( RectangleGLList::size_type each=0; each<rectList.size(); ++each){
+        if (rectList[each].shapeShift!=0){
+            first = each;
+            break;
         }
     }
+
+    vector<RectangleGL*> rects;
+    for ( RectangleGLList::size_type each = first; each<rectList.size(); ++each ){
+        rects.push_back(&rectList[each]);
+    }
+
+    vector<bool> alive;
+    mergeProjectionScan(rects, alive, flagVer1_1, zero);
+    alive.insert(alive.begin(), first, true);
+    rectList.compact(alive);
+}
+
+//**
+//* mergeProjection Ver1.0
+//* - Only used when 'this' RectangleGLList contains only one signed direction
+//*   (being as part of a condcutorFPList)
+//* - If each contains what is after, then erase the latter one.
+//* - If only overlapping with the same boundaries, then merge (update *each and erase *after)
+//* - Inner loop returns to the first one if any modification happens to the list
+//* - does not support sublayer
+void RectangleGLList::mergeProjection()
+{
+    mergeProjectionList(*this, false, 0);
 }
 
 
 //**
-//* insertProjectedOverlappingRectangleGL
-RectangleGLList::IteratorList RectangleGLList::insertProjectedOverlappingRectangleGL(const RectangleGL &rect, const float distance)
+//* mergeProjection Ver1.1
+//* - Only used when 'this' RectangleGLList contains only one signed direction
+//*   (being as part of a condcutorFPList)
+//* - Honor the shapeNormalDistance info
+//* - Assume the grid size is 1e-9 (zero)
+//* - If each contains what is after, then erase the latter one.
+//* - If only overlapping with the same boundaries, then merge (update *each and erase *after)
+//* - does not support sublayer
+void RectangleGLList::mergeProjection1_1(const float projectionMergeDistance)
 {
-    RectangleGLList::IteratorList itList;
-
-    RectangleGLList::iterator dummyEnd = this->insert(this->end(), RectangleGL()); // anchor for inserting projected rect
-    for ( RectangleGLList::iterator eachRectIt = this->begin();
-          eachRectIt != dummyEnd && eachRectIt->shapeShift==0; ++eachRectIt){
-
-        RectangleGL &eachRect = *eachRectIt;
-
-        if ( !(//* x-dir normal
-             ( rect.xn > 0 && eachRect.xn < 0 && rect.x1 < eachRect.x1 && eachRect.x1 < rect.x1+distance ) ||
-             ( rect.xn < 0 && eachRect.xn > 0 && eachRect.x1 < rect.x1 && rect.x1 < eachRect.x1+distance ) ||
-             //* y-dir normal
-             ( rect.yn > 0 && eachRect.yn < 0 && rect.y1 < eachRect.y1 && eachRect.y1 < rect.y1+distance ) ||
-             ( rect.yn < 0 && eachRect.yn > 0 && eachRect.y1 < rect.y1 && rect.y1 < eachRect.y1+distance ) ||
-             //* z-dir normal
-             ( rect.zn > 0 && eachRect.zn < 0 && rect.z1 < eachRect.z1 && eachRect.z1 < rect.z1+distance ) ||
-             ( rect.zn < 0 && eachRect.zn > 0 && eachRect.z1 < rect.z1 && rect.z1 < eachRect.z1+distance )
-             ) ) {
-            continue;
-        }
+    mergeProjectionList(*this, true, projectionMergeDistance);
+}
 
-        //* find and insert the projection of rect onto this list
-        if (eachRect.isOverlappingProjection(rect)==true){
-            RectangleGL projection = eachRect.intersectProjection(rect);
-            if (projection.xn!=0){
-                projection.shapeNormalDistance = abs(rect.x1-eachRect.x1);
-            }
-            else if (projection.yn!=0){
-                projection.shapeNormalDistance = abs(rect.y1-eachRect.y1);
-            }
-            else if (projection.zn!=0){
-                projection.shapeNormalDistance = abs(rect.z1-eachRect.z1);
-            }
 
-            RectangleGLList::iterator it = this->insert( this->end(), projection );
+//**
+//* insertProjectedOverlappingRectangleGL
+RectangleGLList::IndexList RectangleGLList::insertProjectedOverlappingRectangleGL(const RectangleGL &rect, const float distance)
+{
+    RectangleGLList::IndexList indexList;
 
-            //* Ver1.0 obsolete
-            /*
-            if (it->isEmpty()==true){
-                //* if the inserted projection is *eachRect itself, delete it
-                this->erase(it);
-            }
-            else{
-                //* keep the iterator
-                itList.push_back(it);
-            }
-            */
+    //* only the leading non-projection rects are supports
+    size_type nSupport = 0;
+    while (nSupport<this->size() && (*this)[nSupport].shapeShift==0){
+        ++nSupport;
+    }
 
-            //* Ver1.1
-            itList.push_back(it);
+    for ( size_type each = 0; each < nSupport; ++each ){
+        //* find and insert the projection of rect onto this list
+        RectangleGL projection;
+        if ((*this)[each].projectFrom(rect, distance, projection)==true){
+            indexList.push_back(this->size());
+            this->push_back(projection);
         }
     }
-    this->erase(dummyEnd);
-    return itList;
+    return indexList;
 }
 
+//**
+//* absorbCommonSupport
+//* - erase every rect equal to an earlier one (the first one is kept)
+//* - rect indices are sorted by coordinates so that equal rects become adjacent
+class LessRectangleGLCoord
+{
+public:
+    explicit LessRectangleGLCoord(const RectangleGLList &rectList)
+        : rectList(rectList) { }
+
+    bool operator() (const RectangleGLList::size_type i1, const RectangleGLList::size_type i2) const {
+        const RectangleGL &r1 = rectList[i1];
+        const RectangleGL &r2 = rectList[i2];
+        if (r1.xn!=r2.xn) return r1.xn<r2.xn;
+        if (r1.yn!=r2.yn) return r1.yn<r2.yn;
+        if (r1.zn!=r2.zn) return r1.zn<r2.zn;
+        if (r1.x1!=r2.x1) return r1.x1<r2.x1;
+        if (r1.x2!=r2.x2) return r1.x2<r2.x2;
+        if (r1.y1!=r2.y1) return r1.y1<r2.y1;
+        if (r1.y2!=r2.y2) return r1.y2<r2.y2;
+        if (r1.z1!=r2.z1) return r1.z1<r2.z1;
+        return r1.z2<r2.z2;
+    }
+
+private:
+    const RectangleGLList &rectList;
+};
+
 void RectangleGLList::absorbCommonSupport()
 {
-    for ( iterator each = begin(); each!=end(); ++each ){
-        iterator after = each;
-        for ( ++after; after!=end(); ){
-            if (after==each){
-                ++after;
-                continue;
-            }
-            if (*after == *each){
-                after = this->erase(after);
-            }
-            else{
-                ++after;
-            }
-        }
+    IndexList indexList(this->size());
+    for ( size_type i=0; i<indexList.size(); ++i ){
+        indexList[i] = i;
     }
+    absorbCommonSupport(indexList);
 }
 
-void RectangleGLList::absorbCommonSupport(RectangleGLList::IteratorList &itList)
+//**
+//* absorbCommonSupport
+//* - only among the rects in indexList; indexList is cleared since
+//*   the positions are no longer valid afterwards
+void RectangleGLList::absorbCommonSupport(RectangleGLList::IndexList &indexList)
 {
-    if (itList.empty()){
-        return;
+    //* stable: the first one of equal rects stays in front
+    stable_sort(indexList.begin(), indexList.end(), LessRectangleGLCoord(*this));
+
+    vector<bool> flagKeep(this->size(), true);
+    for ( size_type i=1, head=0; i<indexList.size(); ++i ){
+        if ((*this)[indexList[i]] == (*this)[indexList[head]]){
+            flagKeep[indexList[i]] = false;
+        }
+        else{
+            head = i;
+        }
     }
+    indexList.clear();
+    compact(flagKeep);
+}
 
-    for ( IteratorList::iterator eachIt = itList.begin();
-          eachIt != --itList.end(); ++eachIt){
-        IteratorList::iterator afterIt = eachIt;
-        for ( ++afterIt; afterIt!=itList.end(); ){
-            RectangleGL &eachRect = **eachIt;
-            RectangleGL &afterRect = **afterIt;
-            if (eachRect==afterRect){
-                *afterIt = this->erase(*afterIt);
-                afterIt = itList.erase(afterIt);
-            }
-            else{
-                ++afterIt;
+void RectangleGLList::compact(const std::vector<bool> &flagKeep)
+{
+    size_type last = 0;
+    for ( size_type each=0; each<this->size(); ++each ){
+        if (flagKeep[each]==true){
+            if (last!=each){
+                (*this)[last] = (*this)[each];
             }
+            ++last;
         }
     }
+    this->resize(last);
 }
 
 //* - Assume single signed direction
@@ -1610,64 +1669,94 @@ void RectangleGLList::absorbCommonSupport(RectangleGLList::IteratorList &itList)
 //* - If the combined projection coincides the underlying rectangle,
 //*   remove the farthest projection and combine again.
 //* - Repeat until no bad projection.
-bool removeOneFarthestBadProjection(RectangleGLList &rectList,
-                                    const RectangleGLList::iterator lastSupportIt, const float margin);
+//* - Supports and projections are indexed once by RectangleGLIndex, so
+//*   a round costs one indexed merge instead of all-pairs scans
 void RectangleGLList::removeBadProjection(float margin) {
 
     //* Find the first projection
-    iterator lastSupportIt = this->begin();
-    for ( ; lastSupportIt!=end() && lastSupportIt->shapeShift==0; ++lastSupportIt){
+    size_type firstProjection = 0;
+    for ( ; firstProjection<size() && (*this)[firstProjection].shapeShift==0; ++firstProjection){
     }
-    if (lastSupportIt==end()){
+    if (firstProjection==size() || firstProjection==0){
         return;
     }
-    else{
-        --lastSupportIt;
-    }
 
-    while( removeOneFarthestBadProjection(*this, lastSupportIt, margin) ){
-        ;
+    RectangleGLIndex supportIndex;
+    RectangleGLIndex projectionIndex;
+    for ( size_type each = 0; each < firstProjection; ++each ){
+        supportIndex.insert((*this)[each], each);
     }
-}
+    for ( size_type each = firstProjection; each < size(); ++each ){
+        projectionIndex.insert((*this)[each], each);
+    }
+    supportIndex.build();
+    projectionIndex.build();
 
-bool removeOneFarthestBadProjection(RectangleGLList &rectList,
-                                    const RectangleGLList::iterator lastSupportIt, const float margin) {
-
-    RectangleGLList::iterator firstProjectionIt = lastSupportIt;
-    ++firstProjectionIt;
-
-    //* Make a copy of projections
-    RectangleGLList projectionList(firstProjectionIt, rectList.end());
-
-    //* Merge projections
-    projectionList.mergeProjection();
-
-    //* Check if any merged projection coincides underlying rectangles
-    for (RectangleGLList::iterator projectionIt=projectionList.begin();
-         projectionIt != projectionList.end(); ++projectionIt){
-        //* each copied projection
-        for (RectangleGLList::iterator supportIt=rectList.begin(); supportIt!=firstProjectionIt; ++supportIt) {
-            //* each underlying rectangle
-            if (projectionIt->isCoincidental(*supportIt, margin)) {
-                //* Smell bad projections
-                //* Search for the farthest projection component
-                float farthestDistance = 0;
-                RectangleGLList::iterator farthestProjectionIt;
-                for (RectangleGLList::iterator compIt=firstProjectionIt; compIt!=rectList.end(); ++compIt){
-                    if (projectionIt->isContaining(*compIt) &&
-                        compIt->shapeNormalDistance > farthestDistance ) {
-
-                        farthestDistance = compIt->shapeNormalDistance;
-                        farthestProjectionIt = compIt;
-                    }
+    vector<bool> alive(size(), true);
+    vector<unsigned> candidateList;
+    bool flagRemoved = true;
+    while (flagRemoved){
+        flagRemoved = false;
+
+        //* Merge a copy of projections
+        vector<RectangleGL> combinedList;
+        for ( size_type each = firstProjection; each < size(); ++each ){
+            if (alive[each]==true){
+                combinedList.push_back((*this)[each]);
+            }
+        }
+        vector<RectangleGL*> combinedPtrList;
+        for ( unsigned i=0; i<combinedList.size(); ++i ){
+            combinedPtrList.push_back(&combinedList[i]);
+        }
+        vector<bool> combinedAlive;
+        mergeProjectionScan(combinedPtrList, combinedAlive, false, 0);
+
+        //* Check if any merged projection coincides underlying rectangles
+        for ( unsigned i=0; i<combinedList.size() && flagRemoved==false; ++i ){
+            if (combinedAlive[i]==false){
+                continue;
+            }
+            const RectangleGL &combined = combinedList[i];
+            const float plane = (combined.xn!=0)? combined.x1 : (combined.yn!=0)? combined.y1 : combined.z1;
+
+            bool flagCoincidental = false;
+            supportIndex.query(combined, plane, plane, candidateList);
+            for ( vector<unsigned>::const_iterator eachId = candidateList.begin();
+                  eachId != candidateList.end(); ++eachId ){
+                if (combined.isCoincidental((*this)[*eachId], margin)){
+                    flagCoincidental = true;
+                    break;
                 }
-                //* Erase the farthest projection component
-                rectList.erase(farthestProjectionIt);
-                return true;
             }
+            if (flagCoincidental==false){
+                continue;
+            }
+
+            //* Smell bad projections
+            //* Search for the farthest projection component
+            float farthestDistance = 0;
+            int farthest = -1;
+            projectionIndex.query(combined, plane, plane, candidateList);
+            for ( vector<unsigned>::const_iterator eachId = candidateList.begin();
+                  eachId != candidateList.end(); ++eachId ){
+                const RectangleGL &comp = (*this)[*eachId];
+                if (alive[*eachId]==true && combined.isContaining(comp) &&
+                    comp.shapeNormalDistance > farthestDistance ){
+                    farthestDistance = comp.shapeNormalDistance;
+                    farthest = *eachId;
+                }
+            }
+            if (farthest<0){
+                break;
+            }
+
+            //* Erase the farthest projection component
+            alive[farthest] = false;
+            flagRemoved = true;
         }
     }
-    return false;
+    compact(alive);
 }
 
 
@@ -1713,3 +1802,162 @@ bool RectangleGLList::hasCommonSupport() const
 
 
 
+
+
+//****
+//*
+//* RectangleGLIndex
+//*
+//*
+RectangleGLIndex::RectangleGLIndex()
+    : uMin(0), vMin(0), du(1), dv(1), nu(0), nv(0)
+{ }
+
+void RectangleGLIndex::clear()
+{
+    entries.clear();
+    cells.clear();
+    uMin = 0;
+    vMin = 0;
+    du = 1;
+    dv = 1;
+    nu = 0;
+    nv = 0;
+}
+
+//**
+//* RectangleGLIndex::toEntry
+//* - (plane, u, v) is (x, y, z) for x-dir normal,
+//*                    (y, z, x) for y-dir normal,
+//*                    (z, x, y) for z-dir normal
+RectangleGLIndex::Entry RectangleGLIndex::toEntry(const RectangleGL &rect, const unsigned id)
+{
+    Entry entry;
+    entry.id = id;
+    if (rect.xn!=0){
+        entry.plane = rect.x1;
+        entry.u1 = rect.y1;  entry.u2 = rect.y2;
+        entry.v1 = rect.z1;  entry.v2 = rect.z2;
+    }
+    else if (rect.yn!=0){
+        entry.plane = rect.y1;
+        entry.u1 = rect.z1;  entry.u2 = rect.z2;
+        entry.v1 = rect.x1;  entry.v2 = rect.x2;
+    }
+    else{
+        entry.plane = rect.z1;
+        entry.u1 = rect.x1;  entry.u2 = rect.x2;
+        entry.v1 = rect.y1;  entry.v2 = rect.y2;
+    }
+    return entry;
+}
+
+//**
+//* RectangleGLIndex::insert
+//* - after build(), the entry is added to the existing cells; inserting the
+//*   same id again with a grown extent keeps the index valid for that id
+void RectangleGLIndex::insert(const RectangleGL &rect, const unsigned id)
+{
+    entries.push_back(toEntry(rect, id));
+    if (cells.empty()){
+        return;
+    }
+    const Entry &entry = entries.back();
+    for ( int i=cellU(entry.u1); i<=cellU(entry.u2); ++i ){
+        for ( int j=cellV(entry.v1); j<=cellV(entry.v2); ++j ){
+            cells[i*nv+j].push_back(entries.size()-1);
+        }
+    }
+}
+
+size_t RectangleGLIndex::size() const
+{
+    return entries.size();
+}
+
+int RectangleGLIndex::cellU(const float u) const
+{
+    int i = static_cast<int>(floor((u-uMin)/du));
+    return max(0, min(nu-1, i));
+}
+
+int RectangleGLIndex::cellV(const float v) const
+{
+    int i = static_cast<int>(floor((v-vMin)/dv));
+    return max(0, min(nv-1, i));
+}
+
+//**
+//* RectangleGLIndex::build
+//* - cell size follows the mean face extent so that a face covers O(1) cells
+//* - the number of cells per axis is bounded by O(sqrt(n))
+void RectangleGLIndex::build()
+{
+    cells.clear();
+    if (entries.empty()){
+        nu = 0;
+        nv = 0;
+        return;
+    }
+
+    float uMax = entries.front().u2;
+    float vMax = entries.front().v2;
+    uMin = entries.front().u1;
+    vMin = entries.front().v1;
+    double uSum = 0;
+    double vSum = 0;
+    for ( vector<Entry>::const_iterator each = entries.begin(); each != entries.end(); ++each ){
+        uMin = min(uMin, each->u1);
+        uMax = max(uMax, each->u2);
+        vMin = min(vMin, each->v1);
+        vMax = max(vMax, each->v2);
+        uSum += each->u2 - each->u1;
+        vSum += each->v2 - each->v1;
+    }
+
+    const int maxCell = 2*static_cast<int>(ceil(sqrt(static_cast<double>(entries.size())))) + 1;
+    const double uMean = uSum/entries.size();
+    const double vMean = vSum/entries.size();
+    nu = (uMean>0)? static_cast<int>(ceil((uMax-uMin)/uMean)) : 1;
+    nv = (vMean>0)? static_cast<int>(ceil((vMax-vMin)/vMean)) : 1;
+    nu = max(1, min(maxCell, nu));
+    nv = max(1, min(maxCell, nv));
+    du = (uMax>uMin)? (uMax-uMin)/nu : 1;
+    dv = (vMax>vMin)? (vMax-vMin)/nv : 1;
+
+    cells.resize(nu*nv);
+    for ( unsigned k=0; k<entries.size(); ++k ){
+        const Entry &entry = entries[k];
+        for ( int i=cellU(entry.u1); i<=cellU(entry.u2); ++i ){
+            for ( int j=cellV(entry.v1); j<=cellV(entry.v2); ++j ){
+                cells[i*nv+j].push_back(k);
+            }
+        }
+    }
+}
+
+void RectangleGLIndex::query(const RectangleGL &rect, const float planeMin, const float planeMax,
+                             std::vector<unsigned> &ids) const
+{
+    ids.clear();
+    if (cells.empty()){
+        return;
+    }
+
+    const Entry q = toEntry(rect, 0);
+    for ( int i=cellU(q.u1); i<=cellU(q.u2); ++i ){
+        for ( int j=cellV(q.v1); j<=cellV(q.v2); ++j ){
+            const vector<unsigned> &cell = cells[i*nv+j];
+            for ( vector<unsigned>::const_iterator k = cell.begin(); k != cell.end(); ++k ){
+                const Entry &entry = entries[*k];
+                if ( planeMin <= entry.plane && entry.plane <= planeMax &&
+                     entry.u1 <= q.u2 && q.u1 <= entry.u2 &&
+                     entry.v1 <= q.v2 && q.v1 <= entry.v2 ){
+                    ids.push_back(entry.id);
+                }
+            }
+        }
+    }
+    sort(ids.begin(), ids.end());
+    ids.erase(unique(ids.begin(), ids.end()), ids.end());
+}
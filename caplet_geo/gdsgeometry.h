@@ -32,6 +32,8 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 #include <functional>
 #include <sstream>
 
+#include "geoarena.h"
+
 //****
 //*
 //* This file defines basic geometry data structures used by
@@ -137,7 +139,9 @@ public:
 //* Polygon
 //typedef std::list<Point> Polygon;
 
-typedef std::list<Point> PointList;
+//* - Point and Polygon lists only live within GeoLoader::loadGeo() and
+//*   allocate from its GeoArena
+typedef std::list<Point, GeoArenaAllocator<Point> > PointList;
 
 class Polygon : public PointList{
 public:
@@ -156,7 +160,7 @@ public:
 
 //**
 //* PolygonList
-typedef std::list<Polygon> PolygonList;
+typedef std::list<Polygon, GeoArenaAllocator<Polygon> > PolygonList;
 
 //**
 //* LayeredPolygonList
@@ -400,6 +404,14 @@ public:
     //* - intersect the projection of rect onto this
     RectangleGL intersectProjection(const RectangleGL &rect) const;
 
+    //**
+    //* projectFrom
+    //* - true if rect faces this from the opposite direction within distance
+    //*   and their projections overlap
+    //* - projection is filled with intersectProjection(rect) and its
+    //*   shapeNormalDistance when true
+    bool projectFrom(const RectangleGL &rect, const float distance, RectangleGL &projection) const;
+
     //**
     //* intersectArch
     //* - assume same elevation in the normal direction (no check)
@@ -418,10 +430,13 @@ public:
 
 //**
 //* RectangleGLList
-class RectangleGLList : public std::list<RectangleGL>
+//* - contiguous storage; positions are used as stable handles by the
+//*   algorithms below, which rebuild the list instead of inserting or
+//*   erasing in the middle
+class RectangleGLList : public std::vector<RectangleGL>
 {
 public:
-    typedef std::list<RectangleGLList::iterator> IteratorList;
+    typedef std::vector<RectangleGLList::size_type> IndexList;
 
     explicit RectangleGLList(
             const allocator_type    &allo = allocator_type());
@@ -446,12 +461,17 @@ public:
     //* insertOverlappingRectangleGL
     //* - perform projection of rect onto this list
     //* - find and insert the intersecting RectangleGLs
-    //* - return the list of iterators to the inserted RectangleGL
-    IteratorList
+    //* - return the list of indices to the inserted RectangleGL
+    IndexList
     insertProjectedOverlappingRectangleGL(const RectangleGL& rect, const float distance);
 
     void absorbCommonSupport();
-    void absorbCommonSupport(IteratorList &itList);
+    void absorbCommonSupport(IndexList &indexList);
+
+    //**
+    //* compact
+    //* - keep the rects with flag true, in order
+    void compact(const std::vector<bool> &flagKeep);
 
     void removeBadProjection(float margin);
 
@@ -469,6 +489,49 @@ public:
 };
 
 
+//**
+//* RectangleGLIndex
+//* - spatial index over faces that share one signed normal direction
+//* - faces are bucketed on a uniform grid over the two in-plane coordinates
+//* - query() returns ids of faces overlapping the in-plane extent of rect
+//*   with plane coordinate in [planeMin, planeMax], sorted and unique
+class RectangleGLIndex
+{
+public:
+    explicit RectangleGLIndex();
+
+    void clear();
+    void insert(const RectangleGL &rect, const unsigned id);
+    void build();
+    void query(const RectangleGL &rect, const float planeMin, const float planeMax,
+               std::vector<unsigned> &ids) const;
+    size_t size() const;
+
+private:
+    struct Entry{
+        float   plane;
+        float   u1;
+        float   u2;
+        float   v1;
+        float   v2;
+        unsigned id;
+    };
+
+    std::vector<Entry>                  entries;
+    std::vector< std::vector<unsigned> > cells;
+    float   uMin;
+    float   vMin;
+    float   du;
+    float   dv;
+    int     nu;
+    int     nv;
+
+    static Entry toEntry(const RectangleGL &rect, const unsigned id);
+    int cellU(const float u) const;
+    int cellV(const float v) const;
+};
+
+
 //**
 //* DirRectangleGLList
 //* - Dir: 0 to 5 for rect outer normal dir -x, +x, -y, +y, -z, +z
@@ -499,7 +562,7 @@ public:
 
 };
 
-class ConductorFPList : public std::list<ConductorFP>
+class ConductorFPList : public std::vector<ConductorFP>
 {
 public:
     explicit ConductorFPList( const allocator_type &allo = allocator_type());
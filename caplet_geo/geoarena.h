@@ -0,0 +1,225 @@
+/*
+CREATED : Oct 19, 2026
+AUTHOR  : Yu-Chung Hsiao
+EMAIL   : project.caplet@gmail.com
+
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GEOARENA_H
+#define GEOARENA_H
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+//****
+//*
+//* Monotonic arena for short-lived geometry containers
+//*
+//* - GeoLoader::loadGeo() opens a GeoArenaScope. While the scope is open,
+//*   containers using GeoArenaAllocator take memory from the arena,
+//*   deallocation is a no-op, and everything is released at once when
+//*   the scope closes.
+//* - Without an open scope, GeoArenaAllocator falls back to operator new.
+//* - Only containers that never outlive loadGeo() may use this allocator
+//*   (Polygon, PolygonList, adjacency lists).
+//* - Not thread-safe; loadGeo() is single-threaded.
+//*
+//****
+
+//**
+//* GeoArena
+class GeoArena
+{
+public:
+    static const size_t minChunkSize = 1<<16;
+    static const size_t maxChunkSize = 1<<26;
+    static const size_t alignment = 16;
+
+    size_t nAllocation;     //* number of allocations served
+    size_t nByteRequested;  //* bytes requested by containers
+    size_t nByteReserved;   //* bytes taken from operator new
+
+    GeoArena()
+        : nAllocation(0), nByteRequested(0), nByteReserved(0),
+          chunkSize(minChunkSize), head(0), left(0) { }
+
+    ~GeoArena(){
+        release();
+    }
+
+    void* allocate(size_t n){
+        n = (n + alignment - 1) & ~(alignment - 1);
+        ++nAllocation;
+        nByteRequested += n;
+        if (n > left){
+            //* dedicated chunk for a large request, otherwise a new chunk;
+            //* chunks double in size so that owns() scans O(log) chunks
+            size_t size = (n > chunkSize/4)? n : chunkSize;
+            if (size==chunkSize && chunkSize<maxChunkSize){
+                chunkSize *= 2;
+            }
+            Chunk chunk;
+            chunk.begin = static_cast<char*>(::operator new(size));
+            chunk.end   = chunk.begin + size;
+            chunkList.push_back(chunk);
+            nByteReserved += size;
+            if (size==n){
+                return chunk.begin;
+            }
+            head = chunk.begin;
+            left = size;
+        }
+        void *p = head;
+        head += n;
+        left -= n;
+        return p;
+    }
+
+    bool owns(const void *p) const{
+        const char *c = static_cast<const char*>(p);
+        for ( std::vector<Chunk>::const_reverse_iterator each = chunkList.rbegin();
+              each != chunkList.rend(); ++each ){
+            if (each->begin <= c && c < each->end){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void release(){
+        for ( std::vector<Chunk>::iterator each = chunkList.begin();
+              each != chunkList.end(); ++each ){
+            ::operator delete(each->begin);
+        }
+        chunkList.clear();
+        chunkSize = minChunkSize;
+        head = 0;
+        left = 0;
+    }
+
+    //**
+    //* current
+    //* - arena of the innermost open GeoArenaScope, 0 if none
+    static GeoArena *&current(){
+        static GeoArena *arena = 0;
+        return arena;
+    }
+
+private:
+    struct Chunk{
+        char *begin;
+        char *end;
+    };
+    std::vector<Chunk> chunkList;
+    size_t  chunkSize;
+    char   *head;
+    size_t  left;
+
+    GeoArena(const GeoArena &);
+    GeoArena &operator=(const GeoArena &);
+};
+
+//**
+//* GeoArenaScope
+//* - install an arena for the lifetime of this object
+//* - containers allocated in the scope must be destroyed before it
+class GeoArenaScope
+{
+public:
+    GeoArenaScope()
+        : previous(GeoArena::current()) {
+        GeoArena::current() = &arena;
+    }
+    ~GeoArenaScope(){
+        GeoArena::current() = previous;
+    }
+    const GeoArena &getArena() const {
+        return arena;
+    }
+
+private:
+    GeoArena  arena;
+    GeoArena *previous;
+
+    GeoArenaScope(const GeoArenaScope &);
+    GeoArenaScope &operator=(const GeoArenaScope &);
+};
+
+//**
+//* GeoArenaAllocator
+//* - stateless; all instances compare equal
+template<class T>
+class GeoArenaAllocator
+{
+public:
+    typedef T           value_type;
+    typedef T*          pointer;
+    typedef const T*    const_pointer;
+    typedef T&          reference;
+    typedef const T&    const_reference;
+    typedef size_t      size_type;
+    typedef ptrdiff_t   difference_type;
+
+    template<class U> struct rebind { typedef GeoArenaAllocator<U> other; };
+
+    GeoArenaAllocator() throw() { }
+    GeoArenaAllocator(const GeoArenaAllocator &) throw() { }
+    template<class U> GeoArenaAllocator(const GeoArenaAllocator<U> &) throw() { }
+
+    pointer       address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_type n, const void * = 0){
+        GeoArena *arena = GeoArena::current();
+        if (arena!=0){
+            return static_cast<pointer>(arena->allocate(n*sizeof(T)));
+        }
+        return static_cast<pointer>(::operator new(n*sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type){
+        GeoArena *arena = GeoArena::current();
+        if (arena!=0 && arena->owns(p)){
+            return;
+        }
+        ::operator delete(p);
+    }
+
+    size_type max_size() const throw() {
+        return size_t(-1)/sizeof(T);
+    }
+
+    void construct(pointer p, const T &value){
+        new (static_cast<void*>(p)) T(value);
+    }
+    void destroy(pointer p){
+        p->~T();
+    }
+};
+
+template<class T, class U>
+inline bool operator==(const GeoArenaAllocator<T> &, const GeoArenaAllocator<U> &){
+    return true;
+}
+template<class T, class U>
+inline bool operator!=(const GeoArenaAllocator<T> &, const GeoArenaAllocator<U> &){
+    return false;
+}
+
+#endif // GEOARENA_H
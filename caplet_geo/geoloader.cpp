@@ -20,10 +20,12 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "geoloader.h"
+#include "geometrics.h"
 
 #include "debug.h"
 #include <list>
 #include <string>
+#include <sstream>
 #include <vector>
 #include <utility>
 #include <fstream>
@@ -65,7 +67,8 @@ void printMatrix(T** matrix, int nrow, int ncol){
 //**
 //* GeoLoader constructor
 GeoLoader::GeoLoader()
-    :isLoaded(false){
+    :isLoaded(false), flagViaArrayMerged(false), nMergedViaArray(0), nMergedVia(0),
+     maxBasisFunction(0), basisFunctionErrorTolerance(0), nPrunedBasisFunction(0), prunedBasisFunctionError(0){
 }
 
 //**
@@ -80,15 +83,22 @@ GeoLoader::~GeoLoader(){
 //* - Test if geoFile exists first before clear things up
 void GeoLoader::loadGeo(const string &geoFile) throw (FileNotFoundError, GeometryNotManhattanError){
 
+    GeoMetricsScope metricsScope("load_geo");
+
+    //* temporaries below allocate from this arena; released on return
+    GeoArenaScope arenaScope;
+
     //* read geomery definitions from geoFile
     LayeredPolygonList metalLayeredPolygonList;
     LayeredPolygonList viaLayeredPolygonList;
     try{
+        GeoMetricsScope readScope("read");
         readGeo(geoFile, metalLayeredPolygonList, viaLayeredPolygonList); // may throw FileNotFoundError
     }
     catch (FileNotFoundError &e){
         throw;
     }
+    GeoMetricsScope decomposeScope("decompose");
 
     //* check if Manhattan geometries
     for (unsigned int i=0; i<metalLayeredPolygonList.size(); ++i){
@@ -151,12 +161,79 @@ void GeoLoader::loadGeo(const string &geoFile) throw (FileNotFoundError, Geometr
         }
     }
 
+    //* regular via arrays as blocks (see setViaArrayMerging)
+    mergedViaLayeredRectangleList.resize(nVia);
+    nMergedViaArray = 0;
+    nMergedVia = 0;
+    for ( int i=0; i<nVia; ++i ){
+        int nArray = 0;
+        int nArrayVia = 0;
+        mergeViaArrays(viaLayeredRectangleList[i], metalConductorList, viaConnect[i][0], viaConnect[i][1],
+                       mergedViaLayeredRectangleList[i], nArray, nArrayVia);
+        nMergedViaArray += nArray;
+        nMergedVia += nArrayVia;
+    }
+
+    #ifdef DEBUG_GEO_ARENA
+    const GeoArena &arena = arenaScope.getArena();
+    cerr << "GeoArena: " << arena.nAllocation << " allocations, "
+         << arena.nByteRequested << " bytes requested, "
+         << arena.nByteReserved << " bytes reserved" << endl;
+    #endif
 
     //* UNCOMMENT to generate matlab structure output
     //printConductorListMatlab(conductorList);
     isLoaded = true;
 }
 
+//**
+//* GeoLoader::setMetalElevation
+//* - faces of a metal layer only have z coordinates at its bottom and top
+void GeoLoader::setMetalElevation(const int metalIndex, const int bottomElevation, const int topElevation)
+{
+    const int oldBottom = metalDef[metalIndex][0];
+    const int oldTop    = metalDef[metalIndex][1];
+    for ( ConductorList::iterator eachCondIt = metalConductorList.begin();
+          eachCondIt != metalConductorList.end(); ++eachCondIt ){
+        for ( int dirIndex = 0; dirIndex < Conductor::nDir; ++dirIndex ){
+            RectangleList &rectList = eachCondIt->layer[metalIndex][dirIndex];
+            for ( RectangleList::iterator each = rectList.begin(); each != rectList.end(); ++each ){
+                each->z1 = (each->z1==oldBottom)? bottomElevation : topElevation;
+                each->z2 = (each->z2==oldBottom)? bottomElevation : topElevation;
+            }
+        }
+    }
+    metalDef[metalIndex][0] = bottomElevation;
+    metalDef[metalIndex][1] = topElevation;
+}
+
+//**
+//* GeoLoader::setViaElevation
+//* - vias are constructed from viaDef in generateConductorList()
+void GeoLoader::setViaElevation(const int viaIndex, const int bottomElevation, const int topElevation)
+{
+    viaDef[viaIndex][0] = bottomElevation;
+    viaDef[viaIndex][1] = topElevation;
+}
+
+//**
+//* GeoLoader::setViaArrayMerging
+//* - takes effect when basis functions are generated next
+void GeoLoader::setViaArrayMerging(const bool flagMerged)
+{
+    flagViaArrayMerged = flagMerged;
+}
+
+int GeoLoader::getNumberOfMergedViaArray() const
+{
+    return nMergedViaArray;
+}
+
+int GeoLoader::getNumberOfMergedVia() const
+{
+    return nMergedVia;
+}
+
 //**
 //* GeoLoader::getGeometryConductorList
 //* -
@@ -168,16 +245,17 @@ const ConductorFPList &GeoLoader::getGeometryConductorList(const float unit)
     return geometryConductorFPList;
 }
 
-const ConductorFPList &GeoLoader::getPWCBasisFunction(const float unit, const float suggestedPanelSize)
+const ConductorFPList &GeoLoader::getPWCBasisFunction(const float unit, const float suggestedPanelSize,
+                                                      const float growthRatio)
 {
-    clock_t tBefore = clock();
+    GeoMetricsScope metricsScope("pwc_basis");
+    const double tBefore = geoWallTime();
     generateConductorList(geometryConductorList, true);
     pwcConductorFPList.constructFrom(geometryConductorList, unit);
     geometryConductorList.clear();
-    discretizeDisjointSurface(pwcConductorFPList, suggestedPanelSize);
-    clock_t tAfter = clock();
+    discretizeDisjointSurface(pwcConductorFPList, suggestedPanelSize, growthRatio);
 
-    tPWCConstruction = difftime(tAfter, tBefore)/CLOCKS_PER_SEC;
+    tPWCConstruction = geoWallTime() - tBefore;
 
     return pwcConductorFPList;
 }
@@ -191,18 +269,139 @@ const ConductorFPList &GeoLoader::getPWCBasisFunction() const
 const ConductorFPList &GeoLoader::getInstantiableBasisFunction(const float unit, const float archLength,
                                                                const float projectionDistance, const float projectionMergeDistance){
 
-    clock_t tBefore = clock();
+    GeoMetricsScope metricsScope("instantiable_basis");
+    const double tBefore = geoWallTime();
 
     generateConductorList(geometryConductorList, false);
     instantiableConductorFPList.constructFrom(geometryConductorList, unit);
     geometryConductorList.clear();
     instantiateBasisFunction(instantiableConductorFPList, archLength, projectionDistance, projectionMergeDistance);
-    clock_t tAfter = clock();
-    tInstantiableConstruction = difftime(tAfter, tBefore)/CLOCKS_PER_SEC;
+    nPrunedBasisFunction = 0;
+    prunedBasisFunctionError = 0;
+    if ( maxBasisFunction > 0 || basisFunctionErrorTolerance > 0 ){
+        prunedBasisFunctionError = pruneBasisFunction(instantiableConductorFPList, maxBasisFunction,
+                                                      basisFunctionErrorTolerance, nPrunedBasisFunction);
+    }
+    tInstantiableConstruction = geoWallTime() - tBefore;
 
     return instantiableConductorFPList;
 }
 
+//**
+//* pruneTile
+//* - drop basis functions of nets not owned by tile that lie outside its
+//*   window, and nets left without any
+static void pruneTile(Tile &tile)
+{
+    ConductorFPList conductorList;
+    vector<int>     netIndex;
+    vector<bool>    flagOwned;
+    conductorList.reserve(tile.conductorList.size());
+    netIndex.reserve(tile.netIndex.size());
+    flagOwned.reserve(tile.flagOwned.size());
+    for ( unsigned condIndex = 0; condIndex < tile.conductorList.size(); ++condIndex ){
+        ConductorFP &cond = tile.conductorList[condIndex];
+        if ( tile.flagOwned[condIndex] == false ){
+            for ( unsigned layerIndex = 0; layerIndex < cond.layer.size(); ++layerIndex ){
+                for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+                    RectangleGLList &rectList = cond.layer[layerIndex][dirIndex];
+                    vector<bool> flagKeep(rectList.size());
+                    for ( unsigned i = 0; i < rectList.size(); ++i ){
+                        flagKeep[i] = rectList[i].x2 >= tile.x1 && rectList[i].x1 <= tile.x2
+                                   && rectList[i].y2 >= tile.y1 && rectList[i].y1 <= tile.y2;
+                    }
+                    rectList.compact(flagKeep);
+                }
+            }
+            if ( cond.size() == 0 ){
+                continue;
+            }
+        }
+        conductorList.push_back(ConductorFP());
+        swap(conductorList.back(), cond);
+        netIndex.push_back(tile.netIndex[condIndex]);
+        flagOwned.push_back(tile.flagOwned[condIndex]);
+    }
+    tile.conductorList.swap(conductorList);
+    tile.netIndex.swap(netIndex);
+    tile.flagOwned.swap(flagOwned);
+}
+
+const TileList &GeoLoader::getTiledPWCBasisFunction(const float unit, const float suggestedPanelSize,
+                                                    const float tileSize, const float haloSize,
+                                                    const float growthRatio)
+{
+    GeoMetricsScope metricsScope("tiled_pwc_basis");
+    const double tBefore = geoWallTime();
+    generateTileList(unit, tileSize, haloSize, 0, true);
+
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int tileIndex = 0; tileIndex < static_cast<int>(tileList.size()); ++tileIndex ){
+        discretizeDisjointSurface(tileList[tileIndex].conductorList, suggestedPanelSize, growthRatio);
+    }
+    tPWCConstruction = geoWallTime() - tBefore;
+
+    return tileList;
+}
+
+const TileList &GeoLoader::getTiledInstantiableBasisFunction(const float unit, const float archLength,
+                                                             const float tileSize, const float haloSize,
+                                                             const float projectionDistance, const float projectionMergeDistance)
+{
+    GeoMetricsScope metricsScope("tiled_instantiable_basis");
+    const double tBefore = geoWallTime();
+    //* faces within projectionDistance outside the window project onto it
+    generateTileList(unit, tileSize, haloSize, projectionDistance, false);
+
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int tileIndex = 0; tileIndex < static_cast<int>(tileList.size()); ++tileIndex ){
+        instantiateBasisFunction(tileList[tileIndex].conductorList, archLength, projectionDistance, projectionMergeDistance);
+        pruneTile(tileList[tileIndex]);
+    }
+    nPrunedBasisFunction = 0;
+    prunedBasisFunctionError = 0;
+    if ( maxBasisFunction > 0 || basisFunctionErrorTolerance > 0 ){
+        for ( unsigned tileIndex = 0; tileIndex < tileList.size(); ++tileIndex ){
+            int nPruned = 0;
+            const float error = pruneBasisFunction(tileList[tileIndex].conductorList, maxBasisFunction,
+                                                   basisFunctionErrorTolerance, nPruned);
+            nPrunedBasisFunction += nPruned;
+            prunedBasisFunctionError = max(prunedBasisFunctionError, error);
+        }
+    }
+    tInstantiableConstruction = geoWallTime() - tBefore;
+
+    return tileList;
+}
+
+const TileList &GeoLoader::getTileList() const
+{
+    return tileList;
+}
+
+//**
+//* GeoLoader::setBasisFunctionBudget
+//* - takes effect when instantiable basis functions are generated next
+void GeoLoader::setBasisFunctionBudget(const int maxBasisFunction, const float errorTolerance)
+{
+    this->maxBasisFunction = maxBasisFunction;
+    basisFunctionErrorTolerance = errorTolerance;
+}
+
+int GeoLoader::getNumberOfPrunedBasisFunction() const
+{
+    return nPrunedBasisFunction;
+}
+
+float GeoLoader::getPrunedBasisFunctionError() const
+{
+    return prunedBasisFunctionError;
+}
+
 void GeoLoader::loadQui(const string &inputFileName) throw (FileNotFoundError)
 {
     map<int, RectangleGLList> rectListMap;
@@ -266,9 +465,26 @@ void GeoLoader::loadQui(const string &inputFileName) throw (FileNotFoundError)
 //**
 //* GeoLoader::runCapletQui
 //* - write pwcConductorFPList to .qui in path
-//* - run caplet
+//* - run caplet with flag (e.g. --fft)
 //* - write output to .stdsolver_output
-ExtractionInfo &GeoLoader::runCapletQui(const std::string &pathFileBaseName)
+ExtractionInfo &GeoLoader::runCapletQui(const std::string &pathFileBaseName, const std::string &option)
+        throw (FileNotFoundError)
+{
+    writeFastcapFile(pathFileBaseName, pwcConductorFPList);
+
+    extractionInfoList.push_back(ExtractionInfo());
+    ExtractionInfo &result = extractionInfoList.back();
+    extractQui(pathFileBaseName, option, tInstantiableConstruction, result);
+    return result;
+}
+
+//**
+//* GeoLoader::extractQui
+//* - run caplet with flag on an existing .qui in path
+//* - write output to .stdsolver_output and result to .stdsolver_result
+//* - tBasis is added to the total time
+void GeoLoader::extractQui(const std::string &pathFileBaseName, const std::string &option,
+                           const double tBasis, ExtractionInfo &result) const
         throw (FileNotFoundError)
 {
     int coreNum = 1;
@@ -277,11 +493,10 @@ ExtractionInfo &GeoLoader::runCapletQui(const std::string &pathFileBaseName)
     const string suffix  = "stdsolver_output";
     const string resultSuffix = "stdsolver_result";
     const string outputFileName = pathFileBaseName+"."+suffix;
-    writeFastcapFile(pathFileBaseName, pwcConductorFPList);
 
     stringstream ssCommand;
     ssCommand << "/usr/bin/mpirun -np " << coreNum << " " << program
-              << " -o " << pathFileBaseName << ".cmat "
+              << " " << option << " -o " << pathFileBaseName << ".cmat "
               << pathFileBaseName << ".qui | tee " << outputFileName;
     cout << ssCommand.str() << endl;
     int systemReturn = system(ssCommand.str().c_str());
@@ -301,9 +516,6 @@ ExtractionInfo &GeoLoader::runCapletQui(const std::string &pathFileBaseName)
     bool flagTSetupFound   = false;
     bool flagMatrixFound   = false;
 
-    extractionInfoList.push_back(ExtractionInfo());
-    ExtractionInfo &result = extractionInfoList.back();
-
     string line;
     string temp;
     while(getline(fin,line)){
@@ -356,8 +568,8 @@ ExtractionInfo &GeoLoader::runCapletQui(const std::string &pathFileBaseName)
     fin.close();
 
     result.tSolving = result.tTotal-result.tSetup;
-    result.tTotal += tInstantiableConstruction;
-    result.tBasis = tInstantiableConstruction;
+    result.tTotal += tBasis;
+    result.tBasis = tBasis;
 
     const string resultFileName = pathFileBaseName+"."+resultSuffix;
 
@@ -368,8 +580,149 @@ ExtractionInfo &GeoLoader::runCapletQui(const std::string &pathFileBaseName)
     }
     result.print(fout);
     fout.close();
+}
 
-    return result;
+
+//**
+//* Richardson extrapolation of Cmat to zero panel size
+//* - levels[k] is extracted with panel size h[k] ~ 1/sqrt(#basis functions)
+//* - C(h) = C0 + a h^order is fitted to the last (up to) nFit levels by
+//*   least squares, entry by entry. The order is fixed: orders fitted to
+//*   three levels follow the irregular refinement of the meshes rather
+//*   than the discretization error.
+static Matrix extrapolateCmat(const vector<const ExtractionInfo*> &levels,
+                              const float order, const size_t nFit)
+{
+    const size_t nLevel = levels.size();
+    const size_t first  = (nLevel>nFit)? nLevel-nFit : 0;
+    const size_t m      = nLevel-first;
+    const size_t size   = levels.back()->capacitanceMatrix.size();
+
+    vector<double> x(m);
+    double xMean = 0;
+    for ( size_t k=0; k<m; ++k ){
+        x[k] = pow(double(levels[first+k]->nBasisFunction), -0.5*order);
+        xMean += x[k]/m;
+    }
+    double xx = 0;
+    for ( size_t k=0; k<m; ++k ){
+        xx += (x[k]-xMean)*(x[k]-xMean);
+    }
+
+    Matrix c0(size, vector<float>(size));
+    for ( size_t i=0; i<size; ++i ){
+        for ( size_t j=0; j<size; ++j ){
+            double yMean = 0;
+            for ( size_t k=0; k<m; ++k ){
+                yMean += levels[first+k]->capacitanceMatrix[i][j]/m;
+            }
+            double xy = 0;
+            for ( size_t k=0; k<m; ++k ){
+                xy += (x[k]-xMean)*(levels[first+k]->capacitanceMatrix[i][j]-yMean);
+            }
+            c0[i][j] = yMean - xy/xx*xMean;
+        }
+    }
+    return c0;
+}
+
+//**
+//* GeoLoader::computeReference
+//* - PWC basis functions of panel sizes pwcSize, pwcSize/alpha, ... are
+//*   written to path_<size>.qui and extracted by capletMPI with option,
+//*   nConcurrent levels at a time
+//* - levels whose #basis functions do not grow are skipped
+//* - Cmat is extrapolated to zero panel size from the last levels after
+//*   each level (see extrapolateCmat)
+//* - stop when two successive extrapolations differ by less than epsilon
+//*   (as ExtractionInfo::compare) or after maxLevel levels
+//* - the levels are appended to the results, and the last extrapolation
+//*   is stored as the reference and written to pathFileNameCmat
+const ExtractionInfo &GeoLoader::computeReference(const std::string &pathFileBaseName,
+        const float unit, float pwcSize, const float alpha, const float epsilon,
+        const std::string &pathFileNameCmat, const int nConcurrent, const int maxLevel,
+        const std::string &option)
+        throw (FileNotFoundError)
+{
+    vector<const ExtractionInfo*> levels;
+    ExtractionInfo extrapolation;
+    bool isExtrapolated = false;
+    bool isConverged    = false;
+    int  nLevel         = 0;
+    int  nPrevBasis     = 0;
+
+    while ( isConverged==false && nLevel<maxLevel ){
+        //* Write the next levels
+        const int nBatch = min(max(nConcurrent, 1), maxLevel-nLevel);
+        vector<string> names;
+        vector<double> tBasis;
+        for ( int k=0; k<nBatch; ++k, pwcSize/=alpha ){
+            getPWCBasisFunction(unit, pwcSize);
+            stringstream ss;
+            ss << pathFileBaseName << "_" << pwcSize/unit;
+            names.push_back(ss.str());
+            tBasis.push_back(tPWCConstruction);
+            writeFastcapFile(names.back(), pwcConductorFPList);
+        }
+        nLevel += nBatch;
+
+        //* Extract them concurrently (one process each)
+        vector<ExtractionInfo> batch(names.size());
+        string missingFileName;
+        #ifdef CAPLET_OPENMP
+        #pragma omp parallel for schedule(dynamic) num_threads(nBatch)
+        #endif
+        for ( int k=0; k<static_cast<int>(names.size()); ++k ){
+            try{
+                extractQui(names[k], option, tBasis[k], batch[k]);
+            }
+            catch (FileNotFoundError &e){
+                #ifdef CAPLET_OPENMP
+                #pragma omp critical
+                #endif
+                missingFileName = e.what();
+            }
+        }
+        if ( missingFileName.empty()==false ){
+            throw FileNotFoundError(missingFileName);
+        }
+
+        for ( size_t k=0; k<batch.size(); ++k ){
+            extractionInfoList.push_back(batch[k]);
+            const ExtractionInfo &level = extractionInfoList.back();
+            if ( level.capacitanceMatrix.empty()==true || level.nBasisFunction<=nPrevBasis ){
+                continue;
+            }
+            nPrevBasis = level.nBasisFunction;
+            levels.push_back(&level);
+            if ( levels.size()<2 ){
+                continue;
+            }
+
+            ExtractionInfo next = level;
+            next.capacitanceMatrix = extrapolateCmat(levels, caplet::REFERENCE_ORDER,
+                                                     caplet::REFERENCE_FIT_LEVELS);
+            if ( isExtrapolated==true ){
+                next.error  = next.compare(extrapolation);
+                if ( next.error<=epsilon ){
+                    isConverged = true;
+                }
+            }
+            extrapolation  = next;
+            isExtrapolated = true;
+        }
+    }
+
+    if ( isConverged==false ){
+        cerr << "WARNING: Reference Cmat is not converged within " << maxLevel << " levels." << endl;
+    }
+    referenceResult = ( isExtrapolated==true )? extrapolation : extractionInfoList.back();
+    if ( pathFileNameCmat.empty()==false ){
+        ofstream fout(pathFileNameCmat.c_str());
+        referenceResult.printMatrix(fout);
+        fout.close();
+    }
+    return referenceResult;
 }
 
 
@@ -677,13 +1030,16 @@ ConductorList& GeoLoader::generateConductorList(ConductorList &conductorList, bo
     //* Copy metalConductorList to conductorList
     conductorList.insert(conductorList.begin(), metalConductorList.begin(), metalConductorList.end());
 
+    const LayeredRectangleList &viaList = flagViaArrayMerged ? mergedViaLayeredRectangleList
+                                                             : viaLayeredRectangleList;
+
     //* Construct 3D vias and put together connected conductors
     for ( int viaIndex = 0; viaIndex < nVia; ++viaIndex ){
         int lowerMetalIndex = viaConnect[viaIndex][0];
         int upperMetalIndex = viaConnect[viaIndex][1];
 
-        for ( RectangleList::const_iterator eachViaIt = viaLayeredRectangleList[viaIndex].begin();
-              eachViaIt != viaLayeredRectangleList[viaIndex].end(); ++eachViaIt )
+        for ( RectangleList::const_iterator eachViaIt = viaList[viaIndex].begin();
+              eachViaIt != viaList[viaIndex].end(); ++eachViaIt )
         {
             list< Conductor >::iterator eachBottomCondIt;
             list< Conductor >::iterator eachTopCondIt;
@@ -750,6 +1106,218 @@ ConductorList& GeoLoader::generateConductorList(ConductorList &conductorList, bo
 
 
 
+//**
+//* boundingBox
+//* - x-y extent of all faces of cond
+static void boundingBox(const ConductorFP &cond, float &x1, float &x2, float &y1, float &y2)
+{
+    x1 = y1 =  numeric_limits<float>::max();
+    x2 = y2 = -numeric_limits<float>::max();
+    for ( unsigned layerIndex = 0; layerIndex < cond.layer.size(); ++layerIndex ){
+        for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+            const RectangleGLList &rectList = cond.layer[layerIndex][dirIndex];
+            for ( RectangleGLList::const_iterator each = rectList.begin();
+                  each != rectList.end(); ++each ){
+                x1 = min(x1, each->x1);
+                x2 = max(x2, each->x2);
+                y1 = min(y1, each->y1);
+                y2 = max(y2, each->y2);
+            }
+        }
+    }
+}
+
+//**
+//* clipConductorFP
+//* - keep the parts of the faces of cond inside [x1,x2] x [y1,y2]
+//* - faces degenerated to zero area are dropped
+static void clipConductorFP(const ConductorFP &cond, const float x1, const float x2,
+                            const float y1, const float y2, ConductorFP &clipped)
+{
+    clipped.nMetal = cond.nMetal;
+    clipped.nVia   = cond.nVia;
+    clipped.nLayer = cond.nLayer;
+    clipped.layer.assign(cond.layer.size(), DirRectangleGLList(ConductorFP::nDir, RectangleGLList()));
+    for ( unsigned layerIndex = 0; layerIndex < cond.layer.size(); ++layerIndex ){
+        for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+            const RectangleGLList &rectList = cond.layer[layerIndex][dirIndex];
+            RectangleGLList &clippedList = clipped.layer[layerIndex][dirIndex];
+            for ( RectangleGLList::const_iterator each = rectList.begin();
+                  each != rectList.end(); ++each ){
+                if ( each->x2 < x1 || each->x1 > x2 || each->y2 < y1 || each->y1 > y2 ){
+                    continue;
+                }
+                RectangleGL rect = *each;
+                rect.x1 = max(rect.x1, x1);
+                rect.x2 = min(rect.x2, x2);
+                rect.y1 = max(rect.y1, y1);
+                rect.y2 = min(rect.y2, y2);
+                //* x-normal faces have no x extent, y-normal faces no y extent
+                if ( (rect.xn==0 && rect.x1>=rect.x2) || (rect.yn==0 && rect.y1>=rect.y2) ){
+                    continue;
+                }
+                clippedList.push_back(rect);
+            }
+        }
+    }
+}
+
+//**
+//* GeoLoader::generateTileList
+//* - partition nets into tiles of tileSize (see Tile)
+//* - nets not owned by a tile are clipped to its window extended by
+//*   marginSize, so that faces just outside the window can still shape
+//*   the basis functions inside; see pruneTile()
+//* - basis functions are not constructed here
+void GeoLoader::generateTileList(const float unit, const float tileSize, const float haloSize,
+                                 const float marginSize, bool flagDecomposed)
+{
+    tileList.clear();
+
+    generateConductorList(geometryConductorList, flagDecomposed);
+    const ConductorFPList netList(geometryConductorList, unit);
+    geometryConductorList.clear();
+    if ( netList.empty() || tileSize <= 0 ){
+        return;
+    }
+
+    //* bounding box of each net and of the layout
+    const int nNet = netList.size();
+    vector<float> netX1(nNet), netX2(nNet), netY1(nNet), netY2(nNet);
+    float layoutX1 =  numeric_limits<float>::max();
+    float layoutX2 = -numeric_limits<float>::max();
+    float layoutY1 =  numeric_limits<float>::max();
+    float layoutY2 = -numeric_limits<float>::max();
+    for ( int netIndex = 0; netIndex < nNet; ++netIndex ){
+        boundingBox(netList[netIndex], netX1[netIndex], netX2[netIndex], netY1[netIndex], netY2[netIndex]);
+        layoutX1 = min(layoutX1, netX1[netIndex]);
+        layoutX2 = max(layoutX2, netX2[netIndex]);
+        layoutY1 = min(layoutY1, netY1[netIndex]);
+        layoutY2 = max(layoutY2, netY2[netIndex]);
+    }
+    const int nx = max(1, static_cast<int>(ceil((layoutX2-layoutX1)/tileSize)));
+    const int ny = max(1, static_cast<int>(ceil((layoutY2-layoutY1)/tileSize)));
+
+    //* owner tile of each net
+    vector< vector<int> > ownedList(nx*ny);
+    for ( int netIndex = 0; netIndex < nNet; ++netIndex ){
+        const float cx = 0.5f*(netX1[netIndex]+netX2[netIndex]);
+        const float cy = 0.5f*(netY1[netIndex]+netY2[netIndex]);
+        const int ix = min(nx-1, static_cast<int>(floor((cx-layoutX1)/tileSize)));
+        const int iy = min(ny-1, static_cast<int>(floor((cy-layoutY1)/tileSize)));
+        ownedList[iy*nx+ix].push_back(netIndex);
+    }
+
+    //* windows: tile and owned nets extended by halo
+    //* - extension tracks how far a window reaches beyond its tile
+    vector<int> tileIndexList;
+    float extension = haloSize;
+    for ( int iy = 0; iy < ny; ++iy ){
+        for ( int ix = 0; ix < nx; ++ix ){
+            const vector<int> &owned = ownedList[iy*nx+ix];
+            if ( owned.empty() ){
+                continue;
+            }
+            tileList.push_back(Tile());
+            Tile &tile = tileList.back();
+            tile.x1 = layoutX1 + ix*tileSize;
+            tile.x2 = tile.x1 + tileSize;
+            tile.y1 = layoutY1 + iy*tileSize;
+            tile.y2 = tile.y1 + tileSize;
+            for ( vector<int>::const_iterator each = owned.begin(); each != owned.end(); ++each ){
+                extension = max(extension, tile.x1-netX1[*each]+haloSize);
+                extension = max(extension, netX2[*each]-tile.x2+haloSize);
+                extension = max(extension, tile.y1-netY1[*each]+haloSize);
+                extension = max(extension, netY2[*each]-tile.y2+haloSize);
+                tile.x1 = min(tile.x1, netX1[*each]);
+                tile.x2 = max(tile.x2, netX2[*each]);
+                tile.y1 = min(tile.y1, netY1[*each]);
+                tile.y2 = max(tile.y2, netY2[*each]);
+            }
+            //* snap to the layout grid so that clipped faces do not leave slivers
+            tile.x1 = floor((tile.x1-haloSize)/unit)*unit;
+            tile.x2 =  ceil((tile.x2+haloSize)/unit)*unit;
+            tile.y1 = floor((tile.y1-haloSize)/unit)*unit;
+            tile.y2 =  ceil((tile.y2+haloSize)/unit)*unit;
+            tile.netIndex = owned;
+            tileIndexList.push_back(iy*nx+ix);
+        }
+    }
+
+    //* nets in each window (and margin) that are not owned by it
+    //* - a window reaches at most extension beyond its tile
+    extension += marginSize;
+    vector<int> tileOfIndex(nx*ny, -1);
+    vector<int> ownerTile(nNet);
+    for ( unsigned i = 0; i < tileIndexList.size(); ++i ){
+        tileOfIndex[tileIndexList[i]] = i;
+        for ( vector<int>::const_iterator each = tileList[i].netIndex.begin();
+              each != tileList[i].netIndex.end(); ++each ){
+            ownerTile[*each] = i;
+        }
+    }
+    for ( int netIndex = 0; netIndex < nNet; ++netIndex ){
+        const int ix1 = max(0,    static_cast<int>(floor((netX1[netIndex]-extension-layoutX1)/tileSize)));
+        const int ix2 = min(nx-1, static_cast<int>(floor((netX2[netIndex]+extension-layoutX1)/tileSize)));
+        const int iy1 = max(0,    static_cast<int>(floor((netY1[netIndex]-extension-layoutY1)/tileSize)));
+        const int iy2 = min(ny-1, static_cast<int>(floor((netY2[netIndex]+extension-layoutY1)/tileSize)));
+        for ( int iy = iy1; iy <= iy2; ++iy ){
+            for ( int ix = ix1; ix <= ix2; ++ix ){
+                const int tileIndex = tileOfIndex[iy*nx+ix];
+                if ( tileIndex < 0 || ownerTile[netIndex] == tileIndex ){
+                    continue;
+                }
+                Tile &tile = tileList[tileIndex];
+                if ( netX2[netIndex] < tile.x1-marginSize || netX1[netIndex] > tile.x2+marginSize
+                     || netY2[netIndex] < tile.y1-marginSize || netY1[netIndex] > tile.y2+marginSize ){
+                    continue;
+                }
+                tile.netIndex.push_back(netIndex);
+            }
+        }
+    }
+
+    //* conductors of each window
+    //* - kept in the global net order, on which basis construction depends
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int tileIndex = 0; tileIndex < static_cast<int>(tileList.size()); ++tileIndex ){
+        Tile &tile = tileList[tileIndex];
+        const float x1 = floor((tile.x1-marginSize)/unit)*unit;
+        const float x2 =  ceil((tile.x2+marginSize)/unit)*unit;
+        const float y1 = floor((tile.y1-marginSize)/unit)*unit;
+        const float y2 =  ceil((tile.y2+marginSize)/unit)*unit;
+        vector<int> netIndexList;
+        netIndexList.swap(tile.netIndex);
+        sort(netIndexList.begin(), netIndexList.end());
+        tile.nOwned = 0;
+        tile.netIndex.reserve(netIndexList.size());
+        tile.flagOwned.reserve(netIndexList.size());
+        tile.conductorList.reserve(netIndexList.size());
+        for ( unsigned i = 0; i < netIndexList.size(); ++i ){
+            const ConductorFP &net = netList[netIndexList[i]];
+            const bool flagOwned = ( ownerTile[netIndexList[i]] == tileIndex );
+            if ( flagOwned == true ){
+                tile.conductorList.push_back(net);
+                ++tile.nOwned;
+            }
+            else{
+                ConductorFP clipped;
+                clipConductorFP(net, x1, x2, y1, y2, clipped);
+                if ( clipped.size() == 0 ){
+                    continue;
+                }
+                tile.conductorList.push_back(ConductorFP());
+                swap(tile.conductorList.back(), clipped);
+            }
+            tile.netIndex.push_back(netIndexList[i]);
+            tile.flagOwned.push_back(flagOwned);
+        }
+    }
+}
+
+
 //**
 //* GeoLoader::readGeo
 //* - aux function of loadGeo()
@@ -933,12 +1501,14 @@ void GeoLoader::clear(){
 
         //* clean up geo info
         viaLayeredRectangleList.clear();
+        mergedViaLayeredRectangleList.clear();
         metalConductorList.clear();
 
         geometryConductorList.clear();
         geometryConductorFPList.clear();
 
         pwcConductorFPList.clear();
+        tileList.clear();
 
         //* clean up extraction info
         extractionInfoList.clear();
@@ -1452,6 +2022,161 @@ void generateConnectedRects( RectangleList &rectList, ConnectedRectangleList &re
 }
 
 
+//**
+//* isCoveredByMetalFace
+//* - whether rect lies in a single dir face of a metal layer (x-y plane only)
+static bool isCoveredByMetalFace(const Rectangle &rect, const ConductorList &condList,
+                                 const int metalIndex, const Conductor::Dir dir)
+{
+    for ( ConductorList::const_iterator eachCondIt = condList.begin();
+          eachCondIt != condList.end(); ++eachCondIt ){
+        const RectangleList &faceList = eachCondIt->layer[metalIndex][dir];
+        for ( RectangleList::const_iterator each = faceList.begin(); each != faceList.end(); ++each ){
+            if ( each->x1<=rect.x1 && rect.x2<=each->x2 && each->y1<=rect.y1 && rect.y2<=each->y2 ){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+//**
+//* splitViaRuns
+//* - split sorted positions of vias of the given size into runs [first, last)
+//*   on a constant pitch, at least VIA_ARRAY_MIN_COUNT long, whose spacing
+//*   is at most VIA_ARRAY_MAX_SPACING_RATIO times the size
+static void splitViaRuns(const vector<int> &pos, const int size, vector< pair<int,int> > &runs)
+{
+    const float maxSpacing = caplet::VIA_ARRAY_MAX_SPACING_RATIO * size;
+
+    runs.clear();
+    int first = 0;
+    while ( first+1 < (int)pos.size() ){
+        const int pitch = pos[first+1] - pos[first];
+        if ( pitch < size || pitch-size > maxSpacing ){
+            ++first;
+            continue;
+        }
+        int last = first+2;
+        while ( last < (int)pos.size() && pos[last]-pos[last-1] == pitch ){
+            ++last;
+        }
+        if ( last-first >= caplet::VIA_ARRAY_MIN_COUNT ){
+            runs.push_back(make_pair(first, last));
+        }
+        first = last;
+    }
+}
+
+//**
+//* mergeViaArrays
+//* - a regular via array: vias of the same size on constant x and y pitches
+//*   (see splitViaRuns), at least VIA_ARRAY_MIN_COUNT in both directions
+//* - faces between vias of an array are shielded by the array itself, so
+//*   the array is replaced by its bounding block, which keeps the outer faces
+//* - an array is kept as it is unless the block lies in a single top face
+//*   of the lower metal and a single bottom face of the upper metal: the
+//*   block connects the same conductors as the vias and no metal rect has a
+//*   corner inside it (Conductor::generateVia)
+//* - mergedList: vias not in arrays in their original order, then blocks
+void mergeViaArrays(const RectangleList &viaList, const ConductorList &metalConductorList,
+                    const int lowerMetalIndex, const int upperMetalIndex,
+                    RectangleList &mergedList, int &nArray, int &nMergedVia)
+{
+    mergedList.clear();
+    nArray = 0;
+    nMergedVia = 0;
+
+    vector<Rectangle> vias(viaList.begin(), viaList.end());
+    vector<bool>      flagMerged(vias.size(), false);
+
+    //* rows of vias of the same size: (width, height) -> y1 -> (x1, via)
+    typedef map< int, vector< pair<int,int> > > RowMap;
+    map< pair<int,int>, RowMap > sizeRowMap;
+    for ( int i=0; i<(int)vias.size(); ++i ){
+        const Rectangle &via = vias[i];
+        sizeRowMap[make_pair(via.x2-via.x1, via.y2-via.y1)][via.y1].push_back(make_pair(via.x1, i));
+    }
+
+    RectangleList blockList;
+    vector< pair<int,int> > runs;
+    for ( map< pair<int,int>, RowMap >::iterator eachSizeIt = sizeRowMap.begin();
+          eachSizeIt != sizeRowMap.end(); ++eachSizeIt ){
+        const int width  = eachSizeIt->first.first;
+        const int height = eachSizeIt->first.second;
+
+        //* runs along x of each row, stacked by (x1, number of vias, pitch)
+        //* in the order of y1: key -> (y1, vias of the run)
+        typedef map< pair< pair<int,int>, int >, vector< pair< int, vector<int> > > > RunMap;
+        RunMap runMap;
+        for ( RowMap::iterator eachRowIt = eachSizeIt->second.begin();
+              eachRowIt != eachSizeIt->second.end(); ++eachRowIt ){
+            vector< pair<int,int> > &row = eachRowIt->second;
+            sort(row.begin(), row.end());
+            vector<int> pos(row.size());
+            for ( unsigned k=0; k<row.size(); ++k ){
+                pos[k] = row[k].first;
+            }
+            splitViaRuns(pos, width, runs);
+            for ( unsigned r=0; r<runs.size(); ++r ){
+                const int first = runs[r].first;
+                const int last  = runs[r].second;
+                vector<int> index;
+                for ( int k=first; k<last; ++k ){
+                    index.push_back(row[k].second);
+                }
+                runMap[make_pair(make_pair(pos[first], last-first), pos[first+1]-pos[first])]
+                        .push_back(make_pair(eachRowIt->first, index));
+            }
+        }
+
+        //* runs stacked along y on a constant pitch form an array
+        for ( RunMap::iterator eachStackIt = runMap.begin(); eachStackIt != runMap.end(); ++eachStackIt ){
+            const int x1     = eachStackIt->first.first.first;
+            const int nX     = eachStackIt->first.first.second;
+            const int pitchX = eachStackIt->first.second;
+            const vector< pair< int, vector<int> > > &stack = eachStackIt->second;
+
+            vector<int> pos(stack.size());
+            for ( unsigned k=0; k<stack.size(); ++k ){
+                pos[k] = stack[k].first;
+            }
+            splitViaRuns(pos, height, runs);
+            for ( unsigned r=0; r<runs.size(); ++r ){
+                const int first = runs[r].first;
+                const int last  = runs[r].second;
+
+                Rectangle block(vias[stack[first].second.front()]);
+                block.x1 = x1;
+                block.x2 = x1 + (nX-1)*pitchX + width;
+                block.y1 = pos[first];
+                block.y2 = pos[last-1] + height;
+                if ( isCoveredByMetalFace(block, metalConductorList, lowerMetalIndex, Conductor::TOP) == false ||
+                     isCoveredByMetalFace(block, metalConductorList, upperMetalIndex, Conductor::BOTTOM) == false ){
+                    continue;
+                }
+
+                for ( int k=first; k<last; ++k ){
+                    for ( unsigned v=0; v<stack[k].second.size(); ++v ){
+                        flagMerged[stack[k].second[v]] = true;
+                    }
+                }
+                blockList.push_back(block);
+                ++nArray;
+                nMergedVia += nX*(last-first);
+            }
+        }
+    }
+
+    for ( unsigned i=0; i<vias.size(); ++i ){
+        if ( flagMerged[i] == false ){
+            mergedList.push_back(vias[i]);
+        }
+    }
+    mergedList.insert(mergedList.end(), blockList.begin(), blockList.end());
+}
+
+
 //**
 //* computeAdjacency
 //* - CURRENTLY DOES NOT SUPPORT SUBLAYERS
@@ -1473,7 +2198,7 @@ void computeAdjacency(const RectangleList               &rectList,
     compAdjacency.clear();
 
     for ( unsigned int i=0; i<rectList.size(); ++i ){
-        adjacency.push_back(vector< list< pair<int,int> > >(4, list< pair<int,int> >()));
+        adjacency.push_back(DirAdjacencyList(4, AdjacencyList()));
     }
 
     RectangleList::const_iterator               rectIit;
@@ -1566,10 +2291,10 @@ void computeAdjacency(const RectangleList               &rectList,
             }else{
                 (*adjIit)[i].front().first = lower;
             }
-            for ( list< pair<int,int> >::iterator eachRangeIt = (*adjIit)[i].begin();
+            for ( AdjacencyList::iterator eachRangeIt = (*adjIit)[i].begin();
                   eachRangeIt != --(*adjIit)[i].end(); ++eachRangeIt )
             {
-                list< pair<int,int> >::iterator nextRangeIt = eachRangeIt;
+                AdjacencyList::iterator nextRangeIt = eachRangeIt;
                 ++nextRangeIt;
 
                 // if there is a gap between two adjacent rects
@@ -1603,7 +2328,7 @@ void generate3dRects(const RectangleList    &rect2dList,
     vector<RectangleList> &rect3dList = cond.layer[layerIndex];
 
     RectangleList::const_iterator each2dRectIt;
-    list< vector< list< pair<int,int> > > >::const_iterator eachCompAdjIt;
+    DirAdjacencyListOfRectangleList::const_iterator eachCompAdjIt;
     for ( each2dRectIt = rect2dList.begin(), eachCompAdjIt = compAdjacency.begin();
           each2dRectIt != rect2dList.end(); ++each2dRectIt, ++eachCompAdjIt )
     {
@@ -1620,7 +2345,7 @@ void generate3dRects(const RectangleList    &rect2dList,
 
         //* generate LEFT wall rects
         if( (*eachCompAdjIt)[LEFT].empty() == false ){
-            for ( list< pair<int,int> >::const_iterator eachRangeIt = (*eachCompAdjIt)[LEFT].begin();
+            for ( AdjacencyList::const_iterator eachRangeIt = (*eachCompAdjIt)[LEFT].begin();
                   eachRangeIt != (*eachCompAdjIt)[LEFT].end(); ++eachRangeIt )
             {
                 rect3dList[LEFT].push_back(Rectangle());
@@ -1636,7 +2361,7 @@ void generate3dRects(const RectangleList    &rect2dList,
 
         //* generate RIGHT wall rects
         if( (*eachCompAdjIt)[RIGHT].empty() == false ){
-            for ( list< pair<int,int> >::const_iterator eachRangeIt = (*eachCompAdjIt)[RIGHT].begin();
+            for ( AdjacencyList::const_iterator eachRangeIt = (*eachCompAdjIt)[RIGHT].begin();
                   eachRangeIt != (*eachCompAdjIt)[RIGHT].end(); ++eachRangeIt )
             {
                 rect3dList[RIGHT].push_back(Rectangle());
@@ -1652,7 +2377,7 @@ void generate3dRects(const RectangleList    &rect2dList,
 
         //* generate BACK wall rects
         if( (*eachCompAdjIt)[BACK].empty() == false ){
-            for ( list< pair<int,int> >::const_iterator eachRangeIt = (*eachCompAdjIt)[BACK].begin();
+            for ( AdjacencyList::const_iterator eachRangeIt = (*eachCompAdjIt)[BACK].begin();
                   eachRangeIt != (*eachCompAdjIt)[BACK].end(); ++eachRangeIt )
             {
                 rect3dList[BACK].push_back(Rectangle());
@@ -1668,7 +2393,7 @@ void generate3dRects(const RectangleList    &rect2dList,
 
         //* generate FRONT wall rects
         if( (*eachCompAdjIt)[FRONT].empty() == false ){
-            for ( list< pair<int,int> >::const_iterator eachRangeIt = (*eachCompAdjIt)[FRONT].begin();
+            for ( AdjacencyList::const_iterator eachRangeIt = (*eachCompAdjIt)[FRONT].begin();
                   eachRangeIt != (*eachCompAdjIt)[FRONT].end(); ++eachRangeIt )
             {
                 rect3dList[FRONT].push_back(Rectangle());
@@ -1689,56 +2414,255 @@ void generate3dRects(const RectangleList    &rect2dList,
 //* discretizeDisjointSurface
 //* - uniformly discretize rectangle surfaces with one-end length no larger
 //*   than suggestedPanelSize
+//* - growthRatio > 1: graded discretization; panels shrink by growthRatio
+//*   per panel toward conductor edges, down to
+//*   suggestedPanelSize/growthRatio^PWC_GRADING_LEVELS at the edge
 //* - used to generate PWC basis functions with disjoint rectangles as input
 void discretizeXDirRectangleGL(
-        RectangleGLList &rectList,
-        RectangleGLList::iterator &rectIt,
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
         const float suggestedPanelSize);
 void discretizeYDirRectangleGL(
-        RectangleGLList &rectList,
-        RectangleGLList::iterator &rectIt,
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
         const float suggestedPanelSize);
 void discretizeZDirRectangleGL(
-        RectangleGLList &rectList,
-        RectangleGLList::iterator &rectIt,
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
         const float suggestedPanelSize);
-void discretizeDisjointSurface(ConductorFPList &cond, const float suggestedPanelSize)
+void discretizeGradedRectangleGL(
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
+        const float suggestedPanelSize,
+        const float growthRatio,
+        const bool isEdge[4]);
+void findConductorEdge(
+        const LayeredDirRectangleGLList &layer,
+        const unsigned dirIndex,
+        std::vector<std::vector<std::vector<char> > > &isEdge);
+void discretizeDisjointSurface(ConductorFPList &cond, const float suggestedPanelSize, const float growthRatio)
 {
+    const bool isGraded = growthRatio > 1;
+    RectangleGLList panelList;
+    vector<vector<vector<char> > > isEdge;
     for ( ConductorFPList::iterator eachCond = cond.begin();
           eachCond != cond.end(); ++eachCond){
         LayeredDirRectangleGLList &layer = eachCond->layer;
-        for ( unsigned layerIndex = 0; layerIndex < layer.size(); ++layerIndex ){
-            for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+        for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+            if ( isGraded ){
+                findConductorEdge(layer, dirIndex, isEdge);
+            }
+            for ( unsigned layerIndex = 0; layerIndex < layer.size(); ++layerIndex ){
                 RectangleGLList &rectList = layer[layerIndex][dirIndex];
 
-                //* push back a dummy rect as a marker (will be removed after the loop)
-                rectList.push_back(RectangleGL());
-                RectangleGLList::iterator rectEnd = --rectList.end();
-                for ( RectangleGLList::iterator eachRectIt = rectList.begin();
-                      eachRectIt != rectEnd; ){
+                //* panels of each rect are appended in the order of rects
+                panelList.clear();
+                for ( RectangleGLList::const_iterator eachRectIt = rectList.begin();
+                      eachRectIt != rectList.end(); ++eachRectIt ){
 
-                    if (eachRectIt->xn != 0){
+                    if ( isGraded && (eachRectIt->xn != 0 || eachRectIt->yn != 0 || eachRectIt->zn != 0) ){
+                        const vector<char> &edge = isEdge[layerIndex][eachRectIt-rectList.begin()];
+                        const bool rectEdge[4] = { edge[0]!=0, edge[1]!=0, edge[2]!=0, edge[3]!=0 };
+                        discretizeGradedRectangleGL(panelList, *eachRectIt, suggestedPanelSize, growthRatio, rectEdge);
+                    }
+                    else if (eachRectIt->xn != 0){
                         //* x-dir
-                        discretizeXDirRectangleGL(rectList, eachRectIt, suggestedPanelSize);
+                        discretizeXDirRectangleGL(panelList, *eachRectIt, suggestedPanelSize);
                     }
                     else if (eachRectIt->yn != 0){
                         //* y-dir
-                        discretizeYDirRectangleGL(rectList, eachRectIt, suggestedPanelSize);
+                        discretizeYDirRectangleGL(panelList, *eachRectIt, suggestedPanelSize);
                     }
                     else if (eachRectIt->zn != 0){
                         //* z-dir
-                        discretizeZDirRectangleGL(rectList, eachRectIt, suggestedPanelSize);
+                        discretizeZDirRectangleGL(panelList, *eachRectIt, suggestedPanelSize);
                     }
                     else{
-                        ++eachRectIt;
                         cerr << "ERROR: impossible dir in discretizeDisjointSurface" << endl
                              << "       normal = (" << eachRectIt->xn << ","
                                                     << eachRectIt->yn << ","
                                                     << eachRectIt->zn << ")" << endl;
                     }
                 }
-                //* remove the empty marker
-                rectList.erase(rectEnd);
+                rectList.swap(panelList);
+            }
+        }
+    }
+}
+
+
+//**
+//* PlaneRectangle
+//* - a RectangleGL in its own plane: normal coordinate w, in-plane axes
+//*   u and v (x-dir: u=y, v=z; y-dir: u=z, v=x; z-dir: u=x, v=y)
+struct PlaneRectangle{
+    float w;
+    float u1, u2;
+    float v1, v2;
+
+    explicit PlaneRectangle(const RectangleGL &rect){
+        if (rect.xn != 0){
+            w = rect.x1; u1 = rect.y1; u2 = rect.y2; v1 = rect.z1; v2 = rect.z2;
+        }
+        else if (rect.yn != 0){
+            w = rect.y1; u1 = rect.z1; u2 = rect.z2; v1 = rect.x1; v2 = rect.x2;
+        }
+        else{
+            w = rect.z1; u1 = rect.x1; u2 = rect.x2; v1 = rect.y1; v2 = rect.y2;
+        }
+    }
+};
+
+
+//**
+//* findConductorEdge
+//* - aux function of discretizeDisjointSurface
+//* - isEdge[layerIndex][rectIndex][side] of the rects of dirIndex of a
+//*   conductor, side = u1, u2, v1, v2
+//* - a side is a conductor edge unless coplanar rects of the same
+//*   direction across it cover it completely, so that sides between rects
+//*   of the 2D decomposition or between layers are not graded
+void findConductorEdge(
+        const LayeredDirRectangleGLList &layer,
+        const unsigned dirIndex,
+        vector<vector<vector<char> > > &isEdge)
+{
+    //* (w, axis of the side normal, coordinate) -> extents along the side
+    typedef pair<pair<float, int>, float>  SideKey;
+    typedef map<SideKey, vector<pair<float, float> > > SideMap;
+    SideMap sideMap[2];     //* lower and upper sides
+
+    for ( unsigned layerIndex = 0; layerIndex < layer.size(); ++layerIndex ){
+        const RectangleGLList &rectList = layer[layerIndex][dirIndex];
+        for ( RectangleGLList::const_iterator each = rectList.begin(); each != rectList.end(); ++each ){
+            const PlaneRectangle rect(*each);
+            sideMap[0][SideKey(make_pair(rect.w, 0), rect.u1)].push_back(make_pair(rect.v1, rect.v2));
+            sideMap[1][SideKey(make_pair(rect.w, 0), rect.u2)].push_back(make_pair(rect.v1, rect.v2));
+            sideMap[0][SideKey(make_pair(rect.w, 1), rect.v1)].push_back(make_pair(rect.u1, rect.u2));
+            sideMap[1][SideKey(make_pair(rect.w, 1), rect.v2)].push_back(make_pair(rect.u1, rect.u2));
+        }
+    }
+
+    const float coverageTolerance = 1e-4f;
+    isEdge.resize(layer.size());
+    for ( unsigned layerIndex = 0; layerIndex < layer.size(); ++layerIndex ){
+        const RectangleGLList &rectList = layer[layerIndex][dirIndex];
+        isEdge[layerIndex].assign(rectList.size(), vector<char>(4, 1));
+        for ( unsigned rectIndex = 0; rectIndex < rectList.size(); ++rectIndex ){
+            const PlaneRectangle rect(rectList[rectIndex]);
+            const float coordinate[4] = { rect.u1, rect.u2, rect.v1, rect.v2 };
+            const float lower[2] = { rect.v1, rect.u1 };
+            const float upper[2] = { rect.v2, rect.u2 };
+
+            for ( int side = 0; side < 4; ++side ){
+                const int axis = side/2;
+                //* the lower side u1 meets the upper sides of rects ending at u1
+                const SideMap &neighborMap = sideMap[1-side%2];
+                SideMap::const_iterator found = neighborMap.find(SideKey(make_pair(rect.w, axis), coordinate[side]));
+                if ( found == neighborMap.end() ){
+                    continue;
+                }
+                float covered = 0;
+                for ( unsigned k = 0; k < found->second.size(); ++k ){
+                    covered += max(0.0f, min(upper[axis], found->second[k].second)
+                                         - max(lower[axis], found->second[k].first));
+                }
+                const float length = upper[axis] - lower[axis];
+                isEdge[layerIndex][rectIndex][side] = covered < length*(1-coverageTolerance);
+            }
+        }
+    }
+}
+
+
+//**
+//* gradedBreakpoint
+//* - aux function of discretizeGradedRectangleGL
+//* - breakpoints of [x1,x2]: panels grow by growthRatio from
+//*   suggestedPanelSize/growthRatio^PWC_GRADING_LEVELS at each graded end
+//*   up to suggestedPanelSize, and the middle is cut uniformly
+//* - a graded layer is only added while the middle stays at least as long
+//*   as its panels, so short sides end up uniform
+void gradedBreakpoint(
+        vector<float> &breakpoint,
+        const float x1, const float x2,
+        const float suggestedPanelSize,
+        const float growthRatio,
+        const bool isEdge1, const bool isEdge2)
+{
+    const int nEnd = (isEdge1? 1: 0) + (isEdge2? 1: 0);
+    vector<double> endPanel;
+    double middle = x2 - x1;
+    double panelSize = suggestedPanelSize / pow(static_cast<double>(growthRatio), caplet::PWC_GRADING_LEVELS);
+    for ( int level = 0; nEnd > 0 && level < caplet::PWC_GRADING_LEVELS; ++level ){
+        if ( middle - nEnd*panelSize < panelSize ){
+            break;
+        }
+        endPanel.push_back(panelSize);
+        middle -= nEnd*panelSize;
+        panelSize *= growthRatio;
+    }
+    const int nMiddle = max(1, static_cast<int>(ceil(middle/suggestedPanelSize)));
+
+    breakpoint.clear();
+    double x = x1;
+    breakpoint.push_back(x1);
+    if ( isEdge1 ){
+        for ( unsigned i = 0; i < endPanel.size(); ++i ){
+            x += endPanel[i];
+            breakpoint.push_back(static_cast<float>(x));
+        }
+    }
+    const double middle1 = x;
+    for ( int i = 1; i < nMiddle; ++i ){
+        breakpoint.push_back(static_cast<float>(middle1 + middle*i/nMiddle));
+    }
+    if ( isEdge2 ){
+        x = x2;
+        for ( unsigned i = 0; i < endPanel.size(); ++i ){
+            x -= endPanel[i];
+        }
+        for ( unsigned i = endPanel.size(); i > 0; --i ){
+            breakpoint.push_back(static_cast<float>(x));
+            x += endPanel[i-1];
+        }
+    }
+    breakpoint.push_back(x2);
+}
+
+
+//**
+//* discretizeGradedRectangleGL
+//* - aux function of discretizeDisjointSurface
+//* - discretize a RectangleGL of any direction with panels graded toward
+//*   the sides in isEdge (u1, u2, v1, v2) and append to panelList in the
+//*   same order as discretize{X,Y,Z}DirRectangleGL
+void discretizeGradedRectangleGL(
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
+        const float suggestedPanelSize,
+        const float growthRatio,
+        const bool isEdge[4])
+{
+    const PlaneRectangle planeRect(rect);
+    vector<float> u;
+    vector<float> v;
+    gradedBreakpoint(u, planeRect.u1, planeRect.u2, suggestedPanelSize, growthRatio, isEdge[0], isEdge[1]);
+    gradedBreakpoint(v, planeRect.v1, planeRect.v2, suggestedPanelSize, growthRatio, isEdge[2], isEdge[3]);
+
+    for ( unsigned i = 0; i+1 < v.size(); ++i ){
+        for ( unsigned j = 0; j+1 < u.size(); ++j ){
+            panelList.push_back(rect);
+            RectangleGL &panel = panelList.back();
+
+            if (rect.xn != 0){
+                panel.y1 = u[j]; panel.y2 = u[j+1]; panel.z1 = v[i]; panel.z2 = v[i+1];
+            }
+            else if (rect.yn != 0){
+                panel.z1 = u[j]; panel.z2 = u[j+1]; panel.x1 = v[i]; panel.x2 = v[i+1];
+            }
+            else{
+                panel.x1 = u[j]; panel.x2 = u[j+1]; panel.y1 = v[i]; panel.y2 = v[i+1];
             }
         }
     }
@@ -1748,55 +2672,54 @@ void discretizeDisjointSurface(ConductorFPList &cond, const float suggestedPanel
 //**
 //* discretizeZDirRectangleGL
 //* - aux function of discretizeDisjointSurface
-//* - discretize +z and -z RectangleGL
+//* - discretize +z and -z RectangleGL and append to panelList
 void discretizeZDirRectangleGL(
-        RectangleGLList &rectList,
-        RectangleGLList::iterator &rectIt,
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
         const float suggestedPanelSize)
 {
-    float xlen = rectIt->x2 - rectIt->x1;
-    float ylen = rectIt->y2 - rectIt->y1;
+    float xlen = rect.x2 - rect.x1;
+    float ylen = rect.y2 - rect.y1;
     int nx = static_cast<int>(ceil(xlen/suggestedPanelSize));
     int ny = static_cast<int>(ceil(ylen/suggestedPanelSize));
     float dx = xlen/nx;
     float dy = ylen/ny;
 
-    float y1 = rectIt->y1 - dy;
-    float y2 = rectIt->y1;
+    float y1 = rect.y1 - dy;
+    float y2 = rect.y1;
     for ( int i = 0; i<ny; ++i ){
         y1 += dy;
         y2 += dy;
-        float x1 = rectIt->x1 - dx;
-        float x2 = rectIt->x1;
+        float x1 = rect.x1 - dx;
+        float x2 = rect.x1;
 
         for ( int j=0; j<nx; ++j ){
             x1 += dx;
             x2 += dx;
 
-            rectList.push_back(*rectIt);
-            RectangleGL &rect = rectList.back();
+            panelList.push_back(rect);
+            RectangleGL &panel = panelList.back();
 
-            rect.x1 = x1;
-            rect.x2 = x2;
-            rect.y1 = y1;
-            rect.y2 = y2;
+            panel.x1 = x1;
+            panel.x2 = x2;
+            panel.y1 = y1;
+            panel.y2 = y2;
         }
     }
-    rectIt = rectList.erase(rectIt);
 }
 
 
 //**
 //* discretizeYDirRectangleGL
 //* - aux function of discretizeDisjointSurface
-//* - discretize +y and -y RectangleGL
+//* - discretize +y and -y RectangleGL and append to panelList
 void discretizeYDirRectangleGL(
-        RectangleGLList &rectList,
-        RectangleGLList::iterator &rectIt,
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
         const float suggestedPanelSize)
 {
-    float zlen = rectIt->z2 - rectIt->z1;
-    float xlen = rectIt->x2 - rectIt->x1;
+    float zlen = rect.z2 - rect.z1;
+    float xlen = rect.x2 - rect.x1;
 
     int nz = static_cast<int>(ceil(zlen/suggestedPanelSize));
     int nx = static_cast<int>(ceil(xlen/suggestedPanelSize));
@@ -1804,42 +2727,41 @@ void discretizeYDirRectangleGL(
     float dz = zlen/nz;
     float dx = xlen/nx;
 
-    float x1 = rectIt->x1 - dx;
-    float x2 = rectIt->x1;
+    float x1 = rect.x1 - dx;
+    float x2 = rect.x1;
     for ( int i = 0; i<nx; ++i ){
         x1 += dx;
         x2 += dx;
-        float z1 = rectIt->z1 - dz;
-        float z2 = rectIt->z1;
+        float z1 = rect.z1 - dz;
+        float z2 = rect.z1;
 
         for ( int j=0; j<nz; ++j ){
             z1 += dz;
             z2 += dz;
 
-            rectList.push_back(*rectIt);
-            RectangleGL &rect = rectList.back();
+            panelList.push_back(rect);
+            RectangleGL &panel = panelList.back();
 
-            rect.z1 = z1;
-            rect.z2 = z2;
-            rect.x1 = x1;
-            rect.x2 = x2;
+            panel.z1 = z1;
+            panel.z2 = z2;
+            panel.x1 = x1;
+            panel.x2 = x2;
         }
     }
-    rectIt = rectList.erase(rectIt);
 }
 
 
 //**
 //* discretizeXDirRectangleGL
 //* - aux function of discretizeDisjointSurface
-//* - discretize +x and -x RectangleGL
+//* - discretize +x and -x RectangleGL and append to panelList
 void discretizeXDirRectangleGL(
-        RectangleGLList &rectList,
-        RectangleGLList::iterator &rectIt,
+        RectangleGLList &panelList,
+        const RectangleGL &rect,
         const float suggestedPanelSize)
 {
-    float ylen = rectIt->y2 - rectIt->y1;
-    float zlen = rectIt->z2 - rectIt->z1;
+    float ylen = rect.y2 - rect.y1;
+    float zlen = rect.z2 - rect.z1;
 
     int ny = static_cast<int>(ceil(ylen/suggestedPanelSize));
     int nz = static_cast<int>(ceil(zlen/suggestedPanelSize));
@@ -1847,28 +2769,27 @@ void discretizeXDirRectangleGL(
     float dy = ylen/ny;
     float dz = zlen/nz;
 
-    float z1 = rectIt->z1 - dz;
-    float z2 = rectIt->z1;
+    float z1 = rect.z1 - dz;
+    float z2 = rect.z1;
     for ( int i = 0; i<nz; ++i ){
         z1 += dz;
         z2 += dz;
-        float y1 = rectIt->y1 - dy;
-        float y2 = rectIt->y1;
+        float y1 = rect.y1 - dy;
+        float y2 = rect.y1;
 
         for ( int j=0; j<ny; ++j ){
             y1 += dy;
             y2 += dy;
 
-            rectList.push_back(*rectIt);
-            RectangleGL &rect = rectList.back();
+            panelList.push_back(rect);
+            RectangleGL &panel = panelList.back();
 
-            rect.y1 = y1;
-            rect.y2 = y2;
-            rect.z1 = z1;
-            rect.z2 = z2;
+            panel.y1 = y1;
+            panel.y2 = y2;
+            panel.z1 = z1;
+            panel.z2 = z2;
         }
     }
-    rectIt = rectList.erase(rectIt);
 }
 
 
@@ -1878,7 +2799,25 @@ void discretizeXDirRectangleGL(
 //* - do not extend the arch to the rect that is not right under the edge of
 //*   the source rect (at this point).
 //* - fixed normal distance.
+//* - candidate source faces are looked up through RectangleGLIndex
+//*   instead of scanning every conductor pair
+//* - conductors are processed in parallel with CAPLET_OPENMP;
+//*   the output order does not depend on the number of threads
 void generateArch (RectangleGLList &rectList, const float archLength);
+//* - ProjectionSource: non-projection face and its conductor index
+//* - ProjectionRecord: projection of source onto support (target) face
+struct ProjectionSource{
+    unsigned    cond;
+    RectangleGL rect;
+};
+struct ProjectionRecord{
+    unsigned    source;
+    unsigned    support;
+    RectangleGL rect;
+};
+bool lessProjectionRecord(const ProjectionRecord &r1, const ProjectionRecord &r2){
+    return r1.source < r2.source || (r1.source == r2.source && r1.support < r2.support);
+}
 void instantiateBasisFunction (ConductorFPList &cond, const float archLength,
                                const float projectionDistance, const float projectionMergeDistance)
 {
@@ -1890,58 +2829,98 @@ void instantiateBasisFunction (ConductorFPList &cond, const float archLength,
         return;
     }
 
-    for ( ConductorFPList::iterator eachCond1 = cond.begin();
-          eachCond1 != cond.end(); ++eachCond1){
-        for ( ConductorFPList::iterator eachCond2 = cond.begin();
-              eachCond2 != cond.end(); ++eachCond2 ){
-            //* if same conductor, skip
-            if (eachCond1==eachCond2){
-                continue;
+    //* determine overlapping rectangle
+    //* 1. generate a list of overlapping rectangles
+    //* 2. for each overlapping rectangle,
+    //*    extend arches in four directions if dir1 is TOP or BOTTOM
+    //*    extend arches in two  directions otherwise. (side walls)
+    //* 3. for each extending arch,
+    //*    find the overlapping rectangles that share the extending edge
+    //* 4. If one arch is contained completed in another, erase it.
+    //* The way to insert
+    //* - insert them directly into the input list
+    //* - projections are appended to the list in the order of
+    //*   (source conductor, source layer, source rect, target rect)
+
+    //* 1. generate a list of overlapping rectangles
+    vector<ConductorFP*> condVec;
+    for ( ConductorFPList::iterator eachCond = cond.begin();
+          eachCond != cond.end(); ++eachCond){
+        condVec.push_back(&*eachCond);
+    }
+
+    //* 1-a. index all non-projection faces by direction
+    //* - ids follow (conductor, layer, rect) order
+    vector<ProjectionSource> sourceList[ConductorFP::nDir];
+    RectangleGLIndex sourceIndex[ConductorFP::nDir];
+    for ( unsigned dir=0; dir<ConductorFP::nDir; ++dir ){
+        for ( unsigned eachCond=0; eachCond<condVec.size(); ++eachCond ){
+            for ( unsigned layer=0; layer<nMetal; ++layer ){
+                const RectangleGLList &rectList = condVec[eachCond]->layer[layer][dir];
+                for ( RectangleGLList::const_iterator eachRect = rectList.begin();
+                      eachRect != rectList.end(); ++eachRect ){
+                    //* If *eachRect is a projection, continue
+                    if (eachRect->shapeShift==1){
+                        continue;
+                    }
+                    ProjectionSource source;
+                    source.cond = eachCond;
+                    source.rect = *eachRect;
+                    sourceIndex[dir].insert(*eachRect, sourceList[dir].size());
+                    sourceList[dir].push_back(source);
+                }
             }
-            //* determine overlapping rectangle
-            //* 1. generate a list of overlapping rectangles
-            //* 2. for each overlapping rectangle,
-            //*    extend arches in four directions if dir1 is TOP or BOTTOM
-            //*    extend arches in two  directions otherwise. (side walls)
-            //* 3. for each extending arch,
-            //*    find the overlapping rectangles that share the extending edge
-            //* 4. If one arch is contained completed in another, erase it.
-            //* The way to insert
-            //* - insert them directly into the input list
-            //* - return a list of iterators pointing to those inserted RectangleGL
-
-
-            //* 1. generate a list of overlapping rectangles
-            for( unsigned layer1=0; layer1<nMetal; ++layer1){
-                for ( unsigned layer2=0; layer2<nMetal; ++layer2 ){
-                    //* face-to-face
-                    for (unsigned dir1=0; dir1<ConductorFP::nDir; ++dir1 ){
-                        unsigned dir2 = ( dir1%2 == 0 ) ? (dir1+1) : (dir1-1);
-                        RectangleGLList &rectList1 = eachCond1->layer[layer1][dir1];
-                        RectangleGLList &rectList2 = eachCond2->layer[layer2][dir2];
-
-
-                        RectangleGLList::IteratorList projectionRectItList;
-                        for ( RectangleGLList::const_iterator eachRect2 = rectList2.begin();
-                              eachRect2 != rectList2.end(); ++eachRect2){
-
-                            //* If *eachRect2 is a projection, continue
-                            if (eachRect2->shapeShift==1){
-                                continue;
-                            }
-
-                            //* project rect from eachCond2 onto rects from eachCond1
-                            RectangleGLList::IteratorList insertedRectItList =
-                                    rectList1.insertProjectedOverlappingRectangleGL(*eachRect2, closestDistanceOfInterest);
-                            projectionRectItList.insert(projectionRectItList.end(),
-                                    insertedRectItList.begin(), insertedRectItList.end());
-                        }
+        }
+        sourceIndex[dir].build();
+    }
 
+    //* 1-b. project faces from other conductors onto each conductor
+    //* - each conductor only writes its own lists
+    #ifdef CAPLET_OPENMP
+        #pragma omp parallel for schedule(dynamic) num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int eachCond1=0; eachCond1<static_cast<int>(condVec.size()); ++eachCond1 ){
+        vector<unsigned> candidateList;
+        for( unsigned layer1=0; layer1<nMetal; ++layer1){
+            //* face-to-face
+            for (unsigned dir1=0; dir1<ConductorFP::nDir; ++dir1 ){
+                unsigned dir2 = ( dir1%2 == 0 ) ? (dir1+1) : (dir1-1);
+                RectangleGLList &rectList1 = condVec[eachCond1]->layer[layer1][dir1];
+                const vector<ProjectionSource> &rectList2 = sourceList[dir2];
+
+                vector<ProjectionRecord> recordList;
+                unsigned support = 0;
+                for ( RectangleGLList::const_iterator eachRect1 = rectList1.begin();
+                      eachRect1 != rectList1.end() && eachRect1->shapeShift==0; ++eachRect1, ++support ){
+
+                    float plane = (eachRect1->xn!=0)? eachRect1->x1 :
+                                  (eachRect1->yn!=0)? eachRect1->y1 : eachRect1->z1;
+                    sourceIndex[dir2].query(*eachRect1, plane-closestDistanceOfInterest,
+                                            plane+closestDistanceOfInterest, candidateList);
+
+                    for ( vector<unsigned>::const_iterator eachId = candidateList.begin();
+                          eachId != candidateList.end(); ++eachId ){
+                        //* if same conductor, skip
+                        if (rectList2[*eachId].cond == static_cast<unsigned>(eachCond1)){
+                            continue;
+                        }
+                        ProjectionRecord record;
+                        if (eachRect1->projectFrom(rectList2[*eachId].rect, closestDistanceOfInterest, record.rect)){
+                            record.source = *eachId;
+                            record.support = support;
+                            recordList.push_back(record);
+                        }
                     }
-                    //* face-to-side
-                    //- may not be necessary
+                }
+                sort(recordList.begin(), recordList.end(), lessProjectionRecord);
+                rectList1.reserve(rectList1.size() + recordList.size());
+                for ( vector<ProjectionRecord>::const_iterator eachRecord = recordList.begin();
+                      eachRecord != recordList.end(); ++eachRecord ){
+                    rectList1.push_back(eachRecord->rect);
                 }
             }
+            //* face-to-side
+            //- may not be necessary
         }
     }
     for ( ConductorFPList::iterator eachCond = cond.begin();
@@ -1975,88 +2954,335 @@ void instantiateBasisFunction (ConductorFPList &cond, const float archLength,
         }
     }
 }
-void intersectArch(RectangleGLList &rectList, RectangleGLList::iterator intersectEnd, RectangleGLList::iterator archPos);
+void intersectArch(RectangleGLList &archList, const RectangleGLList &rectList,
+                   const RectangleGLList::size_type intersectEnd, const RectangleGL &arch);
 void generateArch (RectangleGLList &rectList, const float archLength)
 {
 
     //* find the head of projection flat rects
-    RectangleGLList::iterator first = rectList.begin();
-    for ( RectangleGLList::iterator each=rectList.begin(); each!=rectList.end(); ++each ){
-        if (each->shapeShift!=0){
+    RectangleGLList::size_type first = 0;
+    for ( RectangleGLList::size_type each=0; each<rectList.size(); ++each ){
+        if (rectList[each].shapeShift!=0){
             first = each;
             break;
         }
     }
 
-    if (first==rectList.begin()){
+    if (first==0){
         //* there is no projection
         return;
     }
-    for ( RectangleGLList::iterator each = first; each!=rectList.end(); ++each ){
-        if (each->shapeType!=RectangleGL::FLAT_TYPE){
+
+    //* supports are kept; each projection is followed by its arches
+    RectangleGLList archList(rectList.begin(), rectList.begin()+first);
+    archList.reserve(rectList.size()*2);
+    for ( RectangleGLList::size_type eachIndex = first; eachIndex<rectList.size(); ++eachIndex ){
+        const RectangleGL &each = rectList[eachIndex];
+        archList.push_back(each);
+        if (each.shapeType!=RectangleGL::FLAT_TYPE){
             continue;
         }
-        RectangleGLList::iterator insertPos = each;
-        ++insertPos;
-        RectangleGLList::iterator archPos;
+        RectangleGL arch;
 
-        if (each->xn!=0 || each->zn!=0){
+        if (each.xn!=0 || each.zn!=0){
             //* x-dir normal: two arches
             //* z-dir normal: bottom and top
             //* bottom
-            archPos = rectList.insert(insertPos, *each);
-            archPos->y1 = each->y1 - archLength;
-            archPos->y2 = each->y1;
-            archPos->shapeType = RectangleGL::ARCH_TYPE;
-            archPos->shapeDir  = RectangleGL::Y_DECAY;
-            archPos->shapeShift= 0;
-            archPos->shapeNormalDistance = each->shapeNormalDistance * -1;
-            intersectArch(rectList, first, archPos);
+            arch = each;
+            arch.y1 = each.y1 - archLength;
+            arch.y2 = each.y1;
+            arch.shapeType = RectangleGL::ARCH_TYPE;
+            arch.shapeDir  = RectangleGL::Y_DECAY;
+            arch.shapeShift= 0;
+            arch.shapeNormalDistance = each.shapeNormalDistance * -1;
+            intersectArch(archList, rectList, first, arch);
             //* top
-            archPos = rectList.insert(insertPos, *each);
-            archPos->y1 = each->y2;
-            archPos->y2 = each->y2 + archLength;
-            archPos->shapeType = RectangleGL::ARCH_TYPE;
-            archPos->shapeDir  = RectangleGL::Y_DECAY;
-            archPos->shapeShift= 0;
-            archPos->shapeNormalDistance = each->shapeNormalDistance *  1;
-            intersectArch(rectList, first, archPos);
-        }
-        if (each->yn!=0 || each->zn!=0){
+            arch = each;
+            arch.y1 = each.y2;
+            arch.y2 = each.y2 + archLength;
+            arch.shapeType = RectangleGL::ARCH_TYPE;
+            arch.shapeDir  = RectangleGL::Y_DECAY;
+            arch.shapeShift= 0;
+            arch.shapeNormalDistance = each.shapeNormalDistance *  1;
+            intersectArch(archList, rectList, first, arch);
+        }
+        if (each.yn!=0 || each.zn!=0){
             //* y-dir normal: two arches
             //* z-dir normal: left and right
             //* left
-            archPos = rectList.insert(insertPos, *each);
-            archPos->x1 = each->x1 - archLength;
-            archPos->x2 = each->x1;
-            archPos->shapeType = RectangleGL::ARCH_TYPE;
-            archPos->shapeDir  = RectangleGL::X_DECAY;
-            archPos->shapeShift= 0;
-            archPos->shapeNormalDistance = each->shapeNormalDistance * -1;
-            intersectArch(rectList, first, archPos);
+            arch = each;
+            arch.x1 = each.x1 - archLength;
+            arch.x2 = each.x1;
+            arch.shapeType = RectangleGL::ARCH_TYPE;
+            arch.shapeDir  = RectangleGL::X_DECAY;
+            arch.shapeShift= 0;
+            arch.shapeNormalDistance = each.shapeNormalDistance * -1;
+            intersectArch(archList, rectList, first, arch);
             //* right
-            archPos = rectList.insert(insertPos, *each);
-            archPos->x1 = each->x2;
-            archPos->x2 = each->x2 + archLength;
-            archPos->shapeType = RectangleGL::ARCH_TYPE;
-            archPos->shapeDir  = RectangleGL::X_DECAY;
-            archPos->shapeShift= 0;
-            archPos->shapeNormalDistance = each->shapeNormalDistance *  1;
-            intersectArch(rectList, first, archPos);
+            arch = each;
+            arch.x1 = each.x2;
+            arch.x2 = each.x2 + archLength;
+            arch.shapeType = RectangleGL::ARCH_TYPE;
+            arch.shapeDir  = RectangleGL::X_DECAY;
+            arch.shapeShift= 0;
+            arch.shapeNormalDistance = each.shapeNormalDistance *  1;
+            intersectArch(archList, rectList, first, arch);
         }
     }
+    rectList.swap(archList);
 }
-void intersectArch(RectangleGLList &rectList, RectangleGLList::iterator intersectEnd, RectangleGLList::iterator archPos)
+
+//**
+//* intersectArch
+//* - append the intersections of arch with supports [0, intersectEnd)
+void intersectArch(RectangleGLList &archList, const RectangleGLList &rectList,
+                   const RectangleGLList::size_type intersectEnd, const RectangleGL &arch)
 {
-    for ( RectangleGLList::iterator eachRect = rectList.begin();
-          eachRect != intersectEnd; ++eachRect){
+    for ( RectangleGLList::size_type eachRect = 0; eachRect < intersectEnd; ++eachRect){
 
-        RectangleGL rect = archPos->intersectArchOnFlat(*eachRect);
+        RectangleGL rect = arch.intersectArchOnFlat(rectList[eachRect]);
         if (rect.isEmpty()==false){
-            rectList.insert(archPos, rect);
+            archList.push_back(rect);
         }
     }
-    archPos = rectList.erase(archPos);
+}
+
+
+//**
+//* pruneBasisFunction
+//* - candidates are the projections of instantiateBasisFunction, each
+//*   dropped together with the arches that follow it; supports are kept
+//*   and carry the charge of the dropped projections
+//* - the contribution of a projection is estimated by its area over its
+//*   normal distance, as a parallel-plate capacitance
+//* - the estimated error of a conductor is the contribution dropped from
+//*   it relative to the contribution of all of its projections; the
+//*   projections of each conductor are dropped from the least contribution
+//*   on, so a projection is dropped with an estimated error, the sum of
+//*   its contribution and the smaller ones
+//* - projections are dropped from the least estimated error on while there
+//*   are more than maxBasisFunction basis functions (0: no limit), and
+//*   otherwise while the estimated error stays within errorTolerance
+//*   (0: none); the largest estimated error of all conductors is kept low
+//* - an arch of a conductor overlapping another arch of the same length on
+//*   the same line by BASIS_FUNCTION_MERGE_OVERLAP is merged into it; the
+//*   arches of neighboring projections overlap this way, and with the
+//*   constant arch shape of the solver the difference of two such arches
+//*   is nearly the difference of the projections at their ends, which
+//*   leaves P close to singular
+//* - nPruned: number of dropped basis functions; return the largest
+//*   estimated error
+struct PruneCandidate{
+    unsigned    cond;
+    unsigned    layer;
+    unsigned    dir;
+    unsigned    first;
+    unsigned    count;
+    double      contribution;
+    double      error;
+};
+struct LessPruneCandidate{
+    const vector<PruneCandidate> &candidateList;
+    double PruneCandidate::*key;
+    LessPruneCandidate(const vector<PruneCandidate> &list, double PruneCandidate::*key)
+        : candidateList(list), key(key) {}
+    bool operator()(const unsigned k1, const unsigned k2) const {
+        return candidateList[k1].*key < candidateList[k2].*key;
+    }
+};
+static double rectangleArea(const RectangleGL &rect)
+{
+    return (rect.xn!=0)? double(rect.y2-rect.y1)*(rect.z2-rect.z1) :
+           (rect.yn!=0)? double(rect.x2-rect.x1)*(rect.z2-rect.z1) :
+                         double(rect.x2-rect.x1)*(rect.y2-rect.y1);
+}
+static void rectangleBound(const RectangleGL &rect, const unsigned dir, float &lower, float &upper)
+{
+    lower = (dir==RectangleGL::X_DECAY)? rect.x1 : (dir==RectangleGL::Y_DECAY)? rect.y1 : rect.z1;
+    upper = (dir==RectangleGL::X_DECAY)? rect.x2 : (dir==RectangleGL::Y_DECAY)? rect.y2 : rect.z2;
+}
+struct ArchRef{
+    const RectangleGL  *rect;
+    unsigned            list;
+    unsigned            index;
+    float               lower;
+    float               length;
+    ArchRef(const RectangleGL *rect, unsigned list, unsigned index)
+        : rect(rect), list(list), index(index)
+    {
+        float upper;
+        rectangleBound(*rect, rect->shapeDir, lower, upper);
+        length = upper - lower;
+    }
+    bool operator<(const ArchRef &ref) const {
+        return (rect->shapeDir != ref.rect->shapeDir)? rect->shapeDir < ref.rect->shapeDir : lower < ref.lower;
+    }
+};
+//* arches of the same length on the same line of the same face overlapping
+//  by overlap of their length along the decaying direction
+static bool isOverlappingArch(const ArchRef &arch1, const ArchRef &arch2, const float overlap)
+{
+    const RectangleGL &rect1 = *arch1.rect;
+    const RectangleGL &rect2 = *arch2.rect;
+    if ( rect1.xn!=rect2.xn || rect1.yn!=rect2.yn || rect1.zn!=rect2.zn || rect1.shapeDir!=rect2.shapeDir ){
+        return false;
+    }
+    const float margin = caplet::BASIS_FUNCTION_MERGE_MARGIN * max(arch1.length, arch2.length);
+    if ( fabs(arch1.length-arch2.length) > margin ){
+        return false;
+    }
+    for ( unsigned dir = 0; dir < 3; ++dir ){
+        float lower1, upper1, lower2, upper2;
+        rectangleBound(rect1, dir, lower1, upper1);
+        rectangleBound(rect2, dir, lower2, upper2);
+        if ( dir==unsigned(rect1.shapeDir) ){
+            if ( min(upper1, upper2) - max(lower1, lower2) < overlap*max(arch1.length, arch2.length) - margin ){
+                return false;
+            }
+        }
+        else if ( fabs(lower1-lower2) > margin || fabs(upper1-upper2) > margin ){
+            return false;
+        }
+    }
+    return true;
+}
+float pruneBasisFunction(ConductorFPList &cond, const int maxBasisFunction,
+                         const float errorTolerance, int &nPruned)
+{
+    nPruned = 0;
+
+    //* candidates in the order of (conductor, layer, dir, position)
+    vector<PruneCandidate> candidateList;
+    vector<double> total(cond.size(), 0);
+    long long nBasisFunction = 0;
+    for ( unsigned condIndex = 0; condIndex < cond.size(); ++condIndex ){
+        nBasisFunction += cond[condIndex].size();
+        for ( unsigned layerIndex = 0; layerIndex < cond[condIndex].layer.size(); ++layerIndex ){
+            for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+                const RectangleGLList &rectList = cond[condIndex].layer[layerIndex][dirIndex];
+                bool flagProjection = false;
+                for ( unsigned i = 0; i < rectList.size(); ++i ){
+                    const RectangleGL &rect = rectList[i];
+                    if ( rect.shapeType==RectangleGL::FLAT_TYPE && rect.shapeShift!=0 ){
+                        PruneCandidate candidate;
+                        candidate.cond  = condIndex;
+                        candidate.layer = layerIndex;
+                        candidate.dir   = dirIndex;
+                        candidate.first = i;
+                        candidate.count = 1;
+                        candidate.contribution = rectangleArea(rect)
+                                / max(fabs(rect.shapeNormalDistance), numeric_limits<float>::min());
+                        total[condIndex] += candidate.contribution;
+                        candidateList.push_back(candidate);
+                        flagProjection = true;
+                    }
+                    else if ( rect.shapeType==RectangleGL::ARCH_TYPE && flagProjection ){
+                        ++candidateList.back().count;
+                    }
+                }
+            }
+        }
+    }
+
+    //* estimated error of each candidate in its conductor
+    vector< vector<unsigned> > condCandidate(cond.size());
+    for ( unsigned k = 0; k < candidateList.size(); ++k ){
+        condCandidate[candidateList[k].cond].push_back(k);
+    }
+    for ( unsigned condIndex = 0; condIndex < cond.size(); ++condIndex ){
+        vector<unsigned> &order = condCandidate[condIndex];
+        stable_sort(order.begin(), order.end(), LessPruneCandidate(candidateList, &PruneCandidate::contribution));
+        double dropped = 0;
+        for ( vector<unsigned>::const_iterator each = order.begin(); each != order.end(); ++each ){
+            dropped += candidateList[*each].contribution;
+            candidateList[*each].error = (total[condIndex] > 0)? dropped / total[condIndex] : 0;
+        }
+    }
+
+    //* drop from the least estimated error on
+    vector<unsigned> order(candidateList.size());
+    for ( unsigned k = 0; k < order.size(); ++k ){
+        order[k] = k;
+    }
+    stable_sort(order.begin(), order.end(), LessPruneCandidate(candidateList, &PruneCandidate::error));
+    vector<bool> flagDropped(candidateList.size(), false);
+    float error = 0;
+    for ( vector<unsigned>::const_iterator each = order.begin(); each != order.end(); ++each ){
+        const PruneCandidate &candidate = candidateList[*each];
+        const bool flagOverBudget = maxBasisFunction > 0 && nBasisFunction > maxBasisFunction;
+        const bool flagTolerable  = candidate.error <= errorTolerance;
+        if ( flagOverBudget==false && flagTolerable==false ){
+            break;
+        }
+        flagDropped[*each] = true;
+        nBasisFunction -= candidate.count;
+        nPruned += candidate.count;
+        error = candidate.error;
+    }
+
+    //* remove dropped candidates and merge overlapping arches;
+    //  candidates of a list are consecutive
+    unsigned next = 0;
+    for ( unsigned condIndex = 0; condIndex < cond.size(); ++condIndex ){
+        LayeredDirRectangleGLList &layer = cond[condIndex].layer;
+        vector< vector<bool> > flagKeep(layer.size()*ConductorFP::nDir);
+        vector<ArchRef> archList;
+        for ( unsigned layerIndex = 0; layerIndex < layer.size(); ++layerIndex ){
+            for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+                const RectangleGLList &rectList = layer[layerIndex][dirIndex];
+                vector<bool> &flag = flagKeep[layerIndex*ConductorFP::nDir+dirIndex];
+                flag.assign(rectList.size(), true);
+                for ( ; next < candidateList.size() && candidateList[next].cond == condIndex
+                        && candidateList[next].layer == layerIndex && candidateList[next].dir == dirIndex; ++next ){
+                    if ( flagDropped[next] ){
+                        fill(flag.begin()+candidateList[next].first,
+                             flag.begin()+candidateList[next].first+candidateList[next].count, false);
+                    }
+                }
+                for ( unsigned i = 0; i < rectList.size(); ++i ){
+                    if ( flag[i] && rectList[i].shapeType==RectangleGL::ARCH_TYPE ){
+                        archList.push_back( ArchRef(&rectList[i], layerIndex*ConductorFP::nDir+dirIndex, i) );
+                    }
+                }
+            }
+        }
+
+        //* arches sorted by decaying direction and lower bound along it
+        sort(archList.begin(), archList.end());
+        const float overlap = caplet::BASIS_FUNCTION_MERGE_OVERLAP;
+        for ( unsigned k = 0; k < archList.size(); ++k ){
+            const ArchRef &arch = archList[k];
+            if ( flagKeep[arch.list][arch.index]==false ){
+                continue;
+            }
+            const float window = (1-overlap+caplet::BASIS_FUNCTION_MERGE_MARGIN)*arch.length;
+            for ( unsigned l = k+1; l < archList.size() && archList[l].rect->shapeDir == arch.rect->shapeDir
+                    && archList[l].lower - arch.lower <= window; ++l ){
+                vector<bool> &flag = flagKeep[archList[l].list];
+                if ( flag[archList[l].index] && isOverlappingArch(arch, archList[l], overlap) ){
+                    flag[archList[l].index] = false;
+                    --nBasisFunction;
+                    ++nPruned;
+                }
+            }
+        }
+
+        for ( unsigned layerIndex = 0; layerIndex < layer.size(); ++layerIndex ){
+            for ( unsigned dirIndex = 0; dirIndex < ConductorFP::nDir; ++dirIndex ){
+                const vector<bool> &flag = flagKeep[layerIndex*ConductorFP::nDir+dirIndex];
+                if ( find(flag.begin(), flag.end(), false) != flag.end() ){
+                    layer[layerIndex][dirIndex].compact(flag);
+                }
+            }
+        }
+    }
+
+    if ( maxBasisFunction > 0 && nBasisFunction > maxBasisFunction ){
+        cerr << "WARNING: " << nBasisFunction << " basis functions are left over the budget of "
+             << maxBasisFunction << " after dropping all projections." << endl;
+    }
+
+    return error;
 }
 
 
@@ -2249,6 +3475,239 @@ void writeCapletFile(
 
 
 
+void writeTileFile(
+        const std::string &outputFileName,
+        const TileList &tileList,
+        const bool flagCaplet)
+        throw (FileNotFoundError)
+{
+    string fullFileName = outputFileName + ".tiles";
+    ofstream fout(fullFileName.c_str());
+    if (fout.is_open()==false){
+        fout.close();
+        throw FileNotFoundError(fullFileName);
+    }
+
+    //* tile files are referred to by base name, relative to the manifest
+    string baseName = outputFileName;
+    size_t index = baseName.find_last_of('/');
+    if (index!=string::npos){
+        baseName = baseName.substr(index+1);
+    }
+
+    size_t nNet = 0;
+    for ( TileList::const_iterator each = tileList.begin(); each != tileList.end(); ++each ){
+        nNet += each->nOwned;
+    }
+    fout << nNet << " " << tileList.size() << endl;
+    for ( unsigned tileIndex = 0; tileIndex < tileList.size(); ++tileIndex ){
+        const Tile &tile = tileList[tileIndex];
+        stringstream ssTile;
+        ssTile << "_tile" << tileIndex;
+        if (flagCaplet==true){
+            writeCapletFile(outputFileName + ssTile.str(), tile.conductorList);
+        }
+        else{
+            writeFastcapFile(outputFileName + ssTile.str(), tile.conductorList);
+        }
+        fout << baseName << ssTile.str() << " " << tile.netIndex.size();
+        for ( unsigned i = 0; i < tile.netIndex.size(); ++i ){
+            fout << " " << tile.netIndex[i] << " " << tile.flagOwned[i];
+        }
+        fout << endl;
+    }
+
+    fout.close();
+}
+
+SweepVariant::SweepVariant()
+    : isSizeInput(false), isProjDistInput(false), isMergeDistInput(false),
+      size(0), projDist(0), mergeDist(0){
+}
+
+//**
+//* readElevation
+//* - aux function of readSweepFile(); value is "index,bottom,top"
+static vector<int> readElevation(const string &value) throw (std::invalid_argument)
+{
+    vector<int> elevation(3);
+    char comma1 = 0;
+    char comma2 = 0;
+    istringstream ss(value);
+    ss >> elevation[0] >> comma1 >> elevation[1] >> comma2 >> elevation[2];
+    if ( ss.fail() || comma1!=',' || comma2!=',' || elevation[1]>=elevation[2] ){
+        throw std::invalid_argument("invalid elevation (" + value + ")");
+    }
+    return elevation;
+}
+
+SweepVariantList readSweepFile(const std::string &sweepFileName)
+        throw (FileNotFoundError, std::invalid_argument)
+{
+    ifstream fin(sweepFileName.c_str());
+    if (fin.is_open()==false){
+        fin.close();
+        throw FileNotFoundError(sweepFileName);
+    }
+
+    SweepVariantList variantList;
+    string line;
+    while ( getline(fin, line) ){
+        line = line.substr(0, line.find('#'));
+        istringstream ssLine(line);
+        SweepVariant variant;
+        if ( !(ssLine >> variant.name) ){
+            continue;
+        }
+        string token;
+        while ( ssLine >> token ){
+            size_t index = token.find('=');
+            if ( index==string::npos ){
+                throw std::invalid_argument("missing value (" + token + ")");
+            }
+            const string key   = token.substr(0, index);
+            const string value = token.substr(index+1);
+            istringstream ssValue(value);
+            if ( key.compare("size")==0 ){
+                variant.isSizeInput = bool(ssValue >> variant.size);
+            }
+            else if ( key.compare("proj-dist")==0 ){
+                variant.isProjDistInput = bool(ssValue >> variant.projDist);
+            }
+            else if ( key.compare("merge-dist")==0 ){
+                variant.isMergeDistInput = bool(ssValue >> variant.mergeDist);
+            }
+            else if ( key.compare("metal")==0 ){
+                variant.metalElevation.push_back(readElevation(value));
+            }
+            else if ( key.compare("via")==0 ){
+                variant.viaElevation.push_back(readElevation(value));
+            }
+            else{
+                throw std::invalid_argument("unknown parameter (" + key + ")");
+            }
+            if ( ssValue.fail() ){
+                throw std::invalid_argument("invalid value (" + token + ")");
+            }
+        }
+        variantList.push_back(variant);
+    }
+    fin.close();
+    return variantList;
+}
+
+void writeSweepFile(
+        const std::string &outputFileName,
+        const SweepVariantList &variantList)
+        throw (FileNotFoundError)
+{
+    string fullFileName = outputFileName + ".sweep";
+    ofstream fout(fullFileName.c_str());
+    if (fout.is_open()==false){
+        fout.close();
+        throw FileNotFoundError(fullFileName);
+    }
+
+    //* variant files are referred to by base name, relative to the manifest
+    string baseName = outputFileName;
+    size_t index = baseName.find_last_of('/');
+    if (index!=string::npos){
+        baseName = baseName.substr(index+1);
+    }
+    for ( SweepVariantList::const_iterator each = variantList.begin();
+          each != variantList.end(); ++each ){
+        fout << baseName << "_" << each->name << endl;
+    }
+    fout.close();
+}
+
+Matrix stitchTileCmat(const std::string &tileFileName) throw (FileNotFoundError)
+{
+    ifstream fin(tileFileName.c_str());
+    if (fin.is_open()==false){
+        fin.close();
+        throw FileNotFoundError(tileFileName);
+    }
+
+    string folderPath = ".";
+    size_t index = tileFileName.find_last_of('/');
+    if (index!=string::npos){
+        folderPath = tileFileName.substr(0, index);
+    }
+
+    size_t nNet  = 0;
+    size_t nTile = 0;
+    fin >> nNet >> nTile;
+    Matrix cmat(nNet, vector<float>(nNet, 0));
+    vector< vector<bool> > isSet(nNet, vector<bool>(nNet, false));
+
+    for ( size_t tileIndex = 0; tileIndex < nTile; ++tileIndex ){
+        string tileBaseName;
+        size_t nCond  = 0;
+        fin >> tileBaseName >> nCond;
+        vector<int>  netIndex(nCond);
+        vector<int>  flagOwned(nCond);
+        for ( size_t i = 0; i < nCond; ++i ){
+            fin >> netIndex[i] >> flagOwned[i];
+        }
+
+        const string cmatFileName = folderPath + "/" + tileBaseName + ".cmat";
+        ifstream finCmat(cmatFileName.c_str());
+        if (finCmat.is_open()==false){
+            finCmat.close();
+            throw FileNotFoundError(cmatFileName);
+        }
+        for ( size_t i = 0; i < nCond; ++i ){
+            for ( size_t j = 0; j < nCond; ++j ){
+                float value = 0;
+                finCmat >> value;
+                if ( flagOwned[i] != 0 ){
+                    cmat[netIndex[i]][netIndex[j]] = value;
+                    isSet[netIndex[i]][netIndex[j]] = true;
+                }
+            }
+        }
+        finCmat.close();
+    }
+    fin.close();
+
+    //* symmetrize; a coupling seen from one side only is taken as is
+    for ( size_t i = 0; i < nNet; ++i ){
+        for ( size_t j = i+1; j < nNet; ++j ){
+            float value = cmat[i][j];
+            if ( isSet[i][j] == true && isSet[j][i] == true ){
+                value = 0.5f*(cmat[i][j] + cmat[j][i]);
+            }
+            else if ( isSet[j][i] == true ){
+                value = cmat[j][i];
+            }
+            cmat[i][j] = cmat[j][i] = value;
+        }
+    }
+
+    return cmat;
+}
+
+void writeCmatFile(
+        const std::string &outputFileName,
+        const Matrix &cmat)
+        throw (FileNotFoundError)
+{
+    ofstream fout(outputFileName.c_str());
+    if (fout.is_open()==false){
+        fout.close();
+        throw FileNotFoundError(outputFileName);
+    }
+    for ( Matrix::const_iterator eachRow = cmat.begin(); eachRow != cmat.end(); ++eachRow ){
+        for ( vector<float>::const_iterator each = eachRow->begin(); each != eachRow->end(); ++each ){
+            fout << *each << " ";
+        }
+        fout << endl;
+    }
+    fout.close();
+}
+
+
 void printPolygon(Polygon &poly){
     Polygon::iterator eachPoint;
     cout << "  Polygon" << endl;
@@ -89,6 +89,32 @@ private:
     std::string m_what;
 };
 
+//****
+//*
+//* Tile
+//*
+//* - the layout is partitioned into square tiles in the x-y plane
+//* - a net is owned by the tile containing the center of its bounding box
+//* - the window of a tile covers the tile and its owned nets, extended by
+//*   a halo on all sides
+//* - conductorList holds the owned nets in full and the other nets
+//*   clipped to the window, in the global net order
+//* - only rows of owned nets in the window Cmat are used for stitching
+class Tile{
+public:
+    float x1;   //* window, halo included
+    float x2;
+    float y1;
+    float y2;
+
+    int                 nOwned;
+    std::vector<int>    netIndex;   //* global net index of each conductor
+    std::vector<bool>   flagOwned;  //* whether each conductor is owned
+    ConductorFPList     conductorList;
+};
+
+typedef std::vector<Tile> TileList;
+
 class GeoLoader{
 public:
     GeoLoader();
@@ -99,23 +125,73 @@ public:
 
     void loadGeo( const std::string &fileName ) throw (FileNotFoundError, GeometryNotManhattanError);
 
+    //**
+    //* setMetalElevation, setViaElevation
+    //* - change the elevations of a loaded layer, e.g. for process corners
+    //* - the 2D decomposition of loadGeo() is kept; only z coordinates change
+    void setMetalElevation(const int metalIndex, const int bottomElevation, const int topElevation);
+    void setViaElevation(const int viaIndex, const int bottomElevation, const int topElevation);
+
+    //**
+    //* setViaArrayMerging
+    //* - flagMerged: each regular via array of loadGeo() is replaced by its
+    //*   bounding block in the constructed conductors (see mergeViaArrays)
+    //* - getNumberOfMergedViaArray/getNumberOfMergedVia: arrays and vias replaced
+    void setViaArrayMerging(const bool flagMerged);
+    int  getNumberOfMergedViaArray() const;
+    int  getNumberOfMergedVia() const;
+
     //**
     //* generate basis functions and floating point geometry
     //* - unit starts to get in
     const ConductorFPList &getGeometryConductorList(const float unit);
-    const ConductorFPList &getPWCBasisFunction(const float unit, const float suggestedPanelSize);
+    //* - growthRatio > 1: panels graded toward conductor edges (see discretizeDisjointSurface)
+    const ConductorFPList &getPWCBasisFunction(const float unit, const float suggestedPanelSize,
+                                               const float growthRatio=1);
     const ConductorFPList &getPWCBasisFunction() const;
     const ConductorFPList &getInstantiableBasisFunction(const float unit, const float archLength,
                                                         const float projectionDistance=caplet::DEFAULT_PROJECTION_DISTANCE,
                                                         const float projectionMergeDistance=caplet::DEFAULT_PROJECTION_MERGE_DISTANCE);
 
+    //**
+    //* tiled basis functions
+    //* - see Tile
+    //* - tiles are independent and constructed in parallel with CAPLET_OPENMP
+    const TileList &getTiledPWCBasisFunction(const float unit, const float suggestedPanelSize,
+                                             const float tileSize, const float haloSize,
+                                             const float growthRatio=1);
+    const TileList &getTiledInstantiableBasisFunction(const float unit, const float archLength,
+                                                      const float tileSize, const float haloSize,
+                                                      const float projectionDistance=caplet::DEFAULT_PROJECTION_DISTANCE,
+                                                      const float projectionMergeDistance=caplet::DEFAULT_PROJECTION_MERGE_DISTANCE);
+    const TileList &getTileList() const;
+
+    //**
+    //* setBasisFunctionBudget
+    //* - instantiable basis functions (of each tile) are pruned to at most
+    //*   maxBasisFunction (0: no limit) or within the estimated error
+    //*   errorTolerance (0: none) (see pruneBasisFunction)
+    //* - getNumberOfPrunedBasisFunction/getPrunedBasisFunctionError:
+    //*   basis functions dropped and the largest estimated error (over tiles)
+    //*   at the last construction
+    void  setBasisFunctionBudget(const int maxBasisFunction, const float errorTolerance);
+    int   getNumberOfPrunedBasisFunction() const;
+    float getPrunedBasisFunctionError() const;
+
     void loadQui(const std::string &inputFileName) throw (FileNotFoundError);
 
     ExtractionInfo &runFastcap(const std::string &pathFileBaseName, const std::string &option="")
             throw (FileNotFoundError);
     ExtractionInfo &runCaplet(const std::string &pathFileBaseName, const unsigned coreNum=1 )
             throw (FileNotFoundError);
-    ExtractionInfo &runCapletQui(const std::string &pathFileBaseName )
+    ExtractionInfo &runCapletQui(const std::string &pathFileBaseName, const std::string &option="" )
+            throw (FileNotFoundError);
+    const ExtractionInfo &computeReference(const std::string &pathFileBaseName,
+            const float unit, float pwcSize, const float alpha, const float epsilon,
+            const std::string &pathFileNameCmat,
+            const int nConcurrent=caplet::REFERENCE_CONCURRENT_LEVELS,
+            const int maxLevel=caplet::REFERENCE_MAX_LEVELS,
+            const std::string &option="--fft")
             throw (FileNotFoundError);
 
     std::string fileName;
@@ -151,12 +227,22 @@ private:
 
     ConductorList           metalConductorList;
     LayeredRectangleList    viaLayeredRectangleList;
+    LayeredRectangleList    mergedViaLayeredRectangleList;  //* via arrays as blocks
+    bool                    flagViaArrayMerged;
+    int                     nMergedViaArray;
+    int                     nMergedVia;
 
     ConductorList           geometryConductorList;
 
     ConductorFPList         geometryConductorFPList;
     ConductorFPList         pwcConductorFPList;
     ConductorFPList         instantiableConductorFPList;
+    TileList                tileList;
+
+    int                     maxBasisFunction;
+    float                   basisFunctionErrorTolerance;
+    int                     nPrunedBasisFunction;
+    float                   prunedBasisFunctionError;
 
     double                  tPWCConstruction;
     double                  tInstantiableConstruction;
@@ -170,18 +256,28 @@ private:
     void readStruc(std::ifstream &fin, int nLayer, std::vector<PolygonList> &struc);
     void printStruc(int nLayer, std::vector<PolygonList> &struc);
 
+    void extractQui(const std::string &pathFileBaseName, const std::string &option,
+                    const double tBasis, ExtractionInfo &result) const
+            throw (FileNotFoundError);
+
     ConductorList &generateConductorList(ConductorList &conductorList, bool flagDecomposed);
+    void generateTileList(const float unit, const float tileSize, const float haloSize,
+                          const float marginSize, bool flagDecomposed);
 
     ExtractionInfoList extractionInfoList;
     ExtractionInfo referenceResult;
 
 };
-typedef std::list< std::pair<int,int> > AdjacencyList;
-typedef std::vector< AdjacencyList >    DirAdjacencyList;
-typedef std::list< DirAdjacencyList >   DirAdjacencyListOfRectangleList;
+//* - adjacency lists are temporaries of GeoLoader::loadGeo() (see geoarena.h)
+typedef std::list< std::pair<int,int>, GeoArenaAllocator< std::pair<int,int> > >   AdjacencyList;
+typedef std::vector< AdjacencyList, GeoArenaAllocator<AdjacencyList> >             DirAdjacencyList;
+typedef std::list< DirAdjacencyList, GeoArenaAllocator<DirAdjacencyList> >         DirAdjacencyListOfRectangleList;
 
 void poly2rect(PolygonList &polygonList, RectangleList &rectList);
 void generateConnectedRects( RectangleList &rectList, ConnectedRectangleList &rectListList );
+void mergeViaArrays(const RectangleList &viaList, const ConductorList &metalConductorList,
+                    const int lowerMetalIndex, const int upperMetalIndex,
+                    RectangleList &mergedList, int &nArray, int &nMergedVia);
 void computeAdjacency(const RectangleList               &rectList,
                       DirAdjacencyListOfRectangleList   &adjacency,
                       DirAdjacencyListOfRectangleList   &compAdjacency);
@@ -193,9 +289,11 @@ void generate3dRects(const RectangleList                    &rect2dList,
                      const int                              layerIndex,
                      Conductor                              &cond);
 
-void discretizeDisjointSurface(ConductorFPList &cond, const float suggestedPanelSize);
+void discretizeDisjointSurface(ConductorFPList &cond, const float suggestedPanelSize, const float growthRatio=1);
 void instantiateBasisFunction (ConductorFPList &cond, const float archLength,
                                const float projectionDistance, const float projectionMergeDistance);
+float pruneBasisFunction(ConductorFPList &cond, const int maxBasisFunction,
+                         const float errorTolerance, int &nPruned);
 
 
 //****
@@ -212,6 +310,71 @@ void writeCapletFile(
         const ConductorFPList &cond)
         throw (FileNotFoundError);
 
+//**
+//* writeTileFile
+//* - write outputFileName_tile<k>.caplet (or .qui) for each tile and
+//*   the manifest outputFileName.tiles:
+//*     nNet nTile
+//*     tileFileBaseName nConductor netIndex flagOwned ...  (one line per tile)
+void writeTileFile(
+        const std::string &outputFileName,
+        const TileList &tileList,
+        const bool flagCaplet)
+        throw (FileNotFoundError);
+
+//****
+//*
+//* Sweep
+//*
+//* - variants of one layout sharing a single loadGeo()
+//* - sweep file: one variant per line, '#' starts a comment
+//*     name [size=v] [proj-dist=v] [merge-dist=v] [metal=k,bottom,top] [via=k,bottom,top]
+//* - size, proj-dist and merge-dist are in the units of the command line options,
+//*   elevations in the grid unit of the .geo file
+//* - parameters not given keep the values of the command line and the .geo file
+class SweepVariant{
+public:
+    std::string name;
+
+    bool    isSizeInput;
+    bool    isProjDistInput;
+    bool    isMergeDistInput;
+    float   size;
+    float   projDist;
+    float   mergeDist;
+
+    std::vector<std::vector<int> > metalElevation;  //* metalIndex, bottom, top
+    std::vector<std::vector<int> > viaElevation;    //* viaIndex, bottom, top
+
+    SweepVariant();
+};
+
+typedef std::vector<SweepVariant> SweepVariantList;
+
+SweepVariantList readSweepFile(const std::string &sweepFileName)
+        throw (FileNotFoundError, std::invalid_argument);
+
+//**
+//* writeSweepFile
+//* - write the manifest outputFileName.sweep with the base name
+//*   outputFileName_<name> of each variant, one per line
+void writeSweepFile(
+        const std::string &outputFileName,
+        const SweepVariantList &variantList)
+        throw (FileNotFoundError);
+
+//**
+//* stitchTileCmat
+//* - read the manifest tileFileName and tileFileBaseName.cmat of each tile
+//*   from the same folder
+//* - rows of owned nets are copied to the global matrix, which is then
+//*   symmetrized; couplings beyond the halo are zero
+Matrix stitchTileCmat(const std::string &tileFileName) throw (FileNotFoundError);
+void writeCmatFile(
+        const std::string &outputFileName,
+        const Matrix &cmat)
+        throw (FileNotFoundError);
+
 
 //****
 //*
@@ -0,0 +1,163 @@
+/*
+CREATED : Oct 19, 2026
+AUTHOR  : Yu-Chung Hsiao
+EMAIL   : project.caplet@gmail.com
+
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "geometrics.h"
+
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+
+GeoMetrics &GeoMetrics::instance()
+{
+    static GeoMetrics metrics;
+    return metrics;
+}
+
+GeoMetrics::GeoMetrics()
+    : current(0)
+{
+    Phase root;
+    root.parent = -1;
+    root.calls  = 0;
+    root.wall   = root.cpu = 0;
+    root.wallStart = root.cpuStart = 0;
+    phaseList.push_back(root);
+}
+
+void GeoMetrics::begin(const string &name)
+{
+    int phase = -1;
+    const vector<int> &children = phaseList[current].children;
+    for ( unsigned i = 0; i < children.size(); ++i ){
+        if ( phaseList[children[i]].name == name ){
+            phase = children[i];
+            break;
+        }
+    }
+    if ( phase < 0 ){
+        Phase child;
+        child.name   = name;
+        child.parent = current;
+        child.calls  = 0;
+        child.wall   = child.cpu = 0;
+        phase = phaseList.size();
+        phaseList.push_back(child);
+        phaseList[current].children.push_back(phase);
+    }
+    current = phase;
+    phaseList[phase].wallStart = geoWallTime();
+    phaseList[phase].cpuStart  = geoCpuTime();
+}
+
+void GeoMetrics::end()
+{
+    if ( current == 0 ){
+        return;
+    }
+    Phase &phase = phaseList[current];
+    phase.wall  += geoWallTime() - phase.wallStart;
+    phase.cpu   += geoCpuTime()  - phase.cpuStart;
+    phase.calls += 1;
+    current = phase.parent;
+}
+
+void GeoMetrics::count(const string &name, long long n)
+{
+    counterMap[name] += n;
+}
+
+void GeoMetrics::setValue(const string &name, double value)
+{
+    valueMap[name] = value;
+}
+
+static string quote(const string &text)
+{
+    string result = "\"";
+    for ( unsigned i = 0; i < text.size(); ++i ){
+        if ( text[i]=='"' || text[i]=='\\' ){
+            result += '\\';
+        }
+        result += text[i];
+    }
+    return result + "\"";
+}
+
+void GeoMetrics::writePhase(ostream &out, int phase, int depth) const
+{
+    const string indent(2*depth, ' ');
+    const Phase &p = phaseList[phase];
+    out << indent << "{ \"name\": " << quote(p.name)
+        << ", \"calls\": " << p.calls
+        << ", \"wall_s\": " << p.wall
+        << ", \"cpu_s\": " << p.cpu
+        << ", \"children\": [";
+    for ( unsigned i = 0; i < p.children.size(); ++i ){
+        out << ( (i==0)? "\n" : ",\n" );
+        writePhase(out, p.children[i], depth+1);
+    }
+    if ( p.children.empty() == false ){
+        out << "\n" << indent;
+    }
+    out << "] }";
+}
+
+bool GeoMetrics::write(const string &fileName, const string &program) const
+{
+    ofstream out(fileName.c_str());
+    if ( !out ){
+        return false;
+    }
+    out.precision(9);
+
+    out << "{\n";
+    out << "  \"program\": " << quote(program) << ",\n";
+
+    out << "  \"phases\": [";
+    const vector<int> &roots = phaseList[0].children;
+    for ( unsigned i = 0; i < roots.size(); ++i ){
+        out << ( (i==0)? "\n" : ",\n" );
+        writePhase(out, roots[i], 2);
+    }
+    out << "\n  ],\n";
+
+    out << "  \"counters\": {";
+    bool isFirst = true;
+    for ( map<string, long long>::const_iterator each = counterMap.begin();
+          each != counterMap.end(); ++each ){
+        out << ( isFirst? "\n" : ",\n" ) << "    " << quote(each->first) << ": " << each->second;
+        isFirst = false;
+    }
+    out << "\n  },\n";
+
+    out << "  \"values\": {";
+    isFirst = true;
+    for ( map<string, double>::const_iterator each = valueMap.begin();
+          each != valueMap.end(); ++each ){
+        out << ( isFirst? "\n" : ",\n" ) << "    " << quote(each->first) << ": " << each->second;
+        isFirst = false;
+    }
+    out << "\n  }\n";
+    out << "}\n";
+
+    return true;
+}
@@ -0,0 +1,120 @@
+/*
+CREATED : Oct 19, 2026
+AUTHOR  : Yu-Chung Hsiao
+EMAIL   : project.caplet@gmail.com
+
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef GEOMETRICS_H
+#define GEOMETRICS_H
+
+#include <ctime>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+//****
+//*
+//* Per-phase timing and counters of basis function construction
+//*
+//* - Phases form a tree by nesting GeoMetricsScope objects; a phase
+//*   entered again under the same parent accumulates.
+//* - Each phase records wall time, CPU time of the process (all threads)
+//*   and calls. Wall time is the elapsed time even when OpenMP tiles run
+//*   in parallel; CPU time over wall time is the number of busy threads.
+//* - Counters and values hold sizes, e.g. conductors and panels.
+//* - write() emits everything as the same JSON layout as the solver
+//*   (caplet --metrics).
+//* - Not thread-safe; phases are opened by the master thread only.
+//*
+//****
+
+//**
+//* wall time and CPU time of the process in seconds
+inline double geoWallTime(){
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+inline double geoCpuTime(){
+    timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+//**
+//* GeoMetrics
+class GeoMetrics
+{
+public:
+    static GeoMetrics &instance();
+
+    void begin(const std::string &name);
+    void end();
+    void count(const std::string &name, long long n=1);
+    void setValue(const std::string &name, double value);
+
+    //* return false if the file cannot be opened
+    bool write(const std::string &fileName, const std::string &program) const;
+
+private:
+    struct Phase{
+        std::string      name;
+        int              parent;
+        std::vector<int> children;
+        long long        calls;
+        double           wall;
+        double           cpu;
+        double           wallStart;
+        double           cpuStart;
+    };
+
+    std::vector<Phase>               phaseList;     //* phaseList[0] is the root
+    int                              current;
+    std::map<std::string, long long> counterMap;
+    std::map<std::string, double>    valueMap;
+
+    GeoMetrics();
+    GeoMetrics(const GeoMetrics &);
+    GeoMetrics &operator=(const GeoMetrics &);
+
+    void writePhase(std::ostream &out, int phase, int depth) const;
+};
+
+//**
+//* GeoMetricsScope
+//* - time a phase for the lifetime of this object, also when an
+//*   exception leaves the scope
+class GeoMetricsScope
+{
+public:
+    explicit GeoMetricsScope(const std::string &name){
+        GeoMetrics::instance().begin(name);
+    }
+    ~GeoMetricsScope(){
+        GeoMetrics::instance().end();
+    }
+
+private:
+    GeoMetricsScope(const GeoMetricsScope &);
+    GeoMetricsScope &operator=(const GeoMetricsScope &);
+};
+
+#endif // GEOMETRICS_H
@@ -21,11 +21,13 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "geoloader.h"
+#include "geometrics.h"
 
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <list>
+#include <vector>
 #include <cstdlib>
 using namespace std;
 
@@ -56,11 +58,75 @@ void printUsage(const string &command){
          << "                               (default: 300e-9, value>0: normal, " << endl
          << "                                                 value=0: no arch, " << endl
          << "                                                 value<0: no flat shapes" << endl
+         << "       -g,--grading     value: growth ratio of piecewise constant basis functions" << endl
+         << "                               graded toward conductor edges" << endl
+         << "                               (default: 1, uniform; value>1: graded)" << endl
          << "       -p,--proj-dist   value: projection distance (default: 2e-6)" << endl
          << "       -m,--merge-dist  value: projection merge distance (default: 1e-7)" << endl
+         << "       --via-array           : replace regular via arrays by their bounding blocks" << endl
+         << "       --budget         value: at most value instantiable basis functions per output" << endl
+         << "                               file; projections of the least estimated contribution" << endl
+         << "                               (area over distance) are dropped (default: 0, no limit)" << endl
+         << "       --budget-error   value: also drop projections while the estimated error of" << endl
+         << "                               each conductor stays within value (%) (default: 0)" << endl
+         << endl
+         << "       Tiled Extraction:" << endl
+         << "       --tile           value: tile size; writes filename_tile<k>.qui/.caplet" << endl
+         << "                               per tile and the manifest filename.tiles" << endl
+         << "                               (default: 0, no tiling)" << endl
+         << "       --halo           value: halo around each tile (default: proj-dist)" << endl
+         << "       --stitch filename.tiles: stitch filename_tile<k>.cmat into filename.cmat" << endl
+         << endl
+         << "       Parameter Sweep:" << endl
+         << "       --sweep      filename: write filename_<name>.qui/.caplet for each variant" << endl
+         << "                               and the manifest filename.sweep; one variant per line:" << endl
+         << "                               name [size=v] [proj-dist=v] [merge-dist=v]" << endl
+         << "                                    [metal=k,bottom,top] [via=k,bottom,top]" << endl
+         << endl
+         << "       Reference Capacitance Matrix:" << endl
+         << "       --reference      value: refine PWC basis functions from --size and extract" << endl
+         << "                               them by ../caplet_solver/bin/capletMPI --fft until" << endl
+         << "                               the extrapolated Cmat changes by less than value (%);" << endl
+         << "                               writes filename_ref.cmat" << endl
+         << endl
+         << "       Instrumentation:" << endl
+         << "       --metrics    filename: write per-phase wall/CPU time and sizes (JSON)" << endl
          << endl;    
 }
 
+//* Add sizes of constructed basis functions to the metrics
+void countBasisFunction(const ConductorFPList &condList)
+{
+    long long nShape = 0;
+    for ( ConductorFPList::const_iterator each = condList.begin(); each != condList.end(); ++each ){
+        nShape += each->size();
+    }
+    GeoMetrics::instance().count("conductors", condList.size());
+    GeoMetrics::instance().count("basis_shapes", nShape);
+}
+
+//* Report basis functions dropped for the budget
+void reportPrunedBasisFunction(const GeoLoader &geoloader, const bool isBudgetInput)
+{
+    if (isBudgetInput==false){
+        return;
+    }
+    const float percent = 0.01;
+    cout << "CAPLET_GEO: Pruned " << geoloader.getNumberOfPrunedBasisFunction()
+         << " basis functions (estimated error " << geoloader.getPrunedBasisFunctionError()/percent << "%)." << endl;
+    GeoMetrics::instance().count("pruned_basis_functions", geoloader.getNumberOfPrunedBasisFunction());
+}
+
+//* Write the metrics file if requested
+void writeMetrics(const string &metricsFileName)
+{
+    if ( metricsFileName.empty()==false
+         && GeoMetrics::instance().write(metricsFileName, "caplet_geo_cli")==false ){
+        cerr << "ERROR: Cannot write file. (" << metricsFileName << ")" << endl;
+        exit(1);
+    }
+}
+
 int main(int argc, char *argv[])
 {
     if (argc<2){
@@ -80,9 +146,22 @@ int main(int argc, char *argv[])
     float size = 300;
     bool   isSizeInput = false;
 
+    float growthRatio = 1;
+    bool  isViaArrayMerged = false;
+    int   budget = 0;
+    float budgetError = 0;
+
     float projDist  = 2000 *unit;
     float mergeDist =   10 *unit;
 
+    float tileSize = 0;
+    float haloSize = 0;
+    bool  isHaloInput = false;
+    string tileFileName;
+    string sweepFileName;
+    string metricsFileName;
+    float  referenceError = 0;
+
     for ( list<string>::iterator each=argvList.begin();
           each!=argvList.end(); ){
 
@@ -146,6 +225,52 @@ int main(int argc, char *argv[])
             continue;
         }
 
+        //* -g,--grading
+        if (each->compare("--grading")==0 || each->compare("-g")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            istringstream growthRatioSS(*each);
+            growthRatioSS >> growthRatio;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --via-array
+        if (each->compare("--via-array")==0){
+            isViaArrayMerged = true;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --budget
+        if (each->compare("--budget")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            istringstream budgetSS(*each);
+            budgetSS >> budget;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --budget-error
+        if (each->compare("--budget-error")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            istringstream budgetErrorSS(*each);
+            budgetErrorSS >> budgetError;
+            each = argvList.erase(each);
+            continue;
+        }
+
         //* -p,--proj-dist
         if (each->compare("--proj-dist")==0 || each->compare("-p")==0){
             if (argvList.empty()==true) {
@@ -174,6 +299,82 @@ int main(int argc, char *argv[])
             continue;
         }
 
+        //* --tile
+        if (each->compare("--tile")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            istringstream tileSizeSS(*each);
+            tileSizeSS >> tileSize;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --halo
+        if (each->compare("--halo")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            isHaloInput = true;
+            istringstream haloSizeSS(*each);
+            haloSizeSS >> haloSize;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --stitch
+        if (each->compare("--stitch")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            tileFileName = *each;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --sweep
+        if (each->compare("--sweep")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            sweepFileName = *each;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --reference
+        if (each->compare("--reference")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            istringstream referenceErrorSS(*each);
+            referenceErrorSS >> referenceError;
+            each = argvList.erase(each);
+            continue;
+        }
+
+        //* --metrics
+        if (each->compare("--metrics")==0){
+            if (argvList.empty()==true) {
+                printUsage(argv[0]);
+                return 0;
+            }
+            each = argvList.erase(each);
+            metricsFileName = *each;
+            each = argvList.erase(each);
+            continue;
+        }
+
         //* increment
         ++each;
     }
@@ -190,6 +391,28 @@ int main(int argc, char *argv[])
     }
 
 
+    //* Stitch tile Cmat files and stop
+    if ( tileFileName.empty()==false ){
+        const string tileExt = ".tiles";
+        if ( tileFileName.size()<=tileExt.size()
+             || tileFileName.compare(tileFileName.size()-tileExt.size(), tileExt.size(), tileExt)!=0 ){
+            cout << "CAPLET_GEO: Not supported file type. (" << tileFileName << ")" << endl;
+            exit(0);
+        }
+        const string cmatFileName = tileFileName.substr(0, tileFileName.size()-tileExt.size()) + ".cmat";
+        try{
+            GeoMetricsScope metricsScope("stitch");
+            writeCmatFile(cmatFileName, stitchTileCmat(tileFileName));
+        }
+        catch (FileNotFoundError e){
+            cerr << "ERROR: File not found. (" << e.what() << ")" << endl;
+            exit(1);
+        }
+        cout << "CAPLET_GEO: Done stitching. (" << cmatFileName << ")" << endl;
+        writeMetrics(metricsFileName);
+        return 0;
+    }
+
     //* If not input file specified
     if ( argvList.empty()==true ){
         cout << "CAPLET_GEO_CLI: No input file specified." << endl;
@@ -216,6 +439,19 @@ int main(int argc, char *argv[])
             exit(0);
         }
     }
+    if (growthRatio < 1){
+        cout << "CAPLET_GEO: PWC growth ratio has to be at least 1." << endl;
+        exit(0);
+    }
+    const bool isBudgetInput = budget!=0 || budgetError!=0;
+    if (budget < 0 || budgetError < 0){
+        cout << "CAPLET_GEO: Basis function budget has to be nonnegative." << endl;
+        exit(0);
+    }
+    if (isBudgetInput && basisFunctionType != INSTANTIABLE_BASIS){
+        cout << "CAPLET_GEO: Basis function budget applies to instantiable basis functions only." << endl;
+        exit(0);
+    }
 
     //* Read file name
     string fileName;
@@ -260,6 +496,171 @@ int main(int argc, char *argv[])
         cerr << "ERROR: " << e.what() << endl;
         exit(1);
     }
+    geoloader.setBasisFunctionBudget(budget, budgetError*0.01f);
+    if (isViaArrayMerged){
+        geoloader.setViaArrayMerging(true);
+        cout << "CAPLET_GEO: Merged " << geoloader.getNumberOfMergedVia() << " vias in "
+             << geoloader.getNumberOfMergedViaArray() << " via arrays into blocks." << endl;
+    }
+
+    //* Construct basis functions for each variant of the sweep
+    if ( sweepFileName.empty()==false ){
+        SweepVariantList variantList;
+        try{
+            variantList = readSweepFile(sweepFileName);
+        }
+        catch (FileNotFoundError e){
+            cerr << "ERROR: File not found. (" << sweepFileName << ")" << endl;
+            exit(1);
+        }
+        catch (std::invalid_argument e){
+            cerr << "ERROR: Invalid sweep file. (" << e.what() << ")" << endl;
+            exit(1);
+        }
+
+        //* elevations of the .geo file
+        vector<vector<int> > metalDef(geoloader.nMetal, vector<int>(2));
+        vector<vector<int> > viaDef(geoloader.nVia, vector<int>(2));
+        for ( int i=0; i<geoloader.nMetal; ++i ){
+            metalDef[i].assign(geoloader.metalDef[i], geoloader.metalDef[i]+2);
+        }
+        for ( int i=0; i<geoloader.nVia; ++i ){
+            viaDef[i].assign(geoloader.viaDef[i], geoloader.viaDef[i]+2);
+        }
+
+        for ( SweepVariantList::const_iterator each = variantList.begin();
+              each != variantList.end(); ++each ){
+            for ( int i=0; i<geoloader.nMetal; ++i ){
+                geoloader.setMetalElevation(i, metalDef[i][0], metalDef[i][1]);
+            }
+            for ( int i=0; i<geoloader.nVia; ++i ){
+                geoloader.setViaElevation(i, viaDef[i][0], viaDef[i][1]);
+            }
+            for ( unsigned k=0; k<each->metalElevation.size(); ++k ){
+                const vector<int> &elevation = each->metalElevation[k];
+                if ( elevation[0]<0 || elevation[0]>=geoloader.nMetal ){
+                    cerr << "ERROR: Metal layer not found. (" << each->name << ")" << endl;
+                    exit(1);
+                }
+                geoloader.setMetalElevation(elevation[0], elevation[1], elevation[2]);
+            }
+            for ( unsigned k=0; k<each->viaElevation.size(); ++k ){
+                const vector<int> &elevation = each->viaElevation[k];
+                if ( elevation[0]<0 || elevation[0]>=geoloader.nVia ){
+                    cerr << "ERROR: Via layer not found. (" << each->name << ")" << endl;
+                    exit(1);
+                }
+                geoloader.setViaElevation(elevation[0], elevation[1], elevation[2]);
+            }
+
+            const float variantSize      = (each->isSizeInput==true)?      each->size      : size;
+            const float variantProjDist  = (each->isProjDistInput==true)?  each->projDist  : projDist;
+            const float variantMergeDist = (each->isMergeDistInput==true)? each->mergeDist : mergeDist;
+            const string variantFileName = fileBaseName + "_" + each->name;
+            try{
+                switch(basisFunctionType){
+                case PWC_BASIS:{
+                    const ConductorFPList &condList = geoloader.getPWCBasisFunction(unit, variantSize*unit, growthRatio);
+                    countBasisFunction(condList);
+                    GeoMetricsScope metricsScope("write");
+                    writeFastcapFile(variantFileName, condList);
+                }break;
+                case INSTANTIABLE_BASIS:{
+                    const ConductorFPList &condList = geoloader.getInstantiableBasisFunction(
+                            unit, variantSize*unit, variantProjDist, variantMergeDist);
+                    reportPrunedBasisFunction(geoloader, isBudgetInput);
+                    countBasisFunction(condList);
+                    GeoMetricsScope metricsScope("write");
+                    writeCapletFile(variantFileName, condList);
+                }break;
+                default:
+                    cerr << "ERROR: Unknown basis function type." << endl;
+                    exit(1);
+                }
+            }
+            catch (FileNotFoundError e){
+                cerr << "ERROR: Cannot write file. (" << e.what() << ")" << endl;
+                exit(1);
+            }
+        }
+
+        const string outputFileName = fileBaseName+".sweep";
+        try{
+            writeSweepFile(fileBaseName, variantList);
+        }
+        catch (FileNotFoundError e){
+            cerr << "ERROR: Cannot write file. (" << outputFileName << ")" << endl;
+            exit(1);
+        }
+        cout << "CAPLET_GEO: Done basis functions construction for " << variantList.size()
+             << " variants. (" << outputFileName << ")" << endl;
+        GeoMetrics::instance().setValue("sweep_variants", variantList.size());
+        writeMetrics(metricsFileName);
+        return 0;
+    }
+
+    //* Extrapolate the reference Cmat from refined PWC basis functions
+    if (referenceError > 0){
+        const float percent = 0.01;
+        const string cmatFileName = fileBaseName+"_ref.cmat";
+        try{
+            GeoMetricsScope metricsScope("reference");
+            geoloader.computeReference(fileBaseName, unit, size*unit, caplet::DEFAULT_REFERENCE_REFINEMENT,
+                                       referenceError*percent, cmatFileName);
+        }
+        catch (FileNotFoundError e){
+            cerr << "ERROR: File not found. (" << e.what() << ")" << endl;
+            exit(1);
+        }
+        list<ExtractionInfo> resultList = geoloader.compareAllAgainstReference();
+        resultList.front().printBasicHeader();
+        cout << endl;
+        for ( list<ExtractionInfo>::const_iterator each = resultList.begin();
+              each != resultList.end(); ++each ){
+            each->printBasicLine();
+            cout << endl;
+        }
+        cout << "CAPLET_GEO: Done reference Cmat extraction. (" << cmatFileName << ")" << endl;
+        writeMetrics(metricsFileName);
+        return 0;
+    }
+
+    //* Construct basis functions tile by tile
+    if (tileSize > 0){
+        if (isHaloInput==false){
+            haloSize = projDist;
+        }
+        const string outputFileName = fileBaseName+".tiles";
+        const TileList *tileList = 0;
+        switch(basisFunctionType){
+        case PWC_BASIS:
+            tileList = &geoloader.getTiledPWCBasisFunction(unit, size*unit, tileSize, haloSize, growthRatio);
+            break;
+        case INSTANTIABLE_BASIS:
+            tileList = &geoloader.getTiledInstantiableBasisFunction(unit, size*unit, tileSize, haloSize, projDist, mergeDist);
+            reportPrunedBasisFunction(geoloader, isBudgetInput);
+            break;
+        default:
+            cerr << "ERROR: Unknown basis function type." << endl;
+            exit(1);
+        }
+        for ( TileList::const_iterator each = tileList->begin(); each != tileList->end(); ++each ){
+            countBasisFunction(each->conductorList);
+        }
+        try{
+            GeoMetricsScope metricsScope("write");
+            writeTileFile(fileBaseName, *tileList, basisFunctionType==INSTANTIABLE_BASIS);
+        }
+        catch (FileNotFoundError e){
+            cerr << "ERROR: Cannot write file. (" << e.what() << ")" << endl;
+            exit(1);
+        }
+        cout << "CAPLET_GEO: Done basis functions construction for " << tileList->size()
+             << " tiles. (" << outputFileName << ")" << endl;
+        GeoMetrics::instance().setValue("tiles", tileList->size());
+        writeMetrics(metricsFileName);
+        return 0;
+    }
 
     //* Construct basis functions
     string outputFileName = fileBaseName+".";
@@ -267,19 +668,26 @@ int main(int argc, char *argv[])
     case PWC_BASIS:{
         outputFileName += fastcapExt;
         try{
-            writeFastcapFile(fileBaseName, geoloader.getPWCBasisFunction(unit, size*unit));
+            const ConductorFPList &condList = geoloader.getPWCBasisFunction(unit, size*unit, growthRatio);
+            countBasisFunction(condList);
+            GeoMetricsScope metricsScope("write");
+            writeFastcapFile(fileBaseName, condList);
         }
         catch (FileNotFoundError e){
             cerr << "ERROR: Cannot write file. (" << outputFileName << ")" << endl;
             exit(1);
         }
-        const ConductorFPList   condList = geoloader.getPWCBasisFunction(unit, size*unit);
+        const ConductorFPList   condList = geoloader.getPWCBasisFunction();
         cout << condList.front().size() << endl;
     }break;
     case INSTANTIABLE_BASIS:{
         outputFileName += capletExt;
         try{
-            writeCapletFile(fileBaseName, geoloader.getInstantiableBasisFunction(unit, size*unit, projDist, mergeDist));
+            const ConductorFPList &condList = geoloader.getInstantiableBasisFunction(unit, size*unit, projDist, mergeDist);
+            reportPrunedBasisFunction(geoloader, isBudgetInput);
+            countBasisFunction(condList);
+            GeoMetricsScope metricsScope("write");
+            writeCapletFile(fileBaseName, condList);
         }
         catch (FileNotFoundError e){
             cerr << "ERROR: Cannot write file. (" << outputFileName << ")" << endl;
@@ -291,6 +699,7 @@ int main(int argc, char *argv[])
         exit(1);
     }
     cout << "CAPLET_GEO: Done basis functions construction. (" << outputFileName << ")" << endl;
+    writeMetrics(metricsFileName);
 
     return 0;
 }
@@ -72,6 +72,9 @@ MainWindow::MainWindow(QWidget *parent) :
     pwcSizeValidator = new QDoubleValidator(this);
     pwcSizeValidator->setBottom(0);
 
+    pwcGradingValidator = new QDoubleValidator(this);
+    pwcGradingValidator->setBottom(1);
+
     archLengthValidator = new QDoubleValidator(this);
     archLengthValidator->setBottom(0);
 
@@ -96,6 +99,7 @@ MainWindow::MainWindow(QWidget *parent) :
 
     //* validator
     ui->pwcSizeLineEdit    ->setValidator(pwcSizeValidator);
+    ui->pwcGradingLineEdit ->setValidator(pwcGradingValidator);
     ui->archLengthLineEdit ->setValidator(archLengthValidator);
     ui->projDistLineEdit   ->setValidator(projDistValidator);
     ui->mergeDistLineEdit  ->setValidator(mergeDistValidator);
@@ -116,6 +120,7 @@ MainWindow::~MainWindow(){
     delete initPWCSizeValidator;
     delete coreNumValidator;
     delete archLengthValidator;
+    delete pwcGradingValidator;
     delete pwcSizeValidator;
     delete ui;
     clear();
@@ -140,7 +145,8 @@ void MainWindow::displayPWCBasisFunction()
         return;
     }
     float suggestedPanelSize = ui->pwcSizeLineEdit->text().toFloat() * unit;
-    const ConductorFPList &condList = geoLoader->getPWCBasisFunction(unit, suggestedPanelSize);
+    float growthRatio = ui->pwcGradingLineEdit->text().toFloat();
+    const ConductorFPList &condList = geoLoader->getPWCBasisFunction(unit, suggestedPanelSize, growthRatio);
     panelRenderer->loadGLRects(&condList);
 }
 
@@ -254,6 +260,7 @@ void MainWindow::on_actionOpenFile_triggered(){
 
     //* reset
     ui->pwcSizeLineEdit->setEnabled(true);
+    ui->pwcGradingLineEdit->setEnabled(true);
 
     QString suffix = QFileInfo(inputFileName).suffix();
     if (suffix.compare("geo")==0){
@@ -301,6 +308,7 @@ void MainWindow::on_actionOpenFile_triggered(){
         panelRenderer->loadGLRects(&(geoLoader->getPWCBasisFunction()));
         panelRenderer->initView();
         ui->pwcSizeLineEdit->setDisabled(true);
+        ui->pwcGradingLineEdit->setDisabled(true);
     }
     else if (suffix.compare("gds")==0){
 
@@ -421,6 +429,11 @@ void MainWindow::on_pwcSizeLineEdit_returnPressed()
     }
 }
 
+void MainWindow::on_pwcGradingLineEdit_returnPressed()
+{
+    on_pwcSizeLineEdit_returnPressed();
+}
+
 void MainWindow::on_extractionButton_clicked()
 {
     if (isLoaded == false) {
@@ -433,6 +446,9 @@ void MainWindow::on_extractionButton_clicked()
 
     if (ui->solverFastcapRadio->isChecked()){
         pathFileBaseName += "_"+ui->pwcSizeLineEdit->text();
+        if (ui->pwcGradingLineEdit->text().toFloat() > 1){
+            pathFileBaseName += "_g"+ui->pwcGradingLineEdit->text();
+        }
         geoLoader->runFastcap(pathFileBaseName.toUtf8().data());
         const ExtractionInfo result = geoLoader->getLastResult();
         QString resultText = result.toString().c_str();
@@ -472,6 +488,9 @@ void MainWindow::on_extractionButton_clicked()
     }
     else if (ui->solverStandardRadio->isChecked()){
         pathFileBaseName += "_"+ui->pwcSizeLineEdit->text();
+        if (ui->pwcGradingLineEdit->text().toFloat() > 1){
+            pathFileBaseName += "_g"+ui->pwcGradingLineEdit->text();
+        }
         geoLoader->runCapletQui(pathFileBaseName.toUtf8().data());
         const ExtractionInfo result = geoLoader->getLastResult();
         QString resultText = result.toString().c_str();
@@ -498,61 +517,32 @@ void MainWindow::on_computeReferenceButton_clicked()
     }
     geoLoader->clearResult();
     const float percent = 0.01;
-    const string fastcapFlag = "-o4";
 
     float alpha   = ui->alphaLineEdit->text().toFloat();
     float epsilon = ui->epsilonLineEdit->text().toFloat() * percent;
     float pwcSize = ui->initPWCSizeLineEdit->text().toFloat() * unit;
 
-    geoLoader->getPWCBasisFunction(unit, pwcSize);
-    QString pathFileBaseName = canonicalPath+"/"+fileBaseName+"_"+QString::number(pwcSize/unit);
-    ExtractionInfo *thisResult = &(geoLoader->runFastcap(pathFileBaseName.toUtf8().data(), fastcapFlag) );
-    ExtractionInfo *prevResult;
-    int thisNPanel = thisResult->nBasisFunction;
-    int prevNPanel = 0;
-    float err = 1;
+    //* Refinement levels are extracted concurrently by capletMPI --fft and
+    //* extrapolated to zero panel size
     logTime("Start to extract reference Cmat...");
-    int counter = 1;
-    do{
-        ++counter;
-        prevResult  = thisResult;
-        prevNPanel  = thisNPanel;
-        pwcSize    /= alpha;
-        geoLoader->getPWCBasisFunction(unit, pwcSize);
-        QString pathFileBaseName = canonicalPath+"/"+fileBaseName+"_"+QString::number(pwcSize);
-        thisResult  = &(geoLoader->runFastcap(pathFileBaseName.toUtf8().data(), fastcapFlag) );
-        thisNPanel  = thisResult->nBasisFunction;
-        try{
-            err         = thisResult->compare(*prevResult);
-        }
-        catch(length_error &e){
-            log(e.what());
-            log("Dump two matrices...");
-            log("Matrix this:");
-            stringstream ssThis;
-            thisResult->printMatrix(ssThis);
-            log(QString(ssThis.str().c_str()));
-            log("Matrix reference:");
-            stringstream ssPrev;
-            prevResult->printMatrix(ssPrev);
-            log(QString(ssPrev.str().c_str()));
-        }
-
-        QString msg = QString::number(counter) + QString( ". (PWCSize, Error(%) ):")
-                + QString::number(pwcSize/unit) + ": " + QString::number(err/percent);
-        log(msg);
-    }while(err>epsilon || thisNPanel==prevNPanel);
-
+    QString pathFileBaseName = canonicalPath+"/"+fileBaseName;
     QString pathFileNameCmat = canonicalPath+"/"+fileBaseName+"_ref.cmat";
-    geoLoader->storeLastAsReference(pathFileNameCmat.toUtf8().data());
+    try{
+        geoLoader->computeReference(pathFileBaseName.toUtf8().data(), unit, pwcSize, alpha, epsilon,
+                                    pathFileNameCmat.toUtf8().data());
+    }
+    catch(FileNotFoundError &e){
+        log(e.what());
+        return;
+    }
 
     list<ExtractionInfo> resultList = geoLoader->compareAllAgainstReference();
     stringstream ssHeader;
     resultList.front().printBasicHeader(ssHeader);
     log(ssHeader.str().c_str());
-    counter = 1;
+    int counter = 1;
     for ( list<ExtractionInfo>::const_iterator each = resultList.begin();
-          each != --resultList.end(); ++each, ++counter){
+          each != resultList.end(); ++each, ++counter){
         stringstream ssTableLine;
         each->printBasicLine(ssTableLine);
         log(QString::number(counter) + QString(", ") + ssTableLine.str().c_str());
@@ -97,6 +97,7 @@ private slots:
 
     //* parameter setting event
     void on_pwcSizeLineEdit_returnPressed();
+    void on_pwcGradingLineEdit_returnPressed();
     void on_extractionButton_clicked();
     void on_computeReferenceButton_clicked();
     void on_loadReferenceButton_clicked();
@@ -125,6 +126,7 @@ private:
     QActionGroup*       colorSchemeGroup;
     QActionGroup*       solverGroup;
     QDoubleValidator*   pwcSizeValidator;
+    QDoubleValidator*   pwcGradingValidator;
     QDoubleValidator*   archLengthValidator;
     QDoubleValidator*   projDistValidator;
     QDoubleValidator*   mergeDistValidator;
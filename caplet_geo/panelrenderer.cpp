@@ -542,7 +542,7 @@ void PanelRenderer::conductorFPList2RectGLForDisplay()
     if ( colorScheme == BYLAYER )
     {//*group rects by layer
         rectGLForDisplay.resize( nLayer );
-        for ( list<ConductorFP>::const_iterator eachCondIt = condFPListPtr->begin();
+        for ( ConductorFPList::const_iterator eachCondIt = condFPListPtr->begin();
               eachCondIt != condFPListPtr->end(); ++eachCondIt)
         {
             for ( int i=0; i<nLayer; ++i )
@@ -560,7 +560,7 @@ void PanelRenderer::conductorFPList2RectGLForDisplay()
     else if ( colorScheme == BYCONDUCTOR )
     {//*group rects by conductor
         rectGLForDisplay.resize( condFPListPtr->size() );
-        list<ConductorFP>::const_iterator eachCondIt;
+        ConductorFPList::const_iterator eachCondIt;
         unsigned int i;
 
         for ( i=0, eachCondIt = condFPListPtr->begin();
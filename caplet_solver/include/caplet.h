@@ -29,10 +29,12 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 #include "caplet_parameter.h"
 #include "caplet_const.h"
 #include "caplet_blas.h"
+#include "caplet_cache.h"
 
 #include <string>
 #include <fstream>
 #include <iostream>
+#include <vector>
 
 namespace caplet{
 
@@ -54,6 +56,14 @@ public: //* functions
     ~Caplet();
 
     void extractC(MODE mode=DOUBLE_GALERKIN);
+    void extractSweep(const std::string filename, MODE mode=FAST_GALERKIN);
+    void setCacheFile(const std::string filename);
+    void setPeriodic(bool flag);
+    void setSymmetric(bool flag);
+    void setPrecorrectedFFT(bool flag);
+    void setAdaptiveRefinement(float tolerance);
+    void setMetricsFile(const std::string filename);
+    void setQuadrature(int order, bool isAdaptive);
 
     int  getNPanels() const;
     int  getNCoefs() const;
@@ -87,6 +97,7 @@ private: //* variables
     bool    isInstantiable;
     bool	isLoaded;
 	bool	isSolved;
+    bool    isRoot;     //* only rank 0 holds Cmat and coefs after extractC
     MODE    mode;
 
 	int 	nCoefs;
@@ -131,18 +142,70 @@ private: //* variables
 
 	bool flagMergeProjection1_0;
 
+    //* P of a previous run for incremental re-extraction
+    //  (FAST_GALERKIN only; empty: disabled)
+    std::string cacheFileName;
+
+    //* Copy P blocks of periodic conductor cells (FAST_GALERKIN only)
+    bool flagPeriodic;
+
+    //* Solve half-problems of mirror-symmetric structures (FAST_GALERKIN only)
+    bool flagSymmetric;
+
+    //* Solve by the precorrected-FFT operator and GMRES (DOUBLE_COLLOCATION only)
+    bool flagPrecorrectedFFT;
+
+    //* Refine panels of large estimated error until Cmat changes by less
+    //  than this fraction of the diagonal (precorrected FFT only; 0: disabled)
+    float adaptiveTolerance;
+
+    //* Keep MPI and the interaction cache between extractions of a sweep
+    bool flagSweep;
+
+    //* JSON file of per-phase timing and counters (empty: disabled)
+    std::string metricsFileName;
+
+    //* Shared P entries of repeated shape pairs during a fill
+    //  (0: disabled)
+    InteractionCache* interactionCache;
+
 private: //* functions
 	void extractCCollocationDouble();
 	void extractCGalerkin();
 	void extractCGalerkinDouble();
+	void packPanelDescriptions(std::vector<float> &desc) const;
+	void saveGalerkinCache(const float* Pfill);
+	void initInteractionCache();
+	void printInteractionCacheStatistics();
+	void saveMetrics();
 
 	void generateCollocationPMatrixDouble();
     void generateRHSDouble();
+    void solveCollocationDoubleMPI();
+    void solveCollocationFFT();
+    void solveCollocationAdaptive();
+    void markAdaptivePanels(const std::vector<int> &ind, std::vector<char> &split) const;
+    void refineAdaptivePanels(const std::vector<int> &ind, const std::vector<char> &split,
+                              std::vector<double> &guess);
 
 	void generateGalerkinPMatrix();
 	void generateGalerkinPMatrixDouble();
     void generateGalerkinPMatrixMPI();
     void generateGalerkinPMatrixDoubleMPI();
+    bool generateGalerkinPMatrixIncremental();
+    bool generateGalerkinPMatrixPeriodic();
+    bool isTranslatedWire(int wire1, int wire2, const std::vector<int> &wireFirstPanel,
+                          float t[nDim], bool isTGiven) const;
+    void generateCoefFirstPanels(std::vector<int> &firstPanel) const;
+    float calGalerkinCoefEntry(int coef1, int coef2, const std::vector<int> &firstPanel);
+    void packSymmetryCoefKey(int coef, int mirrorDir, int sum,
+                             const std::vector<int> &firstPanel, const std::vector<int> &bounds,
+                             std::vector<int> &key) const;
+    void detectMirrorSymmetry(std::vector<int> &planes,
+                              std::vector< std::vector<int> > &mirrorCoefs) const;
+    void solveGalerkinSymmetric(const std::vector<int> &planes,
+                                const std::vector< std::vector<int> > &mirrorCoefs);
+    void generateGalerkinCmat();
     void generateRHS();
 
 	void modifyPanelAspectRatio();
@@ -151,8 +214,9 @@ private: //* functions
 	shape_t selectShape(int panel);
 
 private: //* coordinate functions
-	inline void rotateX2Z(float* coord_ptr[3][4], int panelNo){
-		/* the argument float* coord_ptr[3][4] means:
+	template<class real>
+	inline void rotateX2Z(real* coord_ptr[3][4], real (*panel)[nBit]){
+		/* the argument real* coord_ptr[3][4] means:
 		 * 1. It is a 3-element array.
 		 * 2. Each element is a pointer.
 		 * 3. The pointer points to a 4-element array.
@@ -161,38 +225,46 @@ private: //* coordinate functions
 		 * 1. Look at the 2nd pointer of the array.
 		 * 2. We care about the address where the pointer points
 		 * */
-		*coord_ptr[X] = this->panels[panelNo][Y];
-		*coord_ptr[Y] = this->panels[panelNo][Z];
-		*coord_ptr[Z] = this->panels[panelNo][X];
+		*coord_ptr[X] = panel[Y];
+		*coord_ptr[Y] = panel[Z];
+		*coord_ptr[Z] = panel[X];
 	}
-	inline void rotateY2Z(float* coord_ptr[3][4], int panelNo){
-		*coord_ptr[X] = this->panels[panelNo][Z];
-		*coord_ptr[Y] = this->panels[panelNo][X];
-		*coord_ptr[Z] = this->panels[panelNo][Y];
+	template<class real>
+	inline void rotateY2Z(real* coord_ptr[3][4], real (*panel)[nBit]){
+		*coord_ptr[X] = panel[Z];
+		*coord_ptr[Y] = panel[X];
+		*coord_ptr[Z] = panel[Y];
 	}
-	inline void rotateZ2Z(float* coord_ptr[3][4], int panelNo){
-		*coord_ptr[X] = this->panels[panelNo][X];
-		*coord_ptr[Y] = this->panels[panelNo][Y];
-		*coord_ptr[Z] = this->panels[panelNo][Z];
+	template<class real>
+	inline void rotateZ2Z(real* coord_ptr[3][4], real (*panel)[nBit]){
+		*coord_ptr[X] = panel[X];
+		*coord_ptr[Y] = panel[Y];
+		*coord_ptr[Z] = panel[Z];
 	}
-	inline void mirrorY2X(float* coord_ptr[3][4], int panelNo){
-		*coord_ptr[X] = this->panels[panelNo][Y];
-		*coord_ptr[Y] = this->panels[panelNo][X];
-		*coord_ptr[Z] = this->panels[panelNo][Z];
+	template<class real>
+	inline void mirrorY2X(real* coord_ptr[3][4], real (*panel)[nBit]){
+		*coord_ptr[X] = panel[Y];
+		*coord_ptr[Y] = panel[X];
+		*coord_ptr[Z] = panel[Z];
 	}
-	inline void mirrorY2Z(float* coord_ptr[3][4], int panelNo){
-		*coord_ptr[X] = this->panels[panelNo][X];
-		*coord_ptr[Y] = this->panels[panelNo][Z];
-		*coord_ptr[Z] = this->panels[panelNo][Y];
+	template<class real>
+	inline void mirrorY2Z(real* coord_ptr[3][4], real (*panel)[nBit]){
+		*coord_ptr[X] = panel[X];
+		*coord_ptr[Y] = panel[Z];
+		*coord_ptr[Z] = panel[Y];
 	}
-	inline void mirrorX2Z(float* coord_ptr[3][4], int panelNo){
-		*coord_ptr[X] = this->panels[panelNo][Z];
-		*coord_ptr[Y] = this->panels[panelNo][Y];
-		*coord_ptr[Z] = this->panels[panelNo][X];
+	template<class real>
+	inline void mirrorX2Z(real* coord_ptr[3][4], real (*panel)[nBit]){
+		*coord_ptr[X] = panel[Z];
+		*coord_ptr[Y] = panel[Y];
+		*coord_ptr[Z] = panel[X];
 	}
 
     double calCollocationPEntryDouble(int panel1, int panel2);
     float  calGalerkinPEntry(int panel1, int panel2);
+    template<class real>
+    real   calGalerkinPEntry(int panel1, real (*coord1)[nBit],
+                             int panel2, real (*coord2)[nBit]);
 	double calGalerkinPEntryDouble(int panel1, int panel2);
 };
 
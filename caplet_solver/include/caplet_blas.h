@@ -181,8 +181,43 @@ extern "C"{
     		const int*		ldc		// i
     );
 
+    // B <- alpha A^-1 B  (side 'l'), A triangular
+    void dtrsm_(
+    		const char*		side,	// i	'l' or 'r'
+    		const char*		uplo,	// i	'u' or 'l'
+    		const char*		transA,	// i	'n' or 't' of A
+    		const char*		diag,	// i	'u': unit diagonal, or 'n'
+    		const int*		m,		// i	B:mxn
+    		const int*		n,		// i	B:mxn
+    		const double*	alpha,	// i
+    		const double*	A,		// i[]
+    		const int*		lda,	// i
+    		double*			B,		// io[]
+    		const int*		ldb		// i
+    );
+
 
     /* Lapack part*/
+	// A = P*L*U of an m-by-n matrix
+    void dgetrf_(
+    		const int*		m,		// i
+    		const int*		n,		// i
+    		double*			A,		// io[]	L (unit diagonal) and U
+    		const int*		lda,	// i
+    		int*			ipiv,	// o[]	row i was interchanged with row ipiv[i]
+    		int*			info	// o	= 0: successful exit
+									//		> 0: if info == i,  U(i,i) is exactly zero.
+    );
+	// interchange rows k1..k2 of A as given by ipiv
+    void dlaswp_(
+    		const int*		n,		// i	number of columns
+    		double*			A,		// io[]
+    		const int*		lda,	// i
+    		const int*		k1,		// i
+    		const int*		k2,		// i
+    		const int*		ipiv,	// i[]
+    		const int*		incx	// i
+    );
 	// solve A*x = B
     void dgesv_(
     		const int*		n,		// i
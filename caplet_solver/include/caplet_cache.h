@@ -0,0 +1,118 @@
+/*
+Created: Oct 19, 2026
+Author : Yu-Chung Hsiao
+Email  : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPLET_CACHE_H_
+#define CAPLET_CACHE_H_
+
+#include <map>
+#include <vector>
+
+namespace caplet{
+
+//* Translation-invariant cache of Galerkin P entries
+//
+//  Galerkin integrals only depend on the relative geometry of two basis
+//  shapes. Each panel is given a shape id, which stands for its shape type,
+//  direction, basis parameters and quantized lengths, and a quantized
+//  origin. The key of an entry is the pair of shape ids and the offset
+//  between the origins, so repeated shape pairs on a routing grid share
+//  one entry.
+//
+//  The table is an open-addressing hash table with a bounded probe length.
+//  Threads claim an empty slot by compare-and-swap and publish the entry
+//  with a release store, so lookups and inserts are lock-free. When no slot
+//  is available in the probe range, the caller simply computes the entry.
+//  The cache turns itself off when the hit rate of a thread stays below
+//  interactionCacheMinHitRate.
+//
+//  Shape ids are kept for the lifetime of the cache, so a cache can be
+//  reused by the next structure of a sweep after setNPanels().
+class InteractionCache{
+public:
+    static const int nKey = 5;
+    static const int nCounter = 64;
+
+    //* Slot states
+    enum{
+        EMPTY, WRITING, READY
+    };
+
+public:
+    explicit InteractionCache(int nPanels);
+    ~InteractionCache();
+
+    //* Resize panel arrays for the next structure; all panels are
+    //  excluded until they are set again, and the cache is enabled
+    void setNPanels(int nPanels);
+
+    //* Id of a shape description; new descriptions get new ids
+    int  insertShape(const std::vector<int> &shape);
+
+    //* shapeId<0 excludes the panel from caching
+    void setPanel(int panel, int shapeId, const int origin[3]);
+    int  getShapeId(int panel) const;
+    const int* getOrigin(int panel) const;
+
+    //* Return true and set value if the entry is found.
+    //  Otherwise return false; if slot is not -1, the caller owns the slot
+    //  and has to fill it by publish()
+    bool lookup(int panel1, int panel2, float &value, int &slot);
+    void publish(int slot, float value);
+
+    bool      isActive() const;
+    long long getNHits() const;
+    long long getNMisses() const;
+    int       getCapacity() const;
+
+private:
+    //* Two entries per 64-byte cache line
+    struct Entry{
+        int   key[nKey];
+        float value;
+        int   state;
+        int   padding;
+    };
+
+    //* Hit and miss counters of each thread on separate cache lines
+    struct Counter{
+        long long nHits;
+        long long nMisses;
+        char      padding[48];
+    };
+
+    Entry*      table;
+    int         capacity;   //* power of 2
+    int         isEnabled;
+    int*        shapeIds;
+    int         (*origins)[3];
+    Counter     counters[nCounter];
+
+    std::map< std::vector<int>, int > shapeMap;
+
+    InteractionCache(const InteractionCache&);
+    InteractionCache& operator=(const InteractionCache&);
+};
+
+}
+
+#endif /* CAPLET_CACHE_H_ */
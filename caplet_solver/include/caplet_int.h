@@ -27,6 +27,7 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "caplet_debug.h"
 #include "caplet_const.h"
+#include "caplet_parameter.h"   //* CAPLET_FLAT_ARCH, CAPLET_FLAT_SIDE
 
 #ifdef  DEBUG_SHAPE_BOUNDARY_CHECK
 	#include <iostream>
@@ -35,53 +36,78 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 
 namespace caplet{
 
-//* FAST GALERKIN MODE
+//* Quadrature orders of the kernels with linear shapes
+//  - order 1..maxQuadratureOrder replaces gauss_n_* and quad_n_* of
+//    caplet_parameter.h for all kernels; 0 keeps them
+//  - isAdaptive: well-separated pairs use a lower order chosen from
+//    their gap by the error model of caplet_parameter.h
+//  Set before a fill; the fill threads only read it.
+const int maxQuadratureOrder = 6;
+void setQuadrature(int order, bool isAdaptive);
+int  getQuadratureOrder();
+bool isQuadratureAdaptive();
+
+//* GALERKIN MODE
+//  - real is float for the fast mode and double for the double mode
+//    (caplet -d); both are instantiated in caplet_int.cpp
+//  - bz/bsh and the shape functions stay float
 
 //* Flat-Flat integrals
 //* - integral 1
-float intZFZF(float* coord1[nDim][nBit], float* coord2[nDim][nBit]);
+template<class real>
+real intZFZF(real* coord1[nDim][nBit], real* coord2[nDim][nBit]);
 //* - integral 2
-float intZFXF(float* coord1[nDim][nBit], float* coord2[nDim][nBit]);
+template<class real>
+real intZFXF(real* coord1[nDim][nBit], real* coord2[nDim][nBit]);
 
 //* Linear-Flat integrals
 //* - integral 3
-float intZXZF(
-        float* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float),
-        float* coord2[nDim][nBit] );
+template<class real>
+real intZXZF(
+        real* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float),
+        real* coord2[nDim][nBit] );
 //* - integral 4
-float intZXXF(
-        float* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float),
-        float* coord2[nDim][nBit] );
+template<class real>
+real intZXXF(
+        real* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float),
+        real* coord2[nDim][nBit] );
 //* - integral 5
-float intZXYF(
-        float* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float),
-        float* coord2[nDim][nBit] );
+template<class real>
+real intZXYF(
+        real* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float),
+        real* coord2[nDim][nBit] );
 
 //* Linear-Linear integrals
 //* - integral 6
-float intZXZX(
-        float* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
+template<class real>
+real intZXZX(
+        real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
 //* - integral 7
-float intZXYX(
-        float* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
+template<class real>
+real intZXYX(
+        real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
 //* - integral 8
-float intZXZY(
-        float* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
+template<class real>
+real intZXZY(
+        real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
 //* - integral 9
-float intZXXZ(
-        float* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
+template<class real>
+real intZXXZ(
+        real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
 //* - integral 10
-float intZXYZ(
-        float* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
+template<class real>
+real intZXYZ(
+        real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
 //* - integral 11
-float intZXXY(
-        float* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
+template<class real>
+real intZXXY(
+        real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float) );
 
 
 
@@ -143,6 +169,26 @@ inline float side(float x, float w){
 }
 
 
+
+//* Value of a shape function that is constant (flat, and arch and side
+//  with CAPLET_FLAT_ARCH and CAPLET_FLAT_SIDE), or -1 if it varies
+inline float constantShape(float (*shape)(float, float)){
+    if ( shape==&flat ){
+        return flat(0, 0);
+    }
+    #ifdef CAPLET_FLAT_ARCH
+    if ( shape==&arch ){
+        return arch(0, 0);
+    }
+    #endif
+    #ifdef CAPLET_FLAT_SIDE
+    if ( shape==&side ){
+        return side(0, 0);
+    }
+    #endif
+    return -1;
+}
+
 }
 
 #endif /* CAPLET_INT_H_ */
@@ -0,0 +1,205 @@
+/*
+Created: Oct 19, 2026
+Author : Yu-Chung Hsiao
+Email  : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPLET_METRICS_H_
+#define CAPLET_METRICS_H_
+
+#include "caplet_parameter.h"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <ctime>
+
+#ifdef CAPLET_OPENMP
+#include <omp.h>
+#endif
+
+namespace caplet{
+
+namespace metrics{
+
+//* Kernel classes of P entries
+enum KERNEL{
+    KERNEL_ZFZF, KERNEL_ZFXF,
+    KERNEL_ZXZF, KERNEL_ZXXF, KERNEL_ZXYF,
+    KERNEL_ZXZX, KERNEL_ZXYX, KERNEL_ZXZY, KERNEL_ZXXZ, KERNEL_ZXYZ, KERNEL_ZXXY,
+    KERNEL_COLLOCATION,
+    nKernel
+};
+
+//* Analytical integrals with far-field approximations
+enum INTEGRAL{
+    INTEGRAL_XY, INTEGRAL_XYXY, INTEGRAL_XYYZ, INTEGRAL_XYY, INTEGRAL_XYZ, INTEGRAL_XY_D,
+    nIntegral
+};
+
+//* Wall time (s) from a monotonic clock
+inline double wallTime(){
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+//* CPU time (s) of all threads of the process
+inline double cpuTime(){
+    timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return t.tv_sec + 1e-9*t.tv_nsec;
+}
+
+
+//* Registry of run-time metrics (CAPLET_METRICS)
+//
+//  Phases form a tree by nesting begin() and end() on the master thread.
+//  Each phase accumulates wall time, CPU time of the process and calls, so
+//  CPU time over wall time is the effective number of busy threads.
+//
+//  Kernel classes and analytical integrals are counted in the fill loops
+//  on per-thread cache lines without locks. An integral call that does not
+//  reach its analytical formula took the far-field approximation. With
+//  CAPLET_METRICS_KERNEL_TIME, the time spent in each kernel class is
+//  summed over threads as well.
+//
+//  Named counters and values hold everything else, e.g. cache hits and
+//  problem sizes. write() emits all of them as one JSON document.
+class Registry{
+public:
+    static const int nThread = 64;
+
+public:
+    Registry();
+
+    void begin(const std::string &name);
+    void end();
+    void count(const std::string &name, long long n=1);
+    void setValue(const std::string &name, double value);
+
+    inline void countKernel(int kernel, double seconds){
+        Counter &counter = counters[ threadIndex() ];
+        counter.kernels[kernel]++;
+        counter.kernelTimes[kernel] += seconds;
+    }
+    inline void countIntegral(int integral){
+        counters[ threadIndex() ].integrals[integral]++;
+    }
+    inline void countAnalytical(int integral){
+        counters[ threadIndex() ].analyticals[integral]++;
+    }
+
+    //* Sum thread counters over all MPI ranks to rank 0 (collective)
+    void reduce();
+
+    //* Write the JSON document; return false if the file cannot be opened
+    bool write(const std::string &filename, const std::string &program) const;
+
+private:
+    struct Phase{
+        std::string name;
+        int         parent;
+        std::vector<int> children;
+        long long   calls;
+        double      wall;
+        double      cpu;
+        double      wallStart;
+        double      cpuStart;
+    };
+
+    //* Counters of each thread on separate cache lines
+    struct Counter{
+        long long   kernels[nKernel];
+        double      kernelTimes[nKernel];
+        long long   integrals[nIntegral];
+        long long   analyticals[nIntegral];
+    } __attribute__((aligned(64)));
+
+    static inline int threadIndex(){
+        #ifdef CAPLET_OPENMP
+        return omp_get_thread_num() & (nThread-1);
+        #else
+        return 0;
+        #endif
+    }
+
+    void writePhase(std::ostream &out, int phase, int depth) const;
+
+    std::vector<Phase> phases;      //* phases[0] is the root
+    int                current;
+    Counter            counters[nThread];
+    Counter            total;       //* result of reduce()
+    bool               isReduced;
+
+    std::map<std::string, long long> namedCounters;
+    std::map<std::string, double>    values;
+};
+
+Registry& registry();
+
+
+//* Count (and time) one kernel call for the lifetime of the scope
+class KernelScope{
+public:
+    explicit inline KernelScope(int kernel)
+        :kernel(kernel)
+    {
+        #ifdef CAPLET_METRICS_KERNEL_TIME
+        start = wallTime();
+        #endif
+    }
+    inline ~KernelScope(){
+        #ifdef CAPLET_METRICS_KERNEL_TIME
+        registry().countKernel(kernel, wallTime()-start);
+        #else
+        registry().countKernel(kernel, 0);
+        #endif
+    }
+
+private:
+    int     kernel;
+    #ifdef CAPLET_METRICS_KERNEL_TIME
+    double  start;
+    #endif
+};
+
+}
+
+}
+
+
+#ifdef CAPLET_METRICS
+    #define CAPLET_PHASE_BEGIN(name)         caplet::metrics::registry().begin(name)
+    #define CAPLET_PHASE_END()               caplet::metrics::registry().end()
+    #define CAPLET_COUNT(name, n)            caplet::metrics::registry().count(name, n)
+    #define CAPLET_KERNEL_SCOPE(kernel)      caplet::metrics::KernelScope kernelScope(caplet::metrics::kernel)
+    #define CAPLET_COUNT_INTEGRAL(integral)  caplet::metrics::registry().countIntegral(caplet::metrics::integral)
+    #define CAPLET_COUNT_ANALYTICAL(integral) caplet::metrics::registry().countAnalytical(caplet::metrics::integral)
+#else
+    #define CAPLET_PHASE_BEGIN(name)
+    #define CAPLET_PHASE_END()
+    #define CAPLET_COUNT(name, n)
+    #define CAPLET_KERNEL_SCOPE(kernel)
+    #define CAPLET_COUNT_INTEGRAL(integral)
+    #define CAPLET_COUNT_ANALYTICAL(integral)
+#endif
+
+#endif /* CAPLET_METRICS_H_ */
@@ -51,6 +51,20 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 
 #define ROBUST_INTEGRAL_CHECK 
 
+//* Define to share P entries of repeated shape pairs through a
+//  translation-invariant interaction cache during a fill
+//- Default: uncommented
+#define CAPLET_INTERACTION_CACHE
+
+//* Define to record per-phase wall/CPU time, kernel classes and far-field
+//  hits of P entries for --metrics
+//- Default: uncommented
+#define CAPLET_METRICS
+//* Define to also time every kernel call (two clock reads per computed
+//  entry, well below the cost of the entry itself)
+//- Default: uncommented
+#define CAPLET_METRICS_KERNEL_TIME
+
 //* Openmp num of threads
 #ifdef CAPLET_OPENMP
     #define CAPLET_OPENMP_NUM_THREADS 4
@@ -85,6 +99,26 @@ const int quad_n_ZXZX_2 = quad_n;
 const int quad_n_ZXXZ_1 = quad_n;
 const int quad_n_ZXXZ_2 = quad_n;
 
+//* Adaptive quadrature (-a, --adaptive-quadrature) lowers the order of a
+//  pair to the lowest n whose modeled error
+//      quadratureErrorScale * (1+r)^(-2n),  r = gap / largest panel length
+//  is below quadratureTolerance. The scale bounds the excess error of
+//  orders 1-3 over order 6 in capletKernelBench sweeps of all linear
+//  kernels. The tolerance is below the single-precision error of the
+//  closed-form inner integrals (1e-3 to 4e-3), since the nearly singular
+//  Galerkin P amplifies entry errors in Cmat.
+//- Default: 0.12, 5e-4 (order 1 beyond about 15 panel lengths,
+//           order 2 beyond about 3)
+const float quadratureErrorScale = 0.12f;
+const float quadratureTolerance  = 5e-4f;
+
+//* Pairs of constant shapes (flat, or arch and side with CAPLET_FLAT_ARCH
+//  and CAPLET_FLAT_SIDE) use the exact flat-flat integrals scaled by the
+//  shape values where the quadrature misses quadratureTolerance. Farther
+//  pairs keep the quadrature, which is cheaper than the closed forms.
+//- Default: true
+const bool switch_analytical_constant_shape = true;
+
 //* Switches for whether using fully analytical integrals or not
 //  only work for all flat shapes
 //- Default: all false;
@@ -114,6 +148,79 @@ const float zero2 = zero*zero;
 //  approximating calColD by 1/r
 const double approximationGuardRingForCalColD = 1.0;
 
+
+//* Double collocation mode (.qui) deals the columns of the system to the
+//  MPI ranks in blocks of this many columns, round robin, and factors it
+//  one block at a time
+//- Default: 64
+const int collocationBlockSize = 64;
+
+
+//* Precorrected-FFT solver of the double collocation mode (-f, --fft)
+//  - pfftGridPointsPerPanel: grid points per panel in the bounding box
+//    (the spacing is never below the mean panel length)
+//  - pfftNearCells: pairs within this many grid points in each direction
+//    are precorrected (at least 2)
+//  - pfftTolerance: relative residual of GMRES
+//- Default: 4, 2, 1e-4, 50, 500
+const int    pfftGridPointsPerPanel = 4;
+const int    pfftNearCells          = 2;
+const double pfftTolerance          = 1e-4;
+const int    pfftGmresRestart       = 50;
+const int    pfftMaxIterations      = 500;
+
+
+//* Adaptive refinement of the double collocation mode (-r, --refine)
+//  - adaptiveMarkFraction: each level splits the basis functions of
+//    largest estimated error that make up this fraction of the total
+//    (error: area times the largest density jump to a panel sharing a
+//    side, relative to the charge of the excited conductor)
+//  - adaptiveMaxAspectRatio: panels are only split across their longer
+//    side up to this aspect ratio
+//  - adaptiveMaxLevels: refinement levels at most
+//- Default: 0.5, 16, 12
+const double adaptiveMarkFraction   = 0.5;
+const float  adaptiveMaxAspectRatio = 16;
+const int    adaptiveMaxLevels      = 12;
+
+
+//* Incremental re-extraction (-c, --cache) falls back to a full fill
+//  when more than this fraction of basis functions is new
+//- Default: 0.5
+const float incrementalMaxChangeRatio = 0.5f;
+
+
+//* Periodic mode (-p, --periodic) looks for conductor cells of up to
+//  maxCellWires conductors repeated by a constant pitch. Coordinates
+//  of repeated cells may differ by the tolerance (m).
+//- Default: 4, 1e-10
+const int   periodicMaxCellWires = 4;
+const float periodicTolerance    = 1e-10f;
+
+
+//* Symmetric mode (-s, --symmetric) rounds coordinates to the quantum (m)
+//  when it matches basis functions with their mirror images about the
+//  x and y center planes of the structure.
+//- Default: 1e-10
+const float symmetryQuantum = 1e-10f;
+
+
+//* Interaction cache (CAPLET_INTERACTION_CACHE)
+//  Panel lengths and origins are rounded to the quantum (m) in cache keys.
+//  It should be well below the layout grid.
+//  The table has sizePerPanel entries per basis shape within [minSize, maxSize]
+//  (32 bytes each), and a lookup probes at most maxProbe slots.
+//  The cache is turned off if the hit rate of a thread is below minHitRate
+//  at a multiple of checkInterval lookups.
+//- Default: 1e-11, 256, 1<<12, 1<<22, 8, 0.5, 1<<20
+const float interactionCacheQuantum       = 1e-11f;
+const int   interactionCacheSizePerPanel  = 256;
+const int   interactionCacheMinSize       = 1<<12;
+const int   interactionCacheMaxSize       = 1<<22;
+const int   interactionCacheMaxProbe      = 8;
+const float interactionCacheMinHitRate    = 0.5f;
+const int   interactionCacheCheckInterval = 1<<20;
+
 }
 
 #endif // CAPLET_PARAMETER_H
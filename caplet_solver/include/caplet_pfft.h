@@ -0,0 +1,113 @@
+/*
+Created: Oct 19, 2026
+Author : Yu-Chung Hsiao
+Email  : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPLET_PFFT_H_
+#define CAPLET_PFFT_H_
+
+#include "caplet_const.h"
+
+#include <complex>
+#include <vector>
+
+namespace caplet{
+
+//* Precorrected-FFT collocation operator of piecewise constant panels
+//
+//  Applies the system of the double collocation mode (row i: area of
+//  panel i times the potential at its center due to the unit charge
+//  density on the panels of column j) without storing it.
+//  - Projection: the charge of a panel is replaced by charges on the
+//    3x3x3 grid points around its center, which interpolate it at 2x2
+//    Gauss points of the panel, so that its potential far away is kept.
+//  - Convolution: the potentials of all grid charges on the grid by
+//    zero-padded FFTs of the charges and of 1/r.
+//  - Interpolation: the potential at a panel center from the same
+//    3x3x3 grid points.
+//  - Precorrection: pairs of panels within pfftNearCells grid cells are
+//    computed by calColD instead of through the grid.
+//  Memory and time per product are O(N log N) in the grid points.
+//  solve() runs restarted GMRES scaled by the diagonal, two right-hand
+//  sides per product.
+class PrecorrectedFFT{
+public:
+    //* coefs[i] is the column of panel i; panels of a column are consecutive
+    PrecorrectedFFT(int nPanels, float (*panels)[nDim][nBit], const int* dirs,
+                    const float* areas, const int* coefs, int nCoefs);
+
+    //* y = P x
+    void multiply(const double* x, double* y);
+
+    //* Solve P x = b for the nRhs columns of b to the relative residual
+    //  pfftTolerance, starting from x if isInitialGuess and from zero
+    //  otherwise. Return the largest number of iterations, or -1 if a
+    //  column is not solved within pfftMaxIterations.
+    int  solve(int nRhs, const double* b, double* x, bool isInitialGuess=false);
+
+    const int* getGridSize() const;
+    double     getGridSpacing() const;
+    long long  getNNearEntries() const;
+
+private:
+    static const int nStencil = 27;
+
+    int nPanels;
+    int nCoefs;
+    std::vector<int>    coefs;
+    std::vector<double> areas;
+
+    double h;
+    double origin[nDim];
+    int    n[nDim];             //* grid points
+    int    m[nDim];             //* padded grid points (2^a 3^b)
+    std::vector<int>    cells;  //* grid point at the center of each panel
+    std::vector<double> projection;
+    std::vector<double> interpolation;
+
+    //* Near field by columns: nearPanels[nearStart[j]..nearStart[j+1]-1]
+    //  are the panels near panel j
+    std::vector<int>    nearStart;
+    std::vector<int>    nearPanels;
+    std::vector<double> nearValues;
+
+    std::vector<double> diagonal;
+    std::vector<double> kernelHat;
+    std::vector< std::complex<double> > grid;
+    std::vector< std::complex<double> > roots[nDim];   //* exp(-2 pi i k/m)
+    std::vector<int> factors[nDim];    //* FFT radices and remaining lengths
+
+    int  index(int x, int y, int z) const;
+    void multiplyPair(const double* x1, const double* x2, double* y1, double* y2);
+    int  solvePair(int nPair, const double* b, double* x, bool isInitialGuess);
+    void setWeights(const double point[nDim], const int cell[nDim], double weight, double* weights) const;
+    void transform(bool isInverse);
+    void transformLines(int dir, bool isInverse, int n1, int n2);
+    void computeKernel();
+    void computeNearField(float (*panels)[nDim][nBit], const int* dirs);
+
+    PrecorrectedFFT(const PrecorrectedFFT&);
+    PrecorrectedFFT& operator=(const PrecorrectedFFT&);
+};
+
+}
+
+#endif /* CAPLET_PFFT_H_ */
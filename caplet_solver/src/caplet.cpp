@@ -31,6 +31,8 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 #include "caplet_elem.h"
 #include "caplet_int.h"
 #include "caplet_gauss.h"
+#include "caplet_metrics.h"
+#include "caplet_pfft.h"
 
 #include "mpi.h"
 
@@ -39,8 +41,12 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
 
 
@@ -58,7 +64,9 @@ float Caplet::pi		= 3.1415926535f;
 //*
 
 Caplet::Caplet()
-    : isLoaded(false), isSolved(false), flagMergeProjection1_0(true){
+    : isLoaded(false), isSolved(false), isRoot(true), flagMergeProjection1_0(true),
+      flagPeriodic(false), flagSymmetric(false), flagPrecorrectedFFT(false), adaptiveTolerance(0), flagSweep(false),
+      interactionCache(0){
 }
 
 
@@ -136,7 +144,8 @@ void Caplet::loadFastcapFile(const std::string filename){
         cerr << "ERROR: Cannot open the file: " << filename << endl;
         return;
     }
-    
+    CAPLET_PHASE_BEGIN("parse");
+
     //* Initialize
     this->nPanels = 0;
     this->nWires = 0;
@@ -303,6 +312,7 @@ void Caplet::loadFastcapFile(const std::string filename){
     this->isLoaded = true;
 
     ifile.close();
+    CAPLET_PHASE_END();
 
     #ifdef DEBUG_ASPECT_RATIO_VALIDITY
     if( this->isPanelAspectRatioValid() == false ){
@@ -347,6 +357,7 @@ void Caplet::loadCapletFile(const std::string filename){
         cerr << "ERROR: cannot open the file: " << filename << endl;
         return;
     }
+    CAPLET_PHASE_BEGIN("parse");
 
     ifile >> this->nWires;
     this->nWirePanels 		= new int[this->nWires];
@@ -429,6 +440,7 @@ void Caplet::loadCapletFile(const std::string filename){
     this->isLoaded = true;
 
     ifile.close();
+    CAPLET_PHASE_END();
 
     #ifdef DEBUG_ASPECT_RATIO_VALIDITY
     if( this->isPanelAspectRatioValid() == false ){
@@ -440,7 +452,8 @@ void Caplet::loadCapletFile(const std::string filename){
 
 
 void Caplet::saveCmat(const std::string filename){
-    if (this->isSolved){
+    //* Other ranks return from extractC before solving
+    if (this->isSolved && this->isRoot){
         std::ofstream ofile(filename.c_str());
         if (!ofile.is_open()){
             cerr << "ERROR: cannot write Cmat file: " << filename << endl;
@@ -475,7 +488,7 @@ void Caplet::saveCmat(const std::string filename){
 
 
 void Caplet::saveCoefs(const std::string filename){
-    if (this->isSolved){
+    if (this->isSolved && this->isRoot){
         ofstream ofile(filename.c_str());
         if (!ofile){
             cerr << "ERROR: cannot write the file: " << filename << endl;
@@ -521,18 +534,34 @@ void Caplet::extractC(MODE mode){
     caplet::log(1);
     #endif
 
-    //* Init MPI
-    MPI::Init();
+    //* Init MPI (already done in a sweep)
+    if ( MPI::Is_initialized()==false ){
+        MPI::Init();
+    }
     int rank = MPI::COMM_WORLD.Get_rank();
+    this->isRoot = ( rank==0 );
+    CAPLET_PHASE_BEGIN("extract");
 
     //* Subdivide panels if aspect ratio is too large
+    CAPLET_PHASE_BEGIN("aspect_ratio_split");
     this->modifyPanelAspectRatio();
+    CAPLET_PHASE_END();
 
     if ( rank==0 ){
         std::cout << "Number of conductors        : " << this->nWires << std::endl;
         std::cout << "Number of basis functions   : " << this->nCoefs << std::endl;
         std::cout << "Number of basis shapes      : " << this->nPanels << std::endl;
     }
+
+    #ifdef CAPLET_INTERACTION_CACHE
+    //* The double fills do not read the (float) interaction cache
+    if ( mode==FAST_GALERKIN ){
+        CAPLET_PHASE_BEGIN("interaction_cache_setup");
+        this->initInteractionCache();
+        CAPLET_PHASE_END();
+    }
+    #endif
+
     for (int iter = 0; iter < N_ITER; iter++){
         switch ( mode ){
         case DOUBLE_GALERKIN:
@@ -547,8 +576,22 @@ void Caplet::extractC(MODE mode){
         }
     }
     this->isSolved = true;
+    CAPLET_PHASE_END();
 
-    MPI::Finalize();
+    if ( this->interactionCache!=0 ){
+        this->printInteractionCacheStatistics();
+        if ( this->flagSweep==false ){
+            delete this->interactionCache;
+            this->interactionCache = 0;
+        }
+    }
+
+    if ( this->flagSweep==false ){
+        if ( this->metricsFileName.empty()==false ){
+            this->saveMetrics();
+        }
+        MPI::Finalize();
+    }
     if( rank!= 0 ){
         return;
     }
@@ -578,26 +621,144 @@ void Caplet::extractC(MODE mode){
 
 
 
+//*
+//* METRICS
+//*
+//* With a metrics file, the phase tree of the extraction, the kernel classes
+//* and the far-field hits of P entries are written as JSON at the end (see
+//* caplet_metrics.h). Phase times are those of rank 0; kernel and integral
+//* counts are summed over all ranks.
+//*
+void Caplet::setMetricsFile(const std::string filename){
+    this->metricsFileName = filename;
+}
+
+
+void Caplet::saveMetrics(){
+    #ifdef CAPLET_METRICS
+    metrics::Registry &registry = metrics::registry();
+    registry.reduce();
+    if ( MPI::COMM_WORLD.Get_rank()!=0 ){
+        return;
+    }
+    registry.setValue("conductors",      this->nWires);
+    registry.setValue("basis_functions", this->nCoefs);
+    registry.setValue("basis_shapes",    this->nPanels);
+    registry.setValue("ranks",           MPI::COMM_WORLD.Get_size());
+    #ifdef CAPLET_OPENMP
+    registry.setValue("threads",         CAPLET_OPENMP_NUM_THREADS);
+    #else
+    registry.setValue("threads",         1);
+    #endif
+    registry.write(this->metricsFileName, "caplet");
+    #else
+    if ( MPI::COMM_WORLD.Get_rank()==0 ){
+        cerr << "WARNING: metrics are not recorded without CAPLET_METRICS" << endl;
+    }
+    #endif
+}
+
+
+
+//*
+//* SWEEP MODE
+//*
+//* Variants of one layout written by caplet_geo_cli --sweep, e.g. process
+//* corners or basis parameters, are extracted one after another in one
+//* process. The interaction cache and its shape ids are kept between
+//* variants, so P entries of shape pairs that a variant does not change,
+//* such as lateral couplings within a layer when only elevations shift,
+//* are computed once for the whole sweep. Each variant is extracted by all
+//* ranks and threads, and its Cmat is saved next to its .caplet file.
+//*
+void Caplet::extractSweep(const std::string filename, MODE mode){
+    ifstream ifile(filename.c_str());
+    if (!ifile){
+        cerr << "ERROR: cannot open the file: " << filename << endl;
+        return;
+    }
+    std::string folderPath = ".";
+    size_t index = filename.find_last_of('/');
+    if ( index!=std::string::npos ){
+        folderPath = filename.substr(0, index);
+    }
+    std::vector<std::string> variants;
+    std::string variant;
+    while ( ifile >> variant ){
+        variants.push_back(variant);
+    }
+    ifile.close();
+
+    MPI::Init();
+    int rank = MPI::COMM_WORLD.Get_rank();
+
+    this->flagSweep = true;
+    for ( size_t k=0; k<variants.size(); k++ ){
+        const std::string baseName = folderPath + "/" + variants[k];
+        if ( rank==0 ){
+            std::cout << "Variant                     : " << variants[k] << std::endl;
+        }
+        this->loadCapletFile(baseName + ".caplet");
+        if ( this->isLoaded==false ){
+            continue;
+        }
+        this->extractC(mode);
+        if ( rank==0 ){
+            this->saveCmat(baseName + ".cmat");
+        }
+    }
+    this->flagSweep = false;
+
+    delete this->interactionCache;
+    this->interactionCache = 0;
+    if ( this->metricsFileName.empty()==false ){
+        #ifdef CAPLET_METRICS
+        metrics::registry().setValue("sweep_variants", variants.size());
+        #endif
+        this->saveMetrics();
+    }
+    MPI::Finalize();
+}
+
+
+
 //***************************
 //*
 //* DOUBLE COOLLOCATION MODE
 //*
 //*
+//* Columns of the system are dealt to the ranks in blocks of
+//  collocationBlockSize, round robin. Each rank keeps its columns in
+//  increasing order as a nCoefs-by-nLocal column-major matrix.
+static void collocationLocalColumns(int nCoefs, int rank, int numproc, std::vector<int> &columns){
+    columns.clear();
+    for ( int c=rank*collocationBlockSize; c<nCoefs; c+=numproc*collocationBlockSize ){
+        for ( int k=c; k<nCoefs && k<c+collocationBlockSize; k++ ){
+            columns.push_back(k);
+        }
+    }
+}
+
+
 void Caplet::extractCCollocationDouble(){
+    int rank    = MPI::COMM_WORLD.Get_rank();
+    int numproc = MPI::COMM_WORLD.Get_size();
+
     if ( this->isLoaded == true ){
         //* Allocate system memory for double precision
-        if (MPI::COMM_WORLD.Get_rank()==0){
-            this->dP 	= new double[this->nCoefs*this->nCoefs];
-            this->drhs 	= new double[this->nCoefs*this->nWires];
-            this->dcoefs= new double[this->nCoefs*this->nWires];
-            this->dCmat = new double[this->nWires*this->nWires];
+        //  - dP: the local columns (none with the precorrected FFT)
+        //  - drhs, dcoefs: every rank carries all right-hand sides
+        std::vector<int> columns;
+        if ( this->flagPrecorrectedFFT==false ){
+            collocationLocalColumns(this->nCoefs, rank, numproc, columns);
         }
-        else{
-            this->dP 	= new double[1];
-            this->drhs 	= new double[1];
-            this->dcoefs= new double[1];
+        this->dP 	= new double[ std::max<int>(1, this->nCoefs*columns.size()) ];
+        this->drhs 	= new double[this->nCoefs*this->nWires];
+        this->dcoefs= new double[this->nCoefs*this->nWires];
+        if ( rank==0 ){
+            this->dCmat = new double[this->nWires*this->nWires];
+        }else{
             this->dCmat = new double[1];
-            return;
         }
 
     }else{
@@ -607,22 +768,39 @@ void Caplet::extractCCollocationDouble(){
     this->timeStart = MPI::Wtime();
     #endif
 
-    this->generateCollocationPMatrixDouble();
-    this->generateRHSDouble();
-
-    #ifdef CAPLET_TIMER
-    this->timeAfterFilling = MPI::Wtime();
-    #endif
-
+    if ( this->flagPrecorrectedFFT==true ){
+        //* The operator is applied by rank 0 (and its threads) only
+        if ( rank!=0 ){
+            return;
+        }
+        if ( this->adaptiveTolerance>0 ){
+            this->solveCollocationAdaptive();
+        }else{
+            this->solveCollocationFFT();
+        }
+    }else{
+        CAPLET_PHASE_BEGIN("fill");
+        this->generateCollocationPMatrixDouble();
+        CAPLET_PHASE_END();
+        CAPLET_PHASE_BEGIN("rhs");
+        this->generateRHSDouble();
+        CAPLET_PHASE_END();
+
+        #ifdef CAPLET_TIMER
+        this->timeAfterFilling = MPI::Wtime();
+        #endif
 
-    //* Solve the system
-    int* 	ipiv = new int[this->nCoefs];
-    int  	info;
 
-    dgesv_(&this->nCoefs, &this->nWires, this->dP, &this->nCoefs, ipiv,
-            this->dcoefs, &this->nCoefs, &info);
+        //* Solve the system
+        CAPLET_PHASE_BEGIN("factorization");
+        this->solveCollocationDoubleMPI();
+        CAPLET_PHASE_END();
 
-    delete[] ipiv;
+        if ( rank!=0 ){
+            return;
+        }
+    }
+    //* End of core with non-zero rank
 
     char 	transA 	= 't';
     char 	transB 	= 'n';
@@ -630,11 +808,13 @@ void Caplet::extractCCollocationDouble(){
     double 	beta 	= 0.0;
 
     //* Use matrix-matrix product to compute Cmat from coefs
+    CAPLET_PHASE_BEGIN("cmat_gemm");
     dgemm_(&transA, &transB,
             &this->nWires, &this->nWires, &this->nCoefs,
             &alpha, this->drhs, &this->nCoefs,
             this->dcoefs, &this->nCoefs,
             &beta, this->dCmat, &this->nWires);
+    CAPLET_PHASE_END();
 
     #ifdef CAPLET_TIMER
     this->timeAfterSolving = MPI::Wtime();
@@ -645,12 +825,381 @@ void Caplet::extractCCollocationDouble(){
 }
 
 
+//* Solve the collocation system of each conductor by GMRES on the
+//  precorrected-FFT operator, without forming dP
+void Caplet::solveCollocationFFT(){
+    CAPLET_PHASE_BEGIN("rhs");
+    this->generateRHSDouble();
+    CAPLET_PHASE_END();
+
+    //* Column of each panel
+    std::vector<int> ind(nPanels);
+    ind[0] = 0;
+    for ( int i=1; i<nPanels; i++){
+        ind[i] = ind[i-1] + indexIncrements[i];
+    }
+
+    CAPLET_PHASE_BEGIN("fill");
+    PrecorrectedFFT pfft(nPanels, panels, dirs, areas, &ind[0], nCoefs);
+    CAPLET_PHASE_END();
+
+    const int* gridSize = pfft.getGridSize();
+    std::cout << "Precorrected-FFT grid       : "
+              << gridSize[X] << " x " << gridSize[Y] << " x " << gridSize[Z]
+              << " (spacing " << pfft.getGridSpacing() << ")" << std::endl;
+    std::cout << "Precorrected near entries   : " << pfft.getNNearEntries() << std::endl;
+
+    #ifdef CAPLET_TIMER
+    this->timeAfterFilling = MPI::Wtime();
+    #endif
+
+    CAPLET_PHASE_BEGIN("gmres");
+    int nIter = pfft.solve(nWires, drhs, dcoefs);
+    CAPLET_PHASE_END();
+    if ( nIter<0 ){
+        cerr << "WARNING: GMRES did not converge in " << pfftMaxIterations << " iterations" << endl;
+    }else{
+        std::cout << "Max GMRES iterations        : " << nIter << std::endl;
+    }
+}
+
+
+//* Solve by the precorrected FFT, split the panels of largest estimated
+//  error (markAdaptivePanels) and solve again from the previous
+//  densities, until Cmat changes by less than adaptiveTolerance of the
+//  diagonal or after adaptiveMaxLevels levels
+void Caplet::solveCollocationAdaptive(){
+    std::vector<double> guess;
+    std::vector<double> cmatLast;
+    for ( int level=0; ; level++ ){
+        if ( level>0 ){
+            delete[] this->drhs;
+            delete[] this->dcoefs;
+            this->drhs   = new double[this->nCoefs*this->nWires];
+            this->dcoefs = new double[this->nCoefs*this->nWires];
+        }
+        CAPLET_PHASE_BEGIN("rhs");
+        this->generateRHSDouble();
+        CAPLET_PHASE_END();
+        if ( guess.empty()==false ){
+            std::copy(guess.begin(), guess.end(), this->dcoefs);
+        }
+
+        //* Column of each panel
+        std::vector<int> ind(nPanels);
+        ind[0] = 0;
+        for ( int i=1; i<nPanels; i++){
+            ind[i] = ind[i-1] + indexIncrements[i];
+        }
+
+        CAPLET_PHASE_BEGIN("fill");
+        PrecorrectedFFT pfft(nPanels, panels, dirs, areas, &ind[0], nCoefs);
+        CAPLET_PHASE_END();
+
+        CAPLET_PHASE_BEGIN("gmres");
+        int nIter = pfft.solve(nWires, drhs, dcoefs, guess.empty()==false);
+        CAPLET_PHASE_END();
+        if ( nIter<0 ){
+            cerr << "WARNING: GMRES did not converge in " << pfftMaxIterations << " iterations" << endl;
+        }
+
+        char 	transA 	= 't';
+        char 	transB 	= 'n';
+        double 	alpha 	= 4*pi*epsilon0;
+        double 	beta 	= 0.0;
+        dgemm_(&transA, &transB,
+                &this->nWires, &this->nWires, &this->nCoefs,
+                &alpha, this->drhs, &this->nCoefs,
+                this->dcoefs, &this->nCoefs,
+                &beta, this->dCmat, &this->nWires);
+
+        //* Largest change relative to the diagonal
+        double change = 0;
+        if ( cmatLast.empty()==false ){
+            for ( int i=0; i<nWires; i++ ){
+                for ( int j=0; j<nWires; j++ ){
+                    change = std::max( change, std::abs( (dCmat[i+nWires*j]-cmatLast[i+nWires*j])
+                                                         / dCmat[i+nWires*i] ) );
+                }
+            }
+        }
+        cmatLast.assign(dCmat, dCmat+nWires*nWires);
+
+        std::cout << "Adaptive level " << std::setw(2) << level << "           : "
+                  << nCoefs << " basis functions, " << nIter << " GMRES iterations";
+        if ( level>0 ){
+            std::cout << ", Cmat change " << change*100 << "%";
+        }
+        std::cout << std::endl;
+
+        if ( level>0 && change<this->adaptiveTolerance ){
+            break;
+        }
+        if ( level==adaptiveMaxLevels ){
+            cerr << "WARNING: Cmat did not converge in " << adaptiveMaxLevels << " refinement levels" << endl;
+            break;
+        }
+
+        CAPLET_PHASE_BEGIN("refine");
+        std::vector<char> split;
+        this->markAdaptivePanels(ind, split);
+        this->refineAdaptivePanels(ind, split, guess);
+        CAPLET_PHASE_END();
+    }
+}
+
+
+//* Mark the panels to split: the error of a basis function is its area
+//  times the largest jump of density to a basis function with a panel
+//  sharing a side, in the same plane or across a conductor edge, relative
+//  to the charge of the excited
+//  conductor and maximized over the excitations. The basis functions of
+//  largest errors that sum to adaptiveMarkFraction of the total are
+//  marked, and their panels are split (split[i], bit per axis) across the
+//  sides of at least half the largest jump, so that panels along an edge
+//  are only split toward it.
+void Caplet::markAdaptivePanels(const std::vector<int> &ind, std::vector<char> &split) const{
+    std::vector<double> coefAreas(nCoefs, 0.0);
+    for ( int i=0; i<nPanels; i++ ){
+        coefAreas[ind[i]] += areas[i];
+    }
+    std::vector<double> charges(nWires);
+    for ( int k=0; k<nWires; k++ ){
+        charges[k] = std::abs( dCmat[k+nWires*k] / (4*pi*epsilon0) );
+    }
+
+    //* Sides of the panels by the line they lie on: (axis along the line,
+    //  coordinates on the other two axes in order)
+    typedef std::pair< int, std::pair<float,float> > LineKey;
+    std::map< LineKey, std::vector< std::pair<int,int> > > lines;     //* (panel, axis normal to the side)
+    for ( int i=0; i<nPanels; i++ ){
+        for ( int a=1; a<nDim; a++ ){
+            const int axis  = (dirs[i]+a)%nDim;
+            const int along = (dirs[i]+nDim-a)%nDim;
+            for ( int m=MIN; m<=MAX; m++ ){
+                const float coord[2] = { panels[i][dirs[i]][MIN], panels[i][axis][m] };
+                const bool  isDirFirst = ( dirs[i]<axis );
+                lines[ LineKey( along, std::make_pair( coord[isDirFirst? 0:1], coord[isDirFirst? 1:0] ) ) ]
+                        .push_back( std::make_pair(i, axis) );
+            }
+        }
+    }
+
+    //* Largest jump of each panel across its sides normal to each axis, to
+    //  panels of the same conductor in the same plane or across an edge
+    std::vector<double> jumps(nPanels*nDim, 0.0);
+    for ( std::map< LineKey, std::vector< std::pair<int,int> > >::iterator line = lines.begin();
+          line != lines.end(); ++line ){
+        const int along = line->first.first;
+        std::vector< std::pair<int,int> > &sides = line->second;
+
+        //* Sides overlapping along the line, sorted by their lower ends
+        std::vector< std::pair<float,int> > order(sides.size());
+        for ( unsigned n=0; n<sides.size(); n++ ){
+            order[n] = std::make_pair(panels[sides[n].first][along][MIN], n);
+        }
+        std::sort(order.begin(), order.end());
+        for ( unsigned o1=0; o1<order.size(); o1++ ){
+            const int n1 = order[o1].second;
+            const int i  = sides[n1].first;
+            for ( unsigned o2=o1+1; o2<order.size() && order[o2].first<panels[i][along][MAX]; o2++ ){
+                const int n2 = order[o2].second;
+                const int j  = sides[n2].first;
+                if ( ind[i]==ind[j] ){
+                    continue;
+                }
+                for ( int k=0; k<nWires; k++ ){
+                    if ( charges[k]==0 ){
+                        continue;
+                    }
+                    const double jump = std::abs( dcoefs[k*nCoefs+ind[i]] - dcoefs[k*nCoefs+ind[j]] ) / charges[k];
+                    jumps[i*nDim+sides[n1].second] = std::max( jumps[i*nDim+sides[n1].second], jump );
+                    jumps[j*nDim+sides[n2].second] = std::max( jumps[j*nDim+sides[n2].second], jump );
+                }
+            }
+        }
+    }
+
+    std::vector<double> errors(nCoefs, 0.0);
+    for ( int i=0; i<nPanels; i++ ){
+        for ( int d=0; d<nDim; d++ ){
+            errors[ind[i]] = std::max( errors[ind[i]], coefAreas[ind[i]]*jumps[i*nDim+d] );
+        }
+    }
+    std::vector< std::pair<double,int> > order(nCoefs);
+    double total = 0;
+    for ( int c=0; c<nCoefs; c++ ){
+        order[c] = std::make_pair(errors[c], c);
+        total   += errors[c];
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<char> isMarked(nCoefs, 0);
+    double sum = 0;
+    for ( int c=nCoefs-1; c>=0 && sum<adaptiveMarkFraction*total; c-- ){
+        isMarked[order[c].second] = 1;
+        sum += order[c].first;
+    }
+
+    split.assign(nPanels, 0);
+    for ( int i=0; i<nPanels; i++ ){
+        if ( isMarked[ind[i]]==0 ){
+            continue;
+        }
+        const int a1 = (dirs[i]+1)%nDim;
+        const int a2 = (dirs[i]+2)%nDim;
+        const double largest = std::max( jumps[i*nDim+a1], jumps[i*nDim+a2] );
+        for ( int a=1; a<nDim; a++ ){
+            const int axis = (dirs[i]+a)%nDim;
+            if ( 2*jumps[i*nDim+axis] >= largest ){
+                split[i] |= (1<<axis);
+            }
+        }
+        //* Also halve the other side if a half would be too slender
+        if ( split[i]==(1<<a1) && panels[i][a2][LENGTH] > adaptiveMaxAspectRatio*panels[i][a1][LENGTH]/2 ){
+            split[i] |= (1<<a2);
+        }
+        if ( split[i]==(1<<a2) && panels[i][a1][LENGTH] > adaptiveMaxAspectRatio*panels[i][a2][LENGTH]/2 ){
+            split[i] |= (1<<a1);
+        }
+    }
+}
+
+
+//* Split the marked panels in halves along the axes of split[i]. Panels
+//  of a basis function with a split panel become basis functions of their
+//  own; guess gets the densities of their parents for the next solve.
+void Caplet::refineAdaptivePanels(const std::vector<int> &ind, const std::vector<char> &split,
+                                  std::vector<double> &guess){
+    std::vector<char> isMarked(nCoefs, 0);
+    for ( int i=0; i<nPanels; i++ ){
+        if ( split[i]!=0 ){
+            isMarked[ind[i]] = 1;
+        }
+    }
+
+    std::vector<float> newPanels;
+    std::vector<int>   newDirs;
+    std::vector<float> newAreas;
+    std::vector<int>   newIndexIncrements;
+    std::vector<char>  newBasisTypes;
+    std::vector<int>   newBasisDirs;
+    std::vector<float> newBasisZs;
+    std::vector<float> newBasisShifts;
+    std::vector<int>   parents;     //* old basis function of each new one
+
+    int wire = 0;
+    int wirePanelCount = 0;
+    std::vector<int> newWirePanels(nWires, 0);
+    std::vector<int> newWireCoefs(nWires, 0);
+    for ( int i=0; i<nPanels; i++ ){
+        while ( wirePanelCount==nWirePanels[wire] ){
+            wirePanelCount = 0;
+            wire++;
+        }
+        wirePanelCount++;
+
+        const int dir = dirs[i];
+        const int a1  = (dir+1)%nDim;
+        const int a2  = (dir+2)%nDim;
+        const int nSplit1 = ( split[i] & (1<<a1) )? 2 : 1;
+        const int nSplit2 = ( split[i] & (1<<a2) )? 2 : 1;
+        for ( int s2=0; s2<nSplit2; s2++ ){
+            for ( int s1=0; s1<nSplit1; s1++ ){
+                float panel[nDim][2];
+                for ( int d=0; d<nDim; d++ ){
+                    panel[d][0] = panels[i][d][MIN];
+                    panel[d][1] = panels[i][d][MAX];
+                }
+                if ( nSplit1==2 ){
+                    panel[a1][1-s1] = panels[i][a1][CENTER];
+                }
+                if ( nSplit2==2 ){
+                    panel[a2][1-s2] = panels[i][a2][CENTER];
+                }
+                for ( int d=0; d<nDim; d++ ){
+                    newPanels.push_back(panel[d][0]);
+                    newPanels.push_back(panel[d][1]);
+                }
+                newDirs.push_back(dir);
+                newAreas.push_back( (panel[a1][1]-panel[a1][0]) * (panel[a2][1]-panel[a2][0]) );
+                const int increment = ( isMarked[ind[i]] )? 1 : indexIncrements[i];
+                newIndexIncrements.push_back(increment);
+                newBasisTypes.push_back(basisTypes[i]);
+                newBasisDirs.push_back(basisDirs[i]);
+                newBasisZs.push_back(basisZs[i]);
+                newBasisShifts.push_back(basisShifts[i]);
+                if ( increment==1 ){
+                    parents.push_back(ind[i]);
+                    newWireCoefs[wire]++;
+                }
+                newWirePanels[wire]++;
+            }
+        }
+    }
+
+    //* Densities of the parents
+    const int nNewCoefs = parents.size();
+    guess.resize(nNewCoefs*nWires);
+    for ( int k=0; k<nWires; k++ ){
+        for ( int c=0; c<nNewCoefs; c++ ){
+            guess[k*nNewCoefs+c] = dcoefs[k*nCoefs+parents[c]];
+        }
+    }
+
+    delete[] this->panels;
+    delete[] this->dirs;
+    delete[] this->areas;
+    delete[] this->indexIncrements;
+    delete[] this->basisTypes;
+    delete[] this->basisDirs;
+    delete[] this->basisZs;
+    delete[] this->basisShifts;
+
+    this->nPanels = newDirs.size();
+    this->nCoefs  = nNewCoefs;
+    this->panels			= new float	[this->nPanels][3][4];
+    this->dirs				= new int	[this->nPanels];
+    this->areas	 			= new float	[this->nPanels];
+    this->indexIncrements 	= new int	[this->nPanels];
+    this->basisTypes		= new char	[this->nPanels];
+    this->basisDirs			= new int	[this->nPanels];
+    this->basisZs			= new float	[this->nPanels];
+    this->basisShifts		= new float	[this->nPanels];
+    for ( int i=0; i<this->nPanels; i++ ){
+        for ( int d=0; d<nDim; d++ ){
+            this->panels[i][d][MIN]    = newPanels[(i*nDim+d)*2];
+            this->panels[i][d][MAX]    = newPanels[(i*nDim+d)*2+1];
+            this->panels[i][d][LENGTH] = this->panels[i][d][MAX] - this->panels[i][d][MIN];
+            this->panels[i][d][CENTER] = (this->panels[i][d][MAX] + this->panels[i][d][MIN])/2;
+        }
+        this->dirs[i]            = newDirs[i];
+        this->areas[i]           = newAreas[i];
+        this->indexIncrements[i] = newIndexIncrements[i];
+        this->basisTypes[i]      = newBasisTypes[i];
+        this->basisDirs[i]       = newBasisDirs[i];
+        this->basisZs[i]         = newBasisZs[i];
+        this->basisShifts[i]     = newBasisShifts[i];
+    }
+    std::copy(newWirePanels.begin(), newWirePanels.end(), this->nWirePanels);
+    std::copy(newWireCoefs.begin(), newWireCoefs.end(), this->nWireCoefs);
+}
+
+
+//* Row i: area of panel i times the potential at its center due to the
+//  unit charge density on the panels of column j, so that the
+//  right-hand sides are the areas as in the Galerkin mode
 void Caplet::generateCollocationPMatrixDouble(){
+    int rank    = MPI::COMM_WORLD.Get_rank();
+    int numproc = MPI::COMM_WORLD.Get_size();
+
+    std::vector<int> columns;
+    collocationLocalColumns(nCoefs, rank, numproc, columns);
+    const int nLocal = columns.size();
 
     //* Set dP to zero
     double zero = 0.0;
     int    inc  = 1;
-    int    nC   = nCoefs*nCoefs;
+    int    nC   = nCoefs*nLocal;
     dscal_(&nC, &zero, dP, &inc);
 
     //* Construct ind_vec from indexIncrements
@@ -659,21 +1208,146 @@ void Caplet::generateCollocationPMatrixDouble(){
     for ( int i=1; i<nPanels; i++){
         ind[i] = ind[i-1] + indexIncrements[i];
     }
-    const int nK = nPanels*nPanels;
+    std::vector<int> firstPanel;
+    this->generateCoefFirstPanels(firstPanel);
 
+    //* Each local column is summed by a single thread
+    CAPLET_PHASE_BEGIN("entries");
     #ifdef CAPLET_OPENMP
         #pragma omp parallel for num_threads(CAPLET_OPENMP_NUM_THREADS)
     #endif
-    for ( int k=0; k < nK; k++ ){
-        int j = k/nPanels;
-        int i = k - j*nPanels;
-        dP[ ind[i] + nCoefs*ind[j] ] += calGalerkinPEntry(i,j);
+    for ( int c=0; c < nLocal; c++ ){
+        double* column = dP + nCoefs*c;
+        for ( int j=firstPanel[columns[c]]; j<firstPanel[columns[c]+1]; j++ ){
+            for ( int i=0; i<nPanels; i++ ){
+                column[ ind[i] ] += areas[i]*calCollocationPEntryDouble(i,j);
+            }
+        }
     }
+    CAPLET_PHASE_END();
 
     delete[] ind;
 }
 
 
+//* Solve dP dcoefs = dcoefs on the block-cyclic columns of all ranks
+//  - one rank: dgesv
+//  - otherwise right-looking LU with partial pivoting. The owner of
+//    column block b factors it and broadcasts it with its pivots; every
+//    rank updates its own columns to the right and the forward
+//    substitution of the right-hand sides, which all ranks carry.
+//    The back substitution sums U x of the solved blocks over the ranks
+//    into the owner of the next block, which broadcasts its solution.
+//  Every rank ends with the solution in dcoefs.
+void Caplet::solveCollocationDoubleMPI(){
+    int rank    = MPI::COMM_WORLD.Get_rank();
+    int numproc = MPI::COMM_WORLD.Get_size();
+    int info;
+
+    if ( numproc==1 ){
+        int* ipiv = new int[this->nCoefs];
+        dgesv_(&this->nCoefs, &this->nWires, this->dP, &this->nCoefs, ipiv,
+                this->dcoefs, &this->nCoefs, &info);
+        delete[] ipiv;
+        return;
+    }
+
+    const int n       = this->nCoefs;
+    const int nb      = collocationBlockSize;
+    const int nBlocks = (n+nb-1)/nb;
+    std::vector<int> columns;
+    collocationLocalColumns(n, rank, numproc, columns);
+    const int nLocal  = columns.size();
+
+    double* panel = new double[n*nb];
+    double* xk    = new double[nb*nWires];
+    double* sumUx = new double[n*nWires];
+    int*    ipiv  = new int[nb];
+    double  one = 1.0, minusOne = -1.0, zero = 0.0;
+    int     inc = 1, one_i = 1;
+    char    left = 'l', lower = 'l', upper = 'u', noTrans = 'n', unit = 'u', nonUnit = 'n';
+
+    //* Factorization and forward substitution
+    for ( int b=0; b<nBlocks; b++ ){
+        const int k0    = b*nb;
+        const int kn    = std::min(nb, n-k0);
+        const int m     = n-k0;
+        const int owner = b%numproc;
+
+        if ( rank==owner ){
+            double* A = dP + n*( (b/numproc)*nb ) + k0;
+            dgetrf_(&m, &kn, A, &n, ipiv, &info);
+            for ( int c=0; c<kn; c++ ){
+                dcopy_(&m, A+n*c, &inc, panel+m*c, &inc);
+            }
+        }
+        MPI::COMM_WORLD.Bcast(ipiv, kn, MPI::INT, owner);
+        MPI::COMM_WORLD.Bcast(panel, m*kn, MPI::DOUBLE, owner);
+
+        //* Local columns right of block b
+        const int firstRight = ( b>=rank )? ( (b-rank)/numproc + 1 )*nb : 0;
+        const int nRight     = nLocal - firstRight;
+        if ( nRight>0 ){
+            double* A12 = dP + n*firstRight + k0;
+            dlaswp_(&nRight, A12, &n, &one_i, &kn, ipiv, &inc);
+            dtrsm_(&left, &lower, &noTrans, &unit, &kn, &nRight, &one, panel, &m, A12, &n);
+            if ( m>kn ){
+                const int m2 = m-kn;
+                dgemm_(&noTrans, &noTrans, &m2, &nRight, &kn,
+                        &minusOne, panel+kn, &m, A12, &n, &one, A12+kn, &n);
+            }
+        }
+
+        double* B1 = dcoefs + k0;
+        dlaswp_(&nWires, B1, &n, &one_i, &kn, ipiv, &inc);
+        dtrsm_(&left, &lower, &noTrans, &unit, &kn, &nWires, &one, panel, &m, B1, &n);
+        if ( m>kn ){
+            const int m2 = m-kn;
+            dgemm_(&noTrans, &noTrans, &m2, &nWires, &kn,
+                    &minusOne, panel+kn, &m, B1, &n, &one, B1+kn, &n);
+        }
+    }
+
+    //* Back substitution
+    int nSum = n*nWires;
+    dscal_(&nSum, &zero, sumUx, &inc);
+    for ( int b=nBlocks-1; b>=0; b-- ){
+        const int k0    = b*nb;
+        const int kn    = std::min(nb, n-k0);
+        const int owner = b%numproc;
+
+        for ( int w=0; w<nWires; w++ ){
+            dcopy_(&kn, sumUx+k0+n*w, &inc, panel+kn*w, &inc);
+        }
+        MPI::COMM_WORLD.Reduce(panel, xk, kn*nWires, MPI::DOUBLE, MPI::SUM, owner);
+
+        const double* U = dP + n*( (b/numproc)*nb );
+        if ( rank==owner ){
+            for ( int w=0; w<nWires; w++ ){
+                for ( int k=0; k<kn; k++ ){
+                    xk[k+kn*w] = dcoefs[k0+k+n*w] - xk[k+kn*w];
+                }
+            }
+            dtrsm_(&left, &upper, &noTrans, &nonUnit, &kn, &nWires, &one, U+k0, &n, xk, &kn);
+        }
+        MPI::COMM_WORLD.Bcast(xk, kn*nWires, MPI::DOUBLE, owner);
+        for ( int w=0; w<nWires; w++ ){
+            dcopy_(&kn, xk+kn*w, &inc, dcoefs+k0+n*w, &inc);
+        }
+
+        if ( rank==owner && k0>0 ){
+            dgemm_(&noTrans, &noTrans, &k0, &nWires, &kn,
+                    &one, U, &n, xk, &kn, &one, sumUx, &n);
+        }
+    }
+
+    delete[] panel;
+    delete[] xk;
+    delete[] sumUx;
+    delete[] ipiv;
+}
+
+
 double Caplet::calCollocationPEntryDouble(int panel1, int panel2){
     //* Test point : panel1.center
     //  Integration: panel2
@@ -685,16 +1359,18 @@ double Caplet::calCollocationPEntryDouble(int panel1, int panel2){
     //* Rotate, mirror, and call proper integrals
     switch( dirs[panel2] ){
     case X:
-        this->rotateX2Z(coord_ptr_1, panel1);
-        this->rotateX2Z(coord_ptr_2, panel2);
+        this->rotateX2Z(coord_ptr_1, panels[panel1]);
+        this->rotateX2Z(coord_ptr_2, panels[panel2]);
         return calColD( coord_ptr_1, coord_ptr_2);
         break;
     case Y:
-        this->rotateY2Z(coord_ptr_1, panel1);
-        this->rotateY2Z(coord_ptr_2, panel2);
+        this->rotateY2Z(coord_ptr_1, panels[panel1]);
+        this->rotateY2Z(coord_ptr_2, panels[panel2]);
         return calColD( coord_ptr_1, coord_ptr_2);
         break;
     case Z:
+        this->rotateZ2Z(coord_ptr_1, panels[panel1]);
+        this->rotateZ2Z(coord_ptr_2, panels[panel2]);
         return calColD( coord_ptr_1, coord_ptr_2);
         break;
     }
@@ -782,11 +1458,13 @@ void Caplet::extractCGalerkinDouble(){
     #endif
 
 
+    CAPLET_PHASE_BEGIN("fill");
     #ifdef CAPLET_MPI
     this->generateGalerkinPMatrixDoubleMPI();
     #else
     this->generateGalerkinPMatrixDouble();
     #endif
+    CAPLET_PHASE_END();
 
 
     if (MPI::COMM_WORLD.Get_rank()!=0){
@@ -794,7 +1472,9 @@ void Caplet::extractCGalerkinDouble(){
     }
     //* End of core with non-zero rank
 
+    CAPLET_PHASE_BEGIN("rhs");
     this->generateRHSDouble();
+    CAPLET_PHASE_END();
 
     #ifdef CAPLET_TIMER
     this->timeAfterFilling = MPI::Wtime();;
@@ -806,6 +1486,7 @@ void Caplet::extractCGalerkinDouble(){
     char 	uplo = 'u';
 
     //* Query optimal workspace size
+    CAPLET_PHASE_BEGIN("factorization");
     double*	work = new double[1];
     int		lwork = -1;
     int*	ipiv = new int[this->nCoefs];
@@ -816,6 +1497,7 @@ void Caplet::extractCGalerkinDouble(){
     //* Solve system using optimal work length
     work = new double[lwork];
     dsysv_(&uplo, &nCoefs, &nWires, dP, &nCoefs, ipiv, this->dcoefs, &nCoefs, work, &lwork, &info);
+    CAPLET_PHASE_END();
     delete[] ipiv;
     delete[] work;
 
@@ -825,11 +1507,13 @@ void Caplet::extractCGalerkinDouble(){
     char 	transB 	= 'n';
     double 	alpha 	= 4*pi*epsilon0;
     double 	beta 	= 0.0;
+    CAPLET_PHASE_BEGIN("cmat_gemm");
     dgemm_(&transA, &transB,
             &this->nWires, &this->nWires, &this->nCoefs,
             &alpha, this->drhs, &this->nCoefs,
             this->dcoefs, &this->nCoefs,
             &beta, this->dCmat, &this->nWires);
+    CAPLET_PHASE_END();
 
     #ifdef CAPLET_TIMER
     this->timeAfterSolving = MPI::Wtime();
@@ -849,8 +1533,17 @@ void Caplet::extractCGalerkin(){
 
     int rank = MPI::COMM_WORLD.Get_rank();
 
+    //* Mirror planes of the structure (empty: no symmetry or disabled)
+    std::vector<int> planes;
+    std::vector< std::vector<int> > mirrorCoefs;
+    if ( this->flagSymmetric==true && this->isLoaded==true ){
+        CAPLET_PHASE_BEGIN("symmetry_detection");
+        this->detectMirrorSymmetry(planes, mirrorCoefs);
+        CAPLET_PHASE_END();
+    }
+
     if ( this->isLoaded == true ){
-        if( rank==0 ){
+        if( rank==0 && planes.empty()==true ){
             this->P 	= new float[this->nCoefs*this->nCoefs];
         }else{
             this->P		= new float[1];
@@ -867,19 +1560,71 @@ void Caplet::extractCGalerkin(){
     this->timeStart = MPI::Wtime();;
     #endif
 
+    //* Solve the symmetric and antisymmetric half-problems only
+    if ( planes.empty()==false ){
+        if ( rank==0 ){
+            if ( this->cacheFileName.empty()==false ){
+                cerr << "WARNING: cache file is not used for symmetric structures" << endl;
+            }
+            CAPLET_PHASE_BEGIN("rhs");
+            this->generateRHS();
+            CAPLET_PHASE_END();
+            this->solveGalerkinSymmetric(planes, mirrorCoefs);
+            this->generateGalerkinCmat();
+        }
+        return;
+    }
 
-    #ifdef CAPLET_MPI
-    this->generateGalerkinPMatrixMPI();
-    #endif
+    //* Reuse unchanged entries of the P matrix of a previous run
+    CAPLET_PHASE_BEGIN("fill");
+    int flagFilled = 0;
+    if ( this->cacheFileName.empty()==false ){
+        if ( rank==0 ){
+            CAPLET_PHASE_BEGIN("incremental");
+            flagFilled = this->generateGalerkinPMatrixIncremental();
+            CAPLET_PHASE_END();
+        }
+        MPI::COMM_WORLD.Bcast(&flagFilled, 1, MPI::INT, 0);
+    }
 
-    #ifndef CAPLET_MPI
-    this->generateGalerkinPMatrix();
-    #endif
+    //* Copy P blocks of periodic conductor cells
+    if ( flagFilled==0 && this->flagPeriodic==true ){
+        if ( rank==0 ){
+            CAPLET_PHASE_BEGIN("periodic");
+            flagFilled = this->generateGalerkinPMatrixPeriodic();
+            CAPLET_PHASE_END();
+        }
+        MPI::COMM_WORLD.Bcast(&flagFilled, 1, MPI::INT, 0);
+    }
+
+    if ( flagFilled==0 ){
+        #ifdef CAPLET_MPI
+        this->generateGalerkinPMatrixMPI();
+        #endif
+
+        #ifndef CAPLET_MPI
+        CAPLET_PHASE_BEGIN("entries");
+        this->generateGalerkinPMatrix();
+        CAPLET_PHASE_END();
+        #endif
+    }
+    CAPLET_PHASE_END();
 
     if (MPI::COMM_WORLD.Get_rank()!=0){
         return;
     }
+    CAPLET_PHASE_BEGIN("rhs");
     this->generateRHS();
+    CAPLET_PHASE_END();
+
+    //* Keep P before it is factorized
+    float* Pfill = 0;
+    if ( this->cacheFileName.empty()==false ){
+        int nP  = this->nCoefs*this->nCoefs;
+        int inc = 1;
+        Pfill = new float[nP];
+        scopy_(&nP, P, &inc, Pfill, &inc);
+    }
 
 
     #ifdef CAPLET_TIMER
@@ -892,6 +1637,7 @@ void Caplet::extractCGalerkin(){
     char 	uplo = 'u';
 
     //* Query optimal workspace size
+    CAPLET_PHASE_BEGIN("factorization");
     float*	work = new float[1];
     int		lwork = -1;
     int*	ipiv = new int[this->nCoefs];
@@ -902,20 +1648,32 @@ void Caplet::extractCGalerkin(){
     //* Solve system using optimal work length
     work = new float[lwork];
     ssysv_(&uplo, &nCoefs, &nWires, P, &nCoefs, ipiv, coefs, &nCoefs, work, &lwork, &info);
+    CAPLET_PHASE_END();
     delete[] ipiv;
     delete[] work;
 
+    this->generateGalerkinCmat();
+
+    if ( Pfill!=0 ){
+        this->saveGalerkinCache(Pfill);
+        delete[] Pfill;
+    }
+}
 
+
+void Caplet::generateGalerkinCmat(){
     //* Use matrix-matrix product to compute Cmat from coefs
     char 	transA 	= 't';
     char 	transB 	= 'n';
     float 	alpha 	= 4*pi*epsilon0;
     float 	beta 	= 0.0;
+    CAPLET_PHASE_BEGIN("cmat_gemm");
     sgemm_(&transA, &transB,
             &this->nWires, &this->nWires, &this->nCoefs,
             &alpha, this->rhs, &this->nCoefs,
             this->coefs, &this->nCoefs,
             &beta, this->Cmat, &this->nWires);
+    CAPLET_PHASE_END();
 
     #ifdef CAPLET_TIMER
     this->timeAfterSolving = MPI::Wtime();
@@ -927,7 +1685,715 @@ void Caplet::extractCGalerkin(){
 }
 
 
-void Caplet::generateGalerkinPMatrix(){
+//*
+//* INCREMENTAL GALERKIN MODE
+//*
+//* With a cache file, every run stores P together with the panel
+//* descriptions. The next run on an edited structure matches basis
+//* functions by their shapes, copies P entries between matched basis
+//* functions, and only computes the rows of new basis functions.
+//*
+//* P of instantiable basis functions is indefinite and nearly singular,
+//* so the solution is not updated by low-rank formulas on inv(P);
+//* the assembled P is factorized again with ssysv.
+//*
+
+//* Cache file layout (binary):
+//  magic, nCoefs, nPanels, quadrature order, adaptive flag,
+//  panel descriptions, P (column major)
+static const char   galerkinCacheMagic[8] = {'C','A','P','L','E','T','P','2'};
+static const int    nPanelDesc = 12;
+
+void Caplet::setCacheFile(const std::string filename){
+    this->cacheFileName = filename;
+}
+
+
+void Caplet::setQuadrature(int order, bool isAdaptive){
+    caplet::setQuadrature(order, isAdaptive);
+}
+
+
+void Caplet::packPanelDescriptions(std::vector<float> &desc) const{
+    //* indexIncrement, type, dir, basisDir, basisZ, basisShift, XL, XU, YL, YU, ZL, ZU
+    desc.resize(this->nPanels*nPanelDesc);
+    for ( int i=0; i<this->nPanels; i++ ){
+        float *d = &desc[i*nPanelDesc];
+        d[0] = this->indexIncrements[i];
+        d[1] = this->basisTypes[i];
+        d[2] = this->dirs[i];
+        d[3] = this->basisDirs[i];
+        d[4] = this->basisZs[i];
+        d[5] = this->basisShifts[i];
+        for ( int k=0; k<3; k++ ){
+            d[6+2*k] = this->panels[i][k][MIN];
+            d[7+2*k] = this->panels[i][k][MAX];
+        }
+    }
+}
+
+
+void Caplet::saveGalerkinCache(const float* Pfill){
+    std::ofstream ofile(this->cacheFileName.c_str(), std::ios::binary);
+    if (!ofile.is_open()){
+        cerr << "ERROR: cannot write cache file: " << this->cacheFileName << endl;
+        return;
+    }
+    std::vector<float> desc;
+    this->packPanelDescriptions(desc);
+
+    ofile.write(galerkinCacheMagic, sizeof(galerkinCacheMagic));
+    ofile.write(reinterpret_cast<const char*>(&this->nCoefs), sizeof(int));
+    ofile.write(reinterpret_cast<const char*>(&this->nPanels), sizeof(int));
+    const int quadrature[2] = { getQuadratureOrder(), isQuadratureAdaptive() };
+    ofile.write(reinterpret_cast<const char*>(quadrature), sizeof(quadrature));
+    ofile.write(reinterpret_cast<const char*>(&desc[0]), desc.size()*sizeof(float));
+    ofile.write(reinterpret_cast<const char*>(Pfill),
+                size_t(this->nCoefs)*this->nCoefs*sizeof(float));
+    ofile.close();
+}
+
+
+//* Group panel descriptions into one key per basis function
+static void generateCoefKeys(
+        const std::vector<float> &desc, std::vector< std::vector<float> > &keys){
+    const int nPanel = desc.size()/nPanelDesc;
+    keys.clear();
+    for ( int i=0; i<nPanel; i++ ){
+        const float *d = &desc[i*nPanelDesc];
+        if ( i==0 || d[0]!=0 ){
+            keys.push_back(std::vector<float>());
+        }
+        keys.back().insert(keys.back().end(), d+1, d+nPanelDesc);
+    }
+}
+
+
+bool Caplet::generateGalerkinPMatrixIncremental(){
+    std::ifstream ifile(this->cacheFileName.c_str(), std::ios::binary);
+    if (!ifile){
+        return false;
+    }
+
+    //* Read and check header
+    char magic[sizeof(galerkinCacheMagic)];
+    int  nOld = 0;
+    int  nOldPanels = 0;
+    ifile.read(magic, sizeof(magic));
+    ifile.read(reinterpret_cast<char*>(&nOld), sizeof(int));
+    ifile.read(reinterpret_cast<char*>(&nOldPanels), sizeof(int));
+    if ( !ifile || std::memcmp(magic, galerkinCacheMagic, sizeof(magic))!=0
+         || nOld<=0 || nOldPanels<=0 ){
+        cerr << "WARNING: invalid cache file: " << this->cacheFileName << endl;
+        return false;
+    }
+
+    //* P entries of another quadrature setting are not reused
+    int quadrature[2] = {0, 0};
+    ifile.read(reinterpret_cast<char*>(quadrature), sizeof(quadrature));
+    if ( !ifile || quadrature[0]!=getQuadratureOrder()
+         || quadrature[1]!=int(isQuadratureAdaptive()) ){
+        cerr << "WARNING: cache file was filled with another quadrature setting: "
+             << this->cacheFileName << endl;
+        return false;
+    }
+    std::vector<float> oldDesc(nOldPanels*nPanelDesc);
+    ifile.read(reinterpret_cast<char*>(&oldDesc[0]), oldDesc.size()*sizeof(float));
+
+    //* Match basis functions by shape
+    std::vector<float> newDesc;
+    this->packPanelDescriptions(newDesc);
+    std::vector< std::vector<float> > oldKeys, newKeys;
+    generateCoefKeys(oldDesc, oldKeys);
+    generateCoefKeys(newDesc, newKeys);
+    if ( !ifile || int(oldKeys.size())!=nOld ){
+        cerr << "WARNING: invalid cache file: " << this->cacheFileName << endl;
+        return false;
+    }
+
+    typedef std::map< std::vector<float>, std::vector<int> > KeyMap;
+    KeyMap oldMap;
+    for ( int j=nOld-1; j>=0; j-- ){
+        oldMap[oldKeys[j]].push_back(j);
+    }
+
+    std::vector<int> matchedIndex(this->nCoefs, -1);  //* new coef -> old coef
+    std::vector<int> added;
+    for ( int i=0; i<this->nCoefs; i++ ){
+        KeyMap::iterator found = oldMap.find(newKeys[i]);
+        if ( found!=oldMap.end() && found->second.empty()==false ){
+            matchedIndex[i] = found->second.back();
+            found->second.pop_back();
+        }else{
+            added.push_back(i);
+        }
+    }
+
+    const int nA = added.size();
+    std::cout << "Recomputed basis functions  : " << nA << std::endl;
+    if ( nA > incrementalMaxChangeRatio*this->nCoefs ){
+        return false;
+    }
+
+    //* Read cached P
+    std::vector<float> Pold(size_t(nOld)*nOld);
+    ifile.read(reinterpret_cast<char*>(&Pold[0]), Pold.size()*sizeof(float));
+    if ( !ifile ){
+        cerr << "WARNING: invalid cache file: " << this->cacheFileName << endl;
+        return false;
+    }
+    ifile.close();
+
+    //* Copy entries between matched basis functions (upper triangle)
+    float zero = 0.0f;
+    int   inc  = 1;
+    int   nC   = nCoefs*nCoefs;
+    sscal_(&nC, &zero, P, &inc);
+    for ( int j=0; j<this->nCoefs; j++ ){
+        const int oj = matchedIndex[j];
+        for ( int i=0; i<=j; i++ ){
+            const int oi = matchedIndex[i];
+            if ( oi>=0 && oj>=0 ){
+                P[ i + size_t(nCoefs)*j ] = ( oi<=oj )
+                        ? Pold[ oi + size_t(nOld)*oj ]
+                        : Pold[ oj + size_t(nOld)*oi ];
+            }
+        }
+    }
+
+    std::vector<int> firstPanel;
+    this->generateCoefFirstPanels(firstPanel);
+
+    //* Compute rows of added basis functions
+    const int nK = nA*this->nCoefs;
+    #ifdef CAPLET_OPENMP
+        #pragma omp parallel for num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int k=0; k<nK; k++ ){
+        const int p  = added[k / this->nCoefs];
+        const int q  = k % this->nCoefs;
+        const int lo = std::min(p, q);
+        const int hi = std::max(p, q);
+
+        float result = calGalerkinCoefEntry(lo, hi, firstPanel);
+        P[ lo + size_t(nCoefs)*hi ] = result;
+    }
+
+    return true;
+}
+
+
+//* Panel range [firstPanel[c], firstPanel[c+1]) of each coef c
+void Caplet::generateCoefFirstPanels(std::vector<int> &firstPanel) const{
+    firstPanel.assign(this->nCoefs+1, this->nPanels);
+    for ( int i=0, ind=-1; i<this->nPanels; i++ ){
+        if ( i==0 || this->indexIncrements[i]!=0 ){
+            firstPanel[++ind] = i;
+        }
+    }
+}
+
+
+//* P entry between coef1<=coef2, summed in the same order
+//  as generateGalerkinPMatrix
+float Caplet::calGalerkinCoefEntry(int coef1, int coef2, const std::vector<int> &firstPanel){
+    float result = 0;
+    for ( int j=firstPanel[coef2]; j<firstPanel[coef2+1]; j++ ){
+        for ( int i=firstPanel[coef1]; i<firstPanel[coef1+1] && (coef1!=coef2 || i<=j); i++ ){
+            if ( (i!=j) && (coef1==coef2) ){
+                result += calGalerkinPEntry(i,j)*2;
+            }else{
+                result += calGalerkinPEntry(i,j);
+            }
+        }
+    }
+    return result;
+}
+
+
+//*
+//* PERIODIC GALERKIN MODE
+//*
+//* Buses and array bitlines consist of families of conductor cells,
+//* where cell k is cell 0 translated by k times a pitch vector. P blocks
+//* between cells a<=b of a family then only depend on b-a, so each family
+//* diagonal block is block Toeplitz. Only the first block row of each
+//* family and the blocks between families are computed; the other blocks
+//* are copied.
+//*
+//* P of instantiable basis functions is indefinite and nearly singular,
+//* so structured Toeplitz solvers (block Levinson, FFT-based iterations)
+//* are not used; the assembled P is factorized by ssysv as usual.
+//*
+
+void Caplet::setPeriodic(bool flag){
+    this->flagPeriodic = flag;
+}
+
+
+//* Check whether wire2 is wire1 translated by t
+bool Caplet::isTranslatedWire(int wire1, int wire2, const std::vector<int> &wireFirstPanel,
+                              float t[nDim], bool isTGiven) const{
+    const int n = this->nWirePanels[wire1];
+    if ( n!=this->nWirePanels[wire2] || this->nWireCoefs[wire1]!=this->nWireCoefs[wire2] ){
+        return false;
+    }
+    const int p1 = wireFirstPanel[wire1];
+    const int p2 = wireFirstPanel[wire2];
+    for ( int d=0; d<nDim && isTGiven==false; d++ ){
+        t[d] = panels[p2][d][MIN] - panels[p1][d][MIN];
+    }
+    for ( int k=0; k<n; k++ ){
+        const int i = p1+k;
+        const int j = p2+k;
+        if ( basisTypes[i]!=basisTypes[j] || dirs[i]!=dirs[j] || basisDirs[i]!=basisDirs[j]
+             || basisZs[i]!=basisZs[j] || basisShifts[i]!=basisShifts[j]
+             || (k>0 && indexIncrements[i]!=indexIncrements[j]) ){
+            return false;
+        }
+        for ( int d=0; d<nDim; d++ ){
+            if ( std::abs(panels[j][d][LENGTH] - panels[i][d][LENGTH]) > periodicTolerance
+                 || std::abs(panels[j][d][MIN] - panels[i][d][MIN] - t[d]) > periodicTolerance ){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+bool Caplet::generateGalerkinPMatrixPeriodic(){
+    std::vector<int> wireFirstPanel(this->nWires+1, 0);
+    for ( int w=0; w<this->nWires; w++ ){
+        wireFirstPanel[w+1] = wireFirstPanel[w] + this->nWirePanels[w];
+    }
+    std::vector<int> firstPanel;
+    this->generateCoefFirstPanels(firstPanel);
+    std::vector<int> wireFirstCoef(this->nWires+1, this->nCoefs);
+    for ( int w=0, c=0; w<this->nWires; c+=this->nWireCoefs[w], w++ ){
+        wireFirstCoef[w] = c;
+    }
+
+    //* Detect families: maximal runs of nCells cells of nCellWires wires
+    std::vector<int> coefFamily(this->nCoefs, -1);  //* -1: not in a family
+    std::vector<int> coefCell(this->nCoefs, 0);
+    std::vector<int> familyCellCoefs;
+    int nPeriodicWires = 0;
+    for ( int w=0; w<this->nWires; ){
+        int bestCellWires = 1;
+        int bestCells = 1;
+        for ( int p=1; p<=periodicMaxCellWires && w+2*p<=this->nWires; p++ ){
+            float t[nDim];
+            int   n = 1;
+            bool  isTGiven = false;
+            while ( w+(n+1)*p <= this->nWires ){
+                bool isTranslated = true;
+                for ( int q=0; q<p && isTranslated; q++ ){
+                    isTranslated = isTranslatedWire(w+(n-1)*p+q, w+n*p+q,
+                                                    wireFirstPanel, t, isTGiven);
+                    isTGiven = true;
+                }
+                if ( isTranslated==false ){
+                    break;
+                }
+                n++;
+            }
+            if ( n>=2 && n*p > bestCells*bestCellWires ){
+                bestCellWires = p;
+                bestCells = n;
+            }
+        }
+
+        if ( bestCells>=2 ){
+            const int family    = familyCellCoefs.size();
+            const int firstCoef = wireFirstCoef[w];
+            const int cellCoefs = wireFirstCoef[w+bestCellWires] - firstCoef;
+            for ( int c=firstCoef; c<wireFirstCoef[w+bestCells*bestCellWires]; c++ ){
+                coefFamily[c] = family;
+                coefCell[c] = (c-firstCoef)/cellCoefs;
+            }
+            familyCellCoefs.push_back(cellCoefs);
+            nPeriodicWires += bestCells*bestCellWires;
+        }
+        w += bestCells*bestCellWires;
+    }
+
+    std::cout << "Periodic families           : " << familyCellCoefs.size()
+              << " (" << nPeriodicWires << " of " << this->nWires << " conductors)" << std::endl;
+    if ( familyCellCoefs.empty() ){
+        cerr << "WARNING: no periodic structure found; P is fully filled" << endl;
+        return false;
+    }
+
+    float zero = 0.0f;
+    int   inc  = 1;
+    int   nP   = this->nCoefs*this->nCoefs;
+    sscal_(&nP, &zero, P, &inc);
+
+    //* Compute the first block row of each family and blocks between families
+    long long nComputed = 0;
+    #ifdef CAPLET_OPENMP
+        #pragma omp parallel for num_threads(CAPLET_OPENMP_NUM_THREADS) \
+                schedule(dynamic) reduction(+:nComputed)
+    #endif
+    for ( int hi=0; hi<this->nCoefs; hi++ ){
+        for ( int lo=0; lo<=hi; lo++ ){
+            if ( coefFamily[lo]>=0 && coefFamily[lo]==coefFamily[hi] && coefCell[lo]>0 ){
+                continue;
+            }
+            P[ lo + size_t(nCoefs)*hi ] = calGalerkinCoefEntry(lo, hi, firstPanel);
+            nComputed++;
+        }
+    }
+
+    //* Copy block (a, b) from block (0, b-a)
+    for ( int hi=0; hi<this->nCoefs; hi++ ){
+        const int family = coefFamily[hi];
+        for ( int lo=0; lo<=hi; lo++ ){
+            if ( family>=0 && coefFamily[lo]==family && coefCell[lo]>0 ){
+                const int shift = coefCell[lo]*familyCellCoefs[family];
+                P[ lo + size_t(nCoefs)*hi ] = P[ (lo-shift) + size_t(nCoefs)*(hi-shift) ];
+            }
+        }
+    }
+
+    std::cout << "Computed P entries          : "
+              << 100.0*nComputed/( 0.5*double(nCoefs)*(nCoefs+1) ) << "%" << std::endl;
+    return true;
+}
+
+
+//*
+//* SYMMETRIC GALERKIN MODE
+//*
+//* Mirrors about the x and y center planes of a symmetric structure map
+//* the basis set onto itself. They generate a group G of 2 or 4 elements,
+//* and P is invariant under the permutations of basis functions by G.
+//* With symmetry-adapted basis vectors, one per orbit of basis functions
+//* and sign pattern chi of G, P splits into |G| independent blocks:
+//* the symmetric and antisymmetric half-problems for one plane, and four
+//* quarter-problems for two planes. Entry (r, s) of block chi is
+//*
+//*     sum_g chi(g) P(r, g s) / sqrt(|H_r| |H_s|),
+//*
+//* where r and s are the first basis functions of their orbits, and H_r
+//* is the subgroup of G that maps r onto itself. Each block is solved by
+//* ssysv, and the solutions are mapped back to all basis functions.
+//*
+
+void Caplet::setSymmetric(bool flag){
+    this->flagSymmetric = flag;
+}
+
+
+void Caplet::setPrecorrectedFFT(bool flag){
+    this->flagPrecorrectedFFT = flag;
+}
+
+
+void Caplet::setAdaptiveRefinement(float tolerance){
+    this->adaptiveTolerance = tolerance;
+}
+
+
+//* Sign of group element g in sign pattern chi
+//  (bit k of g: mirror about planes[k])
+static inline int symmetrySign(int g, int chi){
+    int sign = 1;
+    for ( int k=g&chi; k!=0; k>>=1 ){
+        if ( k&1 ){
+            sign = -sign;
+        }
+    }
+    return sign;
+}
+
+
+//* Key of coef mirrored about the plane along mirrorDir (-1: not mirrored);
+//  sum is the sum of the quantized structure bounds along mirrorDir
+void Caplet::packSymmetryCoefKey(int coef, int mirrorDir, int sum,
+        const std::vector<int> &firstPanel, const std::vector<int> &bounds,
+        std::vector<int> &key) const{
+    const int nKey = 5 + 2*nDim;
+    std::vector< std::vector<int> > panelKeys;
+    for ( int i=firstPanel[coef]; i<firstPanel[coef+1]; i++ ){
+        std::vector<int> panelKey(nKey);
+        float basisZ = this->basisZs[i];
+        if ( this->basisDirs[i]==mirrorDir && basisZ!=0 ){
+            basisZ = -basisZ;
+        }
+        panelKey[0] = this->basisTypes[i];
+        panelKey[1] = this->dirs[i];
+        panelKey[2] = this->basisDirs[i];
+        std::memcpy(&panelKey[3], &basisZ,               sizeof(float));
+        std::memcpy(&panelKey[4], &this->basisShifts[i], sizeof(float));
+        for ( int d=0; d<nDim; d++ ){
+            const int lower = bounds[ (i*nDim+d)*2 ];
+            const int upper = bounds[ (i*nDim+d)*2+1 ];
+            panelKey[5+2*d] = ( d==mirrorDir )? sum-upper : lower;
+            panelKey[6+2*d] = ( d==mirrorDir )? sum-lower : upper;
+        }
+        panelKeys.push_back(panelKey);
+    }
+    std::sort(panelKeys.begin(), panelKeys.end());
+
+    key.clear();
+    for ( size_t k=0; k<panelKeys.size(); k++ ){
+        key.insert(key.end(), panelKeys[k].begin(), panelKeys[k].end());
+    }
+}
+
+
+void Caplet::detectMirrorSymmetry(std::vector<int> &planes,
+                                  std::vector< std::vector<int> > &mirrorCoefs) const{
+    planes.clear();
+    mirrorCoefs.clear();
+    const bool isRoot = ( MPI::COMM_WORLD.Get_rank()==0 );
+
+    //* Quantized panel bounds
+    std::vector<int> bounds(this->nPanels*nDim*2);
+    for ( int i=0; i<this->nPanels; i++ ){
+        for ( int d=0; d<nDim; d++ ){
+            const float lower = std::floor( panels[i][d][MIN]/symmetryQuantum + 0.5f );
+            const float upper = std::floor( panels[i][d][MAX]/symmetryQuantum + 0.5f );
+            if ( std::abs(lower)>=1.0e9f || std::abs(upper)>=1.0e9f ){
+                if ( isRoot ){
+                    cerr << "WARNING: structure is too large for symmetryQuantum; P is fully filled" << endl;
+                }
+                return;
+            }
+            bounds[ (i*nDim+d)*2 ]   = int(lower);
+            bounds[ (i*nDim+d)*2+1 ] = int(upper);
+        }
+    }
+
+    std::vector<int> firstPanel;
+    this->generateCoefFirstPanels(firstPanel);
+
+    //* Basis functions by their keys
+    std::map< std::vector<int>, int > coefMap;
+    std::vector<int> key;
+    for ( int c=0; c<this->nCoefs; c++ ){
+        this->packSymmetryCoefKey(c, -1, 0, firstPanel, bounds, key);
+        if ( coefMap.insert( std::make_pair(key, c) ).second==false ){
+            if ( isRoot ){
+                cerr << "WARNING: duplicated basis functions; P is fully filled" << endl;
+            }
+            return;
+        }
+    }
+
+    //* Match each basis function with its mirror image
+    const int mirrorDirs[2] = { X, Y };
+    for ( int k=0; k<2; k++ ){
+        const int d = mirrorDirs[k];
+        int lower = bounds[d*2];
+        int upper = bounds[d*2+1];
+        for ( int i=1; i<this->nPanels; i++ ){
+            lower = std::min(lower, bounds[ (i*nDim+d)*2 ]);
+            upper = std::max(upper, bounds[ (i*nDim+d)*2+1 ]);
+        }
+
+        std::vector<int> mirror(this->nCoefs, -1);
+        bool isSymmetric = true;
+        for ( int c=0; c<this->nCoefs && isSymmetric; c++ ){
+            this->packSymmetryCoefKey(c, d, lower+upper, firstPanel, bounds, key);
+            std::map< std::vector<int>, int >::const_iterator found = coefMap.find(key);
+            if ( found==coefMap.end() ){
+                isSymmetric = false;
+            }else{
+                mirror[c] = found->second;
+            }
+        }
+        if ( isSymmetric ){
+            planes.push_back(d);
+            mirrorCoefs.push_back(mirror);
+        }
+    }
+
+    if ( isRoot ){
+        std::cout << "Mirror symmetry planes      : ";
+        for ( size_t k=0; k<planes.size(); k++ ){
+            std::cout << ( (planes[k]==X)? "x " : "y " );
+        }
+        std::cout << ( planes.empty()? "none" : "" ) << std::endl;
+        if ( planes.empty() ){
+            cerr << "WARNING: no mirror symmetry found; P is fully filled" << endl;
+        }
+    }
+}
+
+
+void Caplet::solveGalerkinSymmetric(const std::vector<int> &planes,
+                                    const std::vector< std::vector<int> > &mirrorCoefs){
+    const int nGroup = 1<<planes.size();
+
+    //* image[g][c]: basis function c mapped by group element g
+    std::vector< std::vector<int> > image(nGroup, std::vector<int>(this->nCoefs));
+    for ( int c=0; c<this->nCoefs; c++ ){
+        image[0][c] = c;
+    }
+    for ( int g=1; g<nGroup; g++ ){
+        int k = 0;
+        while ( (g&(1<<k))==0 ){
+            k++;
+        }
+        for ( int c=0; c<this->nCoefs; c++ ){
+            image[g][c] = mirrorCoefs[k][ image[g&~(1<<k)][c] ];
+        }
+    }
+
+    //* Orbit representatives and their stabilizers (bit g: g maps r onto r)
+    std::vector<int> reps;
+    std::vector<int> stabilizers;
+    for ( int c=0; c<this->nCoefs; c++ ){
+        bool isRep = true;
+        int  stabilizer = 0;
+        for ( int g=0; g<nGroup; g++ ){
+            isRep = isRep && ( image[g][c]>=c );
+            stabilizer |= ( image[g][c]==c )? (1<<g) : 0;
+        }
+        if ( isRep ){
+            reps.push_back(c);
+            stabilizers.push_back(stabilizer);
+        }
+    }
+    const int nReps = reps.size();
+
+    //* Orbit a contributes to block chi if chi is +1 on its stabilizer
+    std::vector< std::vector<int> > blockIndex(nGroup, std::vector<int>(nReps, -1));
+    std::vector<int>   blockSize(nGroup, 0);
+    std::vector<float> scale(nReps);
+    for ( int a=0; a<nReps; a++ ){
+        int nStabilizer = 0;
+        for ( int g=0; g<nGroup; g++ ){
+            nStabilizer += ( stabilizers[a]>>g )&1;
+        }
+        scale[a] = 1/std::sqrt(float(nStabilizer));
+        for ( int chi=0; chi<nGroup; chi++ ){
+            bool isValid = true;
+            for ( int g=0; g<nGroup; g++ ){
+                if ( ((stabilizers[a]>>g)&1) && symmetrySign(g, chi)<0 ){
+                    isValid = false;
+                }
+            }
+            if ( isValid ){
+                blockIndex[chi][a] = blockSize[chi]++;
+            }
+        }
+    }
+
+    std::cout << "Symmetry block sizes        :";
+    for ( int chi=0; chi<nGroup; chi++ ){
+        std::cout << " " << blockSize[chi];
+    }
+    std::cout << std::endl;
+
+    //* Fill the upper triangle of each block
+    CAPLET_PHASE_BEGIN("fill");
+    std::vector< std::vector<float> > blocks(nGroup);
+    for ( int chi=0; chi<nGroup; chi++ ){
+        blocks[chi].assign( size_t(blockSize[chi])*blockSize[chi], 0.0f );
+    }
+    std::vector<int> firstPanel;
+    this->generateCoefFirstPanels(firstPanel);
+
+    long long nComputed = 0;
+    #ifdef CAPLET_OPENMP
+        #pragma omp parallel for num_threads(CAPLET_OPENMP_NUM_THREADS) \
+                schedule(dynamic) reduction(+:nComputed)
+    #endif
+    for ( int b=0; b<nReps; b++ ){
+        float entries[4];
+        for ( int a=0; a<=b; a++ ){
+            for ( int g=0; g<nGroup; g++ ){
+                const int s = image[g][ reps[b] ];
+                int h = 0;
+                while ( image[h][ reps[b] ]!=s ){
+                    h++;
+                }
+                if ( h<g ){
+                    entries[g] = entries[h];
+                }else{
+                    entries[g] = calGalerkinCoefEntry( std::min(reps[a], s), std::max(reps[a], s),
+                                                       firstPanel );
+                    nComputed++;
+                }
+            }
+            for ( int chi=0; chi<nGroup; chi++ ){
+                const int ia = blockIndex[chi][a];
+                const int ib = blockIndex[chi][b];
+                if ( ia<0 || ib<0 ){
+                    continue;
+                }
+                double sum = 0;
+                for ( int g=0; g<nGroup; g++ ){
+                    sum += symmetrySign(g, chi)*entries[g];
+                }
+                blocks[chi][ ia + size_t(blockSize[chi])*ib ] = sum*scale[a]*scale[b];
+            }
+        }
+    }
+    std::cout << "Computed P entries          : "
+              << 100.0*nComputed/( 0.5*double(nCoefs)*(nCoefs+1) ) << "%" << std::endl;
+
+    CAPLET_PHASE_END();
+
+    #ifdef CAPLET_TIMER
+    this->timeAfterFilling = MPI::Wtime();
+    #endif
+
+    //* Solve each block and map the solutions back to all basis functions
+    CAPLET_PHASE_BEGIN("factorization");
+    const float groupScale = 1/std::sqrt(float(nGroup));
+    std::fill(this->coefs, this->coefs + size_t(this->nCoefs)*this->nWires, 0.0f);
+    for ( int chi=0; chi<nGroup; chi++ ){
+        int m = blockSize[chi];
+        if ( m==0 ){
+            continue;
+        }
+        std::vector<float> y( size_t(m)*this->nWires );
+        for ( int a=0; a<nReps; a++ ){
+            const int ia = blockIndex[chi][a];
+            for ( int w=0; w<this->nWires && ia>=0; w++ ){
+                double sum = 0;
+                for ( int g=0; g<nGroup; g++ ){
+                    sum += symmetrySign(g, chi)*this->rhs[ size_t(w)*nCoefs + image[g][reps[a]] ];
+                }
+                y[ ia + size_t(m)*w ] = sum*scale[a]*groupScale;
+            }
+        }
+
+        int  	info;
+        char 	uplo = 'u';
+
+        //* Query optimal workspace size
+        float	workSize;
+        int		lwork = -1;
+        std::vector<int> ipiv(m);
+        ssysv_(&uplo, &m, &nWires, &blocks[chi][0], &m, &ipiv[0], &y[0], &m, &workSize, &lwork, &info);
+        lwork = workSize;
+
+        //* Solve system using optimal work length
+        std::vector<float> work(lwork);
+        ssysv_(&uplo, &m, &nWires, &blocks[chi][0], &m, &ipiv[0], &y[0], &m, &work[0], &lwork, &info);
+        std::vector<float>().swap(blocks[chi]);
+
+        for ( int a=0; a<nReps; a++ ){
+            const int ia = blockIndex[chi][a];
+            for ( int w=0; w<this->nWires && ia>=0; w++ ){
+                const float value = y[ ia + size_t(m)*w ]*scale[a]*groupScale;
+                for ( int g=0; g<nGroup; g++ ){
+                    this->coefs[ size_t(w)*nCoefs + image[g][reps[a]] ] += symmetrySign(g, chi)*value;
+                }
+            }
+        }
+    }
+    CAPLET_PHASE_END();
+}
+
+
+void Caplet::generateGalerkinPMatrix(){
 
     float zero = 0.0f;
     int   inc  = 1;
@@ -983,7 +2449,7 @@ void Caplet::generateGalerkinPMatrixDouble(){
         int j = int((sqrt(double(1+8*k))-1)/2);
         int i = k - j*(j+1)/2;
 
-        double result = calGalerkinPEntry(i,j);
+        double result = calGalerkinPEntryDouble(i,j);
 
         if ( (i!=j) && (ind[i]==ind[j]) ){
             dP[ ind[i] + nCoefs*ind[j] ] += result*2;
@@ -1062,6 +2528,7 @@ void Caplet::generateGalerkinPMatrixMPI(){
     }
 
     //* For each k index
+    CAPLET_PHASE_BEGIN("entries");
     for ( int k = startK[rank] ; k <= lastK[rank] ; k++ ){
         //* Convert k index to i,j subscript
         int i,j;
@@ -1095,7 +2562,10 @@ void Caplet::generateGalerkinPMatrixMPI(){
         }
     }
 
+    CAPLET_PHASE_END();
+
     //* Combine sub-matrices to rank0 node
+    CAPLET_PHASE_BEGIN("gather");
     if( rank==0 ){
         MPI::Status status;
         for ( int i=1; i<numproc; i++ ){
@@ -1110,6 +2580,7 @@ void Caplet::generateGalerkinPMatrixMPI(){
         int copylen = (lastC[rank]-startC[rank]+1)*nCoefs;
         MPI::COMM_WORLD.Send(tempP, copylen, MPI::FLOAT, 0, 0);
     }
+    CAPLET_PHASE_END();
 
 
     delete[] startK;
@@ -1182,13 +2653,14 @@ void Caplet::generateGalerkinPMatrixDoubleMPI(){
     }
 
     //* For each k index
+    CAPLET_PHASE_BEGIN("entries");
     for ( int k = startK[rank] ; k <= lastK[rank] ; k++ ){
         //* Convert k index to i,j subscript
         int i,j;
         ltind2sub(k, i, j);
         //* Compute the P entry
 
-        double result = calGalerkinPEntry(i,j);
+        double result = calGalerkinPEntryDouble(i,j);
 
         #ifdef DEBUG_DETECT_NAN_INF_ENTRY
         #include <cmath>
@@ -1215,7 +2687,10 @@ void Caplet::generateGalerkinPMatrixDoubleMPI(){
         }
     }
 
+    CAPLET_PHASE_END();
+
     //* Combine sub-matrices to rank0 node
+    CAPLET_PHASE_BEGIN("gather");
     if( rank==0 ){
         MPI::Status status;
         for ( int i=1; i<numproc; i++ ){
@@ -1230,6 +2705,7 @@ void Caplet::generateGalerkinPMatrixDoubleMPI(){
         int copylen = (lastC[rank]-startC[rank]+1)*nCoefs;
         MPI::COMM_WORLD.Send(tempP, copylen, MPI::DOUBLE, 0, 0);
     }
+    CAPLET_PHASE_END();
 
 
     delete[] startK;
@@ -1243,16 +2719,155 @@ void Caplet::generateGalerkinPMatrixDoubleMPI(){
 
 
 
+//*
+//* Galerkin P entry through the interaction cache
+//*
+//* While the cache is active, entries are computed in a canonical frame,
+//* where the origin of panel1 is at zero and all lengths and the offset
+//* are rounded to interactionCacheQuantum. Every lookup hence returns the
+//* same value regardless of which thread inserted it first.
+//*
+static inline bool quantizeLength(float x, int &q){
+    const float qf = std::floor( x/interactionCacheQuantum + 0.5f );
+    q = int(qf);
+    //* keep offsets between origins within int
+    return std::abs(qf) < 1.0e9f;
+}
+
+
+void Caplet::initInteractionCache(){
+    //* Entries of a previous structure of a sweep are kept
+    if ( this->interactionCache==0 ){
+        this->interactionCache = new InteractionCache(this->nPanels);
+    }else{
+        this->interactionCache->setNPanels(this->nPanels);
+    }
+
+    //* Panels of the same type, direction, basis and quantized lengths
+    //  share a shape id
+    std::vector<int> shape(5+nDim);
+    for ( int i=0; i<this->nPanels; i++ ){
+        int  origin[nDim];
+        bool isValid = true;
+        //* Only the sign of basisZ, the decaying direction, enters the
+        //  integrals; its magnitude changes with layer elevations
+        shape[0] = basisTypes[i];
+        shape[1] = dirs[i];
+        shape[2] = basisDirs[i];
+        shape[3] = (basisZs[i]>0) - (basisZs[i]<0);
+        std::memcpy(&shape[4], &basisShifts[i], sizeof(float));
+        for ( int d=0; d<nDim; d++ ){
+            isValid = quantizeLength(panels[i][d][LENGTH], shape[5+d]) && isValid;
+            isValid = quantizeLength(panels[i][d][MIN],    origin[d])   && isValid;
+        }
+        if ( isValid ){
+            int shapeId = this->interactionCache->insertShape(shape);
+            this->interactionCache->setPanel(i, shapeId, origin);
+        }
+    }
+}
+
+
 float Caplet::calGalerkinPEntry(int panel1, int panel2){
+    if ( this->interactionCache==0 ){
+        return calGalerkinPEntry(panel1, panels[panel1], panel2, panels[panel2]);
+    }
+
+    float result;
+    int   slot;
+    if ( this->interactionCache->lookup(panel1, panel2, result, slot) ){
+        return result;
+    }
+    if ( this->interactionCache->isActive()==false
+         || this->interactionCache->getShapeId(panel1)<0
+         || this->interactionCache->getShapeId(panel2)<0 ){
+        return calGalerkinPEntry(panel1, panels[panel1], panel2, panels[panel2]);
+    }
+
+    //* Compute in the canonical frame
+    const int* origin1 = this->interactionCache->getOrigin(panel1);
+    const int* origin2 = this->interactionCache->getOrigin(panel2);
+    float coord1[nDim][nBit];
+    float coord2[nDim][nBit];
+    for ( int d=0; d<nDim; d++ ){
+        int q1, q2;
+        quantizeLength(panels[panel1][d][LENGTH], q1);
+        quantizeLength(panels[panel2][d][LENGTH], q2);
+        const float length1 = q1 * interactionCacheQuantum;
+        const float length2 = q2 * interactionCacheQuantum;
+        const float offset  = (origin2[d]-origin1[d]) * interactionCacheQuantum;
+        coord1[d][MIN]    = 0;
+        coord1[d][MAX]    = length1;
+        coord1[d][LENGTH] = length1;
+        coord1[d][CENTER] = length1/2;
+        coord2[d][MIN]    = offset;
+        coord2[d][MAX]    = offset + length2;
+        coord2[d][LENGTH] = length2;
+        coord2[d][CENTER] = offset + length2/2;
+    }
+    result = calGalerkinPEntry(panel1, coord1, panel2, coord2);
+
+    if ( slot>=0 ){
+        this->interactionCache->publish(slot, result);
+    }
+    return result;
+}
+
+
+//* Double Galerkin mode
+//  - the same kernels as calGalerkinPEntry instantiated in double; panel
+//    bounds are widened to double and the lengths and centers recomputed
+//    so that differences between panels do not round to float
+//  - the interaction cache stores float entries and is not used
+double Caplet::calGalerkinPEntryDouble(int panel1, int panel2){
+    double coord1[nDim][nBit];
+    double coord2[nDim][nBit];
+    for ( int d=0; d<nDim; d++ ){
+        coord1[d][MIN]    = panels[panel1][d][MIN];
+        coord1[d][MAX]    = panels[panel1][d][MAX];
+        coord1[d][LENGTH] = coord1[d][MAX] - coord1[d][MIN];
+        coord1[d][CENTER] = ( coord1[d][MIN] + coord1[d][MAX] )/2;
+        coord2[d][MIN]    = panels[panel2][d][MIN];
+        coord2[d][MAX]    = panels[panel2][d][MAX];
+        coord2[d][LENGTH] = coord2[d][MAX] - coord2[d][MIN];
+        coord2[d][CENTER] = ( coord2[d][MIN] + coord2[d][MAX] )/2;
+    }
+    return calGalerkinPEntry(panel1, coord1, panel2, coord2);
+}
+
+void Caplet::printInteractionCacheStatistics(){
+    long long local[2] = { this->interactionCache->getNHits(),
+                           this->interactionCache->getNMisses() };
+    long long total[2] = { 0, 0 };
+    MPI::COMM_WORLD.Reduce(local, total, 2, MPI::LONG_LONG, MPI::SUM, 0);
+
+    if ( MPI::COMM_WORLD.Get_rank()==0 ){
+        const long long nLookups = total[0] + total[1];
+        std::cout << "Interaction cache hit rate  : "
+                  << ( (nLookups>0)? 100.0*total[0]/nLookups : 0.0 ) << "% ("
+                  << total[0] << "/" << nLookups << ")" << std::endl;
+        CAPLET_COUNT("interaction_cache_hits", total[0]);
+        CAPLET_COUNT("interaction_cache_lookups", nLookups);
+    }
+}
+
+
+template<class real>
+real Caplet::calGalerkinPEntry(
+        int panel1, real (*coord1)[nBit],
+        int panel2, real (*coord2)[nBit]){
 
     //* A nDim-element array of pointers pointing to a nBit-element array
-    float *coord_ptr_1[3][4];
-    float *coord_ptr_2[3][4];
+    real *coord_ptr_1[3][4];
+    real *coord_ptr_2[3][4];
 
     if ( this->basisTypes[panel1] == 'F' ){
         int temp = panel1;
         panel1 = panel2;
         panel2 = temp;
+        real (*tempCoord)[nBit] = coord1;
+        coord1 = coord2;
+        coord2 = tempCoord;
     }
 
     //* Select shapes
@@ -1264,8 +2879,8 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
     case X:
         switch( basisDirs[panel1] ){
         case Y: // Xy
-            this->rotateX2Z(coord_ptr_1, panel1);
-            this->rotateX2Z(coord_ptr_2, panel2);
+            this->rotateX2Z(coord_ptr_1, coord1);
+            this->rotateX2Z(coord_ptr_2, coord2);
             switch( dirs[panel2] ){
             case X: // Xy_X
                 switch( basisDirs[panel2] ){
@@ -1305,8 +2920,8 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
                 }
             }
         case Z: // Xz
-            this->mirrorX2Z(coord_ptr_1, panel1);
-            this->mirrorX2Z(coord_ptr_2, panel2);
+            this->mirrorX2Z(coord_ptr_1, coord1);
+            this->mirrorX2Z(coord_ptr_2, coord2);
             switch( dirs[panel2] ){
             case X:
                 switch( basisDirs[panel2] ){
@@ -1349,24 +2964,24 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
         case FLAT: // Xf-?f
             switch( dirs[panel2] ){
             case X: // Xf_Xf
-                this->mirrorX2Z(coord_ptr_1, panel1);
-                this->mirrorX2Z(coord_ptr_2, panel2);
+                this->mirrorX2Z(coord_ptr_1, coord1);
+                this->mirrorX2Z(coord_ptr_2, coord2);
                 return intZFZF(coord_ptr_1, coord_ptr_2);
             case Y: // Xf_Yf
-                this->rotateX2Z(coord_ptr_1, panel1);
-                this->rotateX2Z(coord_ptr_2, panel2);
+                this->rotateX2Z(coord_ptr_1, coord1);
+                this->rotateX2Z(coord_ptr_2, coord2);
                 return intZFXF(coord_ptr_1, coord_ptr_2);
             case Z: // Xf_Zf
-                this->mirrorX2Z(coord_ptr_1, panel1);
-                this->mirrorX2Z(coord_ptr_2, panel2);
+                this->mirrorX2Z(coord_ptr_1, coord1);
+                this->mirrorX2Z(coord_ptr_2, coord2);
                 return intZFXF(coord_ptr_1, coord_ptr_2);
             }
         }
     case Y:
         switch( basisDirs[panel1] ){
         case X: 	// Yx
-            this->mirrorY2Z(coord_ptr_1, panel1);
-            this->mirrorY2Z(coord_ptr_2, panel2);
+            this->mirrorY2Z(coord_ptr_1, coord1);
+            this->mirrorY2Z(coord_ptr_2, coord2);
             switch( dirs[panel2] ){
             case X: // Yx_X
                 switch( basisDirs[panel2] ){
@@ -1406,8 +3021,8 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
                 }
             }
         case Z: 	// Yz
-            this->rotateY2Z(coord_ptr_1, panel1);
-            this->rotateY2Z(coord_ptr_2, panel2);
+            this->rotateY2Z(coord_ptr_1, coord1);
+            this->rotateY2Z(coord_ptr_2, coord2);
             switch( dirs[panel2] ){
             case X: // Yz_X
                 switch( basisDirs[panel2] ){
@@ -1449,24 +3064,24 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
         case FLAT: 	// Yf_?f
             switch( dirs[panel2] ){
             case X:
-                this->mirrorY2Z(coord_ptr_1, panel1);
-                this->mirrorY2Z(coord_ptr_2, panel2);
+                this->mirrorY2Z(coord_ptr_1, coord1);
+                this->mirrorY2Z(coord_ptr_2, coord2);
                 return intZFXF(coord_ptr_1, coord_ptr_2);
             case Y:
-                this->mirrorY2Z(coord_ptr_1, panel1);
-                this->mirrorY2Z(coord_ptr_2, panel2);
+                this->mirrorY2Z(coord_ptr_1, coord1);
+                this->mirrorY2Z(coord_ptr_2, coord2);
                 return intZFZF(coord_ptr_1, coord_ptr_2);
             case Z:
-                this->rotateY2Z(coord_ptr_1, panel1);
-                this->rotateY2Z(coord_ptr_2, panel2);
+                this->rotateY2Z(coord_ptr_1, coord1);
+                this->rotateY2Z(coord_ptr_2, coord2);
                 return intZFXF(coord_ptr_1, coord_ptr_2);
             }
         }
     case Z: // Z
         switch( basisDirs[panel1] ){
         case X:		// Zx
-            this->rotateZ2Z(coord_ptr_1, panel1);
-            this->rotateZ2Z(coord_ptr_2, panel2);
+            this->rotateZ2Z(coord_ptr_1, coord1);
+            this->rotateZ2Z(coord_ptr_2, coord2);
             switch( dirs[panel2] ){
             case X: // Zx_X
                 switch( basisDirs[panel2] ){
@@ -1506,8 +3121,8 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
                 }
             }
         case Y:		// Zy
-            this->mirrorY2X(coord_ptr_1, panel1);
-            this->mirrorY2X(coord_ptr_2, panel2);
+            this->mirrorY2X(coord_ptr_1, coord1);
+            this->mirrorY2X(coord_ptr_2, coord2);
             switch( dirs[panel2] ){
             case X: // Zy_X
                 switch( basisDirs[panel2] ){
@@ -1549,16 +3164,16 @@ float Caplet::calGalerkinPEntry(int panel1, int panel2){
         case FLAT:	// Zf_?f
             switch( dirs[panel2] ){
             case X:
-                this->rotateZ2Z(coord_ptr_1, panel1);
-                this->rotateZ2Z(coord_ptr_2, panel2);
+                this->rotateZ2Z(coord_ptr_1, coord1);
+                this->rotateZ2Z(coord_ptr_2, coord2);
                 return intZFXF(coord_ptr_1, coord_ptr_2);
             case Y:
-                this->mirrorY2X(coord_ptr_1, panel1);
-                this->mirrorY2X(coord_ptr_2, panel2);
+                this->mirrorY2X(coord_ptr_1, coord1);
+                this->mirrorY2X(coord_ptr_2, coord2);
                 return intZFXF(coord_ptr_1, coord_ptr_2);
             case Z:
-                this->rotateZ2Z(coord_ptr_1, panel1);
-                this->rotateZ2Z(coord_ptr_2, panel2);
+                this->rotateZ2Z(coord_ptr_1, coord1);
+                this->rotateZ2Z(coord_ptr_2, coord2);
                 return intZFZF(coord_ptr_1, coord_ptr_2);
             }
         }
@@ -0,0 +1,198 @@
+/*
+Created: Oct 19, 2026
+Author : Yu-Chung Hsiao
+Email  : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "caplet_cache.h"
+#include "caplet_parameter.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifdef CAPLET_OPENMP
+#include <omp.h>
+#endif
+
+namespace caplet{
+
+InteractionCache::InteractionCache(int nPanels)
+    :table(0), capacity(interactionCacheMinSize), isEnabled(1), shapeIds(0), origins(0)
+{
+    while ( capacity < interactionCacheMaxSize
+            && capacity < (long long)interactionCacheSizePerPanel*nPanels ){
+        capacity <<= 1;
+    }
+    //* Zeroed pages are only touched when they are used
+    table = static_cast<Entry*>( std::calloc(capacity, sizeof(Entry)) );
+
+    this->setNPanels(nPanels);
+}
+
+
+InteractionCache::~InteractionCache(){
+    std::free(table);
+    delete[] shapeIds;
+    delete[] origins;
+}
+
+
+void InteractionCache::setNPanels(int nPanels){
+    delete[] shapeIds;
+    delete[] origins;
+    shapeIds = new int[nPanels];
+    origins  = new int[nPanels][3];
+    for ( int i=0; i<nPanels; i++ ){
+        shapeIds[i] = -1;
+    }
+
+    //* Statistics and the hit-rate check restart for each structure
+    std::memset(counters, 0, sizeof(counters));
+    isEnabled = 1;
+}
+
+
+int InteractionCache::insertShape(const std::vector<int> &shape){
+    const int nShapes = shapeMap.size();
+    return shapeMap.insert( std::make_pair(shape, nShapes) ).first->second;
+}
+
+
+void InteractionCache::setPanel(int panel, int shapeId, const int origin[3]){
+    shapeIds[panel] = shapeId;
+    for ( int d=0; d<3; d++ ){
+        origins[panel][d] = origin[d];
+    }
+}
+
+
+int InteractionCache::getShapeId(int panel) const{
+    return shapeIds[panel];
+}
+
+
+const int* InteractionCache::getOrigin(int panel) const{
+    return origins[panel];
+}
+
+
+//* FNV-1a on the key words
+static inline unsigned int hashKey(const int key[InteractionCache::nKey]){
+    unsigned int h = 2166136261u;
+    for ( int i=0; i<InteractionCache::nKey; i++ ){
+        h = ( h ^ (unsigned int)key[i] ) * 16777619u;
+    }
+    return h ^ (h>>15);
+}
+
+
+bool InteractionCache::lookup(int panel1, int panel2, float &value, int &slot){
+    slot = -1;
+
+    #ifdef CAPLET_OPENMP
+    Counter &counter = counters[ omp_get_thread_num() & (nCounter-1) ];
+    #else
+    Counter &counter = counters[0];
+    #endif
+
+    //* Give up the cache on irregular structures, where a lookup costs
+    //  more than the entry itself
+    const long long nLookups = counter.nHits + counter.nMisses;
+    if ( nLookups>0 && (nLookups % interactionCacheCheckInterval)==0
+         && counter.nHits < interactionCacheMinHitRate*nLookups ){
+        __atomic_store_n(&isEnabled, 0, __ATOMIC_RELAXED);
+    }
+    if ( __atomic_load_n(&isEnabled, __ATOMIC_RELAXED)==0
+         || shapeIds[panel1]<0 || shapeIds[panel2]<0 ){
+        __atomic_fetch_add(&counter.nMisses, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    const int key[nKey] = {
+        shapeIds[panel1], shapeIds[panel2],
+        origins[panel2][0] - origins[panel1][0],
+        origins[panel2][1] - origins[panel1][1],
+        origins[panel2][2] - origins[panel1][2] };
+
+    const unsigned int mask = capacity-1;
+    unsigned int index = hashKey(key) & mask;
+
+    for ( int probe=0; probe<interactionCacheMaxProbe; probe++ ){
+        Entry &entry = table[index];
+        int state = __atomic_load_n(&entry.state, __ATOMIC_ACQUIRE);
+
+        if ( state==EMPTY ){
+            int expected = EMPTY;
+            if ( __atomic_compare_exchange_n(&entry.state, &expected, (int)WRITING,
+                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ){
+                //* The key is not read by others until the slot is READY
+                std::memcpy(entry.key, key, sizeof(entry.key));
+                slot = index;
+                break;
+            }
+            state = expected;
+        }
+        if ( state==READY && std::memcmp(entry.key, key, sizeof(entry.key))==0 ){
+            value = entry.value;
+            __atomic_fetch_add(&counter.nHits, 1, __ATOMIC_RELAXED);
+            return true;
+        }
+        //* Occupied by another key, or being written: keep probing
+        index = (index+1) & mask;
+    }
+
+    __atomic_fetch_add(&counter.nMisses, 1, __ATOMIC_RELAXED);
+    return false;
+}
+
+
+void InteractionCache::publish(int slot, float value){
+    table[slot].value = value;
+    __atomic_store_n(&table[slot].state, (int)READY, __ATOMIC_RELEASE);
+}
+
+
+bool InteractionCache::isActive() const{
+    return __atomic_load_n(&isEnabled, __ATOMIC_RELAXED)!=0;
+}
+
+
+long long InteractionCache::getNHits() const{
+    long long n = 0;
+    for ( int i=0; i<nCounter; i++ ){
+        n += counters[i].nHits;
+    }
+    return n;
+}
+
+
+long long InteractionCache::getNMisses() const{
+    long long n = 0;
+    for ( int i=0; i<nCounter; i++ ){
+        n += counters[i].nMisses;
+    }
+    return n;
+}
+
+
+int InteractionCache::getCapacity() const{
+    return capacity;
+}
+
+}
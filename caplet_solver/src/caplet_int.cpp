@@ -29,11 +29,13 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 #include "caplet_blas.h"
 #include "caplet_widgets.h"
 #include "caplet_gauss.h"
+#include "caplet_metrics.h"
 
 #include <cmath>
 #include <iostream>
 #include <cstdlib>
 #include <cassert>
+#include <algorithm>
 
 
 namespace caplet{
@@ -44,29 +46,38 @@ using std::sqrt;
 
 //* Integrals
 //- subroutine declaration
-float  int_xyxy(float* p1[nDim][nBit], float* p2[nDim][nBit]);
+template<class real>
+real  int_xyxy(real* p1[nDim][nBit], real* p2[nDim][nBit]);
 
-float  int_xyyz(float a, float b, float ly, float lz, float x, float y, float z);
-float  int_xyyz(float* p1[nDim][nBit], float* p2[nDim][nBit]);
-float  int_xyxy(float a, float b, float lx, float ly, float x, float y, float z);
-float  int_xyzx(float* p1[nDim][nBit], float* p2[nDim][nBit]);
+template<class real>
+real  int_xyyz(real a, real b, real ly, real lz, real x, real y, real z);
+template<class real>
+real  int_xyyz(real* p1[nDim][nBit], real* p2[nDim][nBit]);
+template<class real>
+real  int_xyxy(real a, real b, real lx, real ly, real x, real y, real z);
+template<class real>
+real  int_xyzx(real* p1[nDim][nBit], real* p2[nDim][nBit]);
 
-float  int_xyy(float a, float b, float ly, float x, float y, float z);
-float  int_xyz(float a, float b, float lz, float x, float y, float z);
+template<class real>
+real  int_xyy(real a, real b, real ly, real x, real y, real z);
+template<class real>
+real  int_xyz(real a, real b, real lz, real x, real y, real z);
 
-float  int_xy(float a, float b, float x, float y, float z, float area);
+template<class real>
+real  int_xy(real a, real b, real x, real y, real z, real area);
 
 
 
 //* Three internal guass quad
 //* 1. x-dir quad over int_xy
-inline float gauss_int_xy_x(int gauss_n, float a, float b, float x1, float x2, float y, float z, float (*shape)(float, float), float w, float bz){
+template<int gauss_n, class Shape, class real>
+inline real gauss_int_xy_x(real a, real b, real x1, real x2, real y, real z, const Shape &shape, real w, float bz){
     int gauss_n2 = (gauss_n+1)/2;
-    float pm = (x2+x1)/2;
-    float pr = (x2-x1)/2;
+    real pm = (x2+x1)/2;
+    real pr = (x2-x1)/2;
 
-    float  val=0;
-    float  p0 = (bz>0)? (x1) : (x2);
+    real  val=0;
+    real  p0 = (bz>0)? (x1) : (x2);
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
@@ -74,7 +85,7 @@ inline float gauss_int_xy_x(int gauss_n, float a, float b, float x1, float x2, f
         val += (*gauss::w[gauss_n])[0] * int_xy(a, b, abs(pm), y, z, a*b) * shape(abs(pm-p0), w);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
                 +int_xy(a, b, abs(pm-dp), y, z, a*b) * shape(abs(pm-dp-p0), w)
                 +int_xy(a, b, abs(pm+dp), y, z, a*b) * shape(abs(pm+dp-p0), w)
@@ -84,13 +95,14 @@ inline float gauss_int_xy_x(int gauss_n, float a, float b, float x1, float x2, f
 }
 
 //* 2. y-dir quad over int_xy
-inline float gauss_int_xy_y(int gauss_n, float a, float b, float x, float y1, float y2, float z, float (*shape)(float, float), float w, float bz){
+template<int gauss_n, class Shape, class real>
+inline real gauss_int_xy_y(real a, real b, real x, real y1, real y2, real z, const Shape &shape, real w, float bz){
     int gauss_n2 = (gauss_n+1)/2;
-    float pm = (y2+y1)/2;
-    float pr = (y2-y1)/2;
+    real pm = (y2+y1)/2;
+    real pr = (y2-y1)/2;
 
-    float  val=0;
-    float  p0 = (bz>0)? (y1) : (y2);
+    real  val=0;
+    real  p0 = (bz>0)? (y1) : (y2);
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
@@ -98,7 +110,7 @@ inline float gauss_int_xy_y(int gauss_n, float a, float b, float x, float y1, fl
         val += (*gauss::w[gauss_n])[0] * int_xy(a, b, x, abs(pm), z, a*b) * shape(abs(pm-p0), w);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
                 +int_xy(a, b, x, abs(pm-dp), z, a*b) * shape(abs(pm-dp-p0), w)
                 +int_xy(a, b, x, abs(pm+dp), z, a*b) * shape(abs(pm+dp-p0), w)
@@ -108,13 +120,14 @@ inline float gauss_int_xy_y(int gauss_n, float a, float b, float x, float y1, fl
 }
 
 //* 3. z-dir quad over int_xy
-inline float gauss_int_xy_z(int gauss_n, float a, float b, float x, float y, float z1, float z2, float (*shape)(float , float ), float w, float bz){
+template<int gauss_n, class Shape, class real>
+inline real gauss_int_xy_z(real a, real b, real x, real y, real z1, real z2, const Shape &shape, real w, float bz){
     int gauss_n2 = (gauss_n+1)/2;
-    float pm = (z2+z1)/2;
-    float pr = (z2-z1)/2;
+    real pm = (z2+z1)/2;
+    real pr = (z2-z1)/2;
 
-    float  val=0;
-    float  p0 = (bz>0)? (z1) : (z2);
+    real  val=0;
+    real  p0 = (bz>0)? (z1) : (z2);
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
@@ -122,7 +135,7 @@ inline float gauss_int_xy_z(int gauss_n, float a, float b, float x, float y, flo
         val += (*gauss::w[gauss_n])[0] * int_xy(a,b,x,y, abs(pm),a*b) * shape(abs(pm-p0), w);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
                 +int_xy(a,b,x,y, abs(pm+dp),a*b) * shape(abs(pm+dp-p0), w)
                 +int_xy(a,b,x,y, abs(pm-dp),a*b) * shape(abs(pm-dp-p0), w)
@@ -133,62 +146,208 @@ inline float gauss_int_xy_z(int gauss_n, float a, float b, float x, float y, flo
 
 
 
+//* Quadrature orders
+//  0 keeps gauss_n_* and quad_n_* of caplet_parameter.h
+static int  quadratureOrder      = 0;
+static bool quadratureIsAdaptive = false;
+
+void setQuadrature(int order, bool isAdaptive){
+    if ( order<0 || order>maxQuadratureOrder ){
+        std::cerr << "WARNING: quadrature order " << order << " is out of range [1,"
+                  << maxQuadratureOrder << "]; use caplet_parameter.h" << std::endl;
+        order = 0;
+    }
+    quadratureOrder      = order;
+    quadratureIsAdaptive = isAdaptive;
+}
+
+int getQuadratureOrder(){
+    return quadratureOrder;
+}
+
+bool isQuadratureAdaptive(){
+    return quadratureIsAdaptive;
+}
+
+//* Gap between two panels over the largest panel length
+template<class real>
+inline real gapRatio(real* coord1[3][4], real* coord2[3][4]){
+    real gap2 = 0;
+    real size = 0;
+    for ( int d=0; d<nDim; d++ ){
+        real dc = abs( (*coord1[d])[CENTER] - (*coord2[d])[CENTER] )
+                   - ( (*coord1[d])[LENGTH] + (*coord2[d])[LENGTH] )/2;
+        if ( dc>0 ){
+            gap2 += dc*dc;
+        }
+        size = std::max( size, std::max((*coord1[d])[LENGTH], (*coord2[d])[LENGTH]) );
+    }
+    return sqrt(gap2)/size;
+}
+
+//* Modeled relative error of an order-n rule at gap ratio r
+//  quadratureErrorScale * (1+r)^(-2n), see caplet_parameter.h
+template<class real>
+inline real quadratureError(real r, int n){
+    const real decay = 1/( (1+r)*(1+r) );
+    real error = quadratureErrorScale;
+    for ( int i=0; i<n; i++ ){
+        error *= decay;
+    }
+    return error;
+}
+
+//* Order of a panel pair
+//  - not adaptive: quadratureOrder (0 for the defaults of caplet_parameter.h)
+//  - adaptive: the lowest order below the near-field order (quadratureOrder,
+//    or nearOrder of the kernel if 0) whose modeled error is below
+//    quadratureTolerance; otherwise the near-field order
+template<class real>
+inline int pairOrder(real* coord1[3][4], real* coord2[3][4], int nearOrder){
+    if ( quadratureIsAdaptive==false ){
+        return quadratureOrder;
+    }
+    if ( quadratureOrder>0 ){
+        nearOrder = quadratureOrder;
+    }
+    const real r = gapRatio(coord1, coord2);
+    for ( int n=1; n<nearOrder; n++ ){
+        if ( quadratureError(r, n)<quadratureTolerance ){
+            return n;
+        }
+    }
+    return quadratureOrder;
+}
+
+//* Whether the order of a panel pair (quadratureOrder, or nearOrder of the
+//  kernel if 0) misses quadratureTolerance
+template<class real>
+inline bool isNearField(real* coord1[3][4], real* coord2[3][4], int nearOrder){
+    if ( quadratureOrder>0 ){
+        nearOrder = quadratureOrder;
+    }
+    return quadratureError(gapRatio(coord1, coord2), nearOrder)>=quadratureTolerance;
+}
+
+//* Return KERNEL<n> ARGS (CAPLET_ORDER_SWITCH2: KERNEL<n,n> ARGS) with the
+//  order n of the pair, or DEFAULT_CALL with the orders of caplet_parameter.h.
+//  Each order is a separate instantiation with fully unrolled loops.
+#define CAPLET_ORDER_SWITCH(order, KERNEL, ARGS, DEFAULT_CALL) \
+    switch ( order ){ \
+    case 1: return KERNEL<1> ARGS; \
+    case 2: return KERNEL<2> ARGS; \
+    case 3: return KERNEL<3> ARGS; \
+    case 4: return KERNEL<4> ARGS; \
+    case 5: return KERNEL<5> ARGS; \
+    case 6: return KERNEL<6> ARGS; \
+    default: return DEFAULT_CALL; \
+    }
+
+#define CAPLET_ORDER_SWITCH2(order, KERNEL, ARGS, DEFAULT_CALL) \
+    switch ( order ){ \
+    case 1: return KERNEL<1,1> ARGS; \
+    case 2: return KERNEL<2,2> ARGS; \
+    case 3: return KERNEL<3,3> ARGS; \
+    case 4: return KERNEL<4,4> ARGS; \
+    case 5: return KERNEL<5,5> ARGS; \
+    case 6: return KERNEL<6,6> ARGS; \
+    default: return DEFAULT_CALL; \
+    }
+
+
+//* Shape functors
+//  Kernels are templated on the shape so that arch and side are inlined
+//  at every quadrature point; ShapeFunction calls any other shape_t.
+struct ArchShape{
+    float operator()(float x, float w) const { return arch(x, w); }
+};
+
+struct SideShape{
+    float operator()(float x, float w) const { return side(x, w); }
+};
+
+struct ShapeFunction{
+    shape_t shape;
+    explicit ShapeFunction(shape_t shape): shape(shape) {}
+    float operator()(float x, float w) const { return shape(x, w); }
+};
+
+//* Return KERNEL(functor, ...) for the shape_t shape
+//  (CAPLET_SHAPE_SWITCH2: KERNEL(functor1, functor2, ...)).
+//  The shape is dispatched once per kernel call, not per quadrature point.
+#define CAPLET_SHAPE_SWITCH(shape, KERNEL, ...) \
+    if ( (shape)==&arch ) return KERNEL(ArchShape(), __VA_ARGS__); \
+    if ( (shape)==&side ) return KERNEL(SideShape(), __VA_ARGS__); \
+    return KERNEL(ShapeFunction(shape), __VA_ARGS__);
+
+#define CAPLET_SHAPE_SWITCH_2ND(SHAPE1, shape2, KERNEL, ...) \
+    if ( (shape2)==&arch ) return KERNEL(SHAPE1, ArchShape(), __VA_ARGS__); \
+    if ( (shape2)==&side ) return KERNEL(SHAPE1, SideShape(), __VA_ARGS__); \
+    return KERNEL(SHAPE1, ShapeFunction(shape2), __VA_ARGS__);
+
+#define CAPLET_SHAPE_SWITCH2(shape1, shape2, KERNEL, ...) \
+    if ( (shape1)==&arch ){ \
+        CAPLET_SHAPE_SWITCH_2ND(ArchShape(), shape2, KERNEL, __VA_ARGS__) \
+    } \
+    if ( (shape1)==&side ){ \
+        CAPLET_SHAPE_SWITCH_2ND(SideShape(), shape2, KERNEL, __VA_ARGS__) \
+    } \
+    CAPLET_SHAPE_SWITCH_2ND(ShapeFunction(shape1), shape2, KERNEL, __VA_ARGS__)
+
+
 //* Flat-Flat integrals
 //  - integral 1
-float intZFZF(float* coord1[3][4], float* coord2[3][4]){
+template<class real>
+real intZFZF(real* coord1[3][4], real* coord2[3][4]){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZFZF);
     return int_xyxy( coord1, coord2 );
 }
 
 
 //* - integral 2
-float intZFXF(float* coord1[3][4], float* coord2[3][4]){
+template<class real>
+real intZFXF(real* coord1[3][4], real* coord2[3][4]){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZFXF);
     return int_xyyz( coord1, coord2 );
 }
 
 
 //* Linear-Flat integrals
 //* - integral 3
-float intZXZF(
-        float* coord1[3][4], float bz, float bsh, float (*shape)(float, float),
-        float* coord2[3][4]
+template<int gauss_n, class Shape, class real>
+static real intZXZF_n(
+        real* coord1[3][4], float bz, float bsh, const Shape &shape,
+        real* coord2[3][4]
 ){
-    //****
-    if (switch_analytical_intZXZF == true){
-        return int_xyxy( coord1, coord2 );
-    }
-    //****
-
-    float a  = (*coord2[X])[LENGTH];
-    float b  = (*coord2[Y])[LENGTH];
-    float ly = (*coord1[Y])[LENGTH];
-    float w  = ly;
+    real a  = (*coord2[X])[LENGTH];
+    real b  = (*coord2[Y])[LENGTH];
+    real ly = (*coord1[Y])[LENGTH];
+    real w  = ly;
 
     if ( b<ly ){
-        float temp = b; b=ly; ly=temp;
+        real temp = b; b=ly; ly=temp;
     }
-    float y = abs( (*coord2[Y])[CENTER] - (*coord1[Y])[CENTER] );
-    float z = abs( (*coord2[Z])[CENTER] - (*coord1[Z])[CENTER] );
+    real y = abs( (*coord2[Y])[CENTER] - (*coord1[Y])[CENTER] );
+    real z = abs( (*coord2[Z])[CENTER] - (*coord1[Z])[CENTER] );
 
-    float x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
-    float x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+    real x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
+    real x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
 
 
     //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n = gauss_n_ZXZF;
-
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (x2+x1)/2;
-    const float pr = (x2-x1)/2;
-    const float  p0 = (bz>0)? (x1) : (x2);
+    const real pm = (x2+x1)/2;
+    const real pr = (x2-x1)/2;
+    const real  p0 = (bz>0)? (x1) : (x2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
     if ( (gauss_n%2)==1 ){ // odd n
         init_i = 1;
         val += (*gauss::w[gauss_n])[0] * int_xyy(a,b,ly,abs(pm),y,z) * shape(abs(pm-p0), w);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
                 +int_xyy(a,b,ly,abs(pm+dp),y,z) * shape(abs(pm+dp-p0), w)
                 +int_xyy(a,b,ly,abs(pm-dp),y,z) * shape(abs(pm-dp-p0), w)
@@ -198,42 +357,70 @@ float intZXZF(
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape, class real>
+static real intZXZF_s(
+        const Shape &shape, int order,
+        real* coord1[3][4], float bz, float bsh,
+        real* coord2[3][4]
+){
+    CAPLET_ORDER_SWITCH( order, intZXZF_n,
+            (coord1, bz, bsh, shape, coord2),
+            intZXZF_n<gauss_n_ZXZF>(coord1, bz, bsh, shape, coord2) );
+}
 
-//* - integral 4
-float intZXXF(
-        float* coord1[3][4], float bz, float bsh, float (*shape)(float, float),
-        float* coord2[3][4]
+template<class real>
+real intZXZF(
+        real* coord1[3][4], float bz, float bsh, float (*shape)(float, float),
+        real* coord2[3][4]
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXZF);
     //****
-    if (switch_analytical_intZXXF == true){
-        return int_xyyz( coord1, coord2 );
+    if (switch_analytical_intZXZF == true){
+        return int_xyxy( coord1, coord2 );
     }
     //****
 
-    float a = (*coord2[Z])[LENGTH];
-    float b = (*coord2[Y])[LENGTH];
-    float ly = (*coord1[Y])[LENGTH];
-    float w  = ly;
+    //* Constant shape: exact flat-flat integral scaled by the shape value
+    //  where the quadrature misses quadratureTolerance
+    const real c = constantShape(shape);
+    if ( switch_analytical_constant_shape && c>=0
+         && isNearField(coord1, coord2, gauss_n_ZXZF) ){
+        return c * int_xyxy( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, gauss_n_ZXZF);
+    CAPLET_SHAPE_SWITCH( shape, intZXZF_s, order, coord1, bz, bsh, coord2 );
+}
+
+
+//* - integral 4
+template<int gauss_n, class Shape, class real>
+static real intZXXF_n(
+        real* coord1[3][4], float bz, float bsh, const Shape &shape,
+        real* coord2[3][4]
+){
+    real a = (*coord2[Z])[LENGTH];
+    real b = (*coord2[Y])[LENGTH];
+    real ly = (*coord1[Y])[LENGTH];
+    real w  = ly;
 
     if ( b<ly ){
-        float temp = b; b = ly; ly = temp;
+        real temp = b; b = ly; ly = temp;
     }
-    float x = abs( (*coord2[Z])[CENTER] - (*coord1[Z])[CENTER] );
-    float y = abs( (*coord2[Y])[CENTER] - (*coord1[Y])[CENTER] );
+    real x = abs( (*coord2[Z])[CENTER] - (*coord1[Z])[CENTER] );
+    real y = abs( (*coord2[Y])[CENTER] - (*coord1[Y])[CENTER] );
 
-    float x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
-    float x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+    real x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
+    real x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
 
 
     //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n = gauss_n_ZXXF;
-
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (x2+x1)/2;
-    const float pr = (x2-x1)/2;
-    const float  p0 = (bz>0)? (x1) : (x2);
+    const real pm = (x2+x1)/2;
+    const real pr = (x2-x1)/2;
+    const real  p0 = (bz>0)? (x1) : (x2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
@@ -241,7 +428,7 @@ float intZXXF(
         val += (*gauss::w[gauss_n])[0] * int_xyy(a,b,ly,x,y,abs(pm)) * shape(abs(pm-p0), w);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
                 +int_xyy(a,b,ly,x,y, abs(pm+dp)) * shape(abs(pm+dp-p0), w)
                 +int_xyy(a,b,ly,x,y, abs(pm-dp)) * shape(abs(pm-dp-p0), w)
@@ -251,39 +438,67 @@ float intZXXF(
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape, class real>
+static real intZXXF_s(
+        const Shape &shape, int order,
+        real* coord1[3][4], float bz, float bsh,
+        real* coord2[3][4]
+){
+    CAPLET_ORDER_SWITCH( order, intZXXF_n,
+            (coord1, bz, bsh, shape, coord2),
+            intZXXF_n<gauss_n_ZXXF>(coord1, bz, bsh, shape, coord2) );
+}
 
-//* - integral 5
-float intZXYF(
-        float* coord1[3][4], float bz, float bsh, float (*shape)(float, float),
-        float* coord2[3][4]
+template<class real>
+real intZXXF(
+        real* coord1[3][4], float bz, float bsh, float (*shape)(float, float),
+        real* coord2[3][4]
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXXF);
     //****
-    if (switch_analytical_intZXYF == true){
-        return int_xyzx( coord1, coord2 );
+    if (switch_analytical_intZXXF == true){
+        return int_xyyz( coord1, coord2 );
     }
     //****
 
-    float a = (*coord2[Z])[LENGTH];
-    float b = (*coord2[X])[LENGTH];
-    float lz= (*coord1[Y])[LENGTH]; // length in rotated z
+    //* Constant shape: exact flat-flat integral scaled by the shape value
+    //  where the quadrature misses quadratureTolerance
+    const real c = constantShape(shape);
+    if ( switch_analytical_constant_shape && c>=0
+         && isNearField(coord1, coord2, gauss_n_ZXXF) ){
+        return c * int_xyyz( coord1, coord2 );
+    }
 
-    float w = lz;
+    const int order = pairOrder(coord1, coord2, gauss_n_ZXXF);
+    CAPLET_SHAPE_SWITCH( shape, intZXXF_s, order, coord1, bz, bsh, coord2 );
+}
 
-    float x = abs((*coord2[Z])[CENTER] - (*coord1[Z])[CENTER]);
-    float z = abs((*coord2[Y])[CENTER] - (*coord1[Y])[CENTER]);
 
-    float y1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
-    float y2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+//* - integral 5
+template<int gauss_n, class Shape, class real>
+static real intZXYF_n(
+        real* coord1[3][4], float bz, float bsh, const Shape &shape,
+        real* coord2[3][4]
+){
+    real a = (*coord2[Z])[LENGTH];
+    real b = (*coord2[X])[LENGTH];
+    real lz= (*coord1[Y])[LENGTH]; // length in rotated z
 
-    //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n = gauss_n_ZXYF;
+    real w = lz;
 
+    real x = abs((*coord2[Z])[CENTER] - (*coord1[Z])[CENTER]);
+    real z = abs((*coord2[Y])[CENTER] - (*coord1[Y])[CENTER]);
+
+    real y1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
+    real y2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+
+    //BEGIN____________________________gauss quad_______________________________
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (y2+y1)/2;
-    const float pr = (y2-y1)/2;
-    const float p0 = (bz>0)? (y1) : (y2);
+    const real pm = (y2+y1)/2;
+    const real pr = (y2-y1)/2;
+    const real p0 = (bz>0)? (y1) : (y2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
@@ -291,7 +506,7 @@ float intZXYF(
         val += (*gauss::w[gauss_n])[0] * int_xyz(a,b,lz,x,abs(pm),z) * shape(abs(pm-p0), w);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
                 +int_xyz(a,b,lz,x,abs(pm+dp),z) * shape(abs(pm+dp-p0), w)
                 +int_xyz(a,b,lz,x,abs(pm-dp),z) * shape(abs(pm-dp-p0), w)
@@ -301,44 +516,71 @@ float intZXYF(
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape, class real>
+static real intZXYF_s(
+        const Shape &shape, int order,
+        real* coord1[3][4], float bz, float bsh,
+        real* coord2[3][4]
+){
+    CAPLET_ORDER_SWITCH( order, intZXYF_n,
+            (coord1, bz, bsh, shape, coord2),
+            intZXYF_n<gauss_n_ZXYF>(coord1, bz, bsh, shape, coord2) );
+}
 
-//* Linear-Linear integrals
-//* - integral 6
-float intZXZX(
-        float* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+template<class real>
+real intZXYF(
+        real* coord1[3][4], float bz, float bsh, float (*shape)(float, float),
+        real* coord2[3][4]
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXYF);
     //****
-    if (switch_analytical_intZXZX == true){
-        return int_xyxy( coord1, coord2 );
+    if (switch_analytical_intZXYF == true){
+        return int_xyzx( coord1, coord2 );
     }
     //****
 
-    float w1 = (*coord1[Y])[LENGTH];
-    float w2 = (*coord2[Y])[LENGTH];
+    //* Constant shape: exact flat-flat integral scaled by the shape value
+    //  where the quadrature misses quadratureTolerance
+    const real c = constantShape(shape);
+    if ( switch_analytical_constant_shape && c>=0
+         && isNearField(coord1, coord2, gauss_n_ZXYF) ){
+        return c * int_xyzx( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, gauss_n_ZXYF);
+    CAPLET_SHAPE_SWITCH( shape, intZXYF_s, order, coord1, bz, bsh, coord2 );
+}
 
-    int quad_n1 = quad_n_ZXZX_1;
-    int quad_n2 = quad_n_ZXZX_2;
 
-    float a1 = (*coord1[X])[LENGTH] / quad_n1;
-    float a2 = (*coord2[X])[LENGTH] / quad_n2;
+//* Linear-Linear integrals
+//* - integral 6
+template<int quad_n1, int quad_n2, class Shape1, class Shape2, class real>
+static real intZXZX_n(
+        real* coord1[3][4], float bz1, float bsh1, const Shape1 &shape1,
+        real* coord2[3][4], float bz2, float bsh2, const Shape2 &shape2
+){
+    real w1 = (*coord1[Y])[LENGTH];
+    real w2 = (*coord2[Y])[LENGTH];
 
-    float val = 0;
+    real a1 = (*coord1[X])[LENGTH] / quad_n1;
+    real a2 = (*coord2[X])[LENGTH] / quad_n2;
 
-    float z = abs( (*coord1[Z])[CENTER] - (*coord2[Z])[CENTER] );
-    float y = abs( (*coord1[Y])[CENTER] - (*coord2[Y])[CENTER] );
+    real val = 0;
 
-    float x10 = (bz1>0)? ( (*coord1[X])[0] ) : ( (*coord1[X])[1] );
-    float x20 = (bz2>0)? ( (*coord2[X])[0] ) : ( (*coord2[X])[1] );
+    real z = abs( (*coord1[Z])[CENTER] - (*coord2[Z])[CENTER] );
+    real y = abs( (*coord1[Y])[CENTER] - (*coord2[Y])[CENTER] );
 
-    float x2 = (*coord2[X])[0] - a2/2;
-    for ( int i=0; i<quad_n1; i++ ){
+    real x10 = (bz1>0)? ( (*coord1[X])[0] ) : ( (*coord1[X])[1] );
+    real x20 = (bz2>0)? ( (*coord2[X])[0] ) : ( (*coord2[X])[1] );
+
+    real x2 = (*coord2[X])[0] - a2/2;
+    for ( int i=0; i<quad_n2; i++ ){
         x2 += a2;
-        float temp = 0;
-        float x1 = (*coord1[X])[0] - a1/2;
-        for ( int j=0; j<quad_n2; j++ ){
+        real temp = 0;
+        real x1 = (*coord1[X])[0] - a1/2;
+        for ( int j=0; j<quad_n1; j++ ){
             x1 += a1;
-            float x = abs( x1-x2 );
+            real x = abs( x1-x2 );
             temp += int_xyxy(a1,w1,a2,w2,x,y,z)*shape1( abs(x1-x10), w1 );
         }
         val += temp*shape2( abs(x2-x20), w2 );
@@ -346,157 +588,244 @@ float intZXZX(
     return val;
 }
 
+template<class Shape1, class Shape2, class real>
+static real intZXZX_s(
+        const Shape1 &shape1, const Shape2 &shape2, int order,
+        real* coord1[3][4], float bz1, float bsh1,
+        real* coord2[3][4], float bz2, float bsh2
+){
+    CAPLET_ORDER_SWITCH2( order, intZXZX_n,
+            (coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2),
+            (intZXZX_n<quad_n_ZXZX_1, quad_n_ZXZX_2>(coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2)) );
+}
 
-//* - integral 7
-float intZXYX(
-        float* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+template<class real>
+real intZXZX(
+        real* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXZX);
     //****
-    if (switch_analytical_intZXYX == true){
-        return int_xyzx( coord1, coord2 );
+    if (switch_analytical_intZXZX == true){
+        return int_xyxy( coord1, coord2 );
     }
     //****
 
-    float a = (*coord1[Y])[LENGTH];
-    float b = (*coord2[Z])[LENGTH];
-    float w1 = a;
-    float w2 = b;
+    //* Constant shapes: exact flat-flat integral scaled by the shape values
+    //  where the quadrature misses quadratureTolerance
+    const real c1 = constantShape(shape1);
+    const real c2 = constantShape(shape2);
+    if ( switch_analytical_constant_shape && c1>=0 && c2>=0
+         && isNearField(coord1, coord2, std::max(quad_n_ZXZX_1, quad_n_ZXZX_2)) ){
+        return c1 * c2 * int_xyxy( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, std::max(quad_n_ZXZX_1, quad_n_ZXZX_2));
+    CAPLET_SHAPE_SWITCH2( shape1, shape2, intZXZX_s, order,
+            coord1, bz1, bsh1, coord2, bz2, bsh2 );
+}
+
+
+//* - integral 7
+template<int gauss_n_inner, int gauss_n, class Shape1, class Shape2, class real>
+static real intZXYX_n(
+        real* coord1[3][4], float bz1, float bsh1, const Shape1 &shape1,
+        real* coord2[3][4], float bz2, float bsh2, const Shape2 &shape2
+){
+    real a = (*coord1[Y])[LENGTH];
+    real b = (*coord2[Z])[LENGTH];
+    real w1 = a;
+    real w2 = b;
 
-    float x = abs((*coord2[Y])[CENTER]-(*coord1[Y])[CENTER]);
-    float y = abs((*coord2[Z])[CENTER]-(*coord1[Z])[CENTER]);
+    real x = abs((*coord2[Y])[CENTER]-(*coord1[Y])[CENTER]);
+    real y = abs((*coord2[Z])[CENTER]-(*coord1[Z])[CENTER]);
 
 
     // output integration limits
-    float zp1 = (*coord1[X])[0];
-    float zp2 = (*coord1[X])[1];
+    real zp1 = (*coord1[X])[0];
+    real zp2 = (*coord1[X])[1];
 
     // inner integration limits
-    float z1 = (*coord2[X])[0];
-    float z2 = (*coord2[X])[1];
+    real z1 = (*coord2[X])[0];
+    real z2 = (*coord2[X])[1];
 
 
     //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n_inner = gauss_n_ZXYX_1;
-    const int gauss_n = gauss_n_ZXYX_2;
-
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (zp2+zp1)/2;
-    const float pr = (zp2-zp1)/2;
-    const float  p0 = (bz1>0)? (zp1) : (zp2);
+    const real pm = (zp2+zp1)/2;
+    const real pr = (zp2-zp1)/2;
+    const real  p0 = (bz1>0)? (zp1) : (zp2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
         init_i = 1;
-        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_z(gauss_n_inner, a,b,x,y, z1-pm, z2-pm, shape2, w2, bz2) * shape1(abs(pm-p0), w1);
+        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_z<gauss_n_inner>(a,b,x,y, z1-pm, z2-pm, shape2, w2, bz2) * shape1(abs(pm-p0), w1);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
-                +gauss_int_xy_z(gauss_n_inner, a,b,x,y, z1-pm-dp, z2-pm-dp, shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
-                +gauss_int_xy_z(gauss_n_inner, a,b,x,y, z1-pm+dp, z2-pm+dp, shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
+                +gauss_int_xy_z<gauss_n_inner>(a,b,x,y, z1-pm-dp, z2-pm-dp, shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
+                +gauss_int_xy_z<gauss_n_inner>(a,b,x,y, z1-pm+dp, z2-pm+dp, shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
                 );
     }
     return val * pr;
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape1, class Shape2, class real>
+static real intZXYX_s(
+        const Shape1 &shape1, const Shape2 &shape2, int order,
+        real* coord1[3][4], float bz1, float bsh1,
+        real* coord2[3][4], float bz2, float bsh2
+){
+    CAPLET_ORDER_SWITCH2( order, intZXYX_n,
+            (coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2),
+            (intZXYX_n<gauss_n_ZXYX_1, gauss_n_ZXYX_2>(coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2)) );
+}
 
-//* - integral 8
-float intZXZY(
-        float* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+template<class real>
+real intZXYX(
+        real* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXYX);
     //****
-    if (switch_analytical_intZXZY == true){
-        return int_xyxy( coord1, coord2 );
+    if (switch_analytical_intZXYX == true){
+        return int_xyzx( coord1, coord2 );
     }
     //****
 
-    float a = (*coord2[X])[LENGTH];
-    float b = (*coord1[Y])[LENGTH];
-    float w1 = b;
-    float w2 = a;
+    //* Constant shapes: exact flat-flat integral scaled by the shape values
+    //  where the quadrature misses quadratureTolerance
+    const real c1 = constantShape(shape1);
+    const real c2 = constantShape(shape2);
+    if ( switch_analytical_constant_shape && c1>=0 && c2>=0
+         && isNearField(coord1, coord2, std::max(gauss_n_ZXYX_1, gauss_n_ZXYX_2)) ){
+        return c1 * c2 * int_xyzx( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, std::max(gauss_n_ZXYX_1, gauss_n_ZXYX_2));
+    CAPLET_SHAPE_SWITCH2( shape1, shape2, intZXYX_s, order,
+            coord1, bz1, bsh1, coord2, bz2, bsh2 );
+}
 
-    float z = abs((*coord2[Z])[CENTER] - (*coord1[Z])[CENTER]);
+
+//* - integral 8
+template<int gauss_n_inner, int gauss_n, class Shape1, class Shape2, class real>
+static real intZXZY_n(
+        real* coord1[3][4], float bz1, float bsh1, const Shape1 &shape1,
+        real* coord2[3][4], float bz2, float bsh2, const Shape2 &shape2
+){
+    real a = (*coord2[X])[LENGTH];
+    real b = (*coord1[Y])[LENGTH];
+    real w1 = b;
+    real w2 = a;
+
+    real z = abs((*coord2[Z])[CENTER] - (*coord1[Z])[CENTER]);
 
     // outer integration limits
-    float x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
-    float x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+    real x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
+    real x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
 
 
     // inner integration limits
-    float y1 = (*coord2[Y])[0] - (*coord1[Y])[CENTER];
-    float y2 = (*coord2[Y])[1] - (*coord1[Y])[CENTER];
+    real y1 = (*coord2[Y])[0] - (*coord1[Y])[CENTER];
+    real y2 = (*coord2[Y])[1] - (*coord1[Y])[CENTER];
 
 
     //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n_inner = gauss_n_ZXZY_1;
-    const int gauss_n = gauss_n_ZXZY_2;
-
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (x2+x1)/2;
-    const float pr = (x2-x1)/2;
-    const float  p0 = (bz1>0)? (x1) : (x2);
+    const real pm = (x2+x1)/2;
+    const real pr = (x2-x1)/2;
+    const real  p0 = (bz1>0)? (x1) : (x2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
         init_i = 1;
-        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_y(gauss_n_inner, a,b, abs(pm), y1, y2, z, shape2, w2, bz2) * shape1(abs(pm-p0), w1);
+        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_y<gauss_n_inner>(a,b, abs(pm), y1, y2, z, shape2, w2, bz2) * shape1(abs(pm-p0), w1);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
-                +gauss_int_xy_y(gauss_n_inner, a,b, abs(pm-dp), y1, y2, z, shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
-                +gauss_int_xy_y(gauss_n_inner, a,b, abs(pm+dp), y1, y2, z, shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
+                +gauss_int_xy_y<gauss_n_inner>(a,b, abs(pm-dp), y1, y2, z, shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
+                +gauss_int_xy_y<gauss_n_inner>(a,b, abs(pm+dp), y1, y2, z, shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
                 );
     }
     return val * pr;
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape1, class Shape2, class real>
+static real intZXZY_s(
+        const Shape1 &shape1, const Shape2 &shape2, int order,
+        real* coord1[3][4], float bz1, float bsh1,
+        real* coord2[3][4], float bz2, float bsh2
+){
+    CAPLET_ORDER_SWITCH2( order, intZXZY_n,
+            (coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2),
+            (intZXZY_n<gauss_n_ZXZY_1, gauss_n_ZXZY_2>(coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2)) );
+}
 
-//* - integral 9
-float intZXXZ(
-        float* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+template<class real>
+real intZXZY(
+        real* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXZY);
     //****
-    if (switch_analytical_intZXXZ == true){
-        return int_xyyz( coord1, coord2 );
+    if (switch_analytical_intZXZY == true){
+        return int_xyxy( coord1, coord2 );
     }
     //****
 
-    float w1 = (*coord1[Y])[LENGTH];
-    float w2 = (*coord2[Y])[LENGTH];
+    //* Constant shapes: exact flat-flat integral scaled by the shape values
+    //  where the quadrature misses quadratureTolerance
+    const real c1 = constantShape(shape1);
+    const real c2 = constantShape(shape2);
+    if ( switch_analytical_constant_shape && c1>=0 && c2>=0
+         && isNearField(coord1, coord2, std::max(gauss_n_ZXZY_1, gauss_n_ZXZY_2)) ){
+        return c1 * c2 * int_xyxy( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, std::max(gauss_n_ZXZY_1, gauss_n_ZXZY_2));
+    CAPLET_SHAPE_SWITCH2( shape1, shape2, intZXZY_s, order,
+            coord1, bz1, bsh1, coord2, bz2, bsh2 );
+}
+
 
-    int quad_n1 = quad_n_ZXXZ_1;
-    int quad_n2 = quad_n_ZXXZ_2;
+//* - integral 9
+template<int quad_n1, int quad_n2, class Shape1, class Shape2, class real>
+static real intZXXZ_n(
+        real* coord1[3][4], float bz1, float bsh1, const Shape1 &shape1,
+        real* coord2[3][4], float bz2, float bsh2, const Shape2 &shape2
+){
+    real w1 = (*coord1[Y])[LENGTH];
+    real w2 = (*coord2[Y])[LENGTH];
 
-    float a1 = (*coord1[X])[LENGTH] / quad_n1;
-    float lz = (*coord2[Z])[LENGTH] / quad_n2;
+    real a1 = (*coord1[X])[LENGTH] / quad_n1;
+    real lz = (*coord2[Z])[LENGTH] / quad_n2;
 
-    float y = abs( (*coord1[Y])[CENTER] - (*coord2[Y])[CENTER] );
-    float x2 = (*coord2[X])[CENTER];
-    float z1 = (*coord1[Z])[CENTER];
+    real y = abs( (*coord1[Y])[CENTER] - (*coord2[Y])[CENTER] );
+    real x2 = (*coord2[X])[CENTER];
+    real z1 = (*coord1[Z])[CENTER];
 
-    float x0 = (bz1>0)? ( (*coord1[X])[0] ) : ( (*coord1[X])[1] );
-    float z0 = (bz2>0)? ( (*coord2[Z])[0] ) : ( (*coord2[Z])[1] );
+    real x0 = (bz1>0)? ( (*coord1[X])[0] ) : ( (*coord1[X])[1] );
+    real z0 = (bz2>0)? ( (*coord2[Z])[0] ) : ( (*coord2[Z])[1] );
 
-    float val = 0;
-    float z2 = (*coord2[Z])[0] - lz/2;
+    real val = 0;
+    real z2 = (*coord2[Z])[0] - lz/2;
     for ( int i=0; i<quad_n2; i++ ){
         z2 += lz;
-        float temp = 0;
-        float x1 = (*coord1[X])[0] - a1/2;
+        real temp = 0;
+        real x1 = (*coord1[X])[0] - a1/2;
         for ( int j=0; j<quad_n1; j++ ){
             x1 += a1;
-            float x = abs( x1 - x2 );
-            float z = abs( z2 - z1 );
+            real x = abs( x1 - x2 );
+            real z = abs( z2 - z1 );
             temp += int_xyyz(a1,w1,w2,lz,x,y,z)*shape1( abs(x1-x0), w1 );
         }
         val += temp*shape2( abs(z2-z0), w2 );
@@ -504,114 +833,209 @@ float intZXXZ(
     return val;
 }
 
+template<class Shape1, class Shape2, class real>
+static real intZXXZ_s(
+        const Shape1 &shape1, const Shape2 &shape2, int order,
+        real* coord1[3][4], float bz1, float bsh1,
+        real* coord2[3][4], float bz2, float bsh2
+){
+    CAPLET_ORDER_SWITCH2( order, intZXXZ_n,
+            (coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2),
+            (intZXXZ_n<quad_n_ZXXZ_1, quad_n_ZXXZ_2>(coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2)) );
+}
 
-//* - integral 10
-float intZXYZ(
-        float* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+template<class real>
+real intZXXZ(
+        real* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXXZ);
     //****
-    if (switch_analytical_intZXYZ == true){
-        return int_xyzx( coord1, coord2 );
+    if (switch_analytical_intZXXZ == true){
+        return int_xyyz( coord1, coord2 );
     }
     //****
 
-    float a = (*coord2[X])[LENGTH];
-    float b = (*coord1[Y])[LENGTH];
-    float w1 = b;
-    float w2 = a;
+    //* Constant shapes: exact flat-flat integral scaled by the shape values
+    //  where the quadrature misses quadratureTolerance
+    const real c1 = constantShape(shape1);
+    const real c2 = constantShape(shape2);
+    if ( switch_analytical_constant_shape && c1>=0 && c2>=0
+         && isNearField(coord1, coord2, std::max(quad_n_ZXXZ_1, quad_n_ZXXZ_2)) ){
+        return c1 * c2 * int_xyyz( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, std::max(quad_n_ZXXZ_1, quad_n_ZXXZ_2));
+    CAPLET_SHAPE_SWITCH2( shape1, shape2, intZXXZ_s, order,
+            coord1, bz1, bsh1, coord2, bz2, bsh2 );
+}
 
-    float y = abs((*coord2[Y])[CENTER] - (*coord1[Y])[CENTER]);
+
+//* - integral 10
+template<int gauss_n_inner, int gauss_n, class Shape1, class Shape2, class real>
+static real intZXYZ_n(
+        real* coord1[3][4], float bz1, float bsh1, const Shape1 &shape1,
+        real* coord2[3][4], float bz2, float bsh2, const Shape2 &shape2
+){
+    real a = (*coord2[X])[LENGTH];
+    real b = (*coord1[Y])[LENGTH];
+    real w1 = b;
+    real w2 = a;
+
+    real y = abs((*coord2[Y])[CENTER] - (*coord1[Y])[CENTER]);
 
     // outer integration limits
-    float x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
-    float x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+    real x1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
+    real x2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
 
     // inner integration limits
-    float z1 = (*coord2[Z])[0] - (*coord1[Z])[CENTER];
-    float z2 = (*coord2[Z])[1] - (*coord1[Z])[CENTER];
+    real z1 = (*coord2[Z])[0] - (*coord1[Z])[CENTER];
+    real z2 = (*coord2[Z])[1] - (*coord1[Z])[CENTER];
 
     //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n_inner = gauss_n_ZXYZ_1;
-    const int gauss_n = gauss_n_ZXYZ_2;
-
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (x2+x1)/2;
-    const float pr = (x2-x1)/2;
-    const float  p0 = (bz1>0)? (x1) : (x2);
+    const real pm = (x2+x1)/2;
+    const real pr = (x2-x1)/2;
+    const real  p0 = (bz1>0)? (x1) : (x2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
         init_i = 1;
-        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_z(gauss_n_inner, a,b, abs(pm) ,y, z1, z2, shape2, w2, bz2) * shape1(abs(pm-p0), w1);
+        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_z<gauss_n_inner>(a,b, abs(pm) ,y, z1, z2, shape2, w2, bz2) * shape1(abs(pm-p0), w1);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
-                +gauss_int_xy_z(gauss_n_inner, a,b, abs(pm+dp) ,y, z1, z2, shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
-                +gauss_int_xy_z(gauss_n_inner, a,b, abs(pm-dp) ,y, z1, z2, shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
+                +gauss_int_xy_z<gauss_n_inner>(a,b, abs(pm+dp) ,y, z1, z2, shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
+                +gauss_int_xy_z<gauss_n_inner>(a,b, abs(pm-dp) ,y, z1, z2, shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
                 );
     }
     return val * pr;
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape1, class Shape2, class real>
+static real intZXYZ_s(
+        const Shape1 &shape1, const Shape2 &shape2, int order,
+        real* coord1[3][4], float bz1, float bsh1,
+        real* coord2[3][4], float bz2, float bsh2
+){
+    CAPLET_ORDER_SWITCH2( order, intZXYZ_n,
+            (coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2),
+            (intZXYZ_n<gauss_n_ZXYZ_1, gauss_n_ZXYZ_2>(coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2)) );
+}
 
-//* - integral 11
-float intZXXY(
-        float* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
-        float* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+template<class real>
+real intZXYZ(
+        real* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
 ){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXYZ);
     //****
-    if (switch_analytical_intZXXY == true){
-        return int_xyyz( coord1, coord2 );
+    if (switch_analytical_intZXYZ == true){
+        return int_xyzx( coord1, coord2 );
     }
     //****
 
-    float a = (*coord1[Y])[LENGTH];
-    float b = (*coord2[Z])[LENGTH];
-    float w1 = a;
-    float w2 = b;
+    //* Constant shapes: exact flat-flat integral scaled by the shape values
+    //  where the quadrature misses quadratureTolerance
+    const real c1 = constantShape(shape1);
+    const real c2 = constantShape(shape2);
+    if ( switch_analytical_constant_shape && c1>=0 && c2>=0
+         && isNearField(coord1, coord2, std::max(gauss_n_ZXYZ_1, gauss_n_ZXYZ_2)) ){
+        return c1 * c2 * int_xyzx( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, std::max(gauss_n_ZXYZ_1, gauss_n_ZXYZ_2));
+    CAPLET_SHAPE_SWITCH2( shape1, shape2, intZXYZ_s, order,
+            coord1, bz1, bsh1, coord2, bz2, bsh2 );
+}
 
-    float y = abs((*coord2[Z])[CENTER] - (*coord1[Z])[CENTER]);
+
+//* - integral 11
+template<int gauss_n_inner, int gauss_n, class Shape1, class Shape2, class real>
+static real intZXXY_n(
+        real* coord1[3][4], float bz1, float bsh1, const Shape1 &shape1,
+        real* coord2[3][4], float bz2, float bsh2, const Shape2 &shape2
+){
+    real a = (*coord1[Y])[LENGTH];
+    real b = (*coord2[Z])[LENGTH];
+    real w1 = a;
+    real w2 = b;
+
+    real y = abs((*coord2[Z])[CENTER] - (*coord1[Z])[CENTER]);
 
     // outer intergration limits
-    float z1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
-    float z2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
+    real z1 = (*coord1[X])[0] - (*coord2[X])[CENTER];
+    real z2 = (*coord1[X])[1] - (*coord2[X])[CENTER];
 
     // inner integration limits
-    float x1 = (*coord2[Y])[0]-(*coord1[Y])[CENTER];
-    float x2 = (*coord2[Y])[1]-(*coord1[Y])[CENTER];
+    real x1 = (*coord2[Y])[0]-(*coord1[Y])[CENTER];
+    real x2 = (*coord2[Y])[1]-(*coord1[Y])[CENTER];
 
     //BEGIN____________________________gauss quad_______________________________
-    const int gauss_n_inner = gauss_n_ZXXY_1;
-    const int gauss_n = gauss_n_ZXXY_2;
-
     const int gauss_n2 = (gauss_n+1)/2;
-    const float pm = (z2+z1)/2;
-    const float pr = (z2-z1)/2;
-    const float  p0 = (bz1>0)? (z1) : (z2);
+    const real pm = (z2+z1)/2;
+    const real pr = (z2-z1)/2;
+    const real  p0 = (bz1>0)? (z1) : (z2);
 
-    float  val=0;
+    real  val=0;
     int init_i = 0;
 
     if ( (gauss_n%2)==1 ){ // odd n
         init_i = 1;
-        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_x(gauss_n_inner, a,b, x1, x2, y, abs(pm), shape2, w2, bz2) * shape1(abs(pm-p0), w1);
+        val += (*gauss::w[gauss_n])[0] * gauss_int_xy_x<gauss_n_inner>(a,b, x1, x2, y, abs(pm), shape2, w2, bz2) * shape1(abs(pm-p0), w1);
     }
     for ( int i = init_i; i < gauss_n2; i++ ) {
-        float dp = pr * (*gauss::p[gauss_n])[i];
+        real dp = pr * (*gauss::p[gauss_n])[i];
         val += (*gauss::w[gauss_n])[i] * (
-                +gauss_int_xy_x(gauss_n_inner, a,b, x1, x2, y, abs(pm-dp), shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
-                +gauss_int_xy_x(gauss_n_inner, a,b, x1, x2, y, abs(pm+dp), shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
+                +gauss_int_xy_x<gauss_n_inner>(a,b, x1, x2, y, abs(pm-dp), shape2, w2, bz2) * shape1(abs(pm-dp-p0), w1)
+                +gauss_int_xy_x<gauss_n_inner>(a,b, x1, x2, y, abs(pm+dp), shape2, w2, bz2) * shape1(abs(pm+dp-p0), w1)
                 );
     }
     return val * pr;
     //_END_____________________________gauss quad_______________________________
 }
 
+template<class Shape1, class Shape2, class real>
+static real intZXXY_s(
+        const Shape1 &shape1, const Shape2 &shape2, int order,
+        real* coord1[3][4], float bz1, float bsh1,
+        real* coord2[3][4], float bz2, float bsh2
+){
+    CAPLET_ORDER_SWITCH2( order, intZXXY_n,
+            (coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2),
+            (intZXXY_n<gauss_n_ZXXY_1, gauss_n_ZXXY_2>(coord1, bz1, bsh1, shape1, coord2, bz2, bsh2, shape2)) );
+}
+
+template<class real>
+real intZXXY(
+        real* coord1[3][4], float bz1, float bsh1, float (*shape1)(float, float),
+        real* coord2[3][4], float bz2, float bsh2, float (*shape2)(float, float)
+){
+    CAPLET_KERNEL_SCOPE(KERNEL_ZXXY);
+    //****
+    if (switch_analytical_intZXXY == true){
+        return int_xyyz( coord1, coord2 );
+    }
+    //****
+
+    //* Constant shapes: exact flat-flat integral scaled by the shape values
+    //  where the quadrature misses quadratureTolerance
+    const real c1 = constantShape(shape1);
+    const real c2 = constantShape(shape2);
+    if ( switch_analytical_constant_shape && c1>=0 && c2>=0
+         && isNearField(coord1, coord2, std::max(gauss_n_ZXXY_1, gauss_n_ZXXY_2)) ){
+        return c1 * c2 * int_xyyz( coord1, coord2 );
+    }
+
+    const int order = pairOrder(coord1, coord2, std::max(gauss_n_ZXXY_1, gauss_n_ZXXY_2));
+    CAPLET_SHAPE_SWITCH2( shape1, shape2, intZXXY_s, order,
+            coord1, bz1, bsh1, coord2, bz2, bsh2 );
+}
+
 
 
 
@@ -622,7 +1046,10 @@ float intZXXY(
 //*
 //*
 
-float  int_xy(float a, float b, float x, float y, float z, float area){
+template<class real>
+real  int_xy(real a, real b, real x, real y, real z, real area){
+    CAPLET_COUNT_INTEGRAL(INTEGRAL_XY);
+
     //**** ASSERT
     assert( a>0 );
     assert( b>0 );
@@ -643,11 +1070,11 @@ float  int_xy(float a, float b, float x, float y, float z, float area){
     //****
 
     //* Compute aspect ratio
-    float ba = b/a;
+    real ba = b/a;
 
     if ( ba < 1 ){ // swap x and y
         ba = 1/ba;
-        float temp;
+        real temp;
         temp = b; b = a; a = temp;
         temp = y; y = x; x = temp;
     }
@@ -668,33 +1095,35 @@ float  int_xy(float a, float b, float x, float y, float z, float area){
         }
     }
 
+    CAPLET_COUNT_ANALYTICAL(INTEGRAL_XY);
+
     //* Analytical integral
-    float x1 = x-a/2;
-    float x2 = x+a/2;
-    float y1 = y-b/2;
-    float y2 = y+b/2;
+    real x1 = x-a/2;
+    real x2 = x+a/2;
+    real y1 = y-b/2;
+    real y2 = y+b/2;
 
-    float x1_2 = x1*x1;
-    float x2_2 = x2*x2;
-    float y1_2 = y1*y1;
-    float y2_2 = y2*y2;
+    real x1_2 = x1*x1;
+    real x2_2 = x2*x2;
+    real y1_2 = y1*y1;
+    real y2_2 = y2*y2;
 
-    float z_2  = z*z;
+    real z_2  = z*z;
 
-    float r11 = sqrt(x1_2 + y1_2 + z_2);
-    float r12 = sqrt(x1_2 + y2_2 + z_2);
-    float r21 = sqrt(x2_2 + y1_2 + z_2);
-    float r22 = sqrt(x2_2 + y2_2 + z_2);
+    real r11 = sqrt(x1_2 + y1_2 + z_2);
+    real r12 = sqrt(x1_2 + y2_2 + z_2);
+    real r21 = sqrt(x2_2 + y1_2 + z_2);
+    real r22 = sqrt(x2_2 + y2_2 + z_2);
 
     #ifdef ROBUST_INTEGRAL_CHECK
-    float p =  (( x2_2>zero2 && abs(y2+r22)>zero && abs(y1+r21)>zero )? x2*log( (y2+r22)/(y1+r21) ) :0)
+    real p =  (( x2_2>zero2 && abs(y2+r22)>zero && abs(y1+r21)>zero )? x2*log( (y2+r22)/(y1+r21) ) :0)
               +(( x1_2>zero2 && abs(y1+r11)>zero && abs(y2+r12)>zero )? x1*log( (y1+r11)/(y2+r12) ) :0)
               +(( y2_2>zero2 && abs(x2+r22)>zero && abs(x1+r12)>zero )? y2*log( (x2+r22)/(x1+r12) ) :0)
               +(( y1_2>zero2 && abs(x1+r11)>zero && abs(x2+r21)>zero )? y1*log( (x1+r11)/(x2+r21) ) :0)
               +((  z_2>zero2 )?  z*( atan(x2*y1/r21/z) + atan(x1*y2/r12/z)
                                     -atan(x2*y2/r22/z) - atan(x1*y1/r11/z) ):0);
     #else
-    float p =  ((x2_2>zero2)? x2*log( (y2+r22)/(y1+r21) ):0)
+    real p =  ((x2_2>zero2)? x2*log( (y2+r22)/(y1+r21) ):0)
               +((x1_2>zero2)? x1*log( (y1+r11)/(y2+r12) ):0)
               +((y2_2>zero2)? y2*log( (x2+r22)/(x1+r12) ):0)
               +((y1_2>zero2)? y1*log( (x1+r11)/(x2+r21) ):0)
@@ -705,14 +1134,15 @@ float  int_xy(float a, float b, float x, float y, float z, float area){
 }
 
 
-float int_xyxy(float a, float b, float lx, float ly, float x, float y, float z){
-    float xp[nBit];
-    float yp[nBit];
-    float zp[nBit];
+template<class real>
+real int_xyxy(real a, real b, real lx, real ly, real x, real y, real z){
+    real xp[nBit];
+    real yp[nBit];
+    real zp[nBit];
 
-    float xx[nBit];
-    float yy[nBit];
-    float zz[nBit];
+    real xx[nBit];
+    real yy[nBit];
+    real zz[nBit];
 
     xp[MIN] = -a/2;
     xp[MAX] =  a/2;
@@ -745,8 +1175,8 @@ float int_xyxy(float a, float b, float lx, float ly, float x, float y, float z){
     yy[LENGTH] = ly;
     zz[LENGTH] = 0;
 
-    float* coord1[nDim][nBit];
-    float* coord2[nDim][nBit];
+    real* coord1[nDim][nBit];
+    real* coord2[nDim][nBit];
 
     *coord1[X] = xp;
     *coord1[Y] = yp;
@@ -760,7 +1190,10 @@ float int_xyxy(float a, float b, float lx, float ly, float x, float y, float z){
 }
 
 
-float int_xyxy(float* p1[3][4], float* p2[3][4]){
+template<class real>
+real int_xyxy(real* p1[3][4], real* p2[3][4]){
+    CAPLET_COUNT_INTEGRAL(INTEGRAL_XYXY);
+
     //* note: the precision needs to be 'double' due to accuracy
 
     #ifdef CAPLET_ATAN_LOG_INT_XYXY
@@ -771,11 +1204,11 @@ float int_xyxy(float* p1[3][4], float* p2[3][4]){
     using std::log;
     #endif
 
-    const float* xp;
-    const float* yp;
+    const real* xp;
+    const real* yp;
 
-    const float* xx;
-    const float* yy;
+    const real* xx;
+    const real* yy;
 
     //* Assign longer sides in x- and y-dir to panel'(xp, yp)
     //  so that panel(xx, yy) is smaller on both sides
@@ -796,7 +1229,7 @@ float int_xyxy(float* p1[3][4], float* p2[3][4]){
 
     //* Now xp.length > xx.length and yp.length > yy.length
     //  Next, determine which one is the characteristic length
-    float b, lx, ly, a, x, y;
+    real b, lx, ly, a, x, y;
     if ( yp[LENGTH] > xp[LENGTH] ){
         a  = xp[LENGTH];
         b  = yp[LENGTH];
@@ -814,10 +1247,10 @@ float int_xyxy(float* p1[3][4], float* p2[3][4]){
         x = abs(yp[CENTER]-yy[CENTER]);
         y = abs(xp[CENTER]-xx[CENTER]);
     }
-    float ba  = b/a;
-    float lyb = ly/b;	// [0.001, 1]
+    real ba  = b/a;
+    real lyb = ly/b;	// [0.001, 1]
 
-    float z  = abs( (*p1[Z])[CENTER] - (*p2[Z])[CENTER] );
+    real z  = abs( (*p1[Z])[CENTER] - (*p2[Z])[CENTER] );
 
 
     //* Approximation when the separation between two panels is far enough
@@ -852,6 +1285,8 @@ float int_xyxy(float* p1[3][4], float* p2[3][4]){
          }
     }
 
+    CAPLET_COUNT_ANALYTICAL(INTEGRAL_XYXY);
+
     //* Analytical integral
     //    double value 	 = 0.0f;
     //    const  double z2 = z*z;
@@ -1234,14 +1669,15 @@ float int_xyxy(float* p1[3][4], float* p2[3][4]){
 }
 
 
-float int_xyyz(float a, float b, float ly, float lz, float x, float y, float z){
-    float xp[nBit];
-    float yp[nBit];
-    float zp[nBit];
+template<class real>
+real int_xyyz(real a, real b, real ly, real lz, real x, real y, real z){
+    real xp[nBit];
+    real yp[nBit];
+    real zp[nBit];
 
-    float xx[nBit];
-    float yy[nBit];
-    float zz[nBit];
+    real xx[nBit];
+    real yy[nBit];
+    real zz[nBit];
 
     xp[MIN] = -a/2;
     xp[MAX] =  a/2;
@@ -1274,8 +1710,8 @@ float int_xyyz(float a, float b, float ly, float lz, float x, float y, float z){
     yy[LENGTH] = ly;
     zz[LENGTH] = lz;
 
-    float* coord1[nDim][nBit];
-    float* coord2[nDim][nBit];
+    real* coord1[nDim][nBit];
+    real* coord2[nDim][nBit];
 
     *coord1[X] = xp;
     *coord1[Y] = yp;
@@ -1289,7 +1725,9 @@ float int_xyyz(float a, float b, float ly, float lz, float x, float y, float z){
 }
 
 
-float int_xyyz(float* p1[3][4], float* p2[3][4]){
+template<class real>
+real int_xyyz(real* p1[3][4], real* p2[3][4]){
+    CAPLET_COUNT_INTEGRAL(INTEGRAL_XYYZ);
 
     #ifdef CAPLET_ATAN_LOG_INT_XYYZ
     using caplet::atan;
@@ -1299,14 +1737,14 @@ float int_xyyz(float* p1[3][4], float* p2[3][4]){
     using std::log;
     #endif
 
-    float* xp;
-    float* yp;
-    float  zp;
+    real* xp;
+    real* yp;
+    real  zp;
 
-    float  xx;
-    float* yy;
+    real  xx;
+    real* yy;
 
-    float* zz;
+    real* zz;
 
     //* Make xp.length > zz.length and yp.length > yy.length
     if ( (*p1[X])[LENGTH] > (*p2[Z])[LENGTH] ){
@@ -1328,19 +1766,19 @@ float int_xyyz(float* p1[3][4], float* p2[3][4]){
         yy = *p1[Y];
     }
 
-    float a= xp[LENGTH];
-    float b= yp[LENGTH];
-    float ly=yy[LENGTH];
-    float lz=zz[LENGTH];
-    float x = abs( xp[CENTER] - xx );
-    float y = abs( yp[CENTER] - yy[CENTER] );
-    float z = abs( zp - zz[CENTER] );
+    real a= xp[LENGTH];
+    real b= yp[LENGTH];
+    real ly=yy[LENGTH];
+    real lz=zz[LENGTH];
+    real x = abs( xp[CENTER] - xx );
+    real y = abs( yp[CENTER] - yy[CENTER] );
+    real z = abs( zp - zz[CENTER] );
 
 
     //* Approximation when panels are far seperated
     if ( b>a ){ // type1 criterion
-        float ba = b/a;
-        float lyb = ly/b;
+        real ba = b/a;
+        real lyb = ly/b;
 
         if ( ba > 15 ){
             if (
@@ -1384,8 +1822,8 @@ float int_xyyz(float* p1[3][4], float* p2[3][4]){
             }
         }
     }else{ // type2 criterion
-        float ab = a/b;
-        float lza = lz/a;
+        real ab = a/b;
+        real lza = lz/a;
 
         if ( ab > 8 ){
             if (
@@ -1430,6 +1868,8 @@ float int_xyyz(float* p1[3][4], float* p2[3][4]){
         }
     }
 
+    CAPLET_COUNT_ANALYTICAL(INTEGRAL_XYYZ);
+
 
     //* Analytical integral
     //	double value = 0.0;
@@ -1684,9 +2124,10 @@ float int_xyyz(float* p1[3][4], float* p2[3][4]){
 }
 
 
-float  int_xyzx(float* p1[nDim][nBit], float* p2[nDim][nBit]){
-    float * p1Mirrored[nDim][nBit];
-    float * p2Mirrored[nDim][nBit];
+template<class real>
+real  int_xyzx(real* p1[nDim][nBit], real* p2[nDim][nBit]){
+    real * p1Mirrored[nDim][nBit];
+    real * p2Mirrored[nDim][nBit];
     *p1Mirrored[X] = *p1[Y];
     *p1Mirrored[Y] = *p1[X];
     *p1Mirrored[Z] = *p1[Z];
@@ -1698,7 +2139,10 @@ float  int_xyzx(float* p1[nDim][nBit], float* p2[nDim][nBit]){
 }
 
 
-float int_xyy(float a, float b, float ly, float x, float y, float z){
+template<class real>
+real int_xyy(real a, real b, real ly, real x, real y, real z){
+    CAPLET_COUNT_INTEGRAL(INTEGRAL_XYY);
+
     //**** ASSERT
     assert( a>0 );
     assert( b>0 );
@@ -1718,7 +2162,7 @@ float int_xyy(float a, float b, float ly, float x, float y, float z){
 
     //* Approximation when seperation is far
     if ( b >= a ){
-        float lyb 	= ly/b;
+        real lyb 	= ly/b;
 
         if ( lyb > 0.3 ){
             if (
@@ -1734,8 +2178,8 @@ float int_xyy(float a, float b, float ly, float x, float y, float z){
             return int_xy(a,b,x,y,z,a*b)*ly;
         }
     }else{ // b < a
-        float ab 	= a/b;
-        float lyb	= ly/b;
+        real ab 	= a/b;
+        real lyb	= ly/b;
 
         if ( lyb > 0.3 ){
             if ( ab > 8 ){
@@ -1774,33 +2218,35 @@ float int_xyy(float a, float b, float ly, float x, float y, float z){
         }
     }
 
+    CAPLET_COUNT_ANALYTICAL(INTEGRAL_XYY);
+
     //* Analytical integral
-    float xp[] = {-a/2,  a/2};
-    float yp[] = {-b/2,  b/2};
-    float xx   = x;
-    float yy[] = {-ly/2+y, ly/2+y};
-    float z_2 = z*z;
+    real xp[] = {-a/2,  a/2};
+    real yp[] = {-b/2,  b/2};
+    real xx   = x;
+    real yy[] = {-ly/2+y, ly/2+y};
+    real z_2 = z*z;
 
-    float u1 = xp[0]-xx;		float u1_2 = u1*u1;
-    float u2 = xp[1]-xx;		float u2_2 = u2*u2;
+    real u1 = xp[0]-xx;		real u1_2 = u1*u1;
+    real u2 = xp[1]-xx;		real u2_2 = u2*u2;
 
-    float v11 = yp[0]-yy[0];	float v11_2 = v11*v11;
-    float v12 = yp[0]-yy[1];	float v12_2 = v12*v12;
-    float v21 = yp[1]-yy[0];	float v21_2 = v21*v21;
-    float v22 = yp[1]-yy[1];	float v22_2 = v22*v22;
+    real v11 = yp[0]-yy[0];	real v11_2 = v11*v11;
+    real v12 = yp[0]-yy[1];	real v12_2 = v12*v12;
+    real v21 = yp[1]-yy[0];	real v21_2 = v21*v21;
+    real v22 = yp[1]-yy[1];	real v22_2 = v22*v22;
 
-    float r111 = sqrt( u1_2 + v11_2 + z_2 );
-    float r112 = sqrt( u1_2 + v12_2 + z_2 );
-    float r121 = sqrt( u1_2 + v21_2 + z_2 );
-    float r122 = sqrt( u1_2 + v22_2 + z_2 );
+    real r111 = sqrt( u1_2 + v11_2 + z_2 );
+    real r112 = sqrt( u1_2 + v12_2 + z_2 );
+    real r121 = sqrt( u1_2 + v21_2 + z_2 );
+    real r122 = sqrt( u1_2 + v22_2 + z_2 );
 
-    float r211 = sqrt( u2_2 + v11_2 + z_2 );
-    float r212 = sqrt( u2_2 + v12_2 + z_2 );
-    float r221 = sqrt( u2_2 + v21_2 + z_2 );
-    float r222 = sqrt( u2_2 + v22_2 + z_2 );
+    real r211 = sqrt( u2_2 + v11_2 + z_2 );
+    real r212 = sqrt( u2_2 + v12_2 + z_2 );
+    real r221 = sqrt( u2_2 + v21_2 + z_2 );
+    real r222 = sqrt( u2_2 + v22_2 + z_2 );
 
 
-    float val = 0;
+    real val = 0;
 
 
 
@@ -1894,7 +2340,10 @@ float int_xyy(float a, float b, float ly, float x, float y, float z){
 }
 
 
-float int_xyz(float a, float b, float lz, float x, float y, float z){
+template<class real>
+real int_xyz(real a, real b, real lz, real x, real y, real z){
+    CAPLET_COUNT_INTEGRAL(INTEGRAL_XYZ);
+
     //**** ASSERT
     assert( a>0 );
     assert( b>0 );
@@ -1915,7 +2364,7 @@ float int_xyz(float a, float b, float lz, float x, float y, float z){
 
     //* Rotate to make sure b > a > lz
     //  in order to make effective approximation when possible
-    float temp;
+    real temp;
     if( b > a ){
         if( lz > a ){
             if( b > lz ){ // b  > lz > a
@@ -1944,8 +2393,8 @@ float int_xyz(float a, float b, float lz, float x, float y, float z){
 
 
     //* Approximation formula for b > a > lz
-    float ba = b/a;
-    float lza = lz/a;
+    real ba = b/a;
+    real lza = lz/a;
 
     // x-dir
     if ( x > ( (7.4772e-06 + (7.997e-08 + 6.4163e-09*ba )*ba + (1.8516e-05 + 1.2866e-05*lza -5.7301e-07*ba)*lza)/(-2.0543e-06 + 1.8656e-05*ba -9.1847e-07*lza) )*b ){
@@ -1970,20 +2419,22 @@ float int_xyz(float a, float b, float lz, float x, float y, float z){
         }
     }
 
+    CAPLET_COUNT_ANALYTICAL(INTEGRAL_XYZ);
+
     //* Analytical integral
-    //	float xp[] = {-a/2-x, a/2-x};
-    //	float yp[] = {-b/2-y, b/2-y};
-    //	float zz[] = {-lz/2-z, lz/2-z};
+    //	real xp[] = {-a/2-x, a/2-x};
+    //	real yp[] = {-b/2-y, b/2-y};
+    //	real zz[] = {-lz/2-z, lz/2-z};
     //
     //	for ( int h=0; h<2; h++ ){
     //	      for ( int m = 0; m<2; m++ ){
     //	          for ( int p = 0; p<2; p++){
-    //	              float u = xp[m]; float u_2 = u*u;
-    //	              float v = yp[p]; float v_2 = v*v;
-    //	              float z = zz[h]; float z_2 = z*z;
-    //	              float r = sqrt(u*u+v*v+z*z);
+    //	              real u = xp[m]; real u_2 = u*u;
+    //	              real v = yp[p]; real v_2 = v*v;
+    //	              real z = zz[h]; real z_2 = z*z;
+    //	              real r = sqrt(u*u+v*v+z*z);
     //
-    //	              float temp = 0;
+    //	              real temp = 0;
     //	              if ( z_2 > zero2 ){
     //	                  temp = temp - 0.5*z_2*atan(u*v/z/r);
     //	                  temp = temp + z*(v*log(u+r) + u*log(v+r));
@@ -2001,23 +2452,23 @@ float int_xyz(float a, float b, float lz, float x, float y, float z){
     //	}
 
     //* Expanded analytical integral
-    float val = 0 ;
+    real val = 0 ;
 
-    float u1 = -a/2  -x;	float u1_2 = u1*u1;
-    float u2 =  a/2  -x;	float u2_2 = u2*u2;
-    float v1 = -b/2  -y;	float v1_2 = v1*v1;
-    float v2 =  b/2  -y;	float v2_2 = v2*v2;
-    float z1 = -lz/2 -z;	float z1_2 = z1*z1;
-    float z2 =  lz/2 -z;	float z2_2 = z2*z2;
+    real u1 = -a/2  -x;	real u1_2 = u1*u1;
+    real u2 =  a/2  -x;	real u2_2 = u2*u2;
+    real v1 = -b/2  -y;	real v1_2 = v1*v1;
+    real v2 =  b/2  -y;	real v2_2 = v2*v2;
+    real z1 = -lz/2 -z;	real z1_2 = z1*z1;
+    real z2 =  lz/2 -z;	real z2_2 = z2*z2;
 
-    float r111 = sqrt( u1_2 + v1_2 + z1_2 );
-    float r112 = sqrt( u1_2 + v1_2 + z2_2 );
-    float r121 = sqrt( u1_2 + v2_2 + z1_2 );
-    float r122 = sqrt( u1_2 + v2_2 + z2_2 );
-    float r211 = sqrt( u2_2 + v1_2 + z1_2 );
-    float r212 = sqrt( u2_2 + v1_2 + z2_2 );
-    float r221 = sqrt( u2_2 + v2_2 + z1_2 );
-    float r222 = sqrt( u2_2 + v2_2 + z2_2 );
+    real r111 = sqrt( u1_2 + v1_2 + z1_2 );
+    real r112 = sqrt( u1_2 + v1_2 + z2_2 );
+    real r121 = sqrt( u1_2 + v2_2 + z1_2 );
+    real r122 = sqrt( u1_2 + v2_2 + z2_2 );
+    real r211 = sqrt( u2_2 + v1_2 + z1_2 );
+    real r212 = sqrt( u2_2 + v1_2 + z2_2 );
+    real r221 = sqrt( u2_2 + v2_2 + z1_2 );
+    real r222 = sqrt( u2_2 + v2_2 + z2_2 );
 
 
     #ifdef ROBUST_INTEGRAL_CHECK
@@ -2129,6 +2580,31 @@ float int_xyz(float a, float b, float lz, float x, float y, float z){
 
 
 
+//* Instantiations for the fast (float) and double (double) Galerkin modes
+#define CAPLET_INSTANTIATE_INTEGRALS(real) \
+    template real intZFZF(real* coord1[nDim][nBit], real* coord2[nDim][nBit]); \
+    template real intZFXF(real* coord1[nDim][nBit], real* coord2[nDim][nBit]); \
+    template real intZXZF(real* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float), real* coord2[nDim][nBit]); \
+    template real intZXXF(real* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float), real* coord2[nDim][nBit]); \
+    template real intZXYF(real* coord1[nDim][nBit], float bz, float bsh, float (*shape)(float, float), real* coord2[nDim][nBit]); \
+    template real intZXZX(real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float), real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float)); \
+    template real intZXYX(real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float), real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float)); \
+    template real intZXZY(real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float), real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float)); \
+    template real intZXXZ(real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float), real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float)); \
+    template real intZXYZ(real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float), real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float)); \
+    template real intZXXY(real* coord1[nDim][nBit], float bz1, float bsh1, float (*shape1)(float, float), real* coord2[nDim][nBit], float bz2, float bsh2, float (*shape2)(float, float)); \
+    template real int_xy(real a, real b, real x, real y, real z, real area); \
+    template real int_xyy(real a, real b, real ly, real x, real y, real z); \
+    template real int_xyz(real a, real b, real lz, real x, real y, real z); \
+    template real int_xyxy(real a, real b, real lx, real ly, real x, real y, real z); \
+    template real int_xyyz(real a, real b, real ly, real lz, real x, real y, real z);
+
+CAPLET_INSTANTIATE_INTEGRALS(float)
+CAPLET_INSTANTIATE_INTEGRALS(double)
+
+#undef CAPLET_INSTANTIATE_INTEGRALS
+
+
 //***********************************************************************
 //*
 //* DOUBLE VERSION
@@ -2137,18 +2613,23 @@ float int_xyz(float a, float b, float lz, float x, float y, float z){
 
 double int_xy_d(float a, float b, float x, float y, float z, float area);
 double calColD(float* p1[nDim][nBit], float* p2[nDim][nBit]){
+    CAPLET_KERNEL_SCOPE(KERNEL_COLLOCATION);
+
     //* Test point : panel1.center-panel2.center
     //  Integration: panel2
+    //  The potential of panel2 is even in x, y and z.
     float a = (*p2[X])[LENGTH];
     float b = (*p2[Y])[LENGTH];
 
-    float x = (*p1[X])[CENTER] - (*p2[X])[CENTER];
-    float y = (*p1[Y])[CENTER] - (*p2[Y])[CENTER];
-    float z = (*p1[Z])[CENTER] - (*p2[Z])[CENTER];
+    float x = std::abs( (*p1[X])[CENTER] - (*p2[X])[CENTER] );
+    float y = std::abs( (*p1[Y])[CENTER] - (*p2[Y])[CENTER] );
+    float z = std::abs( (*p1[Z])[CENTER] - (*p2[Z])[CENTER] );
 
     return int_xy_d(a,b,x,y,z,a*b);
 }
 double int_xy_d(float a, float b, float x, float y, float z, float area){
+    CAPLET_COUNT_INTEGRAL(INTEGRAL_XY_D);
+
     //**** ASSERT
     assert( a>0 );
     assert( b>0 );
@@ -2188,6 +2669,8 @@ double int_xy_d(float a, float b, float x, float y, float z, float area){
         }
     }
 
+    CAPLET_COUNT_ANALYTICAL(INTEGRAL_XY_D);
+
     //* Analytical integral
     double x1 = x-a/2;
     double x2 = x+a/2;
@@ -0,0 +1,716 @@
+/*
+Created : Oct 19, 2026
+Author  : Yu-Chung Hsiao
+Email   : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//****
+//*
+//* Microbenchmark and accuracy harness of the kernels in caplet_int.cpp
+//*
+//* For each kernel, panel pairs are swept over panel sizes, aspect ratios,
+//* separations and lateral shifts. Each pair is timed (ns per call) and
+//* compared with a double-precision reference:
+//* - the inner integral over a source panel is closed-form in one (kernels)
+//*   or two (internal integrals) dimensions,
+//* - all other dimensions use composite Gauss-Legendre rules with panels
+//*   shorter than half the separation, which converges to about 1e-9.
+//* Touching panels are not swept; separations are relative to the panel
+//* size.
+//*
+//****
+
+#include "caplet_int.h"
+#include "caplet_metrics.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <list>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+using namespace std;
+
+
+namespace caplet{
+//* Internal integrals of caplet_int.cpp
+template<class real> real int_xy(real a, real b, real x, real y, real z, real area);
+template<class real> real int_xyy(real a, real b, real ly, real x, real y, real z);
+template<class real> real int_xyz(real a, real b, real lz, real x, real y, real z);
+template<class real> real int_xyxy(real a, real b, real lx, real ly, real x, real y, real z);
+template<class real> real int_xyyz(real a, real b, real ly, real lz, real x, real y, real z);
+}
+
+using namespace caplet;
+
+
+//**********************************
+//*
+//* Reference integrals (double)
+//*
+
+//* Gauss-Legendre nodes and weights on [-1,1] by Newton iteration
+struct GaussRule{
+    vector<double> p;
+    vector<double> w;
+    explicit GaussRule(int n){
+        p.resize(n);
+        w.resize(n);
+        for ( int i=0; i<n; i++ ){
+            double x = std::cos( M_PI*(i+0.75)/(n+0.5) );
+            double dp = 0;
+            for ( int iter=0; iter<100; iter++ ){
+                double p0 = 1, p1 = x;
+                for ( int k=2; k<=n; k++ ){
+                    double p2 = ( (2*k-1)*x*p1 - (k-1)*p0 )/k;
+                    p0 = p1;
+                    p1 = p2;
+                }
+                if ( n==1 ){
+                    p1 = x; p0 = 1;
+                }
+                dp = n*( x*p1 - p0 )/( x*x - 1 );
+                double dx = p1/dp;
+                x -= dx;
+                if ( std::abs(dx)<1e-16 ){
+                    break;
+                }
+            }
+            p[i] = x;
+            w[i] = 2/( (1-x*x)*dp*dp );
+        }
+    }
+};
+
+static const GaussRule refRule(8);
+
+//* Composite rule on [t1,t2] with segments not longer than h
+static void compositeRule(double t1, double t2, double h, vector<double> &t, vector<double> &w){
+    t.clear();
+    w.clear();
+    if ( t2<=t1 ){
+        t.push_back(t1);
+        w.push_back(1);
+        return;
+    }
+    int m = int( std::ceil( (t2-t1)/h ) );
+    m = std::max(1, std::min(m, 48));
+    const double len = (t2-t1)/m;
+    for ( int s=0; s<m; s++ ){
+        const double mid = t1 + (s+0.5)*len;
+        for ( size_t i=0; i<refRule.p.size(); i++ ){
+            t.push_back( mid + 0.5*len*refRule.p[i] );
+            w.push_back( 0.5*len*refRule.w[i] );
+        }
+    }
+}
+
+//* Integral of 1/r over the segment [v1,v2] seen from v0 at distance rho
+static double segmentPotential(double v1, double v2, double v0, double rho){
+    return std::asinh( (v2-v0)/rho ) - std::asinh( (v1-v0)/rho );
+}
+
+//* Integral of 1/r over the rectangle [-a/2,a/2]x[-b/2,b/2] in the plane
+//  z=0 seen from (x,y,z); the asinh form avoids the cancellation of log(Y+R)
+static double rectF(double u, double v, double z){
+    const double r  = std::sqrt(u*u + v*v + z*z);
+    const double ru = std::sqrt(u*u + z*z);
+    const double rv = std::sqrt(v*v + z*z);
+    double f = 0;
+    if ( ru>0 ){
+        f += u*std::asinh(v/ru);
+    }
+    if ( rv>0 ){
+        f += v*std::asinh(u/rv);
+    }
+    if ( z!=0 && r>0 ){
+        f -= z*std::atan( u*v/(z*r) );
+    }
+    return f;
+}
+
+static double rectPotential(double a, double b, double x, double y, double z){
+    const double u1 = -a/2-x, u2 = a/2-x;
+    const double v1 = -b/2-y, v2 = b/2-y;
+    return rectF(u2,v2,z) - rectF(u1,v2,z) - rectF(u2,v1,z) + rectF(u1,v1,z);
+}
+
+
+//**********************************
+//*
+//* Panels in the frames of the kernels
+//*
+
+//* Box with one zero-length dimension, in the nBit layout of panels
+//  (ptr for the float kernels, ptrD for the double ones)
+struct Panel{
+    float   c[nDim][nBit];
+    float*  ptr[nDim][nBit];
+    double  cD[nDim][nBit];
+    double* ptrD[nDim][nBit];
+
+    void set(const double lo[nDim], const double hi[nDim]){
+        for ( int d=0; d<nDim; d++ ){
+            c[d][MIN]    = cD[d][MIN]    = lo[d];
+            c[d][MAX]    = cD[d][MAX]    = hi[d];
+            c[d][LENGTH] = cD[d][LENGTH] = hi[d]-lo[d];
+            c[d][CENTER] = cD[d][CENTER] = (lo[d]+hi[d])/2;
+            ptr[d][0]    = c[d];
+            ptrD[d][0]   = cD[d];
+        }
+    }
+    double lo(int d) const { return c[d][MIN]; }
+    double hi(int d) const { return c[d][MAX]; }
+};
+
+//* Shape of a basis along an axis with the origin at the panel minimum
+struct Basis{
+    int     normal;
+    int     axis;       //* shape axis; equals normal for flat panels
+    shape_t shape;
+};
+
+static float decayShape(float x, float w){
+    return w/(w+x);
+}
+
+//* Double-precision Galerkin integral of two panels with shapes
+//  - target panel p1: composite rule over both tangent dimensions
+//  - source panel p2: composite rule over the shape axis and closed form
+//    over the other tangent dimension
+static double referencePEntry(const Panel &p1, const Basis &b1,
+                              const Panel &p2, const Basis &b2, double h){
+    int t1[2], n1 = 0;
+    for ( int d=0; d<nDim; d++ ){
+        if ( d!=b1.normal ) t1[n1++] = d;
+    }
+    int u2 = -1, v2 = -1;
+    for ( int d=0; d<nDim; d++ ){
+        if ( d==b2.normal ) continue;
+        if ( u2<0 && ( b2.axis==b2.normal || d==b2.axis ) ) u2 = d;
+        else v2 = d;
+    }
+    const int    other1 = ( t1[0]==b1.axis )? t1[1] : t1[0];
+    const double w1 = p1.hi(other1) - p1.lo(other1);
+    const double w2 = p2.hi(v2)-p2.lo(v2);
+
+    vector<double> ta, wa, tb, wb, tu, wu;
+    compositeRule(p1.lo(t1[0]), p1.hi(t1[0]), h, ta, wa);
+    compositeRule(p1.lo(t1[1]), p1.hi(t1[1]), h, tb, wb);
+    compositeRule(p2.lo(u2), p2.hi(u2), h, tu, wu);
+
+    double sum = 0;
+    double r1[nDim];
+    r1[b1.normal] = p1.lo(b1.normal);
+    for ( size_t i=0; i<ta.size(); i++ ){
+        r1[t1[0]] = ta[i];
+        for ( size_t j=0; j<tb.size(); j++ ){
+            r1[t1[1]] = tb[j];
+            double s1 = 1;
+            if ( b1.axis!=b1.normal ){
+                s1 = b1.shape( float(r1[b1.axis]-p1.lo(b1.axis)), float(w1) );
+            }
+            double inner = 0;
+            for ( size_t k=0; k<tu.size(); k++ ){
+                double s2 = 1;
+                if ( b2.axis!=b2.normal ){
+                    s2 = b2.shape( float(tu[k]-p2.lo(u2)), float(w2) );
+                }
+                const double dn = r1[b2.normal] - p2.lo(b2.normal);
+                const double du = r1[u2] - tu[k];
+                const double rho = std::sqrt( dn*dn + du*du );
+                inner += wu[k]*s2*segmentPotential(p2.lo(v2), p2.hi(v2), r1[v2], rho);
+            }
+            sum += wa[i]*wb[j]*s1*inner;
+        }
+    }
+    return sum;
+}
+
+//* Double-precision integral of a flat source rectangle a x b (normal z,
+//  centered) over a target box of dimensions l[] centered at c[]
+static double referenceInternal(double a, double b, const double l[nDim], const double c[nDim], double h){
+    vector<double> t[nDim], w[nDim];
+    for ( int d=0; d<nDim; d++ ){
+        compositeRule(c[d]-l[d]/2, c[d]+l[d]/2, h, t[d], w[d]);
+    }
+    double sum = 0;
+    for ( size_t i=0; i<t[X].size(); i++ ){
+        for ( size_t j=0; j<t[Y].size(); j++ ){
+            for ( size_t k=0; k<t[Z].size(); k++ ){
+                sum += w[X][i]*w[Y][j]*w[Z][k]*rectPotential(a, b, t[X][i], t[Y][j], t[Z][k]);
+            }
+        }
+    }
+    return sum;
+}
+
+
+//**********************************
+//*
+//* Kernels under test
+//*
+
+enum KERNEL_ID{
+    ZFZF, ZFXF, ZXZF, ZXXF, ZXYF, ZXZX, ZXYX, ZXZY, ZXXZ, ZXYZ, ZXXY,
+    INT_XY, INT_XYY, INT_XYZ, INT_XYXY, INT_XYYZ, COL_D, nKernelId
+};
+
+static const char* const kernelIdNames[nKernelId] = {
+    "intZFZF", "intZFXF", "intZXZF", "intZXXF", "intZXYF",
+    "intZXZX", "intZXYX", "intZXZY", "intZXXZ", "intZXYZ", "intZXXY",
+    "int_xy", "int_xyy", "int_xyz", "int_xyxy", "int_xyyz", "calColD"
+};
+
+//* Normal and shape axis of the second panel of each kernel; the first
+//  panel is normal to z with its shape along x (flat for ZF kernels)
+static const int kernelPanel2[ZXXY+1][2] = {
+    {Z, Z}, {X, X}, {Z, Z}, {X, X}, {Y, Y},
+    {Z, X}, {Y, X}, {Z, Y}, {X, Z}, {Y, Z}, {X, Y}
+};
+
+//* One swept configuration
+struct Config{
+    double size;        //* panel length along the shape axis (m)
+    double aspect;      //* length over width
+    double separation;  //* gap relative to the panel size
+    double shift;       //* lateral offset relative to the panel size
+    int    dir;         //* direction of the gap of internal integrals
+};
+
+struct Sample{
+    int    kernel;
+    Config config;
+    double value;
+    double reference;
+    double relError;
+    double nsPerCall;
+};
+
+//* Arguments of a Galerkin kernel call
+struct KernelCase{
+    Panel p1, p2;
+    Basis b1, b2;
+};
+
+static void buildKernelCase(int k, const Config &cfg, shape_t shape, KernelCase &kc){
+    const double L = cfg.size;
+    const double W = cfg.size/cfg.aspect;
+    const double s = cfg.separation*cfg.size;
+    const double dx = cfg.shift*cfg.size;
+
+    kc.b1.normal = Z;
+    kc.b1.axis   = ( k<=ZFXF )? Z : X;
+    kc.b1.shape  = shape;
+    kc.b2.normal = kernelPanel2[k][0];
+    kc.b2.axis   = kernelPanel2[k][1];
+    kc.b2.shape  = shape;
+
+    double lo1[nDim] = {0, 0, 0};
+    double hi1[nDim] = {L, W, 0};
+    kc.p1.set(lo1, hi1);
+
+    //* Panel 2 is L long along its shape axis (x if flat) and W wide
+    //  otherwise; it lies at z=s (normal z), x=L+s (normal x) or y=W+s
+    //  (normal y), and above z=s otherwise
+    const int axis2 = ( kc.b2.axis==kc.b2.normal )? X : kc.b2.axis;
+    double lo2[nDim] = { dx, 0, s };
+    double hi2[nDim];
+    for ( int d=0; d<nDim; d++ ){
+        hi2[d] = lo2[d] + ( (d==axis2)? L : W );
+    }
+    switch ( kc.b2.normal ){
+    case X: lo2[X] = hi2[X] = L + s; break;
+    case Y: lo2[Y] = hi2[Y] = W + s; break;
+    case Z: lo2[Z] = hi2[Z] = s;     break;
+    }
+    kc.p2.set(lo2, hi2);
+}
+
+template<class real>
+static real callKernel(int k, KernelCase &kc, real* p1[nDim][nBit], real* p2[nDim][nBit]){
+    switch ( k ){
+    case ZFZF: return intZFZF(p1, p2);
+    case ZFXF: return intZFXF(p1, p2);
+    case ZXZF: return intZXZF(p1, 1, 0, kc.b1.shape, p2);
+    case ZXXF: return intZXXF(p1, 1, 0, kc.b1.shape, p2);
+    case ZXYF: return intZXYF(p1, 1, 0, kc.b1.shape, p2);
+    case ZXZX: return intZXZX(p1, 1, 0, kc.b1.shape, p2, 1, 0, kc.b2.shape);
+    case ZXYX: return intZXYX(p1, 1, 0, kc.b1.shape, p2, 1, 0, kc.b2.shape);
+    case ZXZY: return intZXZY(p1, 1, 0, kc.b1.shape, p2, 1, 0, kc.b2.shape);
+    case ZXXZ: return intZXXZ(p1, 1, 0, kc.b1.shape, p2, 1, 0, kc.b2.shape);
+    case ZXYZ: return intZXYZ(p1, 1, 0, kc.b1.shape, p2, 1, 0, kc.b2.shape);
+    case ZXXY: return intZXXY(p1, 1, 0, kc.b1.shape, p2, 1, 0, kc.b2.shape);
+    }
+    return 0;
+}
+
+static double callKernel(int k, KernelCase &kc, bool isDouble){
+    return isDouble? callKernel(k, kc, kc.p1.ptrD, kc.p2.ptrD)
+                   : callKernel(k, kc, kc.p1.ptr,  kc.p2.ptr);
+}
+
+//* Arguments of an internal integral: source a x b at the origin,
+//  target box l[] centered at c[] (all offsets non-negative)
+struct InternalCase{
+    double a, b;
+    double l[nDim];
+    double c[nDim];
+    Panel p1, p2;   //* for calColD
+};
+
+static void buildInternalCase(int k, const Config &cfg, InternalCase &ic){
+    const double L = cfg.size;
+    const double W = cfg.size/cfg.aspect;
+    ic.a = L;
+    ic.b = W;
+    for ( int d=0; d<nDim; d++ ){
+        ic.l[d] = 0;
+    }
+    switch ( k ){
+    case INT_XYY:  ic.l[Y] = W;             break;
+    case INT_XYZ:  ic.l[Z] = W;             break;
+    case INT_XYXY: ic.l[X] = L; ic.l[Y] = W; break;
+    case INT_XYYZ: ic.l[Y] = W; ic.l[Z] = W; break;
+    }
+    //* The gap is along dir; other offsets are the lateral shift
+    const double source[nDim] = { L, W, 0 };
+    for ( int d=0; d<nDim; d++ ){
+        ic.c[d] = ( d==cfg.dir )? source[d]/2 + ic.l[d]/2 + cfg.separation*L
+                                : cfg.shift*L;
+    }
+    //* The test point of calColD is the center of panel 1, and panel 2 is
+    //  the source
+    double lo1[nDim], hi1[nDim], lo2[nDim], hi2[nDim];
+    for ( int d=0; d<nDim; d++ ){
+        lo1[d] = hi1[d] = ic.c[d];
+        lo2[d] = -source[d]/2;
+        hi2[d] =  source[d]/2;
+    }
+    ic.p1.set(lo1, hi1);
+    ic.p2.set(lo2, hi2);
+}
+
+template<class real>
+static real callInternal(int k, InternalCase &ic){
+    const real a = ic.a, b = ic.b;
+    const real l[nDim] = { real(ic.l[X]), real(ic.l[Y]), real(ic.l[Z]) };
+    const real c[nDim] = { real(ic.c[X]), real(ic.c[Y]), real(ic.c[Z]) };
+    switch ( k ){
+    case INT_XY:   return int_xy(a, b, c[X], c[Y], c[Z], a*b);
+    case INT_XYY:  return int_xyy(a, b, l[Y], c[X], c[Y], c[Z]);
+    case INT_XYZ:  return int_xyz(a, b, l[Z], c[X], c[Y], c[Z]);
+    case INT_XYXY: return int_xyxy(a, b, l[X], l[Y], c[X], c[Y], c[Z]);
+    case INT_XYYZ: return int_xyyz(a, b, l[Y], l[Z], c[X], c[Y], c[Z]);
+    case COL_D:    return calColD(ic.p1.ptr, ic.p2.ptr);
+    }
+    return 0;
+}
+
+static double callInternal(int k, InternalCase &ic, bool isDouble){
+    return isDouble? callInternal<double>(k, ic) : callInternal<float>(k, ic);
+}
+
+
+//**********************************
+//*
+//* Sweep
+//*
+
+static volatile double sink;
+
+//* Time fn() until minTime seconds of CPU time have passed
+//  (CPU time, so that other load on the machine is not counted)
+template<class F>
+static double nsPerCall(F fn, double minTime){
+    long long n = 0;
+    long long batch = 16;
+    const double start = metrics::cpuTime();
+    double elapsed = 0;
+    while ( elapsed<minTime ){
+        double acc = 0;
+        for ( long long i=0; i<batch; i++ ){
+            acc += fn();
+        }
+        sink = acc;
+        n += batch;
+        batch *= 2;
+        elapsed = metrics::cpuTime() - start;
+    }
+    return 1e9*elapsed/n;
+}
+
+struct KernelCall{
+    int k;
+    KernelCase *kc;
+    bool isDouble;
+    double operator()() const { return callKernel(k, *kc, isDouble); }
+};
+
+struct InternalCall{
+    int k;
+    InternalCase *ic;
+    bool isDouble;
+    double operator()() const { return callInternal(k, *ic, isDouble); }
+};
+
+static vector<double> parseList(const string &text){
+    vector<double> values;
+    stringstream ss(text);
+    string item;
+    while ( getline(ss, item, ',') ){
+        values.push_back( atof(item.c_str()) );
+    }
+    return values;
+}
+
+
+void printUsage(char* command){
+    cout << "CAPLET: Microbenchmark and accuracy harness of the integral kernels" << endl
+         << "Usage  : " << command << " [OPTION]" << endl
+         << "Option : " << endl
+         << "  -k, --kernel NAME         kernel to sweep (repeatable; default: all)" << endl
+         << "                            intZFZF ... intZXXY, int_xy, int_xyy, int_xyz," << endl
+         << "                            int_xyxy, int_xyyz, calColD" << endl
+         << "  --sizes LIST              panel sizes in m (default: 1e-7,3e-7,1e-6,3e-6)" << endl
+         << "  --aspects LIST            length over width (default: 1,4,16)" << endl
+         << "  --separations LIST        gaps relative to the size (default: 0.1,0.3,1,3,10)" << endl
+         << "  --shifts LIST             lateral offsets relative to the size (default: 0,0.5)" << endl
+         << "  --shape arch|side|decay   shape of linear panels (default: arch, as in" << endl
+         << "                            caplet_parameter.h; decay: w/(w+x))" << endl
+         << "  --order N                 Gauss points per dimension of the numerical" << endl
+         << "                            kernels (1-6; default: caplet_parameter.h)" << endl
+         << "  --adaptive                per-pair orders from the separation, as in" << endl
+         << "                            caplet --adaptive-quadrature" << endl
+         << "  -d, --double              the double instantiation of the kernels, as in" << endl
+         << "                            caplet --double (calColD is always double)" << endl
+         << "  -q, --quick               a smaller sweep" << endl
+         << "  -t, --time SECONDS        minimum timing per configuration (default: 2e-4)" << endl
+         << "  -o, --csv FILE            write every configuration to FILE" << endl
+         << "  -e, --max-error VALUE     exit with status 1 if a relative error exceeds VALUE" << endl;
+}
+
+
+int main(int argc, char *argv[]){
+
+    vector<double> sizes       = parseList("1e-7,3e-7,1e-6,3e-6");
+    vector<double> aspects     = parseList("1,4,16");
+    vector<double> separations = parseList("0.1,0.3,1,3,10");
+    vector<double> shifts      = parseList("0,0.5");
+    shape_t shape   = arch;
+    double  minTime = 2e-4;
+    double  maxError = -1;
+    string  fileNameCsv;
+    vector<bool> isSelected(nKernelId, true);
+    bool    isAnySelected = false;
+    int     quadratureOrder = 0;
+    bool    isAdaptive = false;
+    bool    isDouble = false;
+
+    list<string> argvList;
+    for ( int i=1; i<argc; ++i ){
+        argvList.push_back(argv[i]);
+    }
+
+    //* Read options
+    for ( list<string>::iterator each=argvList.begin(); each!=argvList.end(); ){
+        const string option = *each;
+        each = argvList.erase(each);
+        if ( option=="-q" || option=="--quick" ){
+            sizes       = parseList("1e-7,1e-6");
+            aspects     = parseList("1,8");
+            separations = parseList("0.2,1,5");
+            shifts      = parseList("0");
+            continue;
+        }
+        if ( option=="--adaptive" ){
+            isAdaptive = true;
+            continue;
+        }
+        if ( option=="-d" || option=="--double" ){
+            isDouble = true;
+            continue;
+        }
+        if ( each==argvList.end() ){
+            printUsage(argv[0]);
+            return 0;
+        }
+        const string value = *each;
+        each = argvList.erase(each);
+
+        if ( option=="-k" || option=="--kernel" ){
+            if ( isAnySelected==false ){
+                isSelected.assign(nKernelId, false);
+                isAnySelected = true;
+            }
+            bool isFound = false;
+            for ( int k=0; k<nKernelId; k++ ){
+                if ( value==kernelIdNames[k] ){
+                    isSelected[k] = true;
+                    isFound = true;
+                }
+            }
+            if ( isFound==false ){
+                cerr << "ERROR: unknown kernel: " << value << endl;
+                return 1;
+            }
+        }
+        else if ( option=="--sizes" )       sizes       = parseList(value);
+        else if ( option=="--aspects" )     aspects     = parseList(value);
+        else if ( option=="--separations" ) separations = parseList(value);
+        else if ( option=="--shifts" )      shifts      = parseList(value);
+        else if ( option=="-t" || option=="--time" )      minTime  = atof(value.c_str());
+        else if ( option=="-e" || option=="--max-error" ) maxError = atof(value.c_str());
+        else if ( option=="-o" || option=="--csv" )       fileNameCsv = value;
+        else if ( option=="--order" )                     quadratureOrder = atoi(value.c_str());
+        else if ( option=="--shape" ){
+            if      ( value=="arch" )  shape = arch;
+            else if ( value=="side" )  shape = side;
+            else if ( value=="decay" ) shape = decayShape;
+            else{
+                cerr << "ERROR: unknown shape: " << value << endl;
+                return 1;
+            }
+        }
+        else{
+            printUsage(argv[0]);
+            return 0;
+        }
+    }
+
+    setQuadrature(quadratureOrder, isAdaptive);
+
+    #ifdef CAPLET_METRICS_KERNEL_TIME
+    cout << "NOTE: CAPLET_METRICS_KERNEL_TIME adds two clock reads to each Galerkin kernel call" << endl;
+    #endif
+
+    vector<Sample> samples;
+    for ( int k=0; k<nKernelId; k++ ){
+        if ( isSelected[k]==false ){
+            continue;
+        }
+        const bool isInternal = ( k>=INT_XY );
+        const int  nDir = isInternal? nDim : 1;
+        for ( size_t i1=0; i1<sizes.size(); i1++ )
+        for ( size_t i2=0; i2<aspects.size(); i2++ )
+        for ( size_t i3=0; i3<separations.size(); i3++ )
+        for ( size_t i4=0; i4<shifts.size(); i4++ )
+        for ( int dir=0; dir<nDir; dir++ ){
+            Sample sample;
+            sample.kernel = k;
+            Config &cfg = sample.config;
+            cfg.size       = sizes[i1];
+            cfg.aspect     = aspects[i2];
+            cfg.separation = separations[i3];
+            cfg.shift      = shifts[i4];
+            cfg.dir        = isInternal? dir : Z;
+
+            //* Composite panels no longer than half the gap
+            const double h = 0.5*cfg.separation*cfg.size;
+            if ( isInternal ){
+                InternalCase ic;
+                buildInternalCase(k, cfg, ic);
+                double l[nDim], c[nDim];
+                for ( int d=0; d<nDim; d++ ){
+                    l[d] = ic.l[d];
+                    c[d] = ic.c[d];
+                }
+                sample.reference = ( k==COL_D )? rectPotential(ic.a, ic.b, c[X], c[Y], c[Z])
+                                               : referenceInternal(ic.a, ic.b, l, c, h);
+                sample.value     = callInternal(k, ic, isDouble);
+                InternalCall call = { k, &ic, isDouble };
+                sample.nsPerCall = nsPerCall(call, minTime);
+            }else{
+                KernelCase kc;
+                buildKernelCase(k, cfg, shape, kc);
+                sample.reference = referencePEntry(kc.p1, kc.b1, kc.p2, kc.b2, h);
+                sample.value     = callKernel(k, kc, isDouble);
+                KernelCall call = { k, &kc, isDouble };
+                sample.nsPerCall = nsPerCall(call, minTime);
+            }
+            sample.relError = std::abs(sample.value - sample.reference)/std::abs(sample.reference);
+            samples.push_back(sample);
+        }
+    }
+
+    //* Per-configuration CSV
+    if ( fileNameCsv.empty()==false ){
+        ofstream ofile(fileNameCsv.c_str());
+        if ( !ofile ){
+            cerr << "ERROR: cannot write the file: " << fileNameCsv << endl;
+            return 1;
+        }
+        ofile.precision(9);
+        ofile << "kernel,size,aspect,separation,shift,dir,ns_per_call,value,reference,rel_error" << endl;
+        for ( size_t i=0; i<samples.size(); i++ ){
+            const Sample &s = samples[i];
+            ofile << kernelIdNames[s.kernel] << "," << s.config.size << "," << s.config.aspect << ","
+                  << s.config.separation << "," << s.config.shift << "," << "xyz"[s.config.dir] << ","
+                  << s.nsPerCall << "," << s.value << "," << s.reference << "," << s.relError << endl;
+        }
+    }
+
+    //* Summary per kernel
+    cout << left << setw(10) << "kernel" << right
+         << setw(8)  << "configs"
+         << setw(12) << "ns/call"
+         << setw(12) << "max_err"
+         << setw(12) << "rms_err"
+         << "   worst (size, aspect, separation, shift, dir)" << endl;
+    bool isFailed = false;
+    for ( int k=0; k<nKernelId; k++ ){
+        vector<double> ns;
+        double maxErr = 0, sumErr2 = 0;
+        const Sample *worst = 0;
+        for ( size_t i=0; i<samples.size(); i++ ){
+            if ( samples[i].kernel!=k ) continue;
+            ns.push_back(samples[i].nsPerCall);
+            sumErr2 += samples[i].relError*samples[i].relError;
+            if ( worst==0 || samples[i].relError>maxErr ){
+                maxErr = samples[i].relError;
+                worst  = &samples[i];
+            }
+        }
+        if ( ns.empty() ){
+            continue;
+        }
+        std::sort(ns.begin(), ns.end());
+        cout << left << setw(10) << kernelIdNames[k] << right
+             << setw(8)  << ns.size()
+             << setw(12) << setprecision(4) << ns[ns.size()/2]
+             << setw(12) << setprecision(3) << maxErr
+             << setw(12) << std::sqrt(sumErr2/ns.size())
+             << "   (" << worst->config.size << ", " << worst->config.aspect << ", "
+             << worst->config.separation << ", " << worst->config.shift << ", "
+             << "xyz"[worst->config.dir] << ")" << endl;
+        if ( maxError>=0 && maxErr>maxError ){
+            isFailed = true;
+        }
+    }
+    if ( isFailed ){
+        cout << "ERROR: relative error above " << maxError << endl;
+        return 1;
+    }
+    return 0;
+}
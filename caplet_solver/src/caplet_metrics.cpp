@@ -0,0 +1,261 @@
+/*
+Created: Oct 19, 2026
+Author : Yu-Chung Hsiao
+Email  : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "caplet_metrics.h"
+
+#include "mpi.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+namespace caplet{
+
+namespace metrics{
+
+static const char* const kernelNames[nKernel] = {
+    "ZFZF", "ZFXF",
+    "ZXZF", "ZXXF", "ZXYF",
+    "ZXZX", "ZXYX", "ZXZY", "ZXXZ", "ZXYZ", "ZXXY",
+    "collocation"
+};
+
+static const char* const integralNames[nIntegral] = {
+    "int_xy", "int_xyxy", "int_xyyz", "int_xyy", "int_xyz", "int_xy_d"
+};
+
+
+Registry& registry(){
+    static Registry instance;
+    return instance;
+}
+
+
+Registry::Registry()
+    :current(0), isReduced(false)
+{
+    Phase root;
+    root.name   = "";
+    root.parent = -1;
+    root.calls  = 0;
+    root.wall   = root.cpu = 0;
+    root.wallStart = root.cpuStart = 0;
+    phases.push_back(root);
+
+    std::memset(counters, 0, sizeof(counters));
+    std::memset(&total, 0, sizeof(total));
+}
+
+
+void Registry::begin(const std::string &name){
+    //* A phase entered again under the same parent accumulates
+    int phase = -1;
+    const std::vector<int> &children = phases[current].children;
+    for ( size_t i=0; i<children.size(); i++ ){
+        if ( phases[ children[i] ].name==name ){
+            phase = children[i];
+            break;
+        }
+    }
+    if ( phase<0 ){
+        Phase child;
+        child.name   = name;
+        child.parent = current;
+        child.calls  = 0;
+        child.wall   = child.cpu = 0;
+        phase = phases.size();
+        phases.push_back(child);
+        phases[current].children.push_back(phase);
+    }
+    current = phase;
+    phases[phase].wallStart = wallTime();
+    phases[phase].cpuStart  = cpuTime();
+}
+
+
+void Registry::end(){
+    if ( current==0 ){
+        std::cerr << "WARNING: metrics phase ended without being started" << std::endl;
+        return;
+    }
+    Phase &phase = phases[current];
+    phase.wall  += wallTime() - phase.wallStart;
+    phase.cpu   += cpuTime()  - phase.cpuStart;
+    phase.calls += 1;
+    current = phase.parent;
+}
+
+
+void Registry::count(const std::string &name, long long n){
+    namedCounters[name] += n;
+}
+
+
+void Registry::setValue(const std::string &name, double value){
+    values[name] = value;
+}
+
+
+void Registry::reduce(){
+    Counter local;
+    std::memset(&local, 0, sizeof(local));
+    for ( int t=0; t<nThread; t++ ){
+        for ( int k=0; k<nKernel; k++ ){
+            local.kernels[k]     += counters[t].kernels[k];
+            local.kernelTimes[k] += counters[t].kernelTimes[k];
+        }
+        for ( int k=0; k<nIntegral; k++ ){
+            local.integrals[k]   += counters[t].integrals[k];
+            local.analyticals[k] += counters[t].analyticals[k];
+        }
+    }
+    MPI::COMM_WORLD.Reduce(local.kernels, total.kernels, nKernel, MPI::LONG_LONG, MPI::SUM, 0);
+    MPI::COMM_WORLD.Reduce(local.kernelTimes, total.kernelTimes, nKernel, MPI::DOUBLE, MPI::SUM, 0);
+    MPI::COMM_WORLD.Reduce(local.integrals, total.integrals, nIntegral, MPI::LONG_LONG, MPI::SUM, 0);
+    MPI::COMM_WORLD.Reduce(local.analyticals, total.analyticals, nIntegral, MPI::LONG_LONG, MPI::SUM, 0);
+    isReduced = true;
+}
+
+
+static std::string quote(const std::string &text){
+    std::string result = "\"";
+    for ( size_t i=0; i<text.size(); i++ ){
+        if ( text[i]=='"' || text[i]=='\\' ){
+            result += '\\';
+        }
+        result += text[i];
+    }
+    return result + "\"";
+}
+
+
+void Registry::writePhase(std::ostream &out, int phase, int depth) const{
+    const std::string indent(2*depth, ' ');
+    const Phase &p = phases[phase];
+    out << indent << "{ \"name\": " << quote(p.name)
+        << ", \"calls\": " << p.calls
+        << ", \"wall_s\": " << p.wall
+        << ", \"cpu_s\": " << p.cpu
+        << ", \"children\": [";
+    for ( size_t i=0; i<p.children.size(); i++ ){
+        out << ( (i==0)? "\n" : ",\n" );
+        this->writePhase(out, p.children[i], depth+1);
+    }
+    if ( p.children.empty()==false ){
+        out << "\n" << indent;
+    }
+    out << "] }";
+}
+
+
+bool Registry::write(const std::string &filename, const std::string &program) const{
+    std::ofstream out(filename.c_str());
+    if ( !out ){
+        std::cerr << "ERROR: cannot open the file: " << filename << std::endl;
+        return false;
+    }
+    out.precision(9);
+
+    //* Counters of this process if they have not been reduced
+    Counter sum;
+    if ( isReduced ){
+        sum = total;
+    }else{
+        std::memset(&sum, 0, sizeof(sum));
+        for ( int t=0; t<nThread; t++ ){
+            for ( int k=0; k<nKernel; k++ ){
+                sum.kernels[k]     += counters[t].kernels[k];
+                sum.kernelTimes[k] += counters[t].kernelTimes[k];
+            }
+            for ( int k=0; k<nIntegral; k++ ){
+                sum.integrals[k]   += counters[t].integrals[k];
+                sum.analyticals[k] += counters[t].analyticals[k];
+            }
+        }
+    }
+
+    out << "{\n";
+    out << "  \"program\": " << quote(program) << ",\n";
+
+    out << "  \"phases\": [";
+    const std::vector<int> &roots = phases[0].children;
+    for ( size_t i=0; i<roots.size(); i++ ){
+        out << ( (i==0)? "\n" : ",\n" );
+        this->writePhase(out, roots[i], 2);
+    }
+    out << "\n  ],\n";
+
+    out << "  \"kernels\": {";
+    bool isFirst = true;
+    for ( int k=0; k<nKernel; k++ ){
+        if ( sum.kernels[k]==0 ){
+            continue;
+        }
+        out << ( isFirst? "\n" : ",\n" ) << "    " << quote(kernelNames[k])
+            << ": { \"calls\": " << sum.kernels[k];
+        #ifdef CAPLET_METRICS_KERNEL_TIME
+        out << ", \"thread_s\": " << sum.kernelTimes[k];
+        #endif
+        out << " }";
+        isFirst = false;
+    }
+    out << "\n  },\n";
+
+    out << "  \"integrals\": {";
+    isFirst = true;
+    for ( int k=0; k<nIntegral; k++ ){
+        if ( sum.integrals[k]==0 ){
+            continue;
+        }
+        out << ( isFirst? "\n" : ",\n" ) << "    " << quote(integralNames[k])
+            << ": { \"calls\": " << sum.integrals[k]
+            << ", \"far_field\": " << sum.integrals[k]-sum.analyticals[k] << " }";
+        isFirst = false;
+    }
+    out << "\n  },\n";
+
+    out << "  \"counters\": {";
+    isFirst = true;
+    for ( std::map<std::string, long long>::const_iterator each=namedCounters.begin();
+          each!=namedCounters.end(); ++each ){
+        out << ( isFirst? "\n" : ",\n" ) << "    " << quote(each->first) << ": " << each->second;
+        isFirst = false;
+    }
+    out << "\n  },\n";
+
+    out << "  \"values\": {";
+    isFirst = true;
+    for ( std::map<std::string, double>::const_iterator each=values.begin();
+          each!=values.end(); ++each ){
+        out << ( isFirst? "\n" : ",\n" ) << "    " << quote(each->first) << ": " << each->second;
+        isFirst = false;
+    }
+    out << "\n  }\n";
+    out << "}\n";
+
+    return true;
+}
+
+}
+
+}
@@ -0,0 +1,693 @@
+/*
+Created: Oct 19, 2026
+Author : Yu-Chung Hsiao
+Email  : project.caplet@gmail.com
+*/
+
+/*
+This file is part of CAPLET.
+
+CAPLET is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+CAPLET is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU Lesser General Public License for more details.
+
+You should have received a copy of the Lesser GNU General Public License
+along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "caplet_pfft.h"
+#include "caplet_parameter.h"
+#include "caplet_int.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace caplet{
+
+static inline std::complex<double> multiplyComplex(const std::complex<double> &a,
+                                                   const std::complex<double> &b){
+    return std::complex<double>( a.real()*b.real() - a.imag()*b.imag(),
+                                 a.real()*b.imag() + a.imag()*b.real() );
+}
+
+
+//* Mixed-radix decimation-in-time FFT (radices 4, 2 and 3):
+//  out[k] = sum_j in[j*stride] exp(-2 pi i jk/n), n = factors[0]*factors[1],
+//  where factors lists (radix, remaining length) pairs and
+//  roots[j*stride] = exp(-2 pi i j/n) for the full length of roots
+static void fft(std::complex<double>* out, const std::complex<double>* in, int stride,
+                const int* factors, const std::vector< std::complex<double> > &roots){
+    const int p  = factors[0];
+    const int mm = factors[1];
+    if ( mm==1 ){
+        for ( int q=0; q<p; q++ ){
+            out[q] = in[q*stride];
+        }
+    }else{
+        for ( int q=0; q<p; q++ ){
+            fft(out + q*mm, in + q*stride, stride*p, factors+2, roots);
+        }
+    }
+
+    switch ( p ){
+    case 2:
+        for ( int k=0; k<mm; k++ ){
+            const std::complex<double> t = multiplyComplex( out[k+mm], roots[k*stride] );
+            out[k+mm] = out[k] - t;
+            out[k]   += t;
+        }
+        break;
+    case 4:
+        for ( int k=0; k<mm; k++ ){
+            const std::complex<double> s0 = multiplyComplex( out[k+mm],   roots[k*stride] );
+            const std::complex<double> s1 = multiplyComplex( out[k+2*mm], roots[2*k*stride] );
+            const std::complex<double> s2 = multiplyComplex( out[k+3*mm], roots[3*k*stride] );
+            const std::complex<double> s5 = out[k] - s1;
+            const std::complex<double> s3 = s0 + s2;
+            const std::complex<double> s4 = s0 - s2;
+            out[k]     += s1;
+            out[k+2*mm] = out[k] - s3;
+            out[k]     += s3;
+            out[k+mm]   = std::complex<double>( s5.real() + s4.imag(), s5.imag() - s4.real() );
+            out[k+3*mm] = std::complex<double>( s5.real() - s4.imag(), s5.imag() + s4.real() );
+        }
+        break;
+    case 3:
+        {
+            const double sin3 = roots[mm*stride].imag();
+            for ( int k=0; k<mm; k++ ){
+                const std::complex<double> s1 = multiplyComplex( out[k+mm],   roots[k*stride] );
+                const std::complex<double> s2 = multiplyComplex( out[k+2*mm], roots[2*k*stride] );
+                const std::complex<double> s3 = s1 + s2;
+                const std::complex<double> s0 = (s1 - s2)*sin3;
+                const std::complex<double> t  = out[k] - 0.5*s3;
+                out[k]     += s3;
+                out[k+mm]   = std::complex<double>( t.real() - s0.imag(), t.imag() + s0.real() );
+                out[k+2*mm] = std::complex<double>( t.real() + s0.imag(), t.imag() - s0.real() );
+            }
+        }
+        break;
+    }
+}
+
+
+//* Point coord to the axes of panel in the frame of calColD,
+//  where the normal dir becomes z
+static void rotateToZ(float* coord[nDim][nBit], float (*panel)[nBit], int dir){
+    for ( int k=0; k<nDim; k++ ){
+        *coord[k] = panel[(dir+1+k)%nDim];
+    }
+}
+
+
+PrecorrectedFFT::PrecorrectedFFT(int nPanels, float (*panels)[nDim][nBit], const int* dirs,
+                                 const float* areas, const int* coefs, int nCoefs)
+    :nPanels(nPanels), nCoefs(nCoefs), coefs(coefs, coefs+nPanels), areas(areas, areas+nPanels)
+{
+    //* Grid spacing: no finer than the mean panel length, and at most
+    //  pfftGridPointsPerPanel points per panel in the bounding box
+    double lo[nDim], hi[nDim];
+    double meanLength = 0;
+    for ( int d=0; d<nDim; d++ ){
+        lo[d] = panels[0][d][MIN];
+        hi[d] = panels[0][d][MAX];
+    }
+    for ( int i=0; i<nPanels; i++ ){
+        for ( int d=0; d<nDim; d++ ){
+            lo[d] = std::min<double>(lo[d], panels[i][d][MIN]);
+            hi[d] = std::max<double>(hi[d], panels[i][d][MAX]);
+        }
+        meanLength += std::sqrt(areas[i]);
+    }
+    meanLength /= nPanels;
+    double volume = 1;
+    for ( int d=0; d<nDim; d++ ){
+        volume *= std::max(hi[d]-lo[d], meanLength);
+    }
+    h = std::max( meanLength, std::cbrt( volume/(pfftGridPointsPerPanel*nPanels) ) );
+
+    //* Two spare points on each side keep the stencils on the grid
+    for ( int d=0; d<nDim; d++ ){
+        origin[d] = lo[d] - 2*h;
+        n[d] = int( std::ceil( (hi[d]-lo[d])/h ) ) + 5;
+        //* Smallest 2^a 3^b for the aperiodic convolution
+        m[d] = 1 << 30;
+        for ( int p2=1; p2<m[d]; p2*=2 ){
+            int p = p2;
+            while ( p < 2*n[d]-1 ){
+                p *= 3;
+            }
+            m[d] = std::min(m[d], p);
+        }
+        factors[d].clear();
+        for ( int rest=m[d]; rest>1; ){
+            const int p = ( rest%4==0 )? 4 : ( rest%2==0 )? 2 : 3;
+            rest /= p;
+            factors[d].push_back(p);
+            factors[d].push_back(rest);
+        }
+        if ( m[d]==1 ){
+            factors[d].push_back(1);
+            factors[d].push_back(1);
+        }
+        roots[d].resize(m[d]);
+        for ( int k=0; k<m[d]; k++ ){
+            roots[d][k] = std::polar(1.0, -2*M_PI*k/m[d]);
+        }
+    }
+
+    //* Stencils of the panels
+    cells.resize(nDim*nPanels);
+    projection.assign(nStencil*nPanels, 0.0);
+    interpolation.assign(nStencil*nPanels, 0.0);
+    const double gaussPoint = 0.5/std::sqrt(3.0);
+    for ( int i=0; i<nPanels; i++ ){
+        double center[nDim];
+        for ( int d=0; d<nDim; d++ ){
+            center[d] = 0.5*( double(panels[i][d][MIN]) + double(panels[i][d][MAX]) );
+            cells[nDim*i+d] = int( std::floor( (center[d]-origin[d])/h + 0.5 ) );
+        }
+        this->setWeights(center, &cells[nDim*i], 1.0, &interpolation[nStencil*i]);
+
+        const int u = (dirs[i]+1)%nDim;
+        const int v = (dirs[i]+2)%nDim;
+        for ( int gu=-1; gu<=1; gu+=2 ){
+            for ( int gv=-1; gv<=1; gv+=2 ){
+                double point[nDim] = { center[X], center[Y], center[Z] };
+                point[u] += gu*gaussPoint*( double(panels[i][u][MAX]) - double(panels[i][u][MIN]) );
+                point[v] += gv*gaussPoint*( double(panels[i][v][MAX]) - double(panels[i][v][MIN]) );
+                this->setWeights(point, &cells[nDim*i], 0.25*areas[i], &projection[nStencil*i]);
+            }
+        }
+    }
+
+    grid.resize( (long long)m[X]*m[Y]*m[Z] );
+    this->computeKernel();
+    this->computeNearField(panels, dirs);
+}
+
+
+const int* PrecorrectedFFT::getGridSize() const{
+    return n;
+}
+
+
+double PrecorrectedFFT::getGridSpacing() const{
+    return h;
+}
+
+
+long long PrecorrectedFFT::getNNearEntries() const{
+    return nearPanels.size();
+}
+
+
+inline int PrecorrectedFFT::index(int x, int y, int z) const{
+    return x + m[X]*( y + m[Y]*z );
+}
+
+
+//* weights[a+3*(b+3*c)] += weight * Lagrange weights of point at the
+//  grid point cell+(a-1, b-1, c-1)
+void PrecorrectedFFT::setWeights(const double point[nDim], const int cell[nDim],
+                                 double weight, double* weights) const{
+    double w[nDim][3];
+    for ( int d=0; d<nDim; d++ ){
+        const double t = ( point[d] - (origin[d] + cell[d]*h) )/h;
+        w[d][0] = 0.5*t*(t-1);
+        w[d][1] = 1 - t*t;
+        w[d][2] = 0.5*t*(t+1);
+    }
+    for ( int c=0; c<3; c++ ){
+        for ( int b=0; b<3; b++ ){
+            for ( int a=0; a<3; a++ ){
+                weights[a+3*(b+3*c)] += weight*w[X][a]*w[Y][b]*w[Z][c];
+            }
+        }
+    }
+}
+
+
+//* FFT along dir of the lines over [0,count1) x [0,count2) of the two
+//  other directions (in increasing order). Lines are gathered in groups
+//  of lineBlock neighbors so that strided passes read whole cache lines.
+void PrecorrectedFFT::transformLines(int dir, bool isInverse, int count1, int count2){
+    const int lineBlock = 8;
+    const int a = ( dir==X )? Y : X;
+    const int b = ( dir==Z )? Y : Z;
+    const long long stride[nDim] = { 1, m[X], (long long)m[X]*m[Y] };
+    const int len     = m[dir];
+    const int nGroup1 = (count1 + lineBlock - 1)/lineBlock;
+    const int nGroups = nGroup1*count2;
+
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    {
+        //* The inverse transform is conj(FFT(conj(.)))
+        std::vector< std::complex<double> > lines(lineBlock*len);
+        std::vector< std::complex<double> > results(lineBlock*len);
+        #ifdef CAPLET_OPENMP
+        #pragma omp for
+        #endif
+        for ( int k=0; k<nGroups; k++ ){
+            const int first  = (k%nGroup1)*lineBlock;
+            const int nLines = std::min(lineBlock, count1-first);
+            std::complex<double>* p = &grid[0] + first*stride[a] + (k/nGroup1)*stride[b];
+            for ( int i=0; i<len; i++ ){
+                for ( int l=0; l<nLines; l++ ){
+                    const std::complex<double> &each = p[i*stride[dir] + l*stride[a]];
+                    lines[l*len+i] = isInverse? std::conj(each) : each;
+                }
+            }
+            for ( int l=0; l<nLines; l++ ){
+                fft(&results[l*len], &lines[l*len], 1, &factors[dir][0], roots[dir]);
+            }
+            for ( int i=0; i<len; i++ ){
+                for ( int l=0; l<nLines; l++ ){
+                    const std::complex<double> &each = results[l*len+i];
+                    p[i*stride[dir] + l*stride[a]] = isInverse? std::conj(each) : each;
+                }
+            }
+        }
+    }
+}
+
+
+//* Charges only occupy the first n points of each direction, and only
+//  these potentials are read, so lines outside them are skipped
+void PrecorrectedFFT::transform(bool isInverse){
+    if ( isInverse==false ){
+        this->transformLines(X, false, n[Y], n[Z]);
+        this->transformLines(Y, false, m[X], n[Z]);
+        this->transformLines(Z, false, m[X], m[Y]);
+    }else{
+        this->transformLines(Z, true, m[X], m[Y]);
+        this->transformLines(Y, true, m[X], n[Z]);
+        this->transformLines(X, true, n[Y], n[Z]);
+    }
+}
+
+
+//* Transform of 1/r on the padded grid (0 at r=0; pairs with coinciding
+//  grid points are precorrected), scaled by the inverse transform
+void PrecorrectedFFT::computeKernel(){
+    std::fill(grid.begin(), grid.end(), std::complex<double>(0));
+    for ( int z=0; z<m[Z]; z++ ){
+        const int dz = ( z<n[Z] )? z : z-m[Z];
+        if ( dz<=-n[Z] ) continue;
+        for ( int y=0; y<m[Y]; y++ ){
+            const int dy = ( y<n[Y] )? y : y-m[Y];
+            if ( dy<=-n[Y] ) continue;
+            for ( int x=0; x<m[X]; x++ ){
+                const int dx = ( x<n[X] )? x : x-m[X];
+                if ( dx<=-n[X] || (dx==0 && dy==0 && dz==0) ) continue;
+                grid[ index(x,y,z) ] = 1/( h*std::sqrt( double(dx*dx + dy*dy + dz*dz) ) );
+            }
+        }
+    }
+    this->transformLines(X, false, m[Y], m[Z]);
+    this->transformLines(Y, false, m[X], m[Z]);
+    this->transformLines(Z, false, m[X], m[Y]);
+
+    const double scale = 1.0/grid.size();
+    kernelHat.resize(grid.size());
+    for ( size_t k=0; k<grid.size(); k++ ){
+        kernelHat[k] = grid[k].real()*scale;
+    }
+}
+
+
+void PrecorrectedFFT::computeNearField(float (*panels)[nDim][nBit], const int* dirs){
+    const int R  = std::max(2, pfftNearCells);
+
+    //* Panels sorted by grid point
+    std::vector< std::pair<int,int> > byCell(nPanels);
+    for ( int i=0; i<nPanels; i++ ){
+        const int* c = &cells[nDim*i];
+        byCell[i] = std::make_pair( c[X] + n[X]*( c[Y] + n[Y]*c[Z] ), i );
+    }
+    std::sort(byCell.begin(), byCell.end());
+
+    //* Panels within R grid points in each direction
+    nearStart.assign(nPanels+1, 0);
+    nearPanels.clear();
+    for ( int j=0; j<nPanels; j++ ){
+        nearStart[j] = nearPanels.size();
+        const int* c = &cells[nDim*j];
+        for ( int z=std::max(0, c[Z]-R); z<=std::min(n[Z]-1, c[Z]+R); z++ ){
+            for ( int y=std::max(0, c[Y]-R); y<=std::min(n[Y]-1, c[Y]+R); y++ ){
+                const int key1 = std::max(0, c[X]-R)          + n[X]*( y + n[Y]*z );
+                const int key2 = std::min(n[X]-1, c[X]+R)     + n[X]*( y + n[Y]*z );
+                std::vector< std::pair<int,int> >::const_iterator each =
+                        std::lower_bound( byCell.begin(), byCell.end(), std::make_pair(key1, -1) );
+                for ( ; each!=byCell.end() && each->first<=key2; ++each ){
+                    nearPanels.push_back(each->second);
+                }
+            }
+        }
+    }
+    nearStart[nPanels] = nearPanels.size();
+    nearValues.resize(nearPanels.size());
+    std::vector<double> exactValues(nearPanels.size());
+
+    //* 1/r between grid points up to R+2 apart
+    const int G = R+2;
+    const int W = 2*G+1;
+    std::vector<double> gTable(W*W*W);
+    for ( int z=-G; z<=G; z++ ){
+        for ( int y=-G; y<=G; y++ ){
+            for ( int x=-G; x<=G; x++ ){
+                const int r2 = x*x + y*y + z*z;
+                gTable[ (x+G) + W*( (y+G) + W*(z+G) ) ] = ( r2==0 )? 0 : 1/( h*std::sqrt(double(r2)) );
+            }
+        }
+    }
+
+    //* Exact entries minus their part through the grid
+    const int F = 2*(R+1)+1;
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    {
+        std::vector<double> field(F*F*F);
+        float* coord1[nDim][nBit];
+        float* coord2[nDim][nBit];
+        #ifdef CAPLET_OPENMP
+        #pragma omp for schedule(dynamic, 64)
+        #endif
+        for ( int j=0; j<nPanels; j++ ){
+            //* Grid potentials of panel j within R+1 points of its cell
+            const double* P = &projection[nStencil*j];
+            for ( int z=-(R+1); z<=R+1; z++ ){
+                for ( int y=-(R+1); y<=R+1; y++ ){
+                    for ( int x=-(R+1); x<=R+1; x++ ){
+                        double phi = 0;
+                        for ( int s=0; s<nStencil; s++ ){
+                            const int sx = s%3-1, sy = (s/3)%3-1, sz = s/9-1;
+                            phi += P[s]*gTable[ (x-sx+G) + W*( (y-sy+G) + W*(z-sz+G) ) ];
+                        }
+                        field[ (x+R+1) + F*( (y+R+1) + F*(z+R+1) ) ] = phi;
+                    }
+                }
+            }
+
+            rotateToZ(coord2, panels[j], dirs[j]);
+            for ( int k=nearStart[j]; k<nearStart[j+1]; k++ ){
+                const int i = nearPanels[k];
+                const double* I = &interpolation[nStencil*i];
+                const int ox = cells[nDim*i+X] - cells[nDim*j+X];
+                const int oy = cells[nDim*i+Y] - cells[nDim*j+Y];
+                const int oz = cells[nDim*i+Z] - cells[nDim*j+Z];
+                double phi = 0;
+                for ( int s=0; s<nStencil; s++ ){
+                    const int sx = s%3-1, sy = (s/3)%3-1, sz = s/9-1;
+                    phi += I[s]*field[ (ox+sx+R+1) + F*( (oy+sy+R+1) + F*(oz+sz+R+1) ) ];
+                }
+                rotateToZ(coord1, panels[i], dirs[j]);
+                exactValues[k] = areas[i]*calColD(coord1, coord2);
+                nearValues[k]  = exactValues[k] - areas[i]*phi;
+            }
+        }
+    }
+
+    //* Diagonal of the system for the preconditioner
+    diagonal.assign(nCoefs, 0.0);
+    for ( int j=0; j<nPanels; j++ ){
+        for ( int k=nearStart[j]; k<nearStart[j+1]; k++ ){
+            if ( coefs[nearPanels[k]]==coefs[j] ){
+                diagonal[coefs[j]] += exactValues[k];
+            }
+        }
+    }
+}
+
+
+void PrecorrectedFFT::multiply(const double* x, double* y){
+    this->multiplyPair(x, 0, y, 0);
+}
+
+
+//* y1 = P x1 and y2 = P x2 through the real and imaginary parts of the
+//  grid, which the real and even kernel keeps apart (x2 = 0: skipped)
+void PrecorrectedFFT::multiplyPair(const double* x1, const double* x2, double* y1, double* y2){
+    //* Projection
+    std::fill(grid.begin(), grid.end(), std::complex<double>(0));
+    for ( int j=0; j<nPanels; j++ ){
+        const double q1 = ( x1==0 )? 0 : x1[coefs[j]];
+        const double q2 = ( x2==0 )? 0 : x2[coefs[j]];
+        const int* c = &cells[nDim*j];
+        for ( int s=0; s<nStencil; s++ ){
+            const double p = projection[nStencil*j+s];
+            grid[ index( c[X]+s%3-1, c[Y]+(s/3)%3-1, c[Z]+s/9-1 ) ] += std::complex<double>(p*q1, p*q2);
+        }
+    }
+
+    //* Convolution
+    this->transform(false);
+    const int size = grid.size();
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel for num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int k=0; k<size; k++ ){
+        grid[k] *= kernelHat[k];
+    }
+    this->transform(true);
+
+    //* Interpolation
+    std::vector< std::complex<double> > phi(nPanels);
+    #ifdef CAPLET_OPENMP
+    #pragma omp parallel for num_threads(CAPLET_OPENMP_NUM_THREADS)
+    #endif
+    for ( int i=0; i<nPanels; i++ ){
+        const int* c = &cells[nDim*i];
+        std::complex<double> sum = 0;
+        for ( int s=0; s<nStencil; s++ ){
+            sum += interpolation[nStencil*i+s]*grid[ index( c[X]+s%3-1, c[Y]+(s/3)%3-1, c[Z]+s/9-1 ) ];
+        }
+        phi[i] = sum;
+    }
+
+    //* Precorrection
+    const double* x[2] = { x1, x2 };
+    double*       y[2] = { y1, y2 };
+    for ( int c=0; c<2; c++ ){
+        if ( y[c]==0 ){
+            continue;
+        }
+        std::fill(y[c], y[c]+nCoefs, 0.0);
+        for ( int i=0; i<nPanels; i++ ){
+            y[c][coefs[i]] += areas[i]*( (c==0)? phi[i].real() : phi[i].imag() );
+        }
+        if ( x[c]==0 ){
+            continue;
+        }
+        for ( int j=0; j<nPanels; j++ ){
+            const double xj = x[c][coefs[j]];
+            for ( int k=nearStart[j]; k<nearStart[j+1]; k++ ){
+                y[c][coefs[nearPanels[k]]] += nearValues[k]*xj;
+            }
+        }
+    }
+}
+
+
+int PrecorrectedFFT::solve(int nRhs, const double* b, double* x, bool isInitialGuess){
+    int maxIter = 0;
+    for ( int c=0; c<nRhs; c+=2 ){
+        const int iter = this->solvePair( std::min(2, nRhs-c), b + c*nCoefs, x + c*nCoefs, isInitialGuess );
+        if ( iter<0 ){
+            return -1;
+        }
+        maxIter = std::max(maxIter, iter);
+    }
+    return maxIter;
+}
+
+
+//* Restarted GMRES on S P S u = S b, x = S u, with S = D^-1/2 and D the
+//  diagonal of P, for the nPair (1 or 2) columns of b in lockstep
+int PrecorrectedFFT::solvePair(int nPair, const double* b, double* x, bool isInitialGuess){
+    const int N = nCoefs;
+    const int R = pfftGmresRestart;
+
+    std::vector<double> scale(N);
+    for ( int k=0; k<N; k++ ){
+        scale[k] = 1/std::sqrt(diagonal[k]);
+    }
+
+    std::vector<double> V[2], H[2], cs[2], sn[2], g[2], coef[2], r[2], z[2];
+    double target[2] = { 0, 0 };
+    bool   isActive[2] = { false, false };
+    for ( int c=0; c<nPair; c++ ){
+        V[c].resize( (R+1)*N );
+        H[c].assign( (R+1)*R, 0.0 );
+        cs[c].resize(R);
+        sn[c].resize(R);
+        g[c].resize(R+1);
+        coef[c].resize(R);
+        r[c].resize(N);
+        z[c].resize(N);
+
+        double normB = 0;
+        for ( int k=0; k<N; k++ ){
+            if ( isInitialGuess==false ){
+                x[c*N+k] = 0;
+            }
+            r[c][k]  = scale[k]*b[c*N+k];
+            normB   += r[c][k]*r[c][k];
+        }
+        target[c]   = pfftTolerance*std::sqrt(normB);
+        isActive[c] = ( normB>0 );
+    }
+    if ( isInitialGuess==true ){
+        this->multiplyPair( isActive[0]? x : 0, isActive[1]? x+N : 0,
+                            isActive[0]? &r[0][0] : 0, isActive[1]? &r[1][0] : 0 );
+        for ( int c=0; c<nPair; c++ ){
+            if ( isActive[c] ){
+                for ( int k=0; k<N; k++ ){
+                    r[c][k] = scale[k]*( b[c*N+k] - r[c][k] );
+                }
+            }
+        }
+    }
+
+    int iter = 0;
+    while ( true ){
+        for ( int c=0; c<nPair; c++ ){
+            if ( isActive[c]==false ){
+                continue;
+            }
+            double beta = 0;
+            for ( int k=0; k<N; k++ ){
+                beta += r[c][k]*r[c][k];
+            }
+            beta = std::sqrt(beta);
+            if ( beta<=target[c] ){
+                isActive[c] = false;
+                continue;
+            }
+            for ( int k=0; k<N; k++ ){
+                V[c][k] = r[c][k]/beta;
+            }
+            std::fill(g[c].begin(), g[c].end(), 0.0);
+            g[c][0] = beta;
+        }
+        if ( isActive[0]==false && isActive[1]==false ){
+            return iter;
+        }
+        if ( iter>=pfftMaxIterations ){
+            return -1;
+        }
+
+        bool isRunning[2] = { isActive[0], isActive[1] };
+        int  nStep[2]     = { 0, 0 };
+        for ( int s=0; s<R && iter<pfftMaxIterations && (isRunning[0] || isRunning[1]); s++, iter++ ){
+            for ( int c=0; c<nPair; c++ ){
+                if ( isRunning[c] ){
+                    for ( int k=0; k<N; k++ ){
+                        z[c][k] = scale[k]*V[c][s*N+k];
+                    }
+                }
+            }
+            this->multiplyPair( isRunning[0]? &z[0][0] : 0, isRunning[1]? &z[1][0] : 0,
+                                isRunning[0]? &r[0][0] : 0, isRunning[1]? &r[1][0] : 0 );
+
+            for ( int c=0; c<nPair; c++ ){
+                if ( isRunning[c]==false ){
+                    continue;
+                }
+                double* v  = &V[c][(s+1)*N];
+                double* hs = &H[c][0];      //* H(l,s) = hs[l*R+s]
+                for ( int k=0; k<N; k++ ){
+                    v[k] = scale[k]*r[c][k];
+                }
+
+                //* Modified Gram-Schmidt
+                for ( int l=0; l<=s; l++ ){
+                    const double* vl = &V[c][l*N];
+                    double dot = 0;
+                    for ( int k=0; k<N; k++ ){
+                        dot += v[k]*vl[k];
+                    }
+                    hs[l*R+s] = dot;
+                    for ( int k=0; k<N; k++ ){
+                        v[k] -= dot*vl[k];
+                    }
+                }
+                double norm = 0;
+                for ( int k=0; k<N; k++ ){
+                    norm += v[k]*v[k];
+                }
+                norm = std::sqrt(norm);
+                hs[(s+1)*R+s] = norm;
+                if ( norm>0 ){
+                    for ( int k=0; k<N; k++ ){
+                        v[k] /= norm;
+                    }
+                }
+
+                //* Givens rotations
+                for ( int l=0; l<s; l++ ){
+                    const double temp = cs[c][l]*hs[l*R+s] + sn[c][l]*hs[(l+1)*R+s];
+                    hs[(l+1)*R+s] = -sn[c][l]*hs[l*R+s] + cs[c][l]*hs[(l+1)*R+s];
+                    hs[l*R+s]     = temp;
+                }
+                const double denom = std::sqrt( hs[s*R+s]*hs[s*R+s] + hs[(s+1)*R+s]*hs[(s+1)*R+s] );
+                cs[c][s] = hs[s*R+s]/denom;
+                sn[c][s] = hs[(s+1)*R+s]/denom;
+                hs[s*R+s]     = denom;
+                hs[(s+1)*R+s] = 0;
+                g[c][s+1] = -sn[c][s]*g[c][s];
+                g[c][s]   =  cs[c][s]*g[c][s];
+
+                nStep[c] = s+1;
+                if ( std::abs(g[c][s+1])<=target[c] || norm==0 ){
+                    isRunning[c] = false;
+                }
+            }
+        }
+
+        //* x += S V y with H y = g
+        for ( int c=0; c<nPair; c++ ){
+            if ( isActive[c]==false ){
+                continue;
+            }
+            const double* hs = &H[c][0];
+            for ( int l=nStep[c]-1; l>=0; l-- ){
+                double sum = g[c][l];
+                for ( int k=l+1; k<nStep[c]; k++ ){
+                    sum -= hs[l*R+k]*coef[c][k];
+                }
+                coef[c][l] = sum/hs[l*R+l];
+            }
+            for ( int k=0; k<N; k++ ){
+                double sum = 0;
+                for ( int l=0; l<nStep[c]; l++ ){
+                    sum += coef[c][l]*V[c][l*N+k];
+                }
+                x[c*N+k] += scale[k]*sum;
+            }
+        }
+
+        //* True residuals
+        this->multiplyPair( isActive[0]? x : 0, isActive[1]? x+N : 0,
+                            isActive[0]? &r[0][0] : 0, isActive[1]? &r[1][0] : 0 );
+        for ( int c=0; c<nPair; c++ ){
+            if ( isActive[c] ){
+                for ( int k=0; k<N; k++ ){
+                    r[c][k] = scale[k]*( b[c*N+k] - r[c][k] );
+                }
+            }
+        }
+    }
+}
+
+}
@@ -22,6 +22,7 @@ along with CAPLET.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "caplet.h"
+#include "caplet_int.h"
 
 #include "mpi.h" 
 
@@ -39,8 +40,34 @@ void printUsage(char* command){
          << "        or   piecewise constant basis functions (.qui)" << endl
          << "Usage  : " << command << " [OPTION] INPUT.caplet [-o OUTPUT]" << endl
          << "   or  : " << command << " [OPTION] INPUT.qui    [-o OUTPUT]" << endl
+         << "   or  : " << command << " [OPTION] INPUT.sweep" << endl
+         << "         (variants from caplet_geo_cli --sweep; writes VARIANT.cmat each)" << endl
          << "Option : " << endl
-         << "  -d, --double              use double-precision LAPACK" << endl
+         << "  -d, --double              fill with double-precision kernels and solve" << endl
+         << "                            with double-precision LAPACK" << endl
+         << "  -c, --cache FILE          keep the system matrix in FILE; a later run on" << endl
+         << "                            an edited structure only recomputes the entries" << endl
+         << "                            of changed basis functions (single precision)" << endl
+         << "  -p, --periodic            detect periodic conductor cells (buses, arrays)" << endl
+         << "                            and only fill their unique P blocks" << endl
+         << "                            (single precision)" << endl
+         << "  -s, --symmetric           detect mirror symmetry about the x and y center" << endl
+         << "                            planes and solve the symmetric and antisymmetric" << endl
+         << "                            half-problems only (single precision)" << endl
+         << "  -f, --fft                 solve .qui inputs by precorrected-FFT and GMRES" << endl
+         << "                            without storing the system matrix" << endl
+         << "  -r, --refine TOLERANCE    solve .qui inputs by precorrected FFT, split" << endl
+         << "                            the panels of largest estimated error and" << endl
+         << "                            solve again until Cmat changes by less than" << endl
+         << "                            TOLERANCE (%)" << endl
+         << "  -q, --quadrature ORDER    Gauss points per dimension (1-6) of the" << endl
+         << "                            numerical P-entry kernels; default keeps" << endl
+         << "                            the per-kernel orders of caplet_parameter.h" << endl
+         << "  -a, --adaptive-quadrature lower the order of well-separated pairs to" << endl
+         << "                            the cheapest one within the error model of" << endl
+         << "                            caplet_parameter.h (-q sets the near-field order)" << endl
+         << "  -m, --metrics FILE        write per-phase wall/CPU time, kernel classes" << endl
+         << "                            and far-field hits of P entries to FILE (JSON)" << endl
          << "  -v, --version             print version info" << endl;
 } 
 
@@ -57,9 +84,18 @@ int main(int argc, char *argv[]){
     string fileExtName;
     const string capletExt  = "caplet";
     const string fastcapExt = "qui";
+    const string sweepExt   = "sweep";
     string fileNameCmat  = "";
+    string fileNameCache = "";
+    string fileNameMetrics = "";
 
     bool flagDouble = false; //* single precision fast solution
+    bool flagPeriodic = false;
+    bool flagSymmetric = false;
+    bool flagFFT = false;
+    float adaptiveTolerance = 0;
+    bool flagAdaptiveQuadrature = false;
+    int  quadratureOrder = 0;   //* 0: per-kernel defaults
 
     list<string> argvList;
     for (int i=1; i<argc; ++i){ //* skip command name
@@ -81,12 +117,89 @@ int main(int argc, char *argv[]){
             each = argvList.erase(each);
         }
 
+        //* Read cache file name
+        else if (each->compare("-c")==0 || each->compare("--cache")==0 ){
+            each = argvList.erase(each);
+            if (each == argvList.end()){
+                printUsage(argv[0]);
+                return 0;
+            }
+            fileNameCache = *each;
+            each = argvList.erase(each);
+        }
+
+        //* Read metrics file name
+        else if (each->compare("-m")==0 || each->compare("--metrics")==0 ){
+            each = argvList.erase(each);
+            if (each == argvList.end()){
+                printUsage(argv[0]);
+                return 0;
+            }
+            fileNameMetrics = *each;
+            each = argvList.erase(each);
+        }
+
+        //* Read quadrature order
+        else if (each->compare("-q")==0 || each->compare("--quadrature")==0 ){
+            each = argvList.erase(each);
+            if (each == argvList.end()){
+                printUsage(argv[0]);
+                return 0;
+            }
+            quadratureOrder = atoi(each->c_str());
+            if ( quadratureOrder<1 || quadratureOrder>maxQuadratureOrder ){
+                cout << "CAPLET: Quadrature order must be 1 to "
+                     << maxQuadratureOrder << " (" << *each << ")." << endl;
+                return 0;
+            }
+            each = argvList.erase(each);
+        }
+
+        //* Flag -a --adaptive-quadrature
+        else if (each->compare("-a")==0 || each->compare("--adaptive-quadrature")==0 ){
+            flagAdaptiveQuadrature = true;
+            each = argvList.erase(each);
+        }
+
         //* Flag -f for single-precision fast solution
         else if (each->compare("-d")==0 || each->compare("--double")==0 ){
             flagDouble = true;
             each = argvList.erase(each);
         }
 
+        //* Flag -p --periodic
+        else if (each->compare("-p")==0 || each->compare("--periodic")==0 ){
+            flagPeriodic = true;
+            each = argvList.erase(each);
+        }
+
+        //* Flag -s --symmetric
+        else if (each->compare("-s")==0 || each->compare("--symmetric")==0 ){
+            flagSymmetric = true;
+            each = argvList.erase(each);
+        }
+
+        //* Flag -f --fft
+        else if (each->compare("-f")==0 || each->compare("--fft")==0 ){
+            flagFFT = true;
+            each = argvList.erase(each);
+        }
+
+        //* Read adaptive refinement tolerance (%)
+        else if (each->compare("-r")==0 || each->compare("--refine")==0 ){
+            each = argvList.erase(each);
+            if (each == argvList.end()){
+                printUsage(argv[0]);
+                return 0;
+            }
+            adaptiveTolerance = atof(each->c_str())/100;
+            if ( adaptiveTolerance<=0 ){
+                cout << "CAPLET: Refinement tolerance must be positive (" << *each << ")." << endl;
+                return 0;
+            }
+            each = argvList.erase(each);
+        }
+
         //* Flag -v --version
         else if (each->compare("-v")==0 || each->compare("--version")==0 ){
             printVersion();
@@ -134,6 +247,8 @@ int main(int argc, char *argv[]){
 
     //* Call Caplet
     Caplet caplet;
+    caplet.setMetricsFile(fileNameMetrics);
+    caplet.setQuadrature(quadratureOrder, flagAdaptiveQuadrature);
 
 
     if ( fileExtName.compare(capletExt)==0 ){
@@ -142,11 +257,24 @@ int main(int argc, char *argv[]){
             caplet.extractC( Caplet::DOUBLE_GALERKIN );
         }
         else{
+            caplet.setCacheFile(fileNameCache);
+            caplet.setPeriodic(flagPeriodic);
+            caplet.setSymmetric(flagSymmetric);
             caplet.extractC( Caplet::FAST_GALERKIN );
         }
     }
+    else if ( fileExtName.compare(sweepExt)==0 ){
+        //* Cmat of each variant is saved as variant.cmat
+        caplet.setPeriodic(flagPeriodic);
+        caplet.setSymmetric(flagSymmetric);
+        caplet.extractSweep( folderPath+"/"+fileName,
+                             (flagDouble==true)? Caplet::DOUBLE_GALERKIN : Caplet::FAST_GALERKIN );
+        return 0;
+    }
     else if ( fileExtName.compare(fastcapExt)==0 ){
         caplet.loadFastcapFile(folderPath+"/"+fileName);
+        caplet.setPrecorrectedFFT(flagFFT || adaptiveTolerance>0);
+        caplet.setAdaptiveRefinement(adaptiveTolerance);
         caplet.extractC( Caplet::DOUBLE_COLLOCATION );
     }
     else{